@@ -32,13 +32,30 @@
 #include <aerospike/as_udf.h>
 
 #include <hdr_histogram/hdr_histogram.h>
+#include <conc_limiter.h>
+#include <cpu_affinity.h>
+#include <digest_table.h>
 #include <dynamic_throttle.h>
+#include <error_stats.h>
+#include <group_stats.h>
 #include <histogram.h>
+#include <interval_log.h>
+#include <key_tracker.h>
+#include <node_stats.h>
 #include <object_spec.h>
+#include <perf_counters.h>
+#include <proc_stats.h>
+#include <self_stats.h>
+#include <slow_ops.h>
+#include <stage_budget.h>
+#include <trace.h>
+#include <warmup_stats.h>
 #include <workload.h>
 
 // forward declare thr_coordinator for use in threaddata
 struct thr_coordinator_s;
+// defined in transaction.c
+struct async_pool_s;
 
 typedef struct args_s {
 	char* hosts;
@@ -67,6 +84,8 @@ typedef struct args_s {
 	int transaction_worker_threads;
 	bool enable_compression;
 	float compression_ratio;
+	// when true, list/map bins are packed straight to msgpack
+	bool packed_cdt;
 
 	int conn_timeout_ms;
 	int read_socket_timeout;
@@ -77,11 +96,39 @@ typedef struct args_s {
 	int sleep_between_retries;
 	bool debug;
 	bool latency;
+	bool latency_corrected;
 	as_vector latency_percentiles;
 	bool latency_histogram;
 	char* histogram_output;
 	int histogram_period;
 	char* hdr_output;
+	// this process is instance_id of instance_count splitting the run
+	int instance_id;
+	int instance_count;
+	// the interval logs to merge instead of running, NULL to run
+	char* merge_paths;
+	// the number of worker processes to split the run between, 1 to run in
+	// this process
+	int processes;
+	// set in each worker process to the segment it shares with the parent
+	// and its slot in it
+	proc_stats_t* proc_stats;
+	uint32_t proc_idx;
+	bool node_stats;
+	int node_stats_top_n;
+	int error_log_rate;
+	char* slow_ops_file;
+	int slow_ops_k;
+	char* trace_prefix;
+	int trace_sample;
+	bool self_stats;
+	bool perf_counters;
+	int perf_counters_sample;
+	bool digest_table;
+	uint64_t digest_table_max_keys;
+	char* digest_table_file;
+	bool key_tracking;
+	float read_miss_pct;
 	bool use_shm;
 	as_policy_key key;
 	as_policy_replica replica;
@@ -96,7 +143,14 @@ typedef struct args_s {
 	int async_max_conns_per_node;
 	bool durable_deletes;
 	int async_max_commands;
+	bool async_adaptive;
+	bool async_self_sustaining;
 	int event_loop_capacity;
+	char* cpu_list;
+	int numa_node;
+	// where threads and their memory are placed, resolved from cpu_list and
+	// numa_node
+	cpu_affinity_t affinity;
 	as_config_tls tls;
 	char* tls_name;
 	as_auth_mode auth_mode;
@@ -121,6 +175,8 @@ typedef struct clientdata_s {
 	_Atomic(uint64_t) write_count;
 	_Atomic(uint64_t) write_timeout_count;
 	_Atomic(uint64_t) write_error_count;
+	// the number of bytes of bin data successfully written
+	_Atomic(uint64_t) write_bytes;
 
 	_Atomic(uint64_t) udf_count;
 	_Atomic(uint64_t) udf_timeout_count;
@@ -136,6 +192,11 @@ typedef struct clientdata_s {
 	struct hdr_histogram* read_hdr;
 	struct hdr_histogram* write_hdr;
 	struct hdr_histogram* udf_hdr;
+	// the same latencies with coordinated omission corrected for, only
+	// allocated with latency_corrected
+	struct hdr_histogram* read_corrected_hdr;
+	struct hdr_histogram* write_corrected_hdr;
+	struct hdr_histogram* udf_corrected_hdr;
 	as_vector latency_percentiles;
 
 	FILE* histogram_output;
@@ -144,13 +205,74 @@ typedef struct clientdata_s {
 	histogram_t write_histogram;
 	histogram_t udf_histogram;
 
+	// per-node breakdown of single-key transactions, NULL if disabled
+	node_stats_t* node_stats;
+
+	// per-status counts and latencies of failed transactions, and the
+	// rate-limited error log
+	error_stats_t* error_stats;
+
+	// the counters and latencies of each workload of a stage that runs
+	// several at once, NULL if no stage does
+	group_stats_t* group_stats;
+
+	// the counters and latencies of the stages' warmups, NULL if no stage
+	// has one
+	warmup_stats_t* warmup_stats;
+
+	// the ops and bytes budget of each workload, NULL if none has one
+	stage_budget_t* budgets;
+
+	// this instance's latencies and counters logged every period for
+	// merging, NULL unless the run is split between instances
+	interval_log_t* interval_log;
+
+	// where a worker process of --processes publishes its stats and waits
+	// for its stages, NULL when running on its own
+	proc_stats_t* proc_stats;
+	uint32_t proc_idx;
+
+	// the slowest transactions of each interval, NULL if disabled
+	slow_ops_t* slow_ops;
+
+	// sampled per-transaction trace files, NULL if disabled
+	trace_t* trace;
+
+	// breakdown of the worker threads' own time, NULL if disabled
+	self_stats_t* self_stats;
+
+	// hardware events per transaction, NULL if disabled
+	perf_counters_t* perf_counters;
+
+	// the CPUs and NUMA node the threads are placed on
+	const cpu_affinity_t* affinity;
+
+	// precomputed digests of the keys used by the stages, NULL if disabled
+	digest_table_t* digest_table;
+
+	// which keys exist, used to steer RUD workloads, NULL if disabled
+	key_tracker_t* key_tracker;
+	// percent of RUD reads that deliberately target keys that don't exist
+	float read_miss_pct;
+
 	uint32_t tdata_count;
 
 	int async_max_commands;
 	int transaction_worker_threads;
 
+	// when true, the number of in-flight async commands is adjusted at runtime
+	// by async_limiter, bounded above by async_max_commands
+	bool async_adaptive;
+	conc_limiter_t async_limiter;
+
+	// when true, random async workloads issue their next command from the
+	// completion callback of the last one, see struct async_pool_s
+	bool async_self_sustaining;
+
 	float compression_ratio;
+	bool packed_cdt;
 	bool latency;
+	bool latency_corrected;
 	bool debug;
 
 } cdata_t;
@@ -163,8 +285,11 @@ typedef struct threaddata_s {
 
 	// thread index: [0, n_threads)
 	uint32_t t_idx;
-	// which workload stage we're currrently on
+	// which workload stage we're currrently on, the one this thread runs
+	// when its stage has several workloads
 	_Atomic(uint32_t) stage_idx;
+	// the coordinator epoch of that stage, see thr_coord_t
+	_Atomic(uint32_t) epoch;
 
 	/*
 	 * note: to stop threads, tdata->finished must be set before tdata->do_work
@@ -181,9 +306,18 @@ typedef struct threaddata_s {
 	as_record fixed_full_record;
 	as_record fixed_partial_record;
 	as_record fixed_delete_record;
+	// the number of bytes of bin data in the fixed full/partial records
+	uint64_t fixed_full_size;
+	uint64_t fixed_partial_size;
 	as_list* fixed_udf_fn_args;
 
 	as_policies policies;
+
+	// the async commands of this thread, kept from stage to stage
+	struct async_pool_s* async_pool;
+
+	// what this thread has claimed of its workload's budget
+	budget_claim_t budget_claim;
 } tdata_t;
 
 
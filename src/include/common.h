@@ -25,6 +25,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#ifndef __aarch64__
+#include <xmmintrin.h>
+#endif
 
 #include "aerospike/as_record.h"
 #include "aerospike/as_log.h"
@@ -99,6 +102,26 @@ static inline void timespec_add_us(struct timespec* ts, uint64_t us)
 	ts->tv_nsec = nsec % 1000000000LU;
 }
 
+/*
+ * the rate of count events over elapsed_us, rounded to the nearest
+ */
+static inline uint64_t per_sec(uint64_t count, uint64_t elapsed_us)
+{
+	return (uint64_t) ((double) count * 1000000 / elapsed_us + 0.5);
+}
+
+/*
+ * hints to the cpu that this is a spin-wait loop
+ */
+static inline void spin_pause(void)
+{
+	#ifdef __aarch64__
+	__asm__ __volatile__("yield");
+	#else
+	_mm_pause();
+	#endif
+}
+
 
 /*
  * returns the length of the given number were it to be printed in decimal
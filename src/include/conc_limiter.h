@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// the length of the window over which completions are aggregated before the
+// concurrency limit is adjusted, in microseconds
+#define CONC_LIMITER_WINDOW_US 100000
+// the minimum number of completions needed in a window to adjust the limit,
+// so a handful of slow commands can't move the limit around on their own
+#define CONC_LIMITER_MIN_SAMPLES 16
+// the limit the controller starts out at (clamped to max_limit)
+#define CONC_LIMITER_INIT_LIMIT 16
+// the factor the limit is multiplied by when the cluster shows signs of
+// overload
+#define CONC_LIMITER_BACKOFF 0.75f
+// the fraction of commands in a window which may fail (timeouts or no more
+// connections) before the limit is backed off
+#define CONC_LIMITER_ERR_TOLERANCE 0.01f
+// how many times the lowest observed average latency the average latency of
+// a window may be before the limit is backed off
+#define CONC_LIMITER_LATENCY_TOLERANCE 2.f
+// the number of times the issuing thread polls for a free slot before parking
+// until a command completes
+#define CONC_LIMITER_SPIN 1024
+
+
+/*
+ * AIMD controller for the number of in-flight async commands. Completion
+ * callbacks (from any event loop thread) report their latency and outcome,
+ * and the single issuing thread periodically folds those reports into a new
+ * limit.
+ */
+typedef struct conc_limiter_s {
+	// the maximum number of commands allowed in flight at once
+	_Atomic(uint32_t) limit;
+	// the number of commands currently in flight
+	_Atomic(uint32_t) in_flight;
+
+	// set by the issuing thread before it parks waiting on the limit, and
+	// cleared by the release that wakes it (a futex word on Linux)
+	_Atomic(uint32_t) waiting;
+	// what the issuing thread parks on where there are no futexes
+	pthread_cond_t wait_cond;
+	pthread_mutex_t wait_lock;
+
+	// the bounds on limit
+	uint32_t min_limit;
+	uint32_t max_limit;
+
+	// accumulated by completion callbacks over the current window
+	_Atomic(uint64_t) n_completed;
+	_Atomic(uint64_t) n_failed;
+	_Atomic(uint64_t) latency_sum;
+
+	// set when a command had to wait on the limit during the current window,
+	// the limit is only grown if it is actually holding commands back
+	atomic_bool saturated;
+
+	// the time at which the current window began
+	uint64_t window_start;
+
+	// the lowest average latency of any window that saw no failures, used as
+	// the estimate of latency under no load
+	float min_latency;
+} conc_limiter_t;
+
+
+void conc_limiter_init(conc_limiter_t*, uint32_t min_limit, uint32_t max_limit,
+		uint64_t now);
+
+/*
+ * attempts to reserve a slot for a new in-flight command, returning false if
+ * the limit has been reached. May only be called from the issuing thread
+ */
+bool conc_limiter_try_acquire(conc_limiter_t*);
+
+/*
+ * waits until there's a slot free under the limit, polling for a while before
+ * parking until a release wakes it. Returns true if it had to park. May only
+ * be called from the issuing thread
+ */
+bool conc_limiter_wait(conc_limiter_t*);
+
+/*
+ * releases a slot reserved by conc_limiter_try_acquire, recording the latency
+ * of the command (in microseconds) and whether it failed due to overload, and
+ * wakes the issuing thread if it's parked in conc_limiter_wait. Safe to call
+ * from any thread
+ */
+void conc_limiter_release(conc_limiter_t*, uint64_t latency, bool failed);
+
+/*
+ * if the current window has ended, adjusts the limit based on the completions
+ * recorded during it and begins a new window. May only be called from the
+ * issuing thread
+ */
+void conc_limiter_update(conc_limiter_t*, uint64_t now);
+
+static inline uint32_t
+conc_limiter_limit(conc_limiter_t* cl)
+{
+	return cl->limit;
+}
+
+static inline uint32_t
+conc_limiter_in_flight(conc_limiter_t* cl)
+{
+	return cl->in_flight;
+}
+
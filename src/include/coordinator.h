@@ -24,7 +24,6 @@
 #include <pthread.h>
 
 #include <benchmark.h>
-#include <osx_pthread_barrier.h>
 
 
 #define COORD_CLOCK CLOCK_MONOTONIC
@@ -37,7 +36,8 @@
 #define COORD_SLEEP_TIMEOUT     0
 /*
  * returned by the_coordinator_sleep to indicate that the sleep was interrupted
- * because all threads have finished their required work
+ * because all threads have finished their required work, or because the
+ * coordinator has already moved on to the next stage
  */
 #define COORD_SLEEP_INTERRUPTED 1
 
@@ -54,13 +54,20 @@ typedef struct thr_coordinator_s {
 	pthread_cond_t complete;
 	pthread_mutex_t c_lock;
 
-	pthread_barrier_t barrier;
 	uint32_t n_threads;
 	// number of threads which have yet to call thr_coordinator_complete this
 	// stage, plus this thread (which decrements this variable after returning
 	// from the as_sleep call, i.e. once the minimum required duration of the
 	// stage has elapsed)
 	_Atomic(uint32_t) unfinished_threads;
+
+	// the first workload of the stage the threads are running
+	_Atomic(uint32_t) stage_idx;
+	// incremented (under c_lock, with a broadcast on complete) every time the
+	// coordinator moves on to a new stage, after stage_idx has been set. the
+	// threads compare it with the epoch of the stage they are running to pick
+	// up the next one on their own
+	_Atomic(uint32_t) epoch;
 } thr_coord_t;
 
 struct coordinator_worker_args_s {
@@ -81,14 +88,14 @@ void thr_coordinator_free(thr_coord_t*);
 
 
 /*
- * causes all threads to wait at a barrier until the coordinator thread
- * executes some code, after which the thread coordinator will release all
- * the threads again
+ * waits until the coordinator has moved on from the stage the calling thread
+ * was running, then sets the thread up to run its share of the next one (or
+ * returns with tdata->finished set once there are none left)
  *
  * this is safe to call whenever during a stage, even before every other thread
  * has called thr_coordinator_complete
  */
-void thr_coordinator_wait(thr_coord_t*);
+void thr_coordinator_wait(thr_coord_t*, struct threaddata_s* tdata);
 
 /*
  * notifies the thread coordinator that this thread has completed its task.
@@ -106,6 +113,7 @@ void thr_coordinator_complete(thr_coord_t*);
 /*
  * puts the calling thread to sleep until the given wakeup time, either
  * returning when that time has been reached, or when the workload has completed
+ * or the coordinator has moved on from the stage of the given epoch
  *
  * returns either (see definitions above):
  * 	COORD_SLEEP_TIMEOUT
@@ -113,7 +121,15 @@ void thr_coordinator_complete(thr_coord_t*);
  *
  * wakeup_time must be given by the CLOCK_MONOTONIC clock
  */
-int thr_coordinator_sleep(thr_coord_t*, const struct timespec* wakeup_time);
+int thr_coordinator_sleep(thr_coord_t*, uint32_t epoch,
+		const struct timespec* wakeup_time);
+
+/*
+ * signals to all threads to stop execution and return, waking any that are
+ * waiting for the next stage
+ */
+void thr_coordinator_terminate(thr_coord_t*, struct threaddata_s** tdatas,
+		uint32_t n_threads);
 
 
 /*
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// the highest CPU number that can be pinned to, plus one (glibc's
+// CPU_SETSIZE)
+#define CPU_AFFINITY_MAX_CPUS 1024
+
+/*
+ * where asbench's threads run and where their memory comes from. Threads are
+ * assigned slots in the order transaction workers, event loops, output
+ * thread, and slot i runs on cpus[i % n_cpus]
+ */
+typedef struct cpu_affinity_s {
+	// the CPUs to pin threads to, in order, n_cpus == 0 if threads aren't
+	// pinned
+	uint32_t* cpus;
+	uint32_t n_cpus;
+	// the NUMA node all memory is bound to, or -1 to leave memory on the node
+	// of the CPU that first touches it
+	int numa_node;
+} cpu_affinity_t;
+
+
+/*
+ * initializes aff to leave threads and memory where the OS puts them
+ */
+void cpu_affinity_init(cpu_affinity_t* aff);
+void cpu_affinity_free(cpu_affinity_t* aff);
+
+/*
+ * parses a Linux-style CPU list ("0-15,32-47") into a cf_malloc'ed array of
+ * CPU numbers. Returns 0 on success, -1 if the list is malformed or names a
+ * CPU >= CPU_AFFINITY_MAX_CPUS
+ */
+int cpu_affinity_parse_list(const char* str, uint32_t** cpus,
+		uint32_t* n_cpus);
+
+/*
+ * pins threads to the CPUs in str. Returns -1 if the list is invalid
+ */
+int cpu_affinity_set_cpu_list(cpu_affinity_t* aff, const char* str);
+
+/*
+ * binds memory to NUMA node node and, unless a CPU list was already set,
+ * pins threads to the node's CPUs. Returns -1 if the node doesn't exist
+ */
+int cpu_affinity_set_numa_node(cpu_affinity_t* aff, int node);
+
+/*
+ * returns the first CPU in aff that the process isn't allowed to run on, or
+ * -1 if all of them are usable
+ */
+int cpu_affinity_unavailable_cpu(const cpu_affinity_t* aff);
+
+static inline bool
+cpu_affinity_enabled(const cpu_affinity_t* aff)
+{
+	return aff->n_cpus != 0;
+}
+
+/*
+ * the CPU the thread in the given slot runs on, or -1 if threads aren't
+ * pinned
+ */
+int cpu_affinity_cpu(const cpu_affinity_t* aff, uint32_t slot);
+
+/*
+ * the NUMA node of the given CPU, or -1 if it can't be determined
+ */
+int cpu_affinity_cpu_node(uint32_t cpu);
+
+/*
+ * restricts the calling thread, and so every thread it creates from then on
+ * (including the client's tend and event loop threads), to all of aff's
+ * CPUs, and binds its memory to aff's NUMA node if one was given. Returns
+ * false if either couldn't be applied
+ */
+bool cpu_affinity_bind_process(const cpu_affinity_t* aff);
+
+/*
+ * sets the CPU of the thread in the given slot in attr, so it starts running
+ * there. Returns false if the affinity couldn't be set
+ */
+bool cpu_affinity_set_attr(const cpu_affinity_t* aff, pthread_attr_t* attr,
+		uint32_t slot);
+
+/*
+ * moves an already running thread to the CPU of the given slot. Returns false
+ * if the affinity couldn't be set
+ */
+bool cpu_affinity_pin_thread(const cpu_affinity_t* aff, pthread_t thread,
+		uint32_t slot);
+
+/*
+ * allocates size zeroed bytes for the state of the thread in the given slot,
+ * on the NUMA node of that thread's CPU. Falls back to cf_calloc when
+ * threads aren't pinned or the node is unknown. Must be freed with
+ * cpu_affinity_dealloc with the same aff and size
+ */
+void* cpu_affinity_alloc(const cpu_affinity_t* aff, size_t size,
+		uint32_t slot);
+void cpu_affinity_dealloc(const cpu_affinity_t* aff, void* ptr, size_t size);
+
+/*
+ * writes cpus as a CPU list, collapsing consecutive runs into ranges,
+ * truncating to fit in size bytes
+ */
+void cpu_affinity_format_list(const uint32_t* cpus, uint32_t n_cpus,
+		char* buf, size_t size);
+
+/*
+ * prints the CPUs each kind of thread will be pinned to, for the startup
+ * banner
+ */
+void cpu_affinity_print_placement(const cpu_affinity_t* aff,
+		uint32_t n_workers, uint32_t n_event_loops);
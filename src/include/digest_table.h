@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <aerospike/as_key.h>
+
+
+// the default cap on the number of keys in the table (200MB of digests)
+#define DIGEST_TABLE_DEFAULT_MAX_KEYS 10000000
+
+/*
+ * a flat array of precomputed RIPEMD-160 key digests covering the integer
+ * keys [key_start, key_start + n_keys), so that transactions on those keys
+ * don't have to hash them again
+ */
+typedef struct digest_table_s {
+	uint64_t key_start;
+	uint64_t n_keys;
+
+	// the digest of key_start + i is stored in digests[i]
+	const as_digest_value* digests;
+
+	// the mapping backing digests, either anonymous or backed by a file
+	void* map;
+	size_t map_size;
+} digest_table_t;
+
+
+/*
+ * builds the digest table for the integer keys [key_start, key_start + n_keys)
+ * of the given namespace/set, splitting the work across n_threads threads.
+ *
+ * if path is not NULL, the table is backed by that file. If the file already
+ * holds a complete table for the same namespace, set and key range it is
+ * mapped as-is, otherwise it is rebuilt in place so the next run can reuse it.
+ *
+ * returns 0 on success, -1 on failure
+ */
+int digest_table_init(digest_table_t*, const char* ns, const char* set,
+		uint64_t key_start, uint64_t n_keys, uint32_t n_threads,
+		const char* path);
+
+void digest_table_free(digest_table_t*);
+
+/*
+ * returns the precomputed digest of key, or NULL if key is not covered by the
+ * table
+ */
+static inline const uint8_t*
+digest_table_get(const digest_table_t* dt, uint64_t key)
+{
+	uint64_t idx = key - dt->key_start;
+	return idx < dt->n_keys ? dt->digests[idx] : NULL;
+}
+
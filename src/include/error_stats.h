@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <aerospike/as_status.h>
+#include <hdr_histogram/hdr_histogram.h>
+
+
+// the range of as_status codes counted individually, anything outside of it
+// is counted in one extra "other" slot
+#define ERROR_STATS_MIN_CODE (-32)
+#define ERROR_STATS_MAX_CODE 255
+#define ERROR_STATS_N_CODES (ERROR_STATS_MAX_CODE - ERROR_STATS_MIN_CODE + 2)
+
+// the number of errors logged per second with --debug, unless
+// --error-log-rate says otherwise
+#define ERROR_STATS_DEBUG_LOG_RATE 10
+
+typedef enum {
+	ERROR_OP_READ,
+	ERROR_OP_WRITE,
+	ERROR_OP_UDF,
+	ERROR_OP_COUNT
+} error_op_t;
+
+struct error_op_stats_s {
+	// counts of each status code, the per-period counts are cleared by the
+	// output thread
+	_Atomic(uint64_t) period_counts[ERROR_STATS_N_CODES];
+	_Atomic(uint64_t) total_counts[ERROR_STATS_N_CODES];
+
+	// cumulative latencies of transactions that timed out, and of those that
+	// failed with any other error
+	struct hdr_histogram* timeout_hdr;
+	struct hdr_histogram* error_hdr;
+};
+
+typedef struct error_stats_s {
+	struct error_op_stats_s ops[ERROR_OP_COUNT];
+
+	// at most log_rate errors are logged per second, 0 disables logging
+	uint32_t log_rate;
+	// the second the current logging window started in, and the number of
+	// errors seen in it so far
+	_Atomic(uint64_t) log_window;
+	_Atomic(uint32_t) log_count;
+} error_stats_t;
+
+
+error_stats_t* error_stats_create(uint32_t log_rate);
+void error_stats_free(error_stats_t*);
+
+/*
+ * counts a failed transaction by its status code and records its latency in
+ * the timeout or error histogram of op. Lock-free and safe to call from any
+ * thread
+ */
+void error_stats_record(error_stats_t*, error_op_t op, as_status status,
+		uint64_t dt_us);
+
+/*
+ * returns true if the caller may log an error now, allowing at most log_rate
+ * errors per second across all threads
+ */
+bool error_stats_should_log(error_stats_t*);
+
+/*
+ * prints the per-period counts of each status code that occurred, then
+ * clears them. Prints nothing if there were no errors
+ */
+void error_stats_print_period(error_stats_t*);
+
+/*
+ * prints the cumulative count of each status code that occurred, along with
+ * the latency percentiles of timed out and failed transactions
+ */
+void error_stats_print_summary(error_stats_t*);
+
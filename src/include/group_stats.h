@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <aerospike/as_status.h>
+#include <aerospike/as_udf.h>
+#include <aerospike/as_vector.h>
+#include <hdr_histogram/hdr_histogram.h>
+
+#include <workload.h>
+
+
+typedef enum {
+	GROUP_OP_READ,
+	GROUP_OP_WRITE,
+	GROUP_OP_UDF,
+	GROUP_OP_COUNT
+} group_op_t;
+
+struct group_op_stats_s {
+	// per-period counts, cleared by the output thread
+	_Atomic(uint64_t) ok;
+	_Atomic(uint64_t) miss;
+	_Atomic(uint64_t) timeouts;
+	_Atomic(uint64_t) errors;
+
+	// cumulative latencies of successful transactions, NULL when latencies
+	// aren't tracked or the workload never does this op
+	struct hdr_histogram* hdr;
+};
+
+/*
+ * the counters and latencies of each workload, kept apart so the workloads
+ * of a stage that run concurrently can be told apart
+ */
+typedef struct group_stats_s {
+	uint32_t n_workloads;
+	struct group_op_stats_s (*workloads)[GROUP_OP_COUNT];
+} group_stats_t;
+
+
+/*
+ * creates the per-workload stats of every stage, with latency histograms
+ * if latency is set
+ */
+group_stats_t* group_stats_create(const stages_t* stages, bool latency);
+void group_stats_free(group_stats_t*);
+
+/*
+ * counts a transaction of workload stage_idx by its status. Lock-free and
+ * safe to call from any thread
+ */
+void group_stats_record(group_stats_t*, uint32_t stage_idx, group_op_t op,
+		uint64_t dt_us, as_status status);
+
+/*
+ * counts a transaction of op into stats by its status, the way
+ * group_stats_record does
+ */
+void group_op_stats_record(struct group_op_stats_s* stats, group_op_t op,
+		uint64_t dt_us, as_status status);
+
+/*
+ * prints and clears the per-period counts of each workload in the group
+ * starting at first, elapsed_us being the length of the period. Groups of a
+ * single workload print nothing, since the totals already cover them
+ */
+void group_stats_print_period(group_stats_t*, const stages_t* stages,
+		uint32_t first, uint64_t elapsed_us);
+
+/*
+ * prints the latency percentiles of each workload in the group starting at
+ * first, in the format of the totals
+ */
+void group_stats_print_latency(group_stats_t*, const stages_t* stages,
+		uint32_t first, uint64_t elapsed_s, as_vector* percentiles,
+		FILE* out_file);
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+#include <aerospike/as_udf.h>
+
+#include <workload.h>
+
+
+/*
+ * splitting the work of a run between instance_count asbench processes,
+ * each given its own instance_id in [0, instance_count). Every instance
+ * works out its own share from the same arguments, so they need no way of
+ * talking to each other
+ */
+
+/*
+ * the keys of [start, end) that belong to the instance, as the
+ * [*shard_start, *shard_end) range. The first (end - start) % count
+ * instances get one key more than the rest
+ */
+void instance_shard_range(uint64_t start, uint64_t end, uint32_t id,
+		uint32_t count, uint64_t* shard_start, uint64_t* shard_end);
+
+/*
+ * the instance's share of total, split the same way as the keys. Since 0
+ * means unlimited for the amounts that are split (tps and budgets), an
+ * instance whose share rounds down to nothing still gets 1
+ */
+uint64_t instance_shard_count(uint64_t total, uint32_t id, uint32_t count);
+
+/*
+ * narrows every stage to the instance's share of its keys, tps and budgets.
+ * Returns -1 if a stage has fewer keys than there are instances
+ */
+int instance_shard_stages(stages_t* stages, uint32_t id, uint32_t count);
+
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <aerospike/as_vector.h>
+
+#include <hdr_histogram/hdr_histogram.h>
+#include <hdr_histogram/hdr_histogram_log.h>
+
+#include <group_stats.h>
+
+
+// the length of an interval, and what the intervals of every instance are
+// aligned to on the wall clock
+#define INTERVAL_LOG_PERIOD_US 1000000
+
+/*
+ * what happened to the transactions of one op over an interval
+ */
+struct interval_counts_s {
+	uint64_t ok;
+	uint64_t miss;
+	uint64_t timeouts;
+	uint64_t errors;
+	// bytes written, only counted for writes
+	uint64_t bytes;
+};
+
+/*
+ * one instance's latencies and counters, logged interval by interval so the
+ * logs of several instances can be merged. The latencies go to an HDR log
+ * with one entry per op, tagged with the op's name, and the counters go to
+ * a CSV file of the same name
+ */
+typedef struct interval_log_s {
+	FILE* hdr_out;
+	FILE* counts_out;
+	struct hdr_log_writer writer;
+
+	// the cumulative histograms as they were at the end of the last interval,
+	// which are subtracted from them to get the next one
+	struct hdr_histogram* prev[GROUP_OP_COUNT];
+	// the latencies of the interval being logged
+	struct hdr_histogram* interval;
+
+	// wall clock time the current interval began at
+	uint64_t begin_us;
+} interval_log_t;
+
+
+/*
+ * opens the interval logs of instance id of count in dir, named
+ * intervals_<id>_<start_time>.hlog and .csv. Returns NULL if either can't
+ * be created
+ */
+interval_log_t* interval_log_create(const char* dir, uint32_t id,
+		uint32_t count, time_t start_time);
+void interval_log_free(interval_log_t*);
+
+/*
+ * the wall clock time in microseconds since the epoch
+ */
+uint64_t interval_log_now(void);
+
+/*
+ * the first period boundary at least half a period after now_us, so that a
+ * wake-up landing a little before or after a boundary moves on to the next
+ */
+uint64_t interval_log_next_boundary(uint64_t now_us);
+
+/*
+ * starts the next interval at now_us without logging the time since the last
+ * one, for when nothing that happened in it should be counted
+ */
+void interval_log_restart(interval_log_t*, uint64_t now_us);
+
+/*
+ * logs the interval from the end of the last one to end_us. hdrs are the
+ * cumulative latency histograms of each op, NULL for the ops the run doesn't
+ * do, and counts are what the ops did over the interval
+ */
+void interval_log_write(interval_log_t*, uint64_t end_us,
+		struct hdr_histogram* const hdrs[GROUP_OP_COUNT],
+		const struct interval_counts_s counts[GROUP_OP_COUNT]);
+
+/*
+ * prints the throughput line of counts, what the ops set in has_op did over
+ * elapsed_us. extra, unless NULL, goes before the total. Every periodic line
+ * of the run, of --processes and of merged logs is printed by this
+ */
+void interval_log_print_counts(FILE* out,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const bool has_op[GROUP_OP_COUNT], uint64_t elapsed_us,
+		const char* extra);
+
+/*
+ * merges the interval logs in paths, a comma-separated list of .hlog files
+ * and directories holding them, adding up each period across the logs.
+ * Prints the throughput and latency percentiles of every period and of the
+ * whole run to out, and writes the merged logs to out_dir if it isn't NULL.
+ * Returns 0 on success and -1 on error
+ */
+int interval_log_merge(const char* paths, as_vector* percentiles,
+		const char* out_dir, FILE* out);
+
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+
+// number of Feistel rounds, 4 is the minimum for the result to be
+// indistinguishable from a random permutation
+#define KEY_PERM_ROUNDS 4
+
+/*
+ * a pseudo-random bijection over [0, n), computed on the fly with a Feistel
+ * network and cycle walking, so it takes constant space regardless of n
+ */
+typedef struct key_perm_s {
+	uint64_t n;
+	// number of bits in each half of the Feistel network's domain
+	uint32_t half_bits;
+	uint64_t half_mask;
+	uint64_t round_keys[KEY_PERM_ROUNDS];
+} key_perm_t;
+
+
+/*
+ * initializes a permutation over [0, n), with the order determined by seed
+ */
+void key_perm_init(key_perm_t*, uint64_t n, uint64_t seed);
+
+/*
+ * returns the image of idx under the permutation. Values outside of [0, n)
+ * are mapped to themselves
+ */
+uint64_t key_perm_apply(const key_perm_t*, uint64_t idx);
+
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <aerospike/as_random.h>
+
+
+// the number of uniformly drawn keys to try before falling back to selecting
+// a key in the wanted state by its rank
+#define KEY_TRACKER_MAX_TRIES 32
+
+// the bitmap is split into blocks of 64 words and superblocks of 64 blocks,
+// each keeping a count of its set bits
+#define KEY_TRACKER_BLOCK_KEYS (64 * 64)
+#define KEY_TRACKER_SUPER_KEYS (64 * KEY_TRACKER_BLOCK_KEYS)
+
+/*
+ * a concurrent bitmap over the keys [key_start, key_start + n_keys),
+ * tracking which of them currently exist in the database as far as this run
+ * has observed. All keys start out dead
+ */
+typedef struct key_tracker_s {
+	uint64_t key_start;
+	uint64_t n_keys;
+	_Atomic(uint64_t)* words;
+
+	// the number of set bits in each block and superblock, which find the
+	// r-th key in a given state without walking the whole bitmap
+	_Atomic(uint32_t)* block_live;
+	_Atomic(uint32_t)* super_live;
+
+	// the number of set bits
+	_Atomic(uint64_t) n_live;
+} key_tracker_t;
+
+
+void key_tracker_init(key_tracker_t*, uint64_t key_start, uint64_t n_keys);
+void key_tracker_free(key_tracker_t*);
+
+/*
+ * marks key as live/dead. Keys outside the tracked range are ignored
+ */
+void key_tracker_set_live(key_tracker_t*, uint64_t key, bool live);
+
+bool key_tracker_is_live(const key_tracker_t*, uint64_t key);
+
+/*
+ * picks a key in [key_start, key_end) that is live (or dead if live is false)
+ * into *key. Keys are drawn uniformly at random until one in the right state
+ * is found, and if that takes too many tries one of the keys in that state is
+ * chosen uniformly by its rank instead. Returns false if there is no such key.
+ * While keys are being marked concurrently the counts may briefly lag the
+ * bitmap, in which case the pick may also fail
+ */
+bool key_tracker_pick(const key_tracker_t*, as_random*, uint64_t key_start,
+		uint64_t key_end, bool live, uint64_t* key);
+
+static inline uint64_t
+key_tracker_n_live(const key_tracker_t* kt)
+{
+	return kt->n_live;
+}
+
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+#include <aerospike/as_random.h>
+
+
+// the number of buckets continuous distributions are discretized into
+#define LEN_DIST_N_BUCKETS 256
+
+// how many standard deviations either side of the mean (of the log, for
+// lognormal) are covered before the tails are cut off
+#define LEN_DIST_N_SIGMAS 4
+
+struct len_dist_bucket_s {
+	// the bucket covers lengths [lo, hi]
+	uint32_t lo;
+	uint32_t hi;
+
+	// Vose alias table entry: with probability threshold / 2**32 this bucket
+	// is picked, otherwise alias is
+	uint64_t threshold;
+	uint32_t alias;
+};
+
+/*
+ * a distribution over value lengths, sampled in O(1) with an alias table. The
+ * table picks a bucket and the length is then uniform within the bucket
+ */
+typedef struct len_dist_s {
+	uint32_t n_buckets;
+	uint32_t min_len;
+	uint32_t max_len;
+	struct len_dist_bucket_s* buckets;
+} len_dist_t;
+
+
+/*
+ * lengths uniformly distributed in [min_len, max_len]
+ */
+len_dist_t* len_dist_uniform(uint32_t min_len, uint32_t max_len);
+
+/*
+ * a normal distribution, truncated at LEN_DIST_N_SIGMAS standard deviations
+ * and at 0. Returns NULL if the upper tail doesn't fit in a uint32
+ */
+len_dist_t* len_dist_normal(double mean, double stddev);
+
+/*
+ * a lognormal distribution with the given median and shape (the standard
+ * deviation of the log of the length). Returns NULL if the upper tail doesn't
+ * fit in a uint32
+ */
+len_dist_t* len_dist_lognormal(double median, double sigma);
+
+/*
+ * an empirical distribution read from a file of "<length> <weight>" lines.
+ * Blank lines and lines starting with '#' are skipped. Returns NULL if the
+ * file can't be read or has no entries with positive weight
+ */
+len_dist_t* len_dist_from_file(const char* path);
+
+void len_dist_free(len_dist_t*);
+
+static inline uint32_t
+len_dist_sample(const len_dist_t* dist, as_random* random)
+{
+	uint64_t r = as_random_next_uint64(random);
+
+	// the high half picks a column, the low half flips the biased coin
+	uint32_t idx = (uint32_t) (((r >> 32) * dist->n_buckets) >> 32);
+	const struct len_dist_bucket_s* b = &dist->buckets[idx];
+	if ((r & 0xffffffff) >= b->threshold) {
+		b = &dist->buckets[b->alias];
+	}
+
+	if (b->lo == b->hi) {
+		return b->lo;
+	}
+	return b->lo + (uint32_t) (as_random_next_uint64(random) %
+			((uint64_t) b->hi - b->lo + 1));
+}
@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+#include <hdr_histogram/hdr_histogram.h>
+
+
+// the maximum number of distinct nodes that can be tracked, nodes seen after
+// this many have been registered are not broken out
+#define NODE_STATS_MAX_NODES 128
+// the number of slowest nodes highlighted in the output by default
+#define NODE_STATS_DEFAULT_TOP_N 3
+
+typedef enum {
+	NODE_OP_READ,
+	NODE_OP_WRITE,
+	NODE_OP_UDF,
+	NODE_OP_COUNT
+} node_op_t;
+
+struct node_op_stats_s {
+	// cumulative latencies of successful transactions
+	struct hdr_histogram* hdr;
+
+	// per-period counts, cleared by the output thread
+	_Atomic(uint64_t) count;
+	_Atomic(uint64_t) timeout_count;
+	_Atomic(uint64_t) error_count;
+};
+
+struct node_entry_s {
+	// claimed with a CAS from false by the first thread to see a new node
+	atomic_bool claimed;
+	// set once the histograms have been allocated and name has been filled in
+	atomic_bool ready;
+
+	// the name of the node this entry belongs to, which identifies it even
+	// if the node leaves the cluster and comes back
+	char name[AS_NODE_NAME_SIZE];
+	struct node_op_stats_s ops[NODE_OP_COUNT];
+};
+
+typedef struct node_stats_s {
+	// claimed in order, so the first unclaimed entry marks the end
+	struct node_entry_s entries[NODE_STATS_MAX_NODES];
+
+	// the number of slowest nodes to highlight
+	uint32_t top_n;
+} node_stats_t;
+
+
+node_stats_t* node_stats_create(uint32_t top_n);
+void node_stats_free(node_stats_t*);
+
+/*
+ * records a single-key transaction against the master node of the key's
+ * partition. Transactions the node answered (AEROSPIKE_OK or
+ * AEROSPIKE_ERR_RECORD_NOT_FOUND) have their latency recorded, timeouts and
+ * other errors are only counted. Lock-free and safe to call from any thread
+ */
+void node_stats_record(node_stats_t*, aerospike* client, as_key* key,
+		node_op_t op, uint64_t dt_us, as_status status);
+
+/*
+ * prints the per-period throughput of each node along with its cumulative
+ * p99 latency, clearing the per-period counts. The top_n nodes with the
+ * highest p99 latency are marked
+ */
+void node_stats_print_period(node_stats_t*, int64_t elapsed_us);
+
+/*
+ * prints the cumulative latency percentiles of each node, slowest first
+ */
+void node_stats_print_summary(node_stats_t*);
+
+/*
+ * copies the name of the node currently holding the master copy of the key's
+ * partition, from the client's partition map, into name. Returns false if
+ * the node isn't known
+ */
+bool node_stats_key_node(aerospike* client, as_key* key,
+		char name[AS_NODE_NAME_SIZE]);
+
@@ -35,6 +35,8 @@
 #include <aerospike/as_record.h>
 #include <aerospike/as_random.h>
 
+#include <len_dist.h>
+
 
 //==========================================================
 // Typedefs & constants.
@@ -171,6 +173,12 @@ struct bin_spec_s {
 			 * null-terminating bit)
 			 */
 			uint32_t length;
+			/*
+			 * if not NULL, lengths are drawn from this distribution instead,
+			 * and dist_str is the text it was parsed from
+			 */
+			len_dist_t* dist;
+			char* dist_str;
 		} string;
 
 		struct {
@@ -182,6 +190,11 @@ struct bin_spec_s {
 			 * number of random bytes
 			 */
 			uint32_t length;
+			/*
+			 * same as for string
+			 */
+			len_dist_t* dist;
+			char* dist_str;
 		} bytes;
 
 		struct {
@@ -231,9 +244,78 @@ struct bin_spec_kv_pair_s {
 };
 
 
+#define GEN_PLAN_MAP_PREAMBLE_MAX 8
+
+/*
+ * one step of a generation plan, compiled from a single bin_spec. The ops of
+ * a list/map follow it directly, so the subtree of op i is [i, end)
+ */
+struct gen_op_s {
+	// the type of the bin_spec this was compiled from
+	uint8_t type;
+
+	// int range
+	uint8_t range;
+
+	// the number of times this op is repeated in the enclosing list, or the
+	// number of entries generated from a map key op
+	uint32_t n_repeats;
+
+	// the index of the first op following this op's subtree
+	uint32_t end;
+
+	// string/bytes length (if dist is NULL), or list/map length
+	uint32_t length;
+	const len_dist_t* dist;
+
+	// the value of a const op
+	as_val* const_val;
+
+	// upper bounds for packing a value from this op's subtree: the size of
+	// its msgpack encoding, the scratch space needed while building it, and
+	// the number of map entries that may be pending at once
+	uint64_t pack_size;
+	uint64_t pack_scratch;
+	uint32_t pack_entries;
+};
+
+struct gen_plan_bin_s {
+	// the op generating this bin's values
+	uint32_t op;
+
+	// appended to the bin name template to name this bin, e.g. "_2"
+	uint8_t suffix_len;
+	char suffix[12];
+};
+
+/*
+ * a flattened, pre-resolved version of an obj_spec's bin_spec trees, so
+ * values can be generated by a loop over the ops instead of a recursive walk
+ * of the bin_specs
+ */
+struct gen_plan_s {
+	struct gen_op_s* ops;
+	uint32_t n_ops;
+
+	// the deepest nesting of non-const lists/maps
+	uint32_t max_depth;
+
+	// indexed by bin number
+	struct gen_plan_bin_s* bins;
+
+	// what as_orderedmap packs between a map's header and its first entry
+	// (the map's ordering flags), and how much that adds to the header's
+	// element count
+	uint8_t map_preamble[GEN_PLAN_MAP_PREAMBLE_MAX];
+	uint8_t map_preamble_len;
+	uint8_t map_count_extra;
+};
+
+
 typedef struct obj_spec_s {
 	struct bin_spec_s* bin_specs;
 	uint32_t n_bin_specs;
+	struct gen_plan_s* plan;
 	/*
      * when set to true, this is a valid obj_spec, when set to false, this
 	 * obj_spec has already been freed/is owned by another obj_spec
@@ -268,6 +350,13 @@ typedef struct obj_spec_s {
  *        B12 - generates a bytearray of 12 random bytes
  *    S) Generate a string bin or value made of space-separated a-z{1,9} words
  *        S16 - a string with a 16 character length. ex: "uir a mskd poiur"
+ *
+ *    Instead of a fixed length, B and S may take a length distribution:
+ *        B100-200 - lengths uniformly distributed between 100 and 200
+ *        B~n(1000,100) - normally distributed, mean 1000 and stddev 100
+ *        B~ln(1000,0.5) - lognormal, median 1000 and shape (stddev of the
+ *            log of the length) 0.5
+ *        B~f(<path>) - drawn from a file of "<length> <weight>" lines
  *    D) Generate a Double bin or value (8 byte)
  *
  * Collection bins:
@@ -326,10 +415,22 @@ bool obj_spec_bin_name_compatible(const obj_spec_t*, const char* bin_name);
  * 	<bin_name_template>_2
  * 	<bin_name_template>_3
  * 	...
+ *
+ * if size isn't NULL, it's set to the number of bytes of data in the bins, as
+ * obj_spec_val_size would count it, which is tallied while they're generated
  */
 int obj_spec_populate_bins(const obj_spec_t*, as_record*, as_random*,
 		const char* bin_name_template, uint32_t* write_bins,
-		uint32_t n_write_bins, float compression_ratio);
+		uint32_t n_write_bins, float compression_ratio, uint64_t* size);
+
+/*
+ * same as obj_spec_populate_bins, but list and map bins are packed straight
+ * into msgpack and stored as as_bytes of type AS_BYTES_LIST/AS_BYTES_MAP,
+ * which the client sends as-is, rather than being built as trees of as_vals
+ */
+int obj_spec_populate_packed_bins(const obj_spec_t*, as_record*, as_random*,
+		const char* bin_name_template, uint32_t* write_bins,
+		uint32_t n_write_bins, float compression_ratio, uint64_t* size);
 
 /*
  * instead of populating a record's bins, returns an as_list of the objects
@@ -348,6 +449,12 @@ as_val* obj_spec_gen_compressible_value(const obj_spec_t*, as_random*,
 void snprint_obj_spec(const obj_spec_t* obj_spec, char* out_str,
 		size_t str_size);
 
+/*
+ * returns the number of bytes of data held in a value generated from an
+ * obj_spec, not counting any wire encoding overhead
+ */
+uint64_t obj_spec_val_size(const as_val* val);
+
 // define bin printing methods only for testing
 #ifdef _TEST
 
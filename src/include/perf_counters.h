@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// the maximum number of threads that can open counters, any threads beyond
+// this many are ignored
+#define PERF_COUNTERS_MAX_THREADS 1024
+// by default, one in this many transactions of each thread is measured
+#define PERF_COUNTERS_DEFAULT_SAMPLE 16
+
+typedef enum {
+	PERF_OP_READ,
+	PERF_OP_WRITE,
+	PERF_OP_UDF,
+	PERF_OP_COUNT
+} perf_op_t;
+
+/*
+ * the hardware events counted, in the order they appear in a counter group
+ */
+typedef enum {
+	PERF_EV_CYCLES,
+	PERF_EV_INSTRUCTIONS,
+	PERF_EV_CACHE_MISSES,
+	PERF_EV_BRANCH_MISSES,
+	PERF_EV_COUNT
+} perf_ev_t;
+
+struct perf_op_stats_s {
+	// per-period totals over the measured transactions, cleared by the output
+	// thread
+	_Atomic(uint64_t) count;
+	_Atomic(uint64_t) events[PERF_EV_COUNT];
+};
+
+/*
+ * the counter group of one worker thread, which counts the thread's own
+ * user-space events on whichever CPU it runs
+ */
+struct perf_counters_thread_s {
+	int fds[PERF_EV_COUNT];
+
+	// only touched by the owning thread
+	uint32_t countdown;
+	bool measuring;
+	uint64_t start[PERF_EV_COUNT];
+	uint64_t start_enabled;
+	uint64_t start_running;
+
+	struct perf_op_stats_s ops[PERF_OP_COUNT];
+};
+
+typedef struct perf_counters_s {
+	// one in this many transactions of each thread is measured
+	uint32_t sample_every;
+	// distinguishes this instance from any that came before it in the
+	// thread-local cache
+	uint64_t id;
+	// set once a thread has failed to open its counters, so the reason is
+	// only logged once
+	atomic_bool unavailable;
+
+	_Atomic(uint32_t) n_threads;
+	_Atomic(struct perf_counters_thread_s*) threads[PERF_COUNTERS_MAX_THREADS];
+} perf_counters_t;
+
+
+perf_counters_t* perf_counters_create(uint32_t sample_every);
+void perf_counters_free(perf_counters_t*);
+
+/*
+ * opens a counter group for the calling thread. Returns false, logging why
+ * the first time, if the counters can't be opened (not Linux, no PMU access
+ * in a container or VM, or perf_event_paranoid forbidding it), in which case
+ * the thread's transactions simply aren't measured
+ */
+bool perf_counters_thread_init(perf_counters_t*);
+
+/*
+ * marks the start of a transaction on the calling thread, reading its
+ * counters if the transaction is one of those sampled
+ */
+void perf_counters_begin(perf_counters_t*);
+
+/*
+ * marks the end of the transaction begun by the last perf_counters_begin
+ * and charges the events counted in between to op
+ */
+void perf_counters_end(perf_counters_t*, perf_op_t op);
+
+/*
+ * prints the average events per measured transaction of each op type over
+ * the period, clearing the per-period totals
+ */
+void perf_counters_print_period(perf_counters_t*);
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hdr_histogram/hdr_histogram.h>
+
+#include <group_stats.h>
+#include <interval_log.h>
+
+
+// how often a worker process adds its counters to its slot
+#define PROC_STATS_PUBLISH_US 100000
+
+/*
+ * the counters of one op of a worker process, added to by that process only
+ */
+struct proc_counts_s {
+	_Atomic(uint64_t) ok;
+	_Atomic(uint64_t) miss;
+	_Atomic(uint64_t) timeouts;
+	_Atomic(uint64_t) errors;
+	_Atomic(uint64_t) bytes;
+};
+
+/*
+ * what one worker process shares with the parent. Each process only writes
+ * to its own slot, so none of them take locks
+ */
+typedef struct proc_slot_s {
+	// cumulative since the process started, apart for the transactions that
+	// finished while a stage warmed up
+	struct proc_counts_s counts[GROUP_OP_COUNT];
+	struct proc_counts_s warmup_counts[GROUP_OP_COUNT];
+
+	// the cumulative latencies of each op, NULL for the ops the run doesn't
+	// do, which the process's transaction threads record to directly
+	struct hdr_histogram* hdrs[GROUP_OP_COUNT];
+
+	// 1 + the first workload of the last stage the process is ready to start
+	_Atomic(uint32_t) ready;
+} proc_slot_t;
+
+/*
+ * a shared memory segment mapped by the parent before it forks the worker
+ * processes of --processes, so it's at the same address in all of them. The
+ * parent reads the slots to print the combined stats of the run, and moves
+ * the processes from one stage to the next through the control block at the
+ * front of the segment
+ */
+typedef struct proc_stats_s {
+	// 1 + the first workload of the last stage the processes may start
+	_Atomic(uint32_t) released;
+
+	uint32_t n_procs;
+	// the size of the whole mapping
+	size_t size;
+
+	proc_slot_t slots[];
+} proc_stats_t;
+
+
+/*
+ * maps a segment with a slot for each of n_procs processes, holding
+ * histograms for the ops set in has_op. Returns NULL if it can't be mapped
+ */
+proc_stats_t* proc_stats_create(uint32_t n_procs,
+		const bool has_op[GROUP_OP_COUNT]);
+
+/*
+ * unmaps the segment, from whichever process calls it
+ */
+void proc_stats_free(proc_stats_t*);
+
+static inline proc_slot_t*
+proc_stats_slot(proc_stats_t* stats, uint32_t idx)
+{
+	return &stats->slots[idx];
+}
+
+/*
+ * adds what the process did since it last published to its slot, with what
+ * it did while warming up apart
+ */
+void proc_stats_publish(proc_slot_t*,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const struct interval_counts_s warmup_counts[GROUP_OP_COUNT]);
+
+/*
+ * the counters of every process added up, without the warmups
+ */
+void proc_stats_sum(proc_stats_t*,
+		struct interval_counts_s counts[GROUP_OP_COUNT]);
+
+/*
+ * the warmup counters of every process added up
+ */
+void proc_stats_sum_warmup(proc_stats_t*,
+		struct interval_counts_s counts[GROUP_OP_COUNT]);
+
+/*
+ * resets into and adds the latencies of op from every process to it
+ */
+void proc_stats_merge_hdr(proc_stats_t*, group_op_t op,
+		struct hdr_histogram* into);
+
+/*
+ * called by a worker process before it starts the stage beginning at
+ * workload stage_idx, waits for the parent to release it
+ */
+void proc_stats_wait_stage(proc_stats_t*, uint32_t idx, uint32_t stage_idx);
+
+/*
+ * whether every process is waiting to start the stage beginning at workload
+ * stage_idx
+ */
+bool proc_stats_all_ready(proc_stats_t*, uint32_t stage_idx);
+
+/*
+ * lets the processes start the stage beginning at workload stage_idx
+ */
+void proc_stats_release(proc_stats_t*, uint32_t stage_idx);
+
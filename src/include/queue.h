@@ -24,6 +24,24 @@
 #include <pthread.h>
 #include <stdint.h>
 
+
+// bounds on the number of times queue_pop_wait polls an empty queue before
+// parking, which adapts to how long items have recently taken to arrive
+#define QUEUE_SPIN_MIN 64
+#define QUEUE_SPIN_MAX 16384
+
+/*
+ * how a call to queue_pop_wait got its item
+ */
+typedef enum {
+	// the queue wasn't empty
+	QUEUE_WAIT_NONE,
+	// an item was pushed while polling
+	QUEUE_WAIT_SPUN,
+	// the popper went to sleep until an item was pushed
+	QUEUE_WAIT_PARKED
+} queue_wait_t;
+
 /*
  * implementation of a lock-free single-popper multiple-pusher thread-safe
  * queue
@@ -38,6 +56,13 @@ typedef struct queue_s {
 	// the position of the head, i.e. the next element to be popped (modulo len)
 	uint32_t __attribute__((aligned(8))) head;
 
+	// set by the popper before it parks, and cleared by the push that wakes it
+	// (a futex word on Linux)
+	_Atomic(uint32_t) waiting;
+	// how many times the popper polls before parking, only touched by it
+	uint32_t spin_limit;
+
+	// what the popper parks on where there are no futexes
 	pthread_cond_t empty_cond;
 	pthread_mutex_t e_lock;
 } queue_t;
@@ -54,7 +79,7 @@ int queue_init(queue_t* q, uint32_t q_len);
 void queue_free(queue_t* q);
 
 /*
- * push an item to the back of the queue
+ * push an item to the back of the queue, waking the popper if it's parked
  *
  * note that if something tries pushing to the queue when it is at capacity, it
  * results in undefined behavior
@@ -67,3 +92,11 @@ void queue_push(queue_t* q, void* item);
  */
 void* queue_pop(queue_t* q);
 
+/*
+ * pops an item from the end of the queue, waiting for one to be pushed if the
+ * queue is empty. The popper polls for a while first, then parks until a push
+ * wakes it, so it doesn't hold on to a CPU the pushers may need. If wait isn't
+ * NULL, it's set to how the item was obtained
+ */
+void* queue_pop_wait(queue_t* q, queue_wait_t* wait);
+
@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <time.h>
+
+
+// the maximum number of threads whose time can be broken down, any threads
+// beyond this many are ignored
+#define SELF_STATS_MAX_THREADS 1024
+// the client is reported as saturated when the process uses at least this
+// percent of the CPUs available to it
+#define SELF_STATS_CPU_SATURATED_PCT 90
+// or when the worker threads spend at least this percent of their time
+// generating transactions and recording their latencies
+#define SELF_STATS_GEN_SATURATED_PCT 50
+
+/*
+ * what a worker thread can be busy with. Each thread is in exactly one phase
+ * at a time, from the moment it enters it until it enters the next one
+ */
+typedef enum {
+	// building keys, records and batches, and freeing the last ones
+	SELF_PHASE_GEN,
+	// inside an aerospike_* call (only issuing the command for async)
+	SELF_PHASE_CLIENT,
+	// recording latencies and counts once a sync call returns
+	SELF_PHASE_RECORD,
+	// sleeping in the throttle or waiting for a free async command slot
+	SELF_PHASE_THROTTLE,
+	// between stages, not counted towards the breakdown
+	SELF_PHASE_IDLE,
+	SELF_PHASE_COUNT
+} self_phase_t;
+
+/*
+ * each worker thread owns one of these. seq lets the output thread take a
+ * consistent snapshot while the owner may be switching phases
+ */
+struct self_stats_thread_s {
+	// odd while the owner is switching phases
+	_Atomic(uint32_t) seq;
+	// the phase the thread is in and the tick it entered it at
+	_Atomic(uint32_t) phase;
+	_Atomic(uint64_t) since;
+	// cumulative ticks spent in each phase, not counting the current one
+	_Atomic(uint64_t) ticks[SELF_PHASE_COUNT];
+
+	// the output thread's snapshot of ticks at the start of the period
+	uint64_t period_base[SELF_PHASE_IDLE];
+};
+
+typedef enum {
+	SELF_SATURATION_NONE,
+	// the process is using (nearly) all the CPUs it may run on
+	SELF_SATURATION_CPU,
+	// the worker threads spend most of their time on client-side work
+	SELF_SATURATION_GEN
+} self_saturation_t;
+
+typedef struct self_stats_sample_s {
+	// the share of the worker threads' time spent in each phase, in percent
+	double phase_pct[SELF_PHASE_IDLE];
+	// the largest share of its time any one thread spent generating
+	// transactions, in percent
+	double max_gen_pct;
+	// process CPU time (user and system, all threads) over wall clock time,
+	// in percent of one CPU
+	double cpu_pct;
+	uint64_t voluntary_csw;
+	uint64_t involuntary_csw;
+	// waits for a free async command slot that were over while polling, and
+	// ones that had to sleep until a command completed
+	uint64_t spun_waits;
+	uint64_t parked_waits;
+} self_stats_sample_t;
+
+typedef struct self_stats_s {
+	// distinguishes this instance from any that came before it in the
+	// thread-local cache
+	uint64_t id;
+	// the number of CPUs the process may run on
+	uint32_t n_cpus;
+
+	_Atomic(uint32_t) n_threads;
+	_Atomic(struct self_stats_thread_s*) threads[SELF_STATS_MAX_THREADS];
+
+	_Atomic(uint64_t) spun_waits;
+	_Atomic(uint64_t) parked_waits;
+
+	// resource usage and wall clock time when the instance was created and
+	// at the start of the period
+	struct rusage start_usage;
+	uint64_t start_us;
+	struct rusage period_usage;
+	uint64_t period_us;
+	uint64_t period_spun_waits;
+	uint64_t period_parked_waits;
+} self_stats_t;
+
+
+/*
+ * a cheap timestamp in arbitrary units, only ever compared against other
+ * timestamps. This is the TSC on x86 and the virtual counter on aarch64
+ */
+static inline uint64_t
+self_stats_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	uint64_t ticks;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (ticks));
+	return ticks;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000LU + (uint64_t) now.tv_nsec;
+#endif
+}
+
+self_stats_t* self_stats_create(void);
+void self_stats_free(self_stats_t*);
+
+/*
+ * moves the calling thread into phase, charging the time since its last call
+ * to the phase it was in. Costs a timestamp and a handful of plain stores,
+ * and is safe to call from any number of threads
+ */
+void self_stats_enter(self_stats_t*, self_phase_t phase);
+
+/*
+ * counts a wait for a free async command slot, which either ended while the
+ * thread was polling or after it parked. Safe to call from any number of
+ * threads
+ */
+void self_stats_count_wait(self_stats_t*, bool parked);
+
+/*
+ * breaks down the worker threads' time and the process' resource usage since
+ * the start of the period, starting a new period, or since the instance was
+ * created if cumulative is set. Must only be called from one thread
+ */
+void self_stats_sample(self_stats_t*, bool cumulative,
+		self_stats_sample_t* sample);
+
+/*
+ * whether the client itself looks like the bottleneck in sample, and why
+ */
+self_saturation_t self_stats_saturation(const self_stats_t*,
+		const self_stats_sample_t* sample);
+
+/*
+ * prints the breakdown of the period and warns if the client is saturated
+ */
+void self_stats_print_period(self_stats_t*);
+
+/*
+ * prints the breakdown of the whole run
+ */
+void self_stats_print_summary(self_stats_t*);
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_status.h>
+
+
+// the number of slowest transactions captured per interval by default
+#define SLOW_OPS_DEFAULT_K 10
+// the maximum number of threads that can record slow transactions, any
+// threads beyond this many are ignored
+#define SLOW_OPS_MAX_THREADS 1024
+
+typedef enum {
+	SLOW_OP_READ,
+	SLOW_OP_WRITE,
+	SLOW_OP_UDF,
+	SLOW_OP_COUNT
+} slow_op_t;
+
+struct slow_op_entry_s {
+	uint64_t latency_us;
+	// wall clock time the transaction was started at, in microseconds since
+	// the epoch, so it can be matched up with server logs
+	uint64_t start_us;
+	// the key value of single-key transactions, unused for batches
+	int64_t key;
+	// the number of records in the batch, 0 for single-key transactions
+	uint32_t batch_size;
+	as_status status;
+	slow_op_t op;
+	// the master node of the key, empty for batches or if it wasn't known
+	char node[AS_NODE_NAME_SIZE];
+};
+
+/*
+ * a min-heap on latency of the slowest transactions seen in one interval
+ */
+struct slow_ops_heap_s {
+	uint64_t interval;
+	uint32_t n_entries;
+	// the latency of the fastest entry once the heap is full, transactions
+	// that weren't slower than this can't make the cut
+	uint64_t threshold;
+	struct slow_op_entry_s* entries;
+};
+
+/*
+ * each recording thread owns one of these. The owner fills the heap of the
+ * current interval while the output thread reads the heap of the previous
+ * one, with seq guarding against the owner still being in the middle of an
+ * insert into the heap being read
+ */
+struct slow_ops_reservoir_s {
+	// odd while the owner is modifying a heap
+	_Atomic(uint32_t) seq;
+	struct slow_ops_heap_s heaps[2];
+};
+
+typedef struct slow_ops_s {
+	FILE* out;
+	// used to look up the node of each captured key, NULL to skip the lookup
+	aerospike* client;
+	// the number of transactions captured per interval
+	uint32_t k;
+	// distinguishes this instance from any that came before it in the
+	// thread-local reservoir cache
+	uint64_t id;
+
+	// bumped by the output thread every time it dumps an interval
+	_Atomic(uint64_t) interval;
+
+	_Atomic(uint32_t) n_reservoirs;
+	_Atomic(struct slow_ops_reservoir_s*) reservoirs[SLOW_OPS_MAX_THREADS];
+
+	// scratch space for the output thread to merge the reservoirs in
+	struct slow_op_entry_s* merged;
+	struct slow_op_entry_s* copy;
+} slow_ops_t;
+
+
+/*
+ * opens path and writes the CSV header to it. Returns NULL if the file can't
+ * be opened. client may be NULL if the nodes of keys can't be looked up
+ */
+slow_ops_t* slow_ops_create(const char* path, uint32_t k, aerospike* client);
+void slow_ops_free(slow_ops_t*);
+
+/*
+ * offers a finished transaction to the calling thread's reservoir. This only
+ * costs a comparison unless the transaction is among the k slowest the thread
+ * has seen this interval, in which case the key's node is looked up and the
+ * transaction is captured. key is NULL for batches
+ */
+void slow_ops_record(slow_ops_t*, slow_op_t op, uint64_t dt_us,
+		as_status status, uint32_t batch_size, as_key* key);
+
+/*
+ * closes the current interval, merging the k slowest transactions of every
+ * thread and appending them to the file, slowest first. Must only be called
+ * from one thread
+ */
+void slow_ops_dump(slow_ops_t*, uint32_t stage_idx);
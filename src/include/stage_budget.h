@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// how many ops and bytes a thread claims from a budget at a time
+#define STAGE_BUDGET_OPS_CHUNK 64
+#define STAGE_BUDGET_BYTES_CHUNK (1024 * 1024)
+
+/*
+ * the number of transactions and bytes written a workload may do before its
+ * stage ends, shared by all of the threads running it
+ */
+typedef struct stage_budget_s {
+	// 0 for no limit
+	uint64_t ops;
+	uint64_t bytes;
+
+	// how much of each the threads have claimed so far
+	_Atomic(uint64_t) ops_claimed;
+	_Atomic(uint64_t) bytes_claimed;
+} stage_budget_t;
+
+/*
+ * the part of a budget one thread has claimed and not used yet, only to be
+ * used by that thread
+ */
+typedef struct budget_claim_s {
+	uint64_t ops;
+	uint64_t bytes;
+	// set once the thread has found the budget spent
+	bool spent;
+} budget_claim_t;
+
+
+void stage_budget_init(stage_budget_t*, uint64_t ops, uint64_t bytes);
+
+/*
+ * whether the budget limits anything
+ */
+static inline bool
+stage_budget_limited(const stage_budget_t* budget)
+{
+	return budget->ops != 0 || budget->bytes != 0;
+}
+
+static inline void
+budget_claim_init(budget_claim_t* claim)
+{
+	claim->ops = 0;
+	claim->bytes = 0;
+	claim->spent = false;
+}
+
+/*
+ * takes one transaction out of the budget, claiming a chunk of them when the
+ * thread has none left. Returns false once either budget is spent. Every
+ * thread using up what it claimed makes for exactly budget->ops
+ * transactions
+ */
+bool stage_budget_take_op(stage_budget_t*, budget_claim_t*);
+
+/*
+ * takes n bytes written out of the budget. The transaction that spends it
+ * still goes ahead, after which stage_budget_take_op fails, so the stage
+ * writes up to a record per thread past budget->bytes
+ */
+void stage_budget_take_bytes(stage_budget_t*, budget_claim_t*, uint64_t n);
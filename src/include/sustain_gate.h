@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+struct stage_s;
+
+/*
+ * what lets the event loops reissue the async commands of an issuing thread
+ * in self-sustaining mode. The issuing thread opens the gate for a stage, and
+ * the completion callbacks pass through it to issue the next command, taking
+ * a permit to do so when the stage is throttled. Nothing here takes a lock
+ */
+typedef struct sustain_gate_s {
+	// the stage the event loops reissue commands for, NULL when they hand
+	// every command back
+	_Atomic(const struct stage_s*) stage;
+	// the number of callbacks in the middle of reissuing a command
+	_Atomic(uint32_t) n_entered;
+
+	// when the stage is throttled, every command takes a permit: the earliest
+	// time the next one may be issued, which moves on by permit_period each
+	// time. 0 permit_period means no throttling
+	_Atomic(uint64_t) permit_next;
+	uint64_t permit_period;
+} sustain_gate_t;
+
+
+/*
+ * initializes the gate closed
+ */
+void sustain_gate_init(sustain_gate_t*);
+
+/*
+ * lets the event loops reissue commands for stage, one every period
+ * microseconds starting from now, or as fast as they complete if period is 0
+ */
+void sustain_gate_open(sustain_gate_t*, const struct stage_s* stage,
+		uint64_t period, uint64_t now);
+
+/*
+ * stops the event loops from reissuing commands, and waits for those that
+ * are in the middle of it, after which the stage can go
+ */
+void sustain_gate_close(sustain_gate_t*);
+
+/*
+ * called by a callback before it reissues a command, returns the stage to
+ * issue it for, or NULL if the gate is closed. Either way, the callback must
+ * call sustain_gate_leave once it's done with the stage
+ */
+const struct stage_s* sustain_gate_enter(sustain_gate_t*);
+
+void sustain_gate_leave(sustain_gate_t*);
+
+/*
+ * takes the next permit to issue a command if it's due by now. Permits that
+ * have gone unused for more than a period are dropped, so a stall lets one
+ * command through rather than a burst of them. Safe to call from any thread
+ */
+bool sustain_gate_take_permit(sustain_gate_t*, uint64_t now);
+
+/*
+ * whether the gate is open for a throttled stage, so whoever issues a command
+ * has to take a permit first
+ */
+static inline bool
+sustain_gate_throttled(sustain_gate_t* gate)
+{
+	return gate->permit_period != 0 && atomic_load(&gate->stage) != NULL;
+}
+
+/*
+ * the time the next permit is due
+ */
+static inline uint64_t
+sustain_gate_next_permit(sustain_gate_t* gate)
+{
+	return atomic_load(&gate->permit_next);
+}
+
@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <aerospike/as_key.h>
+#include <aerospike/as_status.h>
+
+
+#define TRACE_MAGIC "ASBTRACE"
+#define TRACE_VERSION 1
+
+// trace files grow by this many bytes at a time, each new segment being
+// mapped in when the previous one fills up
+#define TRACE_SEGMENT_SIZE (64 * 1024 * 1024)
+// the maximum number of threads that can write traces, any threads beyond
+// this many are ignored
+#define TRACE_MAX_WRITERS 1024
+
+typedef enum {
+	TRACE_OP_READ,
+	TRACE_OP_WRITE,
+	TRACE_OP_UDF,
+	TRACE_OP_COUNT
+} trace_op_t;
+
+/*
+ * the header at the start of every trace file
+ */
+struct trace_header_s {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	// add to the monotonic times of the records to get wall clock times in
+	// microseconds since the epoch
+	int64_t realtime_offset_us;
+	// one in this many transactions was traced
+	uint32_t sample_every;
+	uint32_t writer_idx;
+	uint8_t pad[32];
+};
+
+/*
+ * one traced transaction. Records are written in place into the mapped file,
+ * so a record with an end_us of 0 marks the end of a trace that wasn't
+ * closed cleanly
+ */
+struct trace_record_s {
+	// monotonic times, as returned by cf_getus
+	uint64_t start_us;
+	uint64_t end_us;
+	// the key value of single-key transactions, unused for batches
+	int64_t key;
+	// the number of records in the batch, 0 for single-key transactions
+	uint32_t batch_size;
+	int16_t status;
+	uint8_t op;
+	uint8_t pad;
+};
+
+struct trace_writer_s {
+	int fd;
+	// the mapped segment and where the next record goes in it
+	uint8_t* seg;
+	struct trace_record_s* next;
+	struct trace_record_s* end;
+	// the index of the mapped segment in the file
+	uint64_t seg_idx;
+	// counts down to the next transaction to be traced
+	uint32_t countdown;
+};
+
+typedef struct trace_s {
+	// trace files are named <prefix>.<writer index>
+	char* prefix;
+	uint32_t sample_every;
+	int64_t realtime_offset_us;
+	// distinguishes this instance from any that came before it in the
+	// thread-local writer cache
+	uint64_t id;
+
+	_Atomic(uint32_t) n_writers;
+	_Atomic(struct trace_writer_s*) writers[TRACE_MAX_WRITERS];
+} trace_t;
+
+
+trace_t* trace_create(const char* prefix, uint32_t sample_every);
+
+/*
+ * truncates every trace file to the records that were written and closes it.
+ * Must only be called once no more transactions are being traced
+ */
+void trace_free(trace_t*);
+
+/*
+ * traces one in every sample_every transactions finished by the calling
+ * thread into that thread's own trace file, which is created the first time
+ * the thread traces anything. Apart from when a segment fills up, this only
+ * writes to mapped memory. key is NULL for batches
+ */
+void trace_record(trace_t*, trace_op_t op, uint64_t start_us,
+		uint64_t end_us, as_status status, uint32_t batch_size, as_key* key);
+
+/*
+ * writes the records of a trace file to out as CSV, returning 0 on success
+ */
+int trace_decode(const char* path, FILE* out);
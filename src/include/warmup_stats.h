@@ -0,0 +1,110 @@
+/*******************************************************************************
+ * Copyright 2020-2021 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <aerospike/as_status.h>
+#include <aerospike/as_vector.h>
+
+#include <group_stats.h>
+#include <interval_log.h>
+
+
+/*
+ * the counters and latencies of the transactions that finish during a
+ * stage's warmup, kept apart so they stay out of the totals
+ */
+typedef struct warmup_stats_s {
+	// set by the coordinator for the length of the warmup
+	atomic_bool active;
+
+	// when the current warmup began, and how long the last one ran
+	uint64_t begin_us;
+	uint64_t elapsed_us;
+
+	struct group_op_stats_s ops[GROUP_OP_COUNT];
+
+	// the same counts since the output thread last took them, without
+	// latencies, and the bytes written over that time
+	struct group_op_stats_s period[GROUP_OP_COUNT];
+	_Atomic(uint64_t) period_bytes;
+} warmup_stats_t;
+
+
+/*
+ * creates the warmup stats, with latency histograms if latency is set
+ */
+warmup_stats_t* warmup_stats_create(bool latency);
+void warmup_stats_free(warmup_stats_t*);
+
+/*
+ * clears the counts of the previous warmup and starts counting transactions
+ * as warmup
+ */
+void warmup_stats_begin(warmup_stats_t*);
+
+/*
+ * stops counting transactions as warmup. Ones already being recorded may
+ * still land in the warmup counts
+ */
+void warmup_stats_end(warmup_stats_t*);
+
+/*
+ * whether transactions are currently counted as warmup, false if there are
+ * no warmup stats
+ */
+static inline bool
+warmup_stats_active(const warmup_stats_t* ws)
+{
+	return ws != NULL &&
+		atomic_load_explicit(&ws->active, memory_order_relaxed);
+}
+
+/*
+ * counts a transaction of op finished during the warmup by its status.
+ * Lock-free and safe to call from any thread
+ */
+void warmup_stats_record(warmup_stats_t*, group_op_t op, uint64_t dt_us,
+		as_status status);
+
+/*
+ * counts the bytes of a write finished during the warmup
+ */
+void warmup_stats_add_bytes(warmup_stats_t*, uint64_t n_bytes);
+
+/*
+ * takes the counts of the transactions finished during the warmup since the
+ * last call, for the periodic output. The counts are all 0 if there are no
+ * warmup stats
+ */
+void warmup_stats_take_period(warmup_stats_t*,
+		struct interval_counts_s counts[GROUP_OP_COUNT]);
+
+/*
+ * prints the counts and latency percentiles of the last warmup
+ */
+void warmup_stats_print(warmup_stats_t*, as_vector* percentiles,
+		FILE* out_file);
@@ -24,6 +24,7 @@
 #include <aerospike/as_random.h>
 #include <aerospike/as_vector.h>
 
+#include <key_permutation.h>
 #include <object_spec.h>
 
 
@@ -80,6 +81,9 @@ typedef struct workload_s {
 	 */
 	float read_all_pct;
 	float write_all_pct;
+
+	// for I, insert the keys in a pseudo-random order rather than ascending
+	bool shuffle;
 } workload_t;
 
 
@@ -92,6 +96,10 @@ typedef struct udf_spec_s {
 typedef struct stage_def_s {
 	// minimum stage duration in seconds
 	uint64_t duration;
+	// the number of transactions and bytes written after which the workload
+	// stops, 0 for no limit
+	uint64_t ops;
+	uint64_t bytes;
 
 	// string desctriptor for the stage, printed when the stage begins
 	char* desc;
@@ -107,6 +115,9 @@ typedef struct stage_def_s {
 	// max number of seconds to pause between stage starts, randomly selected
 	// between 1 and pause
 	uint64_t pause;
+	// seconds at the start of the stage, on top of duration, whose
+	// transactions are counted apart from the totals
+	uint64_t warmup;
 
 	// batch size for all batch types
 	uint32_t batch_size;
@@ -122,8 +133,18 @@ typedef struct stage_def_s {
 	// opposed to using a single fixed object over and over)
 	bool random;
 
+	// consecutive stages with the same index run concurrently as a group
 	uint16_t stage_idx;
 
+	// number of worker threads this workload runs on, 0 for --threads or,
+	// when it shares its stage with others, to split the remaining threads
+	// evenly
+	uint32_t threads;
+	// max number of async commands in flight, 0 for --async-max-commands
+	uint32_t async_max_commands;
+	// whether batch commands are sent to each node in parallel
+	bool batch_concurrent;
+
 	char* workload_str;
 
 	char* obj_spec_str;
@@ -145,6 +166,10 @@ typedef struct stage_defs_s {
 typedef struct stage_s {
 	// minimum stage duration in seconds
 	uint64_t duration;
+	// the number of transactions and bytes written after which the workload
+	// stops, 0 for no limit
+	uint64_t ops;
+	uint64_t bytes;
 
 	// string descriptor for the stage, printed when the stage begins
 	char* desc;
@@ -160,6 +185,9 @@ typedef struct stage_s {
 	// max number of seconds to pause between stage starts, randomly selected
 	// between 1 and pause
 	uint64_t pause;
+	// seconds at the start of the stage, on top of duration, whose
+	// transactions are counted apart from the totals
+	uint64_t warmup;
 
 	// batch size for all batch types
 	uint32_t batch_size;
@@ -174,6 +202,10 @@ typedef struct stage_s {
 	// whether random objects should be created for each write op (as
 	// opposed to using a single fixed object over and over)
 	bool random;
+	// max number of async commands in flight
+	uint32_t async_max_commands;
+	// whether batch commands are sent to each node in parallel
+	bool batch_concurrent;
 
 	workload_t workload;
 
@@ -188,6 +220,18 @@ typedef struct stage_s {
 	as_udf_module_name udf_package_name;
 	as_udf_function_name udf_fn_name;
 	obj_spec_t udf_fn_args;
+
+	// the order keys are visited in when workload.shuffle is set
+	key_perm_t key_perm;
+
+	// the group of concurrent workloads this belongs to (the stage number
+	// - 1), and its position within the group
+	uint32_t group;
+	uint32_t group_pos;
+	// the range of worker threads that run this workload while its group is
+	// active
+	uint32_t first_thread;
+	uint32_t n_threads;
 } stage_t;
 
 
@@ -249,6 +293,44 @@ static inline bool stages_contain_async(const stages_t* stages)
 	return false;
 }
 
+static inline bool stages_contain_batch_concurrent(const stages_t* stages)
+{
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		if (stages->stages[i].batch_concurrent) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * whether the workload stops after a number of transactions or bytes
+ */
+static inline bool stage_has_budget(const stage_t* stage)
+{
+	return stage->ops != 0 || stage->bytes != 0;
+}
+
+static inline bool stages_contain_budgets(const stages_t* stages)
+{
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		if (stage_has_budget(&stages->stages[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline bool stages_contain_warmup(const stages_t* stages)
+{
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		if (stages->stages[i].warmup > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static inline bool stages_contain_random(const stages_t* stages)
 {
 	for (uint32_t i = 0; i < stages->n_stages; i++) {
@@ -271,11 +353,111 @@ static inline bool workload_is_infinite(const workload_t* workload)
 		workload->type == WORKLOAD_TYPE_RUD;
 }
 
+/*
+ * maps the pos'th key of a linear workload to the key that is actually used,
+ * which is pos itself unless the stage shuffles its keys
+ */
+static inline uint64_t stage_linear_key(const stage_t* stage, uint64_t pos)
+{
+	if (!stage->workload.shuffle) {
+		return pos;
+	}
+	return stage->key_start +
+		key_perm_apply(&stage->key_perm, pos - stage->key_start);
+}
+
+/*
+ * returns the index one past the last workload of the group starting at
+ * stage_idx
+ */
+static inline uint32_t stages_group_end(const stages_t* stages,
+		uint32_t stage_idx)
+{
+	uint32_t group = stages->stages[stage_idx].group;
+	uint32_t end = stage_idx + 1;
+
+	while (end < stages->n_stages && stages->stages[end].group == group) {
+		end++;
+	}
+	return end;
+}
+
+static inline bool stage_runs_thread(const stage_t* stage, uint32_t t_idx)
+{
+	return t_idx >= stage->first_thread &&
+		t_idx < stage->first_thread + stage->n_threads;
+}
+
+/*
+ * returns the workload of the group starting at first that worker thread
+ * t_idx runs. Threads the group doesn't use (parked worker threads, or the
+ * output thread) follow the first workload of the group
+ */
+static inline uint32_t stages_assign_thread(const stages_t* stages,
+		uint32_t first, uint32_t t_idx)
+{
+	uint32_t end = stages_group_end(stages, first);
+
+	for (uint32_t i = first; i < end; i++) {
+		if (stage_runs_thread(&stages->stages[i], t_idx)) {
+			return i;
+		}
+	}
+	return first;
+}
+
+static inline bool stages_group_contains_async(const stages_t* stages,
+		uint32_t first)
+{
+	uint32_t end = stages_group_end(stages, first);
+
+	for (uint32_t i = first; i < end; i++) {
+		if (stages->stages[i].async) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline bool stages_group_has_budget(const stages_t* stages,
+		uint32_t first)
+{
+	uint32_t end = stages_group_end(stages, first);
+
+	for (uint32_t i = first; i < end; i++) {
+		if (stage_has_budget(&stages->stages[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * returns true if any group runs more than one workload at a time
+ */
+static inline bool stages_contain_groups(const stages_t* stages)
+{
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		if (stages->stages[i].group_pos != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static inline void fprint_stage(FILE* out_file, const stages_t* stages,
 		uint32_t stage_idx)
 {
-	const char* desc = stages->stages[stage_idx].desc;
-	fprintf(out_file, "Stage %d: %s\n", stage_idx + 1, desc ? desc : "");
+	const stage_t* stage = &stages->stages[stage_idx];
+	uint32_t first = stage_idx - stage->group_pos;
+	uint32_t end = stages_group_end(stages, first);
+
+	fprintf(out_file, "Stage %d: ", stage->group + 1);
+	for (uint32_t i = first; i < end; i++) {
+		const char* desc = stages->stages[i].desc;
+		fprintf(out_file, "%s%s", i == first ? "" : " | ", desc ? desc : "");
+	}
+	fprintf(out_file, "\n");
 }
 
 /*
@@ -328,6 +510,24 @@ bool stages_contain_reads(const stages_t*);
  */
 bool stages_contain_udfs(const stages_t*);
 
+/*
+ * finds the smallest key range [*key_start, *key_end) containing the key
+ * ranges of all of the stages
+ */
+void stages_key_range(const stages_t*, uint64_t* key_start, uint64_t* key_end);
+
+/*
+ * returns the number of worker threads the stages need, the most any one of
+ * them runs on. Stages that need fewer leave the rest parked
+ */
+uint32_t stages_n_threads(const stages_t*);
+
+/*
+ * returns the most async commands any async stage keeps in flight, or 0 if
+ * there are no async stages
+ */
+uint32_t stages_async_max_commands(const stages_t*);
+
 /*
  * generates a random key for the stage
  */
@@ -28,11 +28,14 @@
 #include <time.h>
 
 #include <aerospike/aerospike_info.h>
+#include <aerospike/aerospike_stats.h>
 #include <aerospike/as_config.h>
 #include <aerospike/as_event.h>
 #include <aerospike/as_log.h>
 #include <aerospike/as_monitor.h>
 #include <aerospike/as_random.h>
+#include <aerospike/as_sleep.h>
+#include <citrusleaf/cf_clock.h>
 
 #include <hdr_histogram/hdr_time.h>
 #include <hdr_histogram/hdr_histogram_log.h>
@@ -42,6 +45,21 @@
 #include <transaction.h>
 
 
+//==========================================================
+// Typedefs & constants.
+//
+
+// how long to wait for the connection pools to fill up to their minimums
+// before starting the benchmark anyway
+#define PREWARM_TIMEOUT_MS 10000
+
+// the client threads that send the parallel batches of batch-concurrent
+// stages, one per node. The pool is sized when the client is created, before
+// the cluster is known, so on larger clusters the requests to the remaining
+// nodes wait for a thread to free up
+#define BATCH_CONCURRENT_THREADS 16
+
+
 //==========================================================
 // Forward declarations.
 //
@@ -49,11 +67,23 @@
 LOCAL_HELPER bool as_client_log_cb(as_log_level level, const char* func,
 		const char* file, uint32_t line, const char* fmt, ...);
 LOCAL_HELPER int connect_to_server(args_t* args, aerospike* client);
+LOCAL_HELPER void prewarm_connections(const args_t* args, aerospike* client);
+LOCAL_HELPER bool pools_at_min(aerospike* client, uint32_t min_conns,
+		uint32_t async_min_conns);
+#if AS_EVENT_LIB_DEFINED
+LOCAL_HELPER void pin_event_loops(const args_t* args);
+#endif
 LOCAL_HELPER bool is_single_bin(aerospike* client, const char* namespace);
 LOCAL_HELPER void add_default_tls_host(as_config *as_conf, const char* tls_name);
+LOCAL_HELPER digest_table_t* create_digest_table(const args_t* args,
+		const cdata_t* cdata);
+LOCAL_HELPER uint32_t thread_slot(const args_t* args, const cdata_t* cdata,
+		uint32_t t_idx);
 LOCAL_HELPER tdata_t* init_tdata(const args_t* args, cdata_t* cdata,
 		thr_coord_t* coord, uint32_t t_idx);
 LOCAL_HELPER void destroy_tdata(tdata_t* tdata);
+LOCAL_HELPER int spawn_thread(pthread_t* thread, const cdata_t* cdata,
+		uint32_t slot, void* (*fn)(void*), void* udata);
 LOCAL_HELPER int _run(const args_t* args, cdata_t* cdata);
 
 
@@ -72,10 +102,25 @@ run_benchmark(args_t* args)
 	data.set = args->set;
 	data.transaction_worker_threads = args->transaction_worker_threads;
 	data.compression_ratio = args->compression_ratio;
+	data.packed_cdt = args->packed_cdt;
 	stages_move(&data.stages, &args->stages);
 	data.latency = args->latency;
+	data.latency_corrected = args->latency_corrected;
 	data.debug = args->debug;
-	data.async_max_commands = args->async_max_commands;
+	// the most any stage keeps in flight, each stage holding back the
+	// commands it doesn't use
+	data.async_max_commands = (int) stages_async_max_commands(&data.stages);
+	data.async_adaptive = args->async_adaptive;
+	data.async_self_sustaining = args->async_self_sustaining;
+	if (data.async_adaptive) {
+		// shared by every stage, so what it's learned about the cluster
+		// carries over from one to the next, like the async commands do
+		conc_limiter_init(&data.async_limiter, 1, data.async_max_commands,
+				cf_getus());
+	}
+	data.affinity = &args->affinity;
+	data.proc_stats = args->proc_stats;
+	data.proc_idx = args->proc_idx;
 	
 	atomic_init(&data.read_hit_count, 0);
 	atomic_init(&data.read_miss_count, 0);
@@ -84,6 +129,7 @@ run_benchmark(args_t* args)
 	atomic_init(&data.write_count, 0);
 	atomic_init(&data.write_timeout_count, 0);
 	atomic_init(&data.write_error_count, 0);
+	atomic_init(&data.write_bytes, 0);
 	atomic_init(&data.udf_count, 0);
 	atomic_init(&data.udf_timeout_count, 0);
 	atomic_init(&data.udf_error_count, 0);
@@ -100,12 +146,18 @@ run_benchmark(args_t* args)
 
 	as_log_set_callback(as_client_log_cb);
 
+	// before the client starts any threads of its own, so they inherit it
+	cpu_affinity_bind_process(&args->affinity);
+
 	int ret = connect_to_server(args, &data.client);
 
 	if (ret != 0) {
 		goto cleanup1;
 	}
 
+	// so the first seconds of the first stage don't pay for opening them
+	prewarm_connections(args, &data.client);
+
 	bool single_bin = is_single_bin(&data.client, args->namespace);
 
 	if (single_bin) {
@@ -120,6 +172,73 @@ run_benchmark(args_t* args)
 		data.bin_name = args->bin_name;
 	}
 
+	if (args->digest_table) {
+		data.digest_table = create_digest_table(args, &data);
+		if (data.digest_table == NULL) {
+			ret = -1;
+			goto cleanup2;
+		}
+	}
+
+	if (args->slow_ops_file != NULL) {
+		// the partition map isn't available with shared memory tending
+		data.slow_ops = slow_ops_create(args->slow_ops_file,
+				(uint32_t) args->slow_ops_k, args->use_shm ? NULL : &data.client);
+		if (data.slow_ops == NULL) {
+			ret = -1;
+			goto cleanup2;
+		}
+	}
+
+	if (args->trace_prefix != NULL) {
+		data.trace = trace_create(args->trace_prefix,
+				(uint32_t) args->trace_sample);
+	}
+
+	if (args->self_stats) {
+		data.self_stats = self_stats_create();
+	}
+
+	if (args->perf_counters) {
+		data.perf_counters = perf_counters_create(
+				(uint32_t) args->perf_counters_sample);
+	}
+
+	if (args->node_stats) {
+		data.node_stats = node_stats_create(args->node_stats_top_n);
+	}
+
+	if (stages_contain_groups(&data.stages)) {
+		data.group_stats = group_stats_create(&data.stages, args->latency);
+	}
+
+	if (stages_contain_warmup(&data.stages)) {
+		data.warmup_stats = warmup_stats_create(args->latency);
+	}
+
+	if (stages_contain_budgets(&data.stages)) {
+		data.budgets = (stage_budget_t*) cf_malloc(data.stages.n_stages *
+				sizeof(stage_budget_t));
+		for (uint32_t i = 0; i < data.stages.n_stages; i++) {
+			stage_budget_init(&data.budgets[i], data.stages.stages[i].ops,
+					data.stages.stages[i].bytes);
+		}
+	}
+
+	data.error_stats = error_stats_create(args->error_log_rate != 0 ?
+			(uint32_t) args->error_log_rate :
+			(args->debug ? ERROR_STATS_DEBUG_LOG_RATE : 0));
+
+	if (args->key_tracking) {
+		uint64_t key_start;
+		uint64_t key_end;
+		stages_key_range(&data.stages, &key_start, &key_end);
+
+		data.key_tracker = (key_tracker_t*) cf_malloc(sizeof(key_tracker_t));
+		key_tracker_init(data.key_tracker, key_start, key_end - key_start);
+		data.read_miss_pct = args->read_miss_pct;
+	}
+
 	if (initialize_histograms(&data, args, &start_time, &start_timespec) != 0) {
 		ret = -1;
 		goto cleanup2;
@@ -145,10 +264,54 @@ run_benchmark(args_t* args)
 #pragma GCC diagnostic pop
 #endif /* __linux__ */
 
+	if (data.node_stats != NULL) {
+		node_stats_print_summary(data.node_stats);
+	}
+	// the parent of a worker process prints the summary for all of them
+	if (data.proc_stats == NULL) {
+		error_stats_print_summary(data.error_stats);
+	}
+	if (data.self_stats != NULL) {
+		self_stats_print_summary(data.self_stats);
+	}
+
 cleanup3:
 	free_histograms(&data, args);
+	if (data.node_stats != NULL) {
+		node_stats_free(data.node_stats);
+	}
+	error_stats_free(data.error_stats);
+	if (data.group_stats != NULL) {
+		group_stats_free(data.group_stats);
+	}
+	if (data.warmup_stats != NULL) {
+		warmup_stats_free(data.warmup_stats);
+	}
+	if (data.budgets != NULL) {
+		cf_free(data.budgets);
+	}
 
 cleanup2:
+	if (data.key_tracker != NULL) {
+		key_tracker_free(data.key_tracker);
+		cf_free(data.key_tracker);
+	}
+	if (data.digest_table != NULL) {
+		digest_table_free(data.digest_table);
+		cf_free(data.digest_table);
+	}
+	if (data.slow_ops != NULL) {
+		slow_ops_free(data.slow_ops);
+	}
+	if (data.trace != NULL) {
+		trace_free(data.trace);
+	}
+	if (data.self_stats != NULL) {
+		self_stats_free(data.self_stats);
+	}
+	if (data.perf_counters != NULL) {
+		perf_counters_free(data.perf_counters);
+	}
 	aerospike_close(&data.client, &err);
 	aerospike_destroy(&data.client);
 
@@ -188,6 +351,7 @@ connect_to_server(args_t* args, aerospike* client)
 			blog_error("Failed to create asynchronous event loops\n");
 			return 2;
 		}
+		pin_event_loops(args);
 #else
 		blog_error("Must 'make EVENT_LIB=<libname>' to use asynchronous functions.\n");
 		return 2;
@@ -222,13 +386,19 @@ connect_to_server(args_t* args, aerospike* client)
 	cfg.min_conns_per_node = args->min_conns_per_node;
 	cfg.max_conns_per_node = args->max_conns_per_node;
 
-	// Disable batch/scan/query thread pool because these commands are not used in benchmarks.
-	cfg.thread_pool_size = 0;
+	// Disable batch/scan/query thread pool because these commands are not used
+	// in benchmarks, unless a stage sends its batches to the nodes in parallel,
+	// which takes a thread per node
+	cfg.thread_pool_size = stages_contain_batch_concurrent(&args->stages) ?
+		BATCH_CONCURRENT_THREADS : 0;
 	cfg.conn_pools_per_node = args->conn_pools_per_node;
 
 	cfg.async_min_conns_per_node = args->async_min_conns_per_node;
-	if (args->async_max_conns_per_node < (uint32_t)args->async_max_commands) {
-		cfg.async_max_conns_per_node = args->async_max_commands;
+	// stages may keep more commands in flight than --async-max-commands
+	uint32_t async_max_commands = MAX((uint32_t) args->async_max_commands,
+			stages_async_max_commands(&args->stages));
+	if (args->async_max_conns_per_node < async_max_commands) {
+		cfg.async_max_conns_per_node = async_max_commands;
 	} else {
 		cfg.async_max_conns_per_node = args->async_max_conns_per_node;
 	}
@@ -252,6 +422,82 @@ connect_to_server(args_t* args, aerospike* client)
 	return 0;
 }
 
+/*
+ * waits for the client to open the sync and async connection pools of every
+ * node up to min_conns_per_node and async_min_conns_per_node, which it does
+ * in the background once it finds the node
+ */
+LOCAL_HELPER void
+prewarm_connections(const args_t* args, aerospike* client)
+{
+	uint32_t min_conns = (uint32_t) args->min_conns_per_node;
+	// the async pools only exist when there are event loops
+	uint32_t async_min_conns = stages_contain_async(&args->stages) ?
+		(uint32_t) args->async_min_conns_per_node : 0;
+
+	if (min_conns == 0 && async_min_conns == 0) {
+		return;
+	}
+
+	blog_info("Opening %u sync and %u async connections per node\n",
+			min_conns, async_min_conns);
+
+	uint64_t deadline = cf_getms() + PREWARM_TIMEOUT_MS;
+	while (!pools_at_min(client, min_conns, async_min_conns)) {
+		if (cf_getms() >= deadline) {
+			blog_warn("Connection pools not at their minimums after %ums, "
+					"starting anyway\n", PREWARM_TIMEOUT_MS);
+			return;
+		}
+		as_sleep(10);
+	}
+}
+
+LOCAL_HELPER bool
+pools_at_min(aerospike* client, uint32_t min_conns, uint32_t async_min_conns)
+{
+	as_cluster_stats stats;
+	bool at_min = true;
+
+	aerospike_stats(client, &stats);
+	for (uint32_t i = 0; i < stats.nodes_size; i++) {
+		as_node_stats* node = &stats.nodes[i];
+
+		if (node->sync.in_pool + node->sync.in_use < min_conns ||
+				node->async.in_pool + node->async.in_use < async_min_conns) {
+			at_min = false;
+			break;
+		}
+	}
+	aerospike_stats_destroy(&stats);
+	return at_min;
+}
+
+#if AS_EVENT_LIB_DEFINED
+/*
+ * the client starts its event loop threads itself, so they can only be moved
+ * onto their CPUs once they're running. They come after the transaction
+ * workers in the placement order
+ */
+LOCAL_HELPER void
+pin_event_loops(const args_t* args)
+{
+	if (!cpu_affinity_enabled(&args->affinity)) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < as_event_loop_size; i++) {
+		as_event_loop* loop = as_event_loop_get_by_index(i);
+		uint32_t slot = (uint32_t) args->transaction_worker_threads + i;
+
+		if (!cpu_affinity_pin_thread(&args->affinity, loop->thread, slot)) {
+			blog_warn("Failed to pin event loop %u to CPU %d\n", i,
+					cpu_affinity_cpu(&args->affinity, slot));
+		}
+	}
+}
+#endif
+
 LOCAL_HELPER bool
 is_single_bin(aerospike* client, const char* namespace)
 {
@@ -308,20 +554,73 @@ add_default_tls_host(as_config *as_conf, const char* tls_name)
 }
 
 /*
- * allocates and initializes a new threaddata struct, returning a pointer to it
+ * builds a digest table covering the union of all the stages' key ranges,
+ * capped at digest_table_max_keys keys
+ */
+LOCAL_HELPER digest_table_t*
+create_digest_table(const args_t* args, const cdata_t* cdata)
+{
+	uint64_t key_start;
+	uint64_t key_end;
+	stages_key_range(&cdata->stages, &key_start, &key_end);
+
+	uint64_t n_keys = MIN(key_end - key_start, args->digest_table_max_keys);
+	if (n_keys < key_end - key_start) {
+		blog_warn("Digest table only covers %" PRIu64 " of %" PRIu64 " keys\n",
+				n_keys, key_end - key_start);
+	}
+
+	digest_table_t* dt = (digest_table_t*) cf_malloc(sizeof(digest_table_t));
+	if (digest_table_init(dt, cdata->namespace, cdata->set, key_start, n_keys,
+				cdata->transaction_worker_threads,
+				args->digest_table_file) != 0) {
+		cf_free(dt);
+		return NULL;
+	}
+	return dt;
+}
+
+/*
+ * the placement order of the thread with index t_idx: the transaction workers
+ * first, then the event loops, then the output thread
+ */
+LOCAL_HELPER uint32_t
+thread_slot(const args_t* args, const cdata_t* cdata, uint32_t t_idx)
+{
+	uint32_t n_workers = (uint32_t) cdata->transaction_worker_threads;
+
+	if (t_idx < n_workers) {
+		return t_idx;
+	}
+	return n_workers + (stages_contain_async(&cdata->stages) ?
+			(uint32_t) args->event_loop_capacity : 0);
+}
+
+/*
+ * allocates and initializes a new threaddata struct, returning a pointer to it,
+ * or NULL if it couldn't be allocated
  */
 LOCAL_HELPER tdata_t*
 init_tdata(const args_t* args, cdata_t* cdata, thr_coord_t* coord,
 		uint32_t t_idx)
 {
-	tdata_t* tdata = (tdata_t*) cf_malloc(sizeof(tdata_t));
+	// on the NUMA node of the CPU the thread will run on
+	tdata_t* tdata = (tdata_t*) cpu_affinity_alloc(cdata->affinity,
+			sizeof(tdata_t), thread_slot(args, cdata, t_idx));
+	if (tdata == NULL) {
+		return NULL;
+	}
 
 	tdata->cdata = cdata;
 	tdata->coord = coord;
 	tdata->random = as_random_instance();
 	tdata->t_idx = t_idx;
-	// always start on the first stage
-	atomic_init(&tdata->stage_idx, 0);
+	// always start on the first stage, on the workload of this thread
+	atomic_init(&tdata->stage_idx,
+			stages_assign_thread(&cdata->stages, 0, t_idx));
+
+	atomic_init(&tdata->epoch, 0);
+	tdata->async_pool = NULL;
 
 	atomic_init(&tdata->do_work, true);
 	atomic_init(&tdata->finished, false);
@@ -400,6 +699,27 @@ destroy_tdata(tdata_t* tdata)
 {
 }
 
+/*
+ * creates a thread that starts out on the CPU of the given slot, so
+ * everything it allocates is local to it from the beginning
+ */
+LOCAL_HELPER int
+spawn_thread(pthread_t* thread, const cdata_t* cdata, uint32_t slot,
+		void* (*fn)(void*), void* udata)
+{
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+
+	if (!cpu_affinity_set_attr(cdata->affinity, &attr, slot)) {
+		blog_warn("Failed to pin thread to CPU %d\n",
+				cpu_affinity_cpu(cdata->affinity, slot));
+	}
+
+	int ret = pthread_create(thread, &attr, fn, udata);
+	pthread_attr_destroy(&attr);
+	return ret;
+}
+
 LOCAL_HELPER int
 _run(const args_t* args, cdata_t* cdata)
 {
@@ -419,12 +739,28 @@ _run(const args_t* args, cdata_t* cdata)
 
 	for (uint32_t i = 0; i < n_threads; i++) {
 		tdatas[i] = init_tdata(args, cdata, &coord, i);
+
+		if (tdatas[i] == NULL) {
+			blog_error("Failed to allocate thread data\n");
+			while (i-- > 0) {
+				destroy_tdata(tdatas[i]);
+				cpu_affinity_dealloc(cdata->affinity, tdatas[i],
+						sizeof(tdata_t));
+			}
+			cf_free(tdatas);
+			return -1;
+		}
 	}
 
 	// pause before the first workload stage (using the logger thread's
 	// as_random)
 	stage_random_pause(tdatas[n_threads - 1]->random, &cdata->stages.stages[0]);
 
+	// a worker process starts the first stage along with the others
+	if (cdata->proc_stats != NULL) {
+		proc_stats_wait_stage(cdata->proc_stats, cdata->proc_idx, 0);
+	}
+
 	// then initialize the thread coordinator struct, before spawning any
 	// threads which will be referencing it
 	thr_coordinator_init(&coord, n_threads);
@@ -433,7 +769,8 @@ _run(const args_t* args, cdata_t* cdata)
 
 	// then initialize periodic output thread
 	tdata_t* out_worker_tdata = tdatas[n_threads - 1];
-	if (pthread_create(&threads[n_threads - 1], NULL, periodic_output_worker,
+	if (spawn_thread(&threads[n_threads - 1], cdata,
+				thread_slot(args, cdata, n_threads - 1), periodic_output_worker,
 				out_worker_tdata) != 0) {
 		blog_error("Failed to create output thread\n");
 		cf_free(threads);
@@ -450,7 +787,8 @@ _run(const args_t* args, cdata_t* cdata)
 	for (i = 0; i < n_threads - 1; i++) {
 		tdata_t* tdata = tdatas[i];
 
-		if (pthread_create(&threads[i], NULL, worker_fn, tdata) != 0) {
+		if (spawn_thread(&threads[i], cdata, thread_slot(args, cdata, i),
+					worker_fn, tdata) != 0) {
 			blog_error("Failed to create transaction worker thread\n");
 			ret = -1;
 
@@ -470,6 +808,13 @@ _run(const args_t* args, cdata_t* cdata)
 		// and now enter the coordinator funtion
 		coordinator_worker(&coord_args);
 	}
+	else {
+		// by this point, if all went well, the coordinator thread should have
+		// already closed all of these threads, but since something went wrong
+		// before we started the coordinator, we need to tell each of these
+		// threads to exit
+		thr_coordinator_terminate(&coord, tdatas, n_threads);
+	}
 
 	i--;
 	for (;;) {
@@ -478,20 +823,9 @@ _run(const args_t* args, cdata_t* cdata)
 			i = n_threads - 1;
 		}
 
-		// by this point, if all went well, the coordinator thread should have
-		// already closed all of these threads, but in the case that something
-		// went wrong before we started the coordinator, we need to tell each
-		// of these threads to exit
-		if (ret != 0) {
-			// make thread exit
-			// note that we must update finished before do_work, since we don't
-			// want any of the threads to enter the pthread barrier 
-			tdatas[i]->finished = true;
-			tdatas[i]->do_work = false;
-		}
 		pthread_join(threads[i], NULL);
 		destroy_tdata(tdatas[i]);
-		cf_free(tdatas[i]);
+		cpu_affinity_dealloc(cdata->affinity, tdatas[i], sizeof(tdata_t));
 
 		if (i == n_threads - 1) {
 			break;
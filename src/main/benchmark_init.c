@@ -26,6 +26,8 @@
 
 #include <benchmark.h>
 #include <common.h>
+#include <instance.h>
+#include <processes.h>
 
 #include <limits.h>
 #include <stdio.h>
@@ -99,6 +101,7 @@ typedef enum {
 	BENCH_OPT_BATCH_DELETE_SIZE,
 	BENCH_OPT_COMPRESS,
 	BENCH_OPT_COMPRESSION_RATIO,
+	BENCH_OPT_PACKED_CDT,
 	BENCH_OPT_SOCKET_TIMEOUT,
 	BENCH_OPT_READ_SOCKET_TIMEOUT,
 	BENCH_OPT_WRITE_SOCKET_TIMEOUT,
@@ -107,11 +110,33 @@ typedef enum {
 	BENCH_OPT_MAX_RETRIES,
 	BENCH_OPT_SLEEP_BETWEEN_RETRIES,
 	BENCH_OPT_PERCENTILES,
+	BENCH_OPT_LATENCY_CORRECTED,
 	BENCH_OPT_OUTPUT_FILE,
 	BENCH_OPT_OUTPUT_PERIOD,
 	BENCH_OPT_HDR_HIST,
 	BENCH_OPT_RACK_ID,
-	BENCH_OPT_SEND_KEY
+	BENCH_OPT_SEND_KEY,
+	BENCH_OPT_ASYNC_ADAPTIVE,
+	BENCH_OPT_ASYNC_SELF_SUSTAINING,
+	BENCH_OPT_NODE_STATS,
+	BENCH_OPT_DIGEST_TABLE,
+	BENCH_OPT_DIGEST_TABLE_FILE,
+	BENCH_OPT_KEY_TRACKING,
+	BENCH_OPT_READ_MISS_PCT,
+	BENCH_OPT_ERROR_LOG_RATE,
+	BENCH_OPT_SLOW_OPS,
+	BENCH_OPT_SLOW_OPS_K,
+	BENCH_OPT_TRACE,
+	BENCH_OPT_TRACE_SAMPLE,
+	BENCH_OPT_TRACE_DECODE,
+	BENCH_OPT_INSTANCE_ID,
+	BENCH_OPT_INSTANCE_COUNT,
+	BENCH_OPT_MERGE,
+	BENCH_OPT_PROCESSES,
+	BENCH_OPT_SELF_STATS,
+	BENCH_OPT_PERF_COUNTERS,
+	BENCH_OPT_CPU_LIST,
+	BENCH_OPT_NUMA_NODE
 } benchmark_opt;
 
 static struct option long_options[] = {
@@ -154,6 +179,7 @@ static struct option long_options[] = {
 	{"batch-delete-size",     required_argument, 0, BENCH_OPT_BATCH_DELETE_SIZE},
 	{"compress",              no_argument,       0, BENCH_OPT_COMPRESS},
 	{"compression-ratio",     required_argument, 0, BENCH_OPT_COMPRESSION_RATIO},
+	{"packed-cdt",            no_argument,       0, BENCH_OPT_PACKED_CDT},
 	{"socket-timeout",        required_argument, 0, BENCH_OPT_SOCKET_TIMEOUT},
 	{"read-socket-timeout",   required_argument, 0, BENCH_OPT_READ_SOCKET_TIMEOUT},
 	{"write-socket-timeout",  required_argument, 0, BENCH_OPT_WRITE_SOCKET_TIMEOUT},
@@ -165,9 +191,27 @@ static struct option long_options[] = {
 	{"debug",                 no_argument,       0, 'd'},
 	{"latency",               no_argument,       0, 'L'},
 	{"percentiles",           required_argument, 0, BENCH_OPT_PERCENTILES},
+	{"latency-corrected",     no_argument,       0, BENCH_OPT_LATENCY_CORRECTED},
 	{"output-file",           required_argument, 0, BENCH_OPT_OUTPUT_FILE},
 	{"output-period",         required_argument, 0, BENCH_OPT_OUTPUT_PERIOD},
 	{"hdr-hist",              required_argument, 0, BENCH_OPT_HDR_HIST},
+	{"node-stats",            optional_argument, 0, BENCH_OPT_NODE_STATS},
+	{"digest-table",          optional_argument, 0, BENCH_OPT_DIGEST_TABLE},
+	{"digest-table-file",     required_argument, 0, BENCH_OPT_DIGEST_TABLE_FILE},
+	{"key-tracking",          no_argument,       0, BENCH_OPT_KEY_TRACKING},
+	{"read-miss-pct",         required_argument, 0, BENCH_OPT_READ_MISS_PCT},
+	{"error-log-rate",        required_argument, 0, BENCH_OPT_ERROR_LOG_RATE},
+	{"slow-ops",              required_argument, 0, BENCH_OPT_SLOW_OPS},
+	{"slow-ops-k",            required_argument, 0, BENCH_OPT_SLOW_OPS_K},
+	{"trace",                 required_argument, 0, BENCH_OPT_TRACE},
+	{"trace-sample",          required_argument, 0, BENCH_OPT_TRACE_SAMPLE},
+	{"trace-decode",          required_argument, 0, BENCH_OPT_TRACE_DECODE},
+	{"instance-id",           required_argument, 0, BENCH_OPT_INSTANCE_ID},
+	{"instance-count",        required_argument, 0, BENCH_OPT_INSTANCE_COUNT},
+	{"merge",                 required_argument, 0, BENCH_OPT_MERGE},
+	{"processes",             required_argument, 0, BENCH_OPT_PROCESSES},
+	{"self-stats",            no_argument,       0, BENCH_OPT_SELF_STATS},
+	{"perf-counters",         optional_argument, 0, BENCH_OPT_PERF_COUNTERS},
 	{"shared",                no_argument,       0, 'S'},
 	{"replica",               required_argument, 0, 'C'},
 	{"rack-id",               required_argument, 0, BENCH_OPT_RACK_ID},
@@ -182,7 +226,11 @@ static struct option long_options[] = {
 	{"durable-delete",        no_argument,       0, 'D'},
 	{"async",                 no_argument,       0, 'a'},
 	{"async-max-commands",    required_argument, 0, 'c'},
+	{"async-adaptive",        no_argument,       0, BENCH_OPT_ASYNC_ADAPTIVE},
+	{"async-self-sustaining", no_argument,       0, BENCH_OPT_ASYNC_SELF_SUSTAINING},
 	{"event-loops",           required_argument, 0, 'W'},
+	{"cpu-list",              required_argument, 0, BENCH_OPT_CPU_LIST},
+	{"numa-node",             required_argument, 0, BENCH_OPT_NUMA_NODE},
 	{"send-key",              no_argument,       0, BENCH_OPT_SEND_KEY},
 	{"tls-enable",            no_argument,       0, TLS_OPT_ENABLE},
 	{"tls-name",              required_argument, 0, TLS_OPT_NAME},
@@ -275,13 +323,18 @@ benchmark_init(int argc, char* argv[])
 
 	int ret = set_args(argc, argv, &args);
 
-	if (ret == 0) {
+	if (ret == 0 && args.merge_paths != NULL) {
+		// merging the logs of an earlier run replaces the run
+		ret = interval_log_merge(args.merge_paths, &args.latency_percentiles,
+				args.hdr_output, stdout) == 0 ? -1 : 1;
+	}
+	else if (ret == 0) {
 		ret = _load_defaults_post(&args);
 	}
 
 	if (ret == 0) {
 		print_args(&args);
-		ret = run_benchmark(&args);
+		ret = args.processes > 1 ? run_processes(&args) : run_benchmark(&args);
 	}
 	else if (ret != -1) {
 		printf("Run with --help for usage information and flag options.\n");
@@ -441,6 +494,11 @@ print_usage(const char* program)
 	printf("     workload: Workload type\n");
 	printf("   Optionally each stage should include:\n");
 	printf("     tps : max possible with 0 (default), or specified transactions per second\n");
+	printf("     ops: number of transactions after which the workload stops, 0 (default) for no limit.\n");
+	printf("         Batches count as one transaction each.\n");
+	printf("     bytes: number of record bytes sent by writes after which the workload stops, 0 (default) for\n");
+	printf("         no limit. A workload with ops or bytes runs until they are spent, or for at most duration\n");
+	printf("         seconds if it's given.\n");
 	printf("     object-spec: Object spec for the stage. Otherwise, inherits from the previous\n");
 	printf("         stage, with the first stage inheriting the global object spec.\n");
 	printf("     key-start: Key start, otherwise inheriting from the global context\n");
@@ -449,12 +507,26 @@ print_usage(const char* program)
 	printf("     write-bins: Which bins to write to if the workload includes reads\n");
 	printf("     pause: max number of seconds to pause before the stage starts. Waits a random\n");
 	printf("         number of seconds between 1 and the pause.\n");
+	printf("     warmup: number of seconds the stage runs before its duration, with its transactions counted\n");
+	printf("         separately and left out of the totals and latencies. Default is 0\n");
 	printf("     async: when true/yes, uses asynchronous commands for this stage. Default is false\n");
 	printf("     random: when true/yes, randomly generates new objects for each write. Default is false\n");
 	printf("     batch-size: specifies the batch size for all batch transactions for this stage. Default is 1\n");
 	printf("     batch-read-size: specifies the batch size of reads for this stage. Takes precedence over batch-size. Default is 1\n");
 	printf("     batch-write-size: specifies the batch size of writes for this stage. Takes precedence over batch-size. Default is 1\n");
 	printf("     batch-delete-size: specifies the batch size of deletes for this stage. Takes precedence over batch-size. Default is 1\n");
+	printf("     batch-concurrent: when true/yes, sends the batch commands of this stage to each node in parallel.\n");
+	printf("         Parallel batches share a pool of 16 client threads, so with more than 16 nodes some of\n");
+	printf("         them wait for a thread. Default is false\n");
+	printf("     threads: number of threads this workload runs on. A stage whose workloads all set it runs on just\n");
+	printf("         those threads, more or fewer than --threads, with the threads it doesn't need parked until a\n");
+	printf("         stage that does. Otherwise the stage runs on --threads, with the threads the others leave split\n");
+	printf("         evenly.\n");
+	printf("     async-max-commands: max number of async commands in flight for this stage. Default is\n");
+	printf("         --async-max-commands\n");
+	printf("   Consecutive entries marked with the same stage number run concurrently as one stage, for as long as\n");
+	printf("       the longest of them, each with its own threads and separately labelled (by desc) counters and\n");
+	printf("       latencies.\n");
 	printf("\n");
 
 	printf("-K --start-key <start> # Default: 0\n");
@@ -505,6 +577,12 @@ print_usage(const char* program)
 	printf("         B12 - generates a bytearray of 12 random bytes\n");
 	printf("      S) Generate a string bin or value made of a-z{1,9} characers\n");
 	printf("         S16 - a string with a 16 character length. ex: \"uir9a2mskd4poiur\"\n");
+	printf("      B and S may take a length distribution instead of a fixed length:\n");
+	printf("         B100-200 - lengths uniformly distributed from 100 to 200\n");
+	printf("         B~n(1000,100) - normally distributed, mean 1000 and stddev 100\n");
+	printf("         B~ln(1000,0.5) - lognormal, median 1000 and shape (stddev of\n");
+	printf("            the log of the length) 0.5\n");
+	printf("         B~f(<path>) - drawn from a file of \"<length> <weight>\" lines\n");
 	printf("      D) Generate a Double bin or value (8 byte)\n");
 	printf("      <const>) A constant value of any of the above types (besides bytes):\n");
 	printf("         Const boolean: either T, true (case insensitive), F, or\n");
@@ -556,9 +634,11 @@ print_usage(const char* program)
 	printf("    Specifies the minimum amount of time the benchmark will run for.\n");
 	printf("\n");
 
-	printf("-w --workload I | RU,<read percent> | RR,<read percent> | RUF,<read percent>,<write percent> | RUD,<read percent>,<write percent> | DB  # Default: RU,50\n");
+	printf("-w --workload I | I,shuffle | RU,<read percent> | RR,<read percent> | RUF,<read percent>,<write percent> | RUD,<read percent>,<write percent> | DB  # Default: RU,50\n");
 	printf("   Desired workload.\n");
 	printf("   -w I         : Linear 'insert' workload, initializing each key in the key range.\n");
+	printf("   -w I,shuffle : Insert workload that initializes each key in the key range exactly once,\n");
+	printf("                  in a pseudo-random order rather than ascending.\n");
 	printf("   -w RU,80     : Random read/update workload with 80%% reads and 20%% writes.\n");
 	printf("   -w RR,80     : Random read/replace workload with 80%% reads and 20%% writes.\n");
 	printf("   -w RUF,20,40 : Random read/update/udf workload with 20%% reads, 40%% writes, and 60%% UDF calls.\n");
@@ -613,6 +693,14 @@ print_usage(const char* program)
 	printf("   --compression-ratio <ratio> # Default: 1\n");
 	printf("   Sets the desired compression ratio for binary data.\n");
 	printf("   Causes the benchmark tool to generate data which will roughly compress by this proportion.\n");
+	printf("   Bytes values are made of random runs interleaved with repeats of earlier runs, so LZ-based\n");
+	printf("   compressors (zlib, lz4, zstd) have to find and encode real matches to reach the ratio.\n");
+	printf("\n");
+
+	printf("   --packed-cdt # Default: off\n");
+	printf("   Generate random list and map bins directly in their msgpack wire format rather than\n");
+	printf("   building them out of as_val lists and maps, which is much cheaper for large or deeply\n");
+	printf("   nested bins. Maps are written key-ordered. Does not apply to UDF arguments.\n");
 	printf("\n");
 
 	printf("   --connection-timeout <ms> # Default: 1000\n");
@@ -654,13 +742,34 @@ print_usage(const char* program)
 	printf("\n");
 
 	printf("-d --debug           # Default: debug mode is false.\n");
-	printf("   Run benchmarks in debug mode.\n");
+	printf("   Run benchmarks in debug mode. Failed transactions are logged, at most %d\n",
+			ERROR_STATS_DEBUG_LOG_RATE);
+	printf("   per second unless --error-log-rate is given.\n");
+	printf("\n");
+
+	printf("   --error-log-rate <errors/s> # Default: 0, or %d with --debug\n",
+			ERROR_STATS_DEBUG_LOG_RATE);
+	printf("   Logs the details of failed transactions, at most this many per second\n");
+	printf("   across all threads. Errors past the limit are only counted, so this is\n");
+	printf("   safe to enable at full load. Every transaction's status is counted\n");
+	printf("   regardless, with the counts of each error code printed every second\n");
+	printf("   and at the end of the run along with the latencies of failed transactions.\n");
 	printf("\n");
 
 	printf("-L --latency\n");
 	printf("   Enables the periodic HDR histogram summary of latency data.\n");
 	printf("\n");
 
+	printf("   --latency-corrected  # Default: off\n");
+	printf("   Also prints the periodic HDR histogram summary with coordinated omission\n");
+	printf("   corrected for, below the raw one. In stages with a throughput limit,\n");
+	printf("   each transaction that took longer than its thread's expected interval\n");
+	printf("   between transactions is taken to have delayed the ones that should\n");
+	printf("   have been issued in the meantime, which are recorded with the latency\n");
+	printf("   they would have seen. Async commands are each expected once every\n");
+	printf("   async-max-commands intervals. Requires --latency.\n");
+	printf("\n");
+
 	printf("   --percentiles <p1>[,<p2>[,<p3>...]] # Default: \"50,90,99,99.9,99.99\".\n");
 	printf("   Specifies the latency percentiles to display in the periodic latency\n");
 	printf("   histogram.\n");
@@ -683,6 +792,127 @@ print_usage(const char* program)
 	printf("   dump the cumulative HDR histogram summary.\n");
 	printf("\n");
 
+	printf("   --processes <n>  # Default: 1\n");
+	printf("   Runs the benchmark in n worker processes on this machine, each with\n");
+	printf("   its own client and its own share of every stage's keys, tps and ops\n");
+	printf("   or bytes budget, for when a single process can't keep up. The workers\n");
+	printf("   publish their counters and latencies to shared memory, and this\n");
+	printf("   process prints the combined periodic output and a summary of all of\n");
+	printf("   them, and starts each stage once every worker is ready for it. The\n");
+	printf("   per-workload and per-status error breakdowns are not combined.\n");
+	printf("   Cannot be used with --hdr-hist, --output-file, --latency-corrected,\n");
+	printf("   --node-stats, --slow-ops, --trace, --self-stats, --perf-counters,\n");
+	printf("   --cpu-list or --numa-node.\n");
+	printf("\n");
+
+	printf("   --instance-count <n>  # Default: 1\n");
+	printf("   --instance-id <id>  # Default: 0\n");
+	printf("   Splits the run between n asbench instances, started with the same\n");
+	printf("   arguments and ids 0 to n - 1, possibly on different machines. Each\n");
+	printf("   instance takes its own share of every stage's keys, tps and ops or\n");
+	printf("   bytes budget. With --hdr-hist, each instance also logs its latencies\n");
+	printf("   and counts every second to intervals_<id>_<time>.hlog and .csv in\n");
+	printf("   the --hdr-hist directory, with intervals aligned to the wall clock,\n");
+	printf("   so the logs of all instances can be merged with --merge.\n");
+	printf("\n");
+
+	printf("   --merge <path>[,<path>...]\n");
+	printf("   Merges the interval logs of the instances of a run, given as .hlog\n");
+	printf("   files or directories holding them, then exits. Prints the combined\n");
+	printf("   throughput and --percentiles latencies of every second and of the\n");
+	printf("   whole run, and writes the merged logs to the --hdr-hist directory if\n");
+	printf("   one is given.\n");
+	printf("\n");
+
+	printf("   --node-stats[=<top-n>]  # Default: off, top-n defaults to %d\n",
+			NODE_STATS_DEFAULT_TOP_N);
+	printf("   Breaks down the throughput and latency of single-key transactions by\n");
+	printf("   the node holding the master copy of each key's partition. Per-node\n");
+	printf("   throughput and p99 latency are printed every second, with the top-n\n");
+	printf("   slowest nodes marked, and per-node percentiles are printed at the end\n");
+	printf("   of the run. Batch transactions are not included. Cannot be used with\n");
+	printf("   --shared.\n");
+	printf("\n");
+
+	printf("   --slow-ops <file>  # Default: off\n");
+	printf("   Captures the slowest transactions of every output period and appends\n");
+	printf("   them to the given CSV file, slowest first, along with their op type,\n");
+	printf("   key, batch size, master node, status and UTC start time, so outliers\n");
+	printf("   can be matched up with server logs. Each thread keeps its own slowest\n");
+	printf("   transactions, so faster ones cost no more than a comparison. Nodes are\n");
+	printf("   left empty for batches and with --shared.\n");
+	printf("\n");
+
+	printf("   --slow-ops-k <count>  # Default: %d\n", SLOW_OPS_DEFAULT_K);
+	printf("   The number of slowest transactions captured per output period.\n");
+	printf("\n");
+
+	printf("   --trace <prefix>  # Default: off\n");
+	printf("   Writes the start and end time, op type, key, batch size and status of\n");
+	printf("   sampled transactions to binary trace files. Every thread that finishes\n");
+	printf("   transactions writes its own memory-mapped file, named <prefix>.<n>, so\n");
+	printf("   tracing takes no locks or system calls apart from growing the file by\n");
+	printf("   %d MiB at a time. Use --trace-decode to read the files.\n",
+			TRACE_SEGMENT_SIZE / (1024 * 1024));
+	printf("\n");
+
+	printf("   --trace-sample <n>  # Default: 1\n");
+	printf("   Traces one in every n transactions of each thread, 1 traces them all.\n");
+	printf("\n");
+
+	printf("   --trace-decode <file>\n");
+	printf("   Writes the transactions in a trace file to stdout as CSV with times in\n");
+	printf("   microseconds since the epoch, then exits.\n");
+	printf("\n");
+
+	printf("   --self-stats  # Default: false\n");
+	printf("   Measures how asbench itself spends its time, to tell whether a run is\n");
+	printf("   bound by the client rather than the server. Every second, prints the\n");
+	printf("   share of the worker threads' time spent generating keys, records and\n");
+	printf("   batches, inside client calls, recording latencies and throttling, the\n");
+	printf("   largest generation share of any one thread, the CPU usage of the process\n");
+	printf("   and its voluntary and involuntary context switches, and warns when the\n");
+	printf("   client is saturated. Phases are timed with the CPU's cycle counter.\n");
+	printf("\n");
+
+	printf("   --perf-counters[=<n>]  # Default: off, n defaults to %d\n",
+			PERF_COUNTERS_DEFAULT_SAMPLE);
+	printf("   Reads the CPU's hardware performance counters (Linux perf_event_open)\n");
+	printf("   around one in every n transactions of each worker thread, from the\n");
+	printf("   start of building the transaction to the return of the client call, and\n");
+	printf("   prints the average user-space cycles, instructions, IPC, cache misses\n");
+	printf("   and branch misses per transaction of each op type every second. If the\n");
+	printf("   counters can't be opened (no PMU in a VM or container, or a restrictive\n");
+	printf("   kernel.perf_event_paranoid), a warning is logged and nothing is measured.\n");
+	printf("\n");
+
+	printf("   --digest-table[=<max-keys>]  # Default: off, max-keys defaults to %d\n",
+			DIGEST_TABLE_DEFAULT_MAX_KEYS);
+	printf("   Precomputes the digests of the keys used by the workload stages before\n");
+	printf("   the benchmark starts, so that transactions don't hash their keys. The\n");
+	printf("   table takes 20 bytes per key, and only covers the first max-keys keys of\n");
+	printf("   the key range, keys past that are hashed as usual.\n");
+	printf("\n");
+
+	printf("   --digest-table-file <path>  # Default: off\n");
+	printf("   Backs the digest table with the given file, implies --digest-table. If the\n");
+	printf("   file holds a table for the same namespace, set and keys it is reused,\n");
+	printf("   otherwise it is rebuilt for the next run.\n");
+	printf("\n");
+
+	printf("   --key-tracking  # Default: off\n");
+	printf("   Tracks which keys exist in a bitmap (1 bit per key), based on the writes,\n");
+	printf("   deletes and single-key reads made during the run. RUD workloads then\n");
+	printf("   read and delete keys that exist and write keys that don't, so reads don't\n");
+	printf("   drift towards misses and deletes don't become no-ops as the run goes on.\n");
+	printf("   All keys are assumed not to exist at the start of the run.\n");
+	printf("\n");
+
+	printf("   --read-miss-pct <pct>  # Default: 0\n");
+	printf("   With --key-tracking, the percent of RUD reads that deliberately target keys\n");
+	printf("   that don't exist.\n");
+	printf("\n");
+
 	printf("-S --shared          # Default: false\n");
 	printf("   Use shared memory cluster tending.\n");
 	printf("\n");
@@ -721,9 +951,8 @@ print_usage(const char* program)
 	printf("\n");
 
 	printf("   --min-conns-per-node <number>  # Default: 0\n");
-	printf("   Maximum number of synchronous connections allowed per server node. Synchronous transactions\n");
-	printf("   will go through retry logic and potentially fail with error code \"AEROSPIKE_ERR_NO_MORE_CONNECTIONS\"\n");
-	printf("   if the maximum number of connections would be exceeded.\n");
+	printf("   Minimum number of synchronous connections allowed per server node. The benchmark waits\n");
+	printf("   for them to be opened before it starts.\n");
 	printf("\n");
 	printf("   The number of connections used per node depends on how many concurrent threads issue database commands\n");
 	printf("   plus sub-threads used for parallel multi-node commands (batch, scan, and query).\n");
@@ -748,6 +977,7 @@ print_usage(const char* program)
 	printf("   Minimum number of asynchronous connections allowed per server node.\n");
 	printf("   Preallocate min connections on client node creation. The client will\n");
 	printf("   periodically allocate new connections if count falls below min connections.\n");
+	printf("   The benchmark waits for them to be opened before it starts.\n");
 	printf("\n");
 	printf("   Server proto-fd-idle-ms and client max_socket_idle should be set to zero (no reap)\n");
 	printf("   if async_min_conns_per_node is greater than zero. Reaping connections can defeat the\n");
@@ -777,10 +1007,41 @@ print_usage(const char* program)
 	printf("   in time.\n");
 	printf("\n");
 
+	printf("   --async-adaptive # Default: false\n");
+	printf("   Adjust the number of concurrent asynchronous commands at runtime instead of\n");
+	printf("   always keeping async-max-commands in flight. The limit is grown while commands\n");
+	printf("   are waiting on it and backed off when timeouts/connection errors exceed 1%% of\n");
+	printf("   commands or average latency exceeds twice the lowest seen. async-max-commands\n");
+	printf("   becomes the upper bound, and the current limit is reported every second.\n");
+	printf("\n");
+
+	printf("   --async-self-sustaining # Default: false\n");
+	printf("   In random async workloads, issue the next command straight from the completion\n");
+	printf("   callback of the last one, on its event loop thread, instead of handing every\n");
+	printf("   completed command back to the transaction thread. The transaction thread only\n");
+	printf("   starts the commands and picks up any that can't be reissued right away. With\n");
+	printf("   --throughput, the event loops share the rate through permits. Linear workloads\n");
+	printf("   (insert/delete) are unaffected. Can't be combined with --async-adaptive.\n");
+	printf("   --self-stats and --perf-counters leave out the commands the event loops issue.\n");
+	printf("\n");
+
 	printf("-W --event-loops <thread count> # Default: 1\n");
 	printf("   Number of event loops (or selector threads) when running in asynchronous mode.\n");
 	printf("\n");
 
+	printf("   --cpu-list <cpus>  # Default: threads aren't pinned\n");
+	printf("   Pin asbench's threads to the given CPUs, e.g. 0-15,32-47. Transaction\n");
+	printf("   threads, then event loops, then the output thread are each pinned to the\n");
+	printf("   next CPU in the list, wrapping around if there are more threads than CPUs,\n");
+	printf("   and the client's own threads are confined to the list. Per-thread state is\n");
+	printf("   allocated on the NUMA node of the thread's CPU.\n");
+	printf("\n");
+
+	printf("   --numa-node <node>  # Default: memory is allocated where it's first used\n");
+	printf("   Bind all of asbench's memory to the given NUMA node and, without\n");
+	printf("   --cpu-list, pin threads to the node's CPUs.\n");
+	printf("\n");
+
 	printf("   --tls-enable         # Default: TLS disabled\n");
 	printf("   Enable TLS.\n");
 	printf("\n");
@@ -875,6 +1136,7 @@ print_args(args_t* args)
 
 	printf("enable compression:     %s\n", boolstring(args->enable_compression));
 	printf("compression ratio:      %f\n", args->compression_ratio);
+	printf("packed cdt:             %s\n", boolstring(args->packed_cdt));
 	printf("connect timeout:        %d ms\n", args->conn_timeout_ms);
 	printf("read socket timeout:    %d ms\n", args->read_socket_timeout);
 	printf("write socket timeout:   %d ms\n", args->write_socket_timeout);
@@ -883,6 +1145,9 @@ print_args(args_t* args)
 	printf("max retries:            %d\n", args->max_retries);
 	printf("sleep between retries:  %d ms\n", args->sleep_between_retries);
 	printf("debug:                  %s\n", boolstring(args->debug));
+	printf("error log rate:         %d/s\n", args->error_log_rate != 0 ?
+			args->error_log_rate :
+			(args->debug ? ERROR_STATS_DEBUG_LOG_RATE : 0));
 
 	if (args->latency) {
 		printf("hdr histogram format:   UTC-time, seconds-running, total, "
@@ -899,11 +1164,64 @@ print_args(args_t* args)
 		}
 		printf("\n");
 		printf("latency period:         %ds\n", args->histogram_period);
+		printf("latency corrected:      %s\n",
+				boolstring(args->latency_corrected));
 	}
 	else {
 		printf("latency:                false\n");
 	}
 
+	if (args->node_stats) {
+		printf("node stats:             true (top %d)\n", args->node_stats_top_n);
+	}
+	else {
+		printf("node stats:             false\n");
+	}
+
+	if (args->slow_ops_file != NULL) {
+		printf("slow ops:               %s (top %d)\n", args->slow_ops_file,
+				args->slow_ops_k);
+	}
+	else {
+		printf("slow ops:               false\n");
+	}
+
+	if (args->trace_prefix != NULL) {
+		printf("trace:                  %s (1 in %d)\n", args->trace_prefix,
+				args->trace_sample);
+	}
+	else {
+		printf("trace:                  false\n");
+	}
+
+	printf("self stats:             %s\n", boolstring(args->self_stats));
+
+	if (args->perf_counters) {
+		printf("perf counters:          true (1 in %d)\n",
+				args->perf_counters_sample);
+	}
+	else {
+		printf("perf counters:          false\n");
+	}
+
+	if (args->digest_table) {
+		printf("digest table:           true (max %" PRIu64 " keys)\n",
+				args->digest_table_max_keys);
+		printf("digest table file:      %s\n",
+				(args->digest_table_file ? args->digest_table_file : "none"));
+	}
+	else {
+		printf("digest table:           false\n");
+	}
+
+	if (args->key_tracking) {
+		printf("key tracking:           true (read miss %g%%)\n",
+				args->read_miss_pct);
+	}
+	else {
+		printf("key tracking:           false\n");
+	}
+
 	if (args->latency_histogram) {
 		printf("latency histogram:      true\n");
 		printf("histogram output file:  %s\n",
@@ -922,6 +1240,15 @@ print_args(args_t* args)
 		printf("cumulative HDR hist:    false\n");
 	}
 
+	if (args->instance_count > 1) {
+		printf("instance:               %d of %d\n", args->instance_id,
+				args->instance_count);
+	}
+
+	if (args->processes > 1) {
+		printf("worker processes:       %d\n", args->processes);
+	}
+
 	printf("shared memory:          %s\n", boolstring(args->use_shm));
 
 	printf("send-key:               %s\n", boolstring(args->key == AS_POLICY_KEY_SEND));
@@ -981,7 +1308,14 @@ print_args(args_t* args)
 	printf("async min conns per node: %d\n", args->async_min_conns_per_node);
 	printf("async max conns per node: %d\n", args->async_max_conns_per_node);
 	printf("async max commands:       %d\n", args->async_max_commands);
+	printf("async adaptive:           %s\n", boolstring(args->async_adaptive));
+	printf("async self sustaining:    %s\n",
+			boolstring(args->async_self_sustaining));
 	printf("event loops:              %d\n", args->event_loop_capacity);
+	cpu_affinity_print_placement(&args->affinity,
+			(uint32_t) args->transaction_worker_threads,
+			stages_contain_async(&args->stages) ?
+				(uint32_t) args->event_loop_capacity : 0);
 
 	if (args->tls.enable) {
 		printf("TLS:                    enabled\n");
@@ -1099,6 +1433,113 @@ validate_args(args_t* args)
 		return 1;
 	}
 
+	if (args->node_stats) {
+		if (args->node_stats_top_n < 0) {
+			printf("Invalid node stats top-n: %d  Valid values: [>= 0]\n",
+					args->node_stats_top_n);
+			return 1;
+		}
+		if (args->use_shm) {
+			printf("Node stats cannot be used with shared memory cluster "
+					"tending\n");
+			return 1;
+		}
+	}
+
+	if (args->error_log_rate < 0) {
+		printf("Invalid error log rate: %d  Valid values: [>= 0]\n",
+				args->error_log_rate);
+		return 1;
+	}
+
+	if (args->slow_ops_k < 1) {
+		printf("Invalid slow ops k: %d  Valid values: [>= 1]\n",
+				args->slow_ops_k);
+		return 1;
+	}
+
+	if (args->trace_sample < 1) {
+		printf("Invalid trace sample: %d  Valid values: [>= 1]\n",
+				args->trace_sample);
+		return 1;
+	}
+
+	if (args->perf_counters_sample < 1) {
+		printf("Invalid perf counters sample: %d  Valid values: [>= 1]\n",
+				args->perf_counters_sample);
+		return 1;
+	}
+
+	if (args->instance_count < 1) {
+		printf("Invalid instance count: %d  Valid values: [>= 1]\n",
+				args->instance_count);
+		return 1;
+	}
+
+	if (args->instance_id < 0 || args->instance_id >= args->instance_count) {
+		printf("Invalid instance id: %d  Valid values: [0-%d]\n",
+				args->instance_id, args->instance_count - 1);
+		return 1;
+	}
+
+	if (args->processes < 1) {
+		printf("Invalid processes: %d  Valid values: [>= 1]\n",
+				args->processes);
+		return 1;
+	}
+
+	if (args->processes > 1) {
+		// per-process outputs, which the parent doesn't combine
+		const char* opt = NULL;
+
+		if (args->hdr_output) {
+			opt = "--hdr-hist";
+		}
+		else if (args->latency_histogram) {
+			opt = "--output-file";
+		}
+		else if (args->latency_corrected) {
+			opt = "--latency-corrected";
+		}
+		else if (args->node_stats) {
+			opt = "--node-stats";
+		}
+		else if (args->slow_ops_file != NULL) {
+			opt = "--slow-ops";
+		}
+		else if (args->trace_prefix != NULL) {
+			opt = "--trace";
+		}
+		else if (args->self_stats) {
+			opt = "--self-stats";
+		}
+		else if (args->perf_counters) {
+			opt = "--perf-counters";
+		}
+		else if (args->cpu_list != NULL) {
+			opt = "--cpu-list";
+		}
+		else if (args->numa_node >= 0) {
+			opt = "--numa-node";
+		}
+
+		if (opt != NULL) {
+			printf("%s cannot be used with --processes\n", opt);
+			return 1;
+		}
+	}
+
+	if (args->read_miss_pct < 0 || args->read_miss_pct > 100) {
+		printf("Invalid read miss percent: %g  Valid values: [0, 100]\n",
+				args->read_miss_pct);
+		return 1;
+	}
+
+	if (args->digest_table && args->digest_table_max_keys == 0) {
+		printf("Invalid digest table max-keys: 0  Valid values: [> 0]\n");
+		return 1;
+	}
+
 	if (args->latency) {
 		as_vector * perc = &args->latency_percentiles;
 		if (perc->size == 0) {
@@ -1130,6 +1571,11 @@ validate_args(args_t* args)
 		return 1;
 	}
 
+	if (args->latency_corrected && !args->latency) {
+		printf("--latency-corrected requires --latency\n");
+		return 1;
+	}
+
 	if (args->min_conns_per_node < 0) {
 		printf("Invalid min conns per node: %d  Valid values: [>= 0]\n",
 				args->min_conns_per_node);
@@ -1181,11 +1627,40 @@ validate_args(args_t* args)
 		return 1;
 	}
 
+	if (args->async_self_sustaining && args->async_adaptive) {
+		printf("Invalid async-self-sustaining: can't be combined with "
+				"async-adaptive, whose limiter expects a single issuing "
+				"thread\n");
+		return 1;
+	}
+
 	if (args->event_loop_capacity <= 0 || args->event_loop_capacity > 1000) {
 		printf("Invalid event-loops: %d  Valid values: [1-1000]\n",
 				args->event_loop_capacity);
 		return 1;
 	}
+
+	if (args->cpu_list != NULL &&
+			cpu_affinity_set_cpu_list(&args->affinity, args->cpu_list) != 0) {
+		printf("Invalid cpu list: %s  Valid values: CPUs and ranges of CPUs "
+				"below %d, separated by commas\n", args->cpu_list,
+				CPU_AFFINITY_MAX_CPUS);
+		return 1;
+	}
+
+	if (args->numa_node != -1 &&
+			cpu_affinity_set_numa_node(&args->affinity, args->numa_node) != 0) {
+		printf("Invalid numa node: %d  Valid values: the nodes in "
+				"/sys/devices/system/node\n", args->numa_node);
+		return 1;
+	}
+
+	int cpu = cpu_affinity_unavailable_cpu(&args->affinity);
+	if (cpu >= 0) {
+		printf("Invalid cpu list: CPU %d is offline or not available to "
+				"asbench\n", cpu);
+		return 1;
+	}
 	return 0;
 }
 
@@ -1539,6 +2014,10 @@ set_args(int argc, char * const* argv, args_t* args)
 				args->compression_ratio = (float) atof(optarg);
 				break;
 
+			case BENCH_OPT_PACKED_CDT:
+				args->packed_cdt = true;
+				break;
+
 			case BENCH_OPT_SOCKET_TIMEOUT:
 				args->read_socket_timeout = atoi(optarg);
 				args->write_socket_timeout = args->read_socket_timeout;
@@ -1580,6 +2059,10 @@ set_args(int argc, char * const* argv, args_t* args)
 				args->latency = true;
 				break;
 
+			case BENCH_OPT_LATENCY_CORRECTED:
+				args->latency_corrected = true;
+				break;
+
 			case BENCH_OPT_PERCENTILES:
 				; // parse percentiles as a comma-separated list
 				as_vector * perc = &args->latency_percentiles;
@@ -1624,6 +2107,83 @@ set_args(int argc, char * const* argv, args_t* args)
 				args->hdr_output = strdup(optarg);
 				break;
 
+			case BENCH_OPT_NODE_STATS:
+				args->node_stats = true;
+				if (optarg != NULL) {
+					args->node_stats_top_n = atoi(optarg);
+				}
+				break;
+
+			case BENCH_OPT_DIGEST_TABLE:
+				args->digest_table = true;
+				if (optarg != NULL) {
+					args->digest_table_max_keys = strtoull(optarg, NULL, 10);
+				}
+				break;
+
+			case BENCH_OPT_DIGEST_TABLE_FILE:
+				args->digest_table = true;
+				args->digest_table_file = strdup(optarg);
+				break;
+
+			case BENCH_OPT_KEY_TRACKING:
+				args->key_tracking = true;
+				break;
+
+			case BENCH_OPT_READ_MISS_PCT:
+				args->read_miss_pct = (float) atof(optarg);
+				break;
+
+			case BENCH_OPT_ERROR_LOG_RATE:
+				args->error_log_rate = atoi(optarg);
+				break;
+
+			case BENCH_OPT_SLOW_OPS:
+				args->slow_ops_file = strdup(optarg);
+				break;
+
+			case BENCH_OPT_SLOW_OPS_K:
+				args->slow_ops_k = atoi(optarg);
+				break;
+
+			case BENCH_OPT_TRACE:
+				args->trace_prefix = strdup(optarg);
+				break;
+
+			case BENCH_OPT_TRACE_SAMPLE:
+				args->trace_sample = atoi(optarg);
+				break;
+
+			case BENCH_OPT_TRACE_DECODE:
+				return trace_decode(optarg, stdout) == 0 ? -1 : 1;
+
+			case BENCH_OPT_INSTANCE_ID:
+				args->instance_id = atoi(optarg);
+				break;
+
+			case BENCH_OPT_INSTANCE_COUNT:
+				args->instance_count = atoi(optarg);
+				break;
+
+			case BENCH_OPT_MERGE:
+				args->merge_paths = strdup(optarg);
+				break;
+
+			case BENCH_OPT_PROCESSES:
+				args->processes = atoi(optarg);
+				break;
+
+			case BENCH_OPT_SELF_STATS:
+				args->self_stats = true;
+				break;
+
+			case BENCH_OPT_PERF_COUNTERS:
+				args->perf_counters = true;
+				if (optarg != NULL) {
+					args->perf_counters_sample = atoi(optarg);
+				}
+				break;
+
 			case 'S':
 				args->use_shm = true;
 				break;
@@ -1736,10 +2296,26 @@ set_args(int argc, char * const* argv, args_t* args)
 				args->async_max_commands = atoi(optarg);
 				break;
 
+			case BENCH_OPT_ASYNC_ADAPTIVE:
+				args->async_adaptive = true;
+				break;
+
+			case BENCH_OPT_ASYNC_SELF_SUSTAINING:
+				args->async_self_sustaining = true;
+				break;
+
 			case 'W':
 				args->event_loop_capacity = atoi(optarg);
 				break;
 
+			case BENCH_OPT_CPU_LIST:
+				args->cpu_list = strdup(optarg);
+				break;
+
+			case BENCH_OPT_NUMA_NODE:
+				args->numa_node = atoi(optarg);
+				break;
+
 			case BENCH_OPT_SEND_KEY:
 				args->key = AS_POLICY_KEY_SEND;
 				break;
@@ -1873,6 +2449,7 @@ _load_defaults(args_t* args)
 	args->transaction_worker_threads = 16;
 	args->enable_compression = false;
 	args->compression_ratio = 1.f;
+	args->packed_cdt = false;
 	args->conn_timeout_ms = 1000;
 	args->read_socket_timeout = AS_POLICY_SOCKET_TIMEOUT_DEFAULT;
 	args->write_socket_timeout = AS_POLICY_SOCKET_TIMEOUT_DEFAULT;
@@ -1882,11 +2459,33 @@ _load_defaults(args_t* args)
 	args->sleep_between_retries = 0;
 	args->debug = false;
 	args->latency = false;
+	args->latency_corrected = false;
 	as_vector_init(&args->latency_percentiles, sizeof(double), 5);
 	args->latency_histogram = false;
 	args->histogram_output = NULL;
 	args->histogram_period = 1;
 	args->hdr_output = NULL;
+	args->instance_id = 0;
+	args->instance_count = 1;
+	args->merge_paths = NULL;
+	args->processes = 1;
+	args->proc_stats = NULL;
+	args->proc_idx = 0;
+	args->node_stats = false;
+	args->node_stats_top_n = NODE_STATS_DEFAULT_TOP_N;
+	args->error_log_rate = 0;
+	args->slow_ops_file = NULL;
+	args->slow_ops_k = SLOW_OPS_DEFAULT_K;
+	args->trace_prefix = NULL;
+	args->trace_sample = 1;
+	args->self_stats = false;
+	args->perf_counters = false;
+	args->perf_counters_sample = PERF_COUNTERS_DEFAULT_SAMPLE;
+	args->digest_table = false;
+	args->digest_table_max_keys = DIGEST_TABLE_DEFAULT_MAX_KEYS;
+	args->digest_table_file = NULL;
+	args->key_tracking = false;
+	args->read_miss_pct = 0;
 	args->use_shm = false;
 	args->key = AS_POLICY_KEY_DIGEST;
 	args->replica = AS_POLICY_REPLICA_SEQUENCE;
@@ -1901,7 +2500,12 @@ _load_defaults(args_t* args)
 	args->async_min_conns_per_node = 0;
 	args->async_max_conns_per_node = 300;
 	args->async_max_commands = 50;
+	args->async_adaptive = false;
+	args->async_self_sustaining = false;
 	args->event_loop_capacity = 1;
+	args->cpu_list = NULL;
+	args->numa_node = -1;
+	cpu_affinity_init(&args->affinity);
 	memset(&args->tls, 0, sizeof(as_config_tls));
 	args->tls_name = NULL;
 	args->auth_mode = AS_AUTH_INTERNAL;
@@ -1926,6 +2530,13 @@ _load_defaults_post(args_t* args)
 	if (args->workload_stages_file != NULL) {
 		res = parse_workload_config_file(args->workload_stages_file,
 				&args->stages, args);
+
+		if (res == 0) {
+			// as many threads as the stage that needs the most, which may
+			// be more or fewer than were asked for
+			args->transaction_worker_threads =
+				(int) stages_n_threads(&args->stages);
+		}
 	}
 	else {
 		struct stage_def_s* stage = get_or_init_stage(args);
@@ -1943,6 +2554,11 @@ _load_defaults_post(args_t* args)
 		free_stage_defs(&args->stage_defs);
 	}
 
+	if (res == 0 && args->instance_count > 1) {
+		res = instance_shard_stages(&args->stages, (uint32_t) args->instance_id,
+				(uint32_t) args->instance_count);
+	}
+
 	return res;
 }
 
@@ -1955,7 +2571,13 @@ _free_args(args_t* args)
 		free_workload_config(&args->stages);
 	}
 	cf_free(args->hdr_output);
+	cf_free(args->merge_paths);
 	cf_free(args->histogram_output);
+	cf_free(args->digest_table_file);
+	cf_free(args->slow_ops_file);
+	cf_free(args->trace_prefix);
+	cf_free(args->cpu_list);
+	cpu_affinity_free(&args->affinity);
 	cf_free(args->bin_name);
 	as_vector_destroy(&args->latency_percentiles);
 	cf_free(args->tls_name);
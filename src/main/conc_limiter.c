@@ -0,0 +1,188 @@
+
+//==========================================================
+// Includes
+//
+
+#include <math.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include <common.h>
+#include <conc_limiter.h>
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER void _limiter_park(conc_limiter_t* cl);
+LOCAL_HELPER void _limiter_wake(conc_limiter_t* cl);
+
+
+//==========================================================
+// Public API
+//
+
+void
+conc_limiter_init(conc_limiter_t* cl, uint32_t min_limit, uint32_t max_limit,
+		uint64_t now)
+{
+	min_limit = MAX(min_limit, 1);
+	max_limit = MAX(max_limit, min_limit);
+
+	cl->min_limit = min_limit;
+	cl->max_limit = max_limit;
+	cl->window_start = now;
+	cl->min_latency = 0;
+
+	// the output thread may be reading these from a previous stage, so store
+	// rather than atomic_init
+	cl->limit = MAX(MIN(CONC_LIMITER_INIT_LIMIT, max_limit), min_limit);
+	cl->in_flight = 0;
+	cl->n_completed = 0;
+	cl->n_failed = 0;
+	cl->latency_sum = 0;
+	cl->saturated = false;
+
+	atomic_init(&cl->waiting, 0);
+	pthread_cond_init(&cl->wait_cond, NULL);
+	pthread_mutex_init(&cl->wait_lock, NULL);
+}
+
+bool
+conc_limiter_try_acquire(conc_limiter_t* cl)
+{
+	// in_flight is only ever incremented by the issuing thread, so it can't
+	// grow between the check and the increment
+	if (cl->in_flight >= cl->limit) {
+		cl->saturated = true;
+		return false;
+	}
+	cl->in_flight++;
+	return true;
+}
+
+bool
+conc_limiter_wait(conc_limiter_t* cl)
+{
+	for (uint32_t i = 0; i < CONC_LIMITER_SPIN; i++) {
+		if (cl->in_flight < cl->limit) {
+			return false;
+		}
+		spin_pause();
+	}
+
+	for (;;) {
+		cl->waiting = 1;
+		// look once more, now that a release is sure to wake us
+		if (cl->in_flight < cl->limit) {
+			cl->waiting = 0;
+			return true;
+		}
+		_limiter_park(cl);
+	}
+}
+
+void
+conc_limiter_release(conc_limiter_t* cl, uint64_t latency, bool failed)
+{
+	if (failed) {
+		cl->n_failed++;
+	}
+	else {
+		cl->n_completed++;
+		cl->latency_sum += latency;
+	}
+	cl->in_flight--;
+
+	// the issuing thread sets waiting before its last look at in_flight, so
+	// either it sees this release or this sees it waiting
+	if (cl->waiting != 0 && atomic_exchange(&cl->waiting, 0) != 0) {
+		_limiter_wake(cl);
+	}
+}
+
+void
+conc_limiter_update(conc_limiter_t* cl, uint64_t now)
+{
+	if (now - cl->window_start < CONC_LIMITER_WINDOW_US) {
+		return;
+	}
+
+	uint64_t n_completed = cl->n_completed;
+	uint64_t n_failed = cl->n_failed;
+
+	// keep accumulating into this window until there are enough samples to
+	// say anything about it
+	if (n_completed + n_failed < CONC_LIMITER_MIN_SAMPLES) {
+		return;
+	}
+
+	n_completed = atomic_exchange(&cl->n_completed, 0);
+	n_failed = atomic_exchange(&cl->n_failed, 0);
+	uint64_t latency_sum = atomic_exchange(&cl->latency_sum, 0);
+	bool saturated = atomic_exchange(&cl->saturated, false);
+	cl->window_start = now;
+
+	uint32_t limit = cl->limit;
+	float err_rate = ((float) n_failed) / (n_completed + n_failed);
+	float avg_latency = n_completed == 0 ? 0 :
+		((float) latency_sum) / n_completed;
+
+	if (err_rate > CONC_LIMITER_ERR_TOLERANCE ||
+			(cl->min_latency != 0 &&
+			 avg_latency > CONC_LIMITER_LATENCY_TOLERANCE * cl->min_latency)) {
+		// multiplicative decrease
+		limit = (uint32_t) (limit * CONC_LIMITER_BACKOFF);
+	}
+	else if (saturated) {
+		// additive increase, though by sqrt(limit) rather than by 1 so that
+		// climbing to thousands of commands doesn't take minutes
+		limit += (uint32_t) ceilf(sqrtf((float) limit));
+	}
+	limit = MAX(MIN(limit, cl->max_limit), cl->min_limit);
+	cl->limit = limit;
+
+	if (n_failed == 0 && n_completed != 0 &&
+			(cl->min_latency == 0 || avg_latency < cl->min_latency)) {
+		cl->min_latency = avg_latency;
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * sleeps until a release clears cl->waiting, or spuriously
+ */
+LOCAL_HELPER void
+_limiter_park(conc_limiter_t* cl)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &cl->waiting, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&cl->wait_lock);
+	while (cl->waiting != 0) {
+		pthread_cond_wait(&cl->wait_cond, &cl->wait_lock);
+	}
+	pthread_mutex_unlock(&cl->wait_lock);
+#endif /* __linux__ */
+}
+
+LOCAL_HELPER void
+_limiter_wake(conc_limiter_t* cl)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &cl->waiting, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&cl->wait_lock);
+	pthread_cond_signal(&cl->wait_cond);
+	pthread_mutex_unlock(&cl->wait_lock);
+#endif /* __linux__ */
+}
@@ -17,14 +17,13 @@
 
 LOCAL_HELPER int _has_not_happened(const struct timespec* time);
 LOCAL_HELPER int _sleep_for(uint64_t n_secs);
-LOCAL_HELPER void _halt_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
-LOCAL_HELPER void _terminate_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
-LOCAL_HELPER void _release_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
+LOCAL_HELPER void _halt_threads(tdata_t** tdatas, uint32_t n_threads);
+LOCAL_HELPER void _next_stage(thr_coord_t* coord, uint32_t stage_idx);
 LOCAL_HELPER void _finish_req_duration(thr_coord_t* coord);
-LOCAL_HELPER void clear_cdata_counts(cdata_t* cdata);
+LOCAL_HELPER void _warm_up(thr_coord_t* coord, cdata_t* cdata,
+		const stage_t* stage, bool has_budget);
+LOCAL_HELPER void _wait_for_threads(thr_coord_t* coord, uint64_t n_secs);
+LOCAL_HELPER void _warn_key_division(const stage_t* stage);
 
 
 //==========================================================
@@ -53,11 +52,11 @@ thr_coordinator_init(thr_coord_t* coord, uint32_t n_threads)
 
 	pthread_mutex_init(&coord->c_lock, NULL);
 
-	// the one extra thread is this thread
-	pthread_barrier_init(&coord->barrier, NULL, n_threads + 1);
 	coord->n_threads = n_threads;
 	// unfinished threads includes this thread
 	atomic_init(&coord->unfinished_threads, n_threads + 1);
+	atomic_init(&coord->stage_idx, 0);
+	atomic_init(&coord->epoch, 0);
 
 	return 0;
 }
@@ -65,19 +64,27 @@ thr_coordinator_init(thr_coord_t* coord, uint32_t n_threads)
 void
 thr_coordinator_free(thr_coord_t* coord)
 {
-	pthread_barrier_destroy(&coord->barrier);
 	pthread_mutex_destroy(&coord->c_lock);
 	pthread_cond_destroy(&coord->complete);
 }
 
 void
-thr_coordinator_wait(thr_coord_t* coord)
+thr_coordinator_wait(thr_coord_t* coord, tdata_t* tdata)
 {
-	// wait at the barrier twice: once to sync every thread up, and again to
-	// wait for the coordinator to execute initialization code before resuming
-	// everything
-	pthread_barrier_wait(&coord->barrier);
-	pthread_barrier_wait(&coord->barrier);
+	pthread_mutex_lock(&coord->c_lock);
+	while (coord->epoch == tdata->epoch) {
+		pthread_cond_wait(&coord->complete, &coord->c_lock);
+	}
+	pthread_mutex_unlock(&coord->c_lock);
+
+	// the coordinator sets finished and stage_idx before moving the epoch on,
+	// so both are up to date by now
+	tdata->epoch = coord->epoch;
+	if (!tdata->finished) {
+		tdata->stage_idx = stages_assign_thread(&tdata->cdata->stages,
+				coord->stage_idx, tdata->t_idx);
+		tdata->do_work = true;
+	}
 }
 
 void
@@ -88,31 +95,47 @@ thr_coordinator_complete(thr_coord_t* coord)
 
 	uint32_t rem_threads = atomic_fetch_sub(&coord->unfinished_threads, 1) - 1;
 
-	if (rem_threads == 0) {
+	// with only the coordinator left, a warmup waiting on the threads is over
+	if (rem_threads <= 1) {
 		pthread_cond_broadcast(&coord->complete);
 	}
 	pthread_mutex_unlock(&coord->c_lock);
 }
 
 int
-thr_coordinator_sleep(thr_coord_t* coord,
+thr_coordinator_sleep(thr_coord_t* coord, uint32_t epoch,
 		const struct timespec* wakeup_time)
 {
-	uint32_t rem_threads;
+	bool interrupted;
 	pthread_mutex_lock(&coord->c_lock);
 
 	// since condition variable waits may spuriously return, we have to check
 	// that the time hasn't expired each time. we also want to check that there
-	// are still unfinished threads left, since if this value is 0, we don't
-	// want to continue waiting any longer
-	while ((rem_threads = coord->unfinished_threads) != 0 &&
+	// are still unfinished threads left and that the stage hasn't already
+	// ended, since in either case we don't want to continue waiting any longer
+	while (!(interrupted = coord->unfinished_threads == 0 ||
+				coord->epoch != epoch) &&
 			_has_not_happened(wakeup_time)) {
 		pthread_cond_timedwait(&coord->complete, &coord->c_lock,
 				wakeup_time);
 	}
 	pthread_mutex_unlock(&coord->c_lock);
 
-	return rem_threads == 0 ? COORD_SLEEP_INTERRUPTED : COORD_SLEEP_TIMEOUT;
+	return interrupted ? COORD_SLEEP_INTERRUPTED : COORD_SLEEP_TIMEOUT;
+}
+
+void
+thr_coordinator_terminate(thr_coord_t* coord, tdata_t** tdatas,
+		uint32_t n_threads)
+{
+	// finished must be set before do_work, since threads check finished after
+	// do_work goes false
+	for (uint32_t i = 0; i < n_threads; i++) {
+		tdatas[i]->finished = true;
+		tdatas[i]->do_work = false;
+	}
+	// wakes the threads waiting for the next stage, which see they're finished
+	_next_stage(coord, coord->stage_idx);
 }
 
 void*
@@ -124,7 +147,6 @@ coordinator_worker(void* udata)
 	cdata_t* cdata = args->cdata;
 	tdata_t** tdatas = args->tdatas;
 	uint32_t n_threads = args->n_threads;
-	uint32_t worker_threads = args->cdata->transaction_worker_threads;
 	as_random random;
 
 	uint32_t n_stages = cdata->stages.n_stages;
@@ -133,83 +155,64 @@ coordinator_worker(void* udata)
 	as_random_init(&random);
 
 	for (;;) {
+		// every workload of a group runs at once, each on its own threads
+		uint32_t group_end = stages_group_end(&cdata->stages, stage_idx);
 		stage_t* stage = &cdata->stages.stages[stage_idx];
-		fprint_stage(stdout, &cdata->stages, stage_idx);
-
-		if (stage->workload.type == WORKLOAD_TYPE_I) {
-			uint64_t nkeys = stage->key_end - stage->key_start;
+		// the parent of a worker process prints the stages for all of them
+		if (cdata->proc_stats == NULL) {
+			fprint_stage(stdout, &cdata->stages, stage_idx);
+		}
 
-			if (stage->async) {
-				if (nkeys % stage->batch_write_size != 0) {
-					blog_warn("--keys is not divisible by --batch-write-size so more than "
-								"--keys records will be written\n");
-				}
-			}
-			else { // TODO when async is multithreaded change this
-				if (stage->batch_write_size * worker_threads > nkeys) {
-					blog_warn("--batch-write-size * --threads is greater than --keys so "
-								"more than --keys records will be written\n");
-				}
-
-				if (nkeys % (stage->batch_write_size * worker_threads) != 0) {
-					blog_warn("--keys is not divisible by (--batch-write-size * --threads) so more than "
-								"--keys records will be written\n");
-				}
-			}
+		for (uint32_t i = stage_idx; i < group_end; i++) {
+			_warn_key_division(&cdata->stages.stages[i]);
 		}
 
-		if (stage->workload.type == WORKLOAD_TYPE_D) {
-			uint64_t nkeys = stage->key_end - stage->key_start;
+		bool has_budget = stages_group_has_budget(&cdata->stages, stage_idx);
 
-			if (stage->async) {
-				if (nkeys % stage->batch_delete_size != 0) {
-					blog_warn("--keys is not divisible by --batch-delete-size so more than "
-								"--keys records will be deleted\n");
-				}
-			}
-			else { // TODO when async is multithreaded change this
-				if (stage->batch_delete_size * worker_threads > nkeys) {
-					blog_warn("--batch-delete-size * --threads is greater than --keys so more than "
-								"--keys records will be deleted\n");
-				}
-
-				if (nkeys % (stage->batch_delete_size * worker_threads) != 0) {
-					blog_warn("--keys is not divisible by (--batch-delete-size * --threads) so more than "
-								"--keys records will be deleted\n");
-				}
-			}
+		if (stage->warmup > 0) {
+			_warm_up(coord, cdata, stage, has_budget);
 		}
 
-		if (stage->duration > 0) {
+		if (has_budget && stage->duration > 0) {
+			// the workloads with a budget end the stage as soon as they've
+			// spent it, with the duration as a limit
+			_wait_for_threads(coord, stage->duration);
+			_halt_threads(tdatas, n_threads);
+		}
+		else if (stage->duration > 0) {
 			// first sleep the minimum duration of the stage
 			_sleep_for(stage->duration);
 		}
 		_finish_req_duration(coord);
 
 		// at this point, all threads have completed their required tasks, so
-		// halt threads, increment stage indices, then continue
-		_halt_threads(coord, tdatas, n_threads);
-		stage_idx++;
-
-		clear_cdata_counts(cdata);
+		// stop them and move on to the next stage. the threads don't have to
+		// check in first: each picks up the next stage as soon as it's done
+		// with this one
+		stage_idx = group_end;
 
 		if (stage_idx == n_stages) {
 			// all done, terminate threads and exit
-			_terminate_threads(coord, tdatas, n_threads);
+			thr_coordinator_terminate(coord, tdatas, n_threads);
 			break;
 		}
 		else {
-			// advance to the next stage
-			for (uint32_t t_idx = 0; t_idx < n_threads; t_idx++) {
-				tdatas[t_idx]->stage_idx = stage_idx;
-			}
+			_halt_threads(tdatas, n_threads);
 
+			// the threads stay stopped for the pause, since a thread can't
+			// pick up the next stage before the epoch changes
 			stage_random_pause(&random, &cdata->stages.stages[stage_idx]);
 
+			// a worker process starts the stage along with the others
+			if (cdata->proc_stats != NULL) {
+				proc_stats_wait_stage(cdata->proc_stats, cdata->proc_idx,
+						stage_idx);
+			}
+
 			// reset unfinished_threads count
 			coord->unfinished_threads = n_threads + 1;
 
-			_release_threads(coord, tdatas, n_threads);
+			_next_stage(coord, stage_idx);
 		}
 	}
 
@@ -255,44 +258,31 @@ _sleep_for(uint64_t n_secs)
 }
 
 /*
- * halt all threads and return once all threads have called thr_coordinator_wait
+ * signal to all threads to stop the stage they are running. this returns
+ * immediately, threads which are in the middle of a transaction finish it
+ * first
  */
 LOCAL_HELPER void
-_halt_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads)
+_halt_threads(tdata_t** tdatas, uint32_t n_threads)
 {
 	for (uint32_t i = 0; i < n_threads; i++) {
 		tdatas[i]->do_work = false;
 	}
-	pthread_barrier_wait(&coord->barrier);
 }
 
 /*
- * signal to all threads to stop execution and return,
- * must be called after a call to _halt_threads
+ * moves the threads on to the stage starting at workload stage_idx, waking
+ * every thread waiting for the current one to end
  */
 LOCAL_HELPER void
-_terminate_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads)
+_next_stage(thr_coord_t* coord, uint32_t stage_idx)
 {
-	for (uint32_t i = 0; i < n_threads; i++) {
-		tdatas[i]->finished = true;
-	}
-	pthread_barrier_wait(&coord->barrier);
-}
+	coord->stage_idx = stage_idx;
 
-/*
- * signal to all threads to continue execution,
- * must be called after a call to _halt_threads
- */
-LOCAL_HELPER void
-_release_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads)
-{
-	for (uint32_t i = 0; i < n_threads; i++) {
-		tdatas[i]->do_work = true;
-	}
-	pthread_barrier_wait(&coord->barrier);
+	pthread_mutex_lock(&coord->c_lock);
+	coord->epoch++;
+	pthread_cond_broadcast(&coord->complete);
+	pthread_mutex_unlock(&coord->c_lock);
 }
 
 /*
@@ -323,25 +313,103 @@ _finish_req_duration(thr_coord_t* coord)
 }
 
 /*
- * clear the transaction history in case some stragglers in RU workloads did
- * an extra transaction after the latency_output thread had already printed its
- * last status report
- *
- * note: this is not thread safe, only call this when all other threads are
- * halted
+ * runs the stage for its warmup, with its transactions counted apart from
+ * the totals. A stage without a duration, or with a budget, ends its warmup
+ * early if its threads finish their work first
+ */
+LOCAL_HELPER void
+_warm_up(thr_coord_t* coord, cdata_t* cdata, const stage_t* stage,
+		bool has_budget)
+{
+	bool print = cdata->proc_stats == NULL;
+
+	if (print) {
+		printf("Warmup for %" PRIu64 " seconds\n", stage->warmup);
+	}
+
+	warmup_stats_begin(cdata->warmup_stats);
+	if (stage->duration > 0 && !has_budget) {
+		_sleep_for(stage->warmup);
+	}
+	else {
+		_wait_for_threads(coord, stage->warmup);
+	}
+	warmup_stats_end(cdata->warmup_stats);
+
+	if (print) {
+		warmup_stats_print(cdata->warmup_stats, &cdata->latency_percentiles,
+				stdout);
+	}
+}
+
+/*
+ * waits up to n_secs for every thread but the coordinator to call
+ * thr_coordinator_complete
+ */
+LOCAL_HELPER void
+_wait_for_threads(thr_coord_t* coord, uint64_t n_secs)
+{
+	struct timespec wakeup_time;
+	clock_gettime(COORD_CLOCK, &wakeup_time);
+	wakeup_time.tv_sec += n_secs;
+
+	pthread_mutex_lock(&coord->c_lock);
+	while (coord->unfinished_threads > 1 && _has_not_happened(&wakeup_time)) {
+		pthread_cond_timedwait(&coord->complete, &coord->c_lock,
+				&wakeup_time);
+	}
+	pthread_mutex_unlock(&coord->c_lock);
+}
+
+/*
+ * warns when the keys of a linear workload can't be split evenly between the
+ * threads running it
  */
 LOCAL_HELPER void
-clear_cdata_counts(cdata_t* cdata)
+_warn_key_division(const stage_t* stage)
 {
-	cdata->write_count = 0;
-	cdata->write_timeout_count = 0;
-	cdata->write_error_count = 0;
-	cdata->read_hit_count = 0;
-	cdata->read_miss_count = 0;
-	cdata->read_timeout_count = 0;
-	cdata->read_error_count = 0;
-	cdata->udf_count = 0;
-	cdata->udf_timeout_count = 0;
-	cdata->udf_error_count = 0;
+	if (stage->workload.type == WORKLOAD_TYPE_I) {
+		uint64_t nkeys = stage->key_end - stage->key_start;
+
+		if (stage->async) {
+			if (nkeys % stage->batch_write_size != 0) {
+				blog_warn("--keys is not divisible by --batch-write-size so more than "
+							"--keys records will be written\n");
+			}
+		}
+		else { // TODO when async is multithreaded change this
+			if (stage->batch_write_size * stage->n_threads > nkeys) {
+				blog_warn("--batch-write-size * --threads is greater than --keys so "
+							"more than --keys records will be written\n");
+			}
+
+			if (nkeys % (stage->batch_write_size * stage->n_threads) != 0) {
+				blog_warn("--keys is not divisible by (--batch-write-size * --threads) so more than "
+							"--keys records will be written\n");
+			}
+		}
+	}
+
+	if (stage->workload.type == WORKLOAD_TYPE_D) {
+		uint64_t nkeys = stage->key_end - stage->key_start;
+
+		if (stage->async) {
+			if (nkeys % stage->batch_delete_size != 0) {
+				blog_warn("--keys is not divisible by --batch-delete-size so more than "
+							"--keys records will be deleted\n");
+			}
+		}
+		else { // TODO when async is multithreaded change this
+			if (stage->batch_delete_size * stage->n_threads > nkeys) {
+				blog_warn("--batch-delete-size * --threads is greater than --keys so more than "
+							"--keys records will be deleted\n");
+			}
+
+			if (nkeys % (stage->batch_delete_size * stage->n_threads) != 0) {
+				blog_warn("--keys is not divisible by (--batch-delete-size * --threads) so more than "
+							"--keys records will be deleted\n");
+			}
+		}
+	}
 }
 
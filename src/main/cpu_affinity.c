@@ -0,0 +1,465 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <cpu_affinity.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+// large enough for the cpulist of any node
+#define CPULIST_MAX_LEN 4096
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER int _parse_uint(const char** str, uint32_t* val);
+LOCAL_HELPER bool _bind_memory(void* addr, size_t len, int node);
+LOCAL_HELPER size_t _round_to_pages(size_t size);
+LOCAL_HELPER void _print_slots(const cpu_affinity_t* aff, const char* name,
+		uint32_t first, uint32_t n);
+
+
+//==========================================================
+// Public API.
+//
+
+void
+cpu_affinity_init(cpu_affinity_t* aff)
+{
+	aff->cpus = NULL;
+	aff->n_cpus = 0;
+	aff->numa_node = -1;
+}
+
+void
+cpu_affinity_free(cpu_affinity_t* aff)
+{
+	if (aff->cpus != NULL) {
+		cf_free(aff->cpus);
+	}
+	cpu_affinity_init(aff);
+}
+
+int
+cpu_affinity_parse_list(const char* str, uint32_t** cpus, uint32_t* n_cpus)
+{
+	uint32_t capacity = 16;
+	uint32_t n = 0;
+	uint32_t* list = (uint32_t*) cf_malloc(capacity * sizeof(uint32_t));
+
+	for (;;) {
+		uint32_t lo;
+		uint32_t hi;
+
+		if (_parse_uint(&str, &lo) != 0) {
+			goto fail;
+		}
+		hi = lo;
+		if (*str == '-') {
+			str++;
+			if (_parse_uint(&str, &hi) != 0 || hi < lo) {
+				goto fail;
+			}
+		}
+		if (hi >= CPU_AFFINITY_MAX_CPUS) {
+			goto fail;
+		}
+
+		for (uint32_t cpu = lo; cpu <= hi; cpu++) {
+			if (n == capacity) {
+				capacity *= 2;
+				list = (uint32_t*) cf_realloc(list, capacity * sizeof(uint32_t));
+			}
+			list[n++] = cpu;
+		}
+
+		if (*str == '\0') {
+			break;
+		}
+		if (*str != ',') {
+			goto fail;
+		}
+		str++;
+	}
+
+	*cpus = list;
+	*n_cpus = n;
+	return 0;
+
+fail:
+	cf_free(list);
+	return -1;
+}
+
+int
+cpu_affinity_set_cpu_list(cpu_affinity_t* aff, const char* str)
+{
+	uint32_t* cpus;
+	uint32_t n_cpus;
+
+	if (cpu_affinity_parse_list(str, &cpus, &n_cpus) != 0) {
+		return -1;
+	}
+
+	if (aff->cpus != NULL) {
+		cf_free(aff->cpus);
+	}
+	aff->cpus = cpus;
+	aff->n_cpus = n_cpus;
+	return 0;
+}
+
+int
+cpu_affinity_set_numa_node(cpu_affinity_t* aff, int node)
+{
+	char path[64];
+	char buf[CPULIST_MAX_LEN];
+
+	if (node < 0) {
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), SYSFS_NODE_DIR "/node%d/cpulist", node);
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		return -1;
+	}
+	char* line = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (line == NULL) {
+		return -1;
+	}
+	buf[strcspn(buf, "\n")] = '\0';
+
+	// a memory-only node has an empty cpulist, which is fine as long as the
+	// CPUs come from somewhere else
+	if (aff->n_cpus == 0 && cpu_affinity_set_cpu_list(aff, buf) != 0) {
+		return -1;
+	}
+
+	aff->numa_node = node;
+	return 0;
+}
+
+int
+cpu_affinity_unavailable_cpu(const cpu_affinity_t* aff)
+{
+#ifdef __linux__
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+		return -1;
+	}
+	for (uint32_t i = 0; i < aff->n_cpus; i++) {
+		if (!CPU_ISSET(aff->cpus[i], &set)) {
+			return (int) aff->cpus[i];
+		}
+	}
+#endif /* __linux__ */
+	return -1;
+}
+
+int
+cpu_affinity_cpu(const cpu_affinity_t* aff, uint32_t slot)
+{
+	if (aff->n_cpus == 0) {
+		return -1;
+	}
+	return (int) aff->cpus[slot % aff->n_cpus];
+}
+
+int
+cpu_affinity_cpu_node(uint32_t cpu)
+{
+	char path[64];
+
+	// each CPU's directory has a nodeN link to the node it belongs to
+	snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%u", cpu);
+	DIR* dir = opendir(path);
+	if (dir == NULL) {
+		return -1;
+	}
+
+	int node = -1;
+	struct dirent* ent;
+	while ((ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, "node", 4) == 0 &&
+				isdigit((unsigned char) ent->d_name[4])) {
+			node = atoi(ent->d_name + 4);
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+}
+
+bool
+cpu_affinity_bind_process(const cpu_affinity_t* aff)
+{
+#ifdef __linux__
+	bool ok = true;
+
+	if (aff->n_cpus != 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (uint32_t i = 0; i < aff->n_cpus; i++) {
+			CPU_SET(aff->cpus[i], &set);
+		}
+		if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+			blog_warn("Failed to restrict asbench to its CPU list (%s)\n",
+					strerror(errno));
+			ok = false;
+		}
+	}
+
+	if (aff->numa_node >= 0) {
+		unsigned long mask[CPU_AFFINITY_MAX_CPUS / (8 * sizeof(unsigned long))] =
+			{ 0 };
+		uint32_t bits = 8 * sizeof(unsigned long);
+
+		mask[aff->numa_node / bits] |= 1UL << (aff->numa_node % bits);
+		if (syscall(SYS_set_mempolicy, MPOL_BIND, mask,
+					CPU_AFFINITY_MAX_CPUS + 1) != 0) {
+			blog_warn("Failed to bind memory to NUMA node %d (%s)\n",
+					aff->numa_node, strerror(errno));
+			ok = false;
+		}
+	}
+	return ok;
+#else
+	if (aff->n_cpus != 0 || aff->numa_node >= 0) {
+		blog_warn("CPU and NUMA affinity are only supported on Linux\n");
+		return false;
+	}
+	return true;
+#endif /* __linux__ */
+}
+
+bool
+cpu_affinity_set_attr(const cpu_affinity_t* aff, pthread_attr_t* attr,
+		uint32_t slot)
+{
+	int cpu = cpu_affinity_cpu(aff, slot);
+	if (cpu < 0) {
+		return true;
+	}
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_attr_setaffinity_np(attr, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+bool
+cpu_affinity_pin_thread(const cpu_affinity_t* aff, pthread_t thread,
+		uint32_t slot)
+{
+	int cpu = cpu_affinity_cpu(aff, slot);
+	if (cpu < 0) {
+		return true;
+	}
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+void*
+cpu_affinity_alloc(const cpu_affinity_t* aff, size_t size, uint32_t slot)
+{
+	if (!cpu_affinity_enabled(aff)) {
+		return cf_calloc(1, size);
+	}
+
+	// whole pages of its own, so nothing else decides which node they're on
+	size_t len = _round_to_pages(size);
+	void* ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+
+	int node = aff->numa_node >= 0 ? aff->numa_node :
+		cpu_affinity_cpu_node((uint32_t) cpu_affinity_cpu(aff, slot));
+	if (node >= 0) {
+		// nothing has been faulted in yet, so this places every page
+		_bind_memory(ptr, len, node);
+	}
+	return ptr;
+}
+
+void
+cpu_affinity_dealloc(const cpu_affinity_t* aff, void* ptr, size_t size)
+{
+	if (!cpu_affinity_enabled(aff)) {
+		cf_free(ptr);
+		return;
+	}
+	munmap(ptr, _round_to_pages(size));
+}
+
+void
+cpu_affinity_format_list(const uint32_t* cpus, uint32_t n_cpus, char* buf,
+		size_t size)
+{
+	size_t off = 0;
+
+	buf[0] = '\0';
+	for (uint32_t i = 0; i < n_cpus && off < size; ) {
+		uint32_t j = i;
+		while (j + 1 < n_cpus && cpus[j + 1] == cpus[j] + 1) {
+			j++;
+		}
+
+		int len = j == i ?
+			snprintf(buf + off, size - off, "%s%u", off ? "," : "", cpus[i]) :
+			snprintf(buf + off, size - off, "%s%u-%u", off ? "," : "", cpus[i],
+					cpus[j]);
+		if (len < 0) {
+			break;
+		}
+		off += (size_t) len;
+		i = j + 1;
+	}
+}
+
+void
+cpu_affinity_print_placement(const cpu_affinity_t* aff, uint32_t n_workers,
+		uint32_t n_event_loops)
+{
+	if (!cpu_affinity_enabled(aff)) {
+		printf("cpu affinity:           none\n");
+		return;
+	}
+
+	printf("cpu affinity:           ");
+	_print_slots(aff, "workers", 0, n_workers);
+	if (n_event_loops != 0) {
+		_print_slots(aff, " event-loops", n_workers, n_event_loops);
+	}
+	_print_slots(aff, " output", n_workers + n_event_loops, 1);
+	printf("\n");
+
+	if (aff->numa_node >= 0) {
+		printf("numa node:              %d\n", aff->numa_node);
+	}
+	else {
+		printf("numa node:              local to each thread\n");
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * parses a decimal number at *str, advancing *str past it
+ */
+LOCAL_HELPER int
+_parse_uint(const char** str, uint32_t* val)
+{
+	const char* s = *str;
+	uint64_t v = 0;
+
+	if (!isdigit((unsigned char) *s)) {
+		return -1;
+	}
+	while (isdigit((unsigned char) *s)) {
+		v = v * 10 + (uint64_t) (*s - '0');
+		if (v > UINT32_MAX) {
+			return -1;
+		}
+		s++;
+	}
+
+	*val = (uint32_t) v;
+	*str = s;
+	return 0;
+}
+
+LOCAL_HELPER bool
+_bind_memory(void* addr, size_t len, int node)
+{
+#ifdef __linux__
+	unsigned long mask[CPU_AFFINITY_MAX_CPUS / (8 * sizeof(unsigned long))] =
+		{ 0 };
+	uint32_t bits = 8 * sizeof(unsigned long);
+
+	if (node >= CPU_AFFINITY_MAX_CPUS) {
+		return false;
+	}
+	mask[node / bits] |= 1UL << (node % bits);
+	// preferred rather than bound, so a full node spills over instead of
+	// failing the allocation
+	return syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask,
+			CPU_AFFINITY_MAX_CPUS + 1, 0) == 0;
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+LOCAL_HELPER size_t
+_round_to_pages(size_t size)
+{
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	return (size + page - 1) / page * page;
+}
+
+/*
+ * prints the CPUs of the n threads starting at slot first
+ */
+LOCAL_HELPER void
+_print_slots(const cpu_affinity_t* aff, const char* name, uint32_t first,
+		uint32_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	uint32_t cpus[n];
+	char buf[256];
+
+	for (uint32_t i = 0; i < n; i++) {
+		cpus[i] = (uint32_t) cpu_affinity_cpu(aff, first + i);
+	}
+	cpu_affinity_format_list(cpus, n, buf, sizeof(buf));
+	printf("%s=%s", name, buf);
+}
+
@@ -0,0 +1,262 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <digest_table.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define DIGEST_TABLE_MAGIC "ASBDGST1"
+
+/*
+ * the header at the start of a persisted table, followed directly by the
+ * digests. The magic is written last, so a table that was only partially
+ * built is never reused
+ */
+struct digest_file_hdr_s {
+	char magic[8];
+	uint64_t key_start;
+	uint64_t n_keys;
+	char ns[AS_NAMESPACE_MAX_SIZE];
+	char set[AS_SET_MAX_SIZE];
+};
+
+struct build_slice_s {
+	as_digest_value* digests;
+	const char* ns;
+	const char* set;
+	uint64_t key_start;
+	// the range of keys this thread is responsible for
+	uint64_t start;
+	uint64_t end;
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER void* _build_slice(void* udata);
+LOCAL_HELPER int _build(as_digest_value* digests, const char* ns,
+		const char* set, uint64_t key_start, uint64_t n_keys,
+		uint32_t n_threads);
+LOCAL_HELPER bool _hdr_matches(const struct digest_file_hdr_s* hdr,
+		const char* ns, const char* set, uint64_t key_start, uint64_t n_keys);
+LOCAL_HELPER void* _map_file(const char* path, size_t map_size);
+
+
+//==========================================================
+// Public API.
+//
+
+int
+digest_table_init(digest_table_t* dt, const char* ns, const char* set,
+		uint64_t key_start, uint64_t n_keys, uint32_t n_threads,
+		const char* path)
+{
+	size_t digests_size = n_keys * sizeof(as_digest_value);
+
+	dt->key_start = key_start;
+	dt->n_keys = n_keys;
+
+	if (path == NULL) {
+		dt->map_size = digests_size;
+		dt->map = mmap(NULL, dt->map_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (dt->map == MAP_FAILED) {
+			blog_error("Failed to allocate %zu bytes for the digest table: %s\n",
+					dt->map_size, strerror(errno));
+			return -1;
+		}
+		dt->digests = (const as_digest_value*) dt->map;
+
+		if (_build((as_digest_value*) dt->map, ns, set, key_start, n_keys,
+					n_threads) != 0) {
+			munmap(dt->map, dt->map_size);
+			return -1;
+		}
+		return 0;
+	}
+
+	dt->map_size = sizeof(struct digest_file_hdr_s) + digests_size;
+	dt->map = _map_file(path, dt->map_size);
+	if (dt->map == NULL) {
+		return -1;
+	}
+
+	struct digest_file_hdr_s* hdr = (struct digest_file_hdr_s*) dt->map;
+	as_digest_value* digests = (as_digest_value*) (hdr + 1);
+	dt->digests = (const as_digest_value*) digests;
+
+	if (_hdr_matches(hdr, ns, set, key_start, n_keys)) {
+		blog_info("Reusing key digests from %s\n", path);
+		return 0;
+	}
+
+	memset(hdr, 0, sizeof(struct digest_file_hdr_s));
+	if (_build(digests, ns, set, key_start, n_keys, n_threads) != 0) {
+		munmap(dt->map, dt->map_size);
+		return -1;
+	}
+
+	hdr->key_start = key_start;
+	hdr->n_keys = n_keys;
+	strncpy(hdr->ns, ns, sizeof(hdr->ns) - 1);
+	strncpy(hdr->set, set, sizeof(hdr->set) - 1);
+	msync(dt->map, dt->map_size, MS_SYNC);
+
+	memcpy(hdr->magic, DIGEST_TABLE_MAGIC, sizeof(hdr->magic));
+	msync(dt->map, sizeof(struct digest_file_hdr_s), MS_SYNC);
+	return 0;
+}
+
+void
+digest_table_free(digest_table_t* dt)
+{
+	munmap(dt->map, dt->map_size);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER void*
+_build_slice(void* udata)
+{
+	struct build_slice_s* slice = (struct build_slice_s*) udata;
+
+	for (uint64_t key_val = slice->start; key_val < slice->end; key_val++) {
+		as_key key;
+		as_key_init_int64(&key, slice->ns, slice->set, key_val);
+
+		as_digest* digest = as_key_digest(&key);
+		memcpy(slice->digests[key_val - slice->key_start], digest->value,
+				AS_DIGEST_VALUE_SIZE);
+		as_key_destroy(&key);
+	}
+	return NULL;
+}
+
+/*
+ * hashes every key in [key_start, key_start + n_keys) into digests, evenly
+ * dividing the range between n_threads threads
+ */
+LOCAL_HELPER int
+_build(as_digest_value* digests, const char* ns, const char* set,
+		uint64_t key_start, uint64_t n_keys, uint32_t n_threads)
+{
+	n_threads = MAX(n_threads, 1);
+
+	pthread_t* threads =
+		(pthread_t*) cf_malloc(n_threads * sizeof(pthread_t));
+	struct build_slice_s* slices = (struct build_slice_s*)
+		cf_malloc(n_threads * sizeof(struct build_slice_s));
+	uint32_t n_started = 0;
+	int ret = 0;
+
+	uint64_t t1 = cf_getms();
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		struct build_slice_s* slice = &slices[i];
+		slice->digests = digests;
+		slice->ns = ns;
+		slice->set = set;
+		slice->key_start = key_start;
+		slice->start = key_start + ((n_keys * i) / n_threads);
+		slice->end = key_start + ((n_keys * (i + 1)) / n_threads);
+
+		if (pthread_create(&threads[i], NULL, _build_slice, slice) != 0) {
+			blog_error("Failed to create digest table thread\n");
+			ret = -1;
+			break;
+		}
+		n_started++;
+	}
+
+	for (uint32_t i = 0; i < n_started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if (ret == 0) {
+		blog_info("Computed %" PRIu64 " key digests in %" PRIu64 " ms\n",
+				n_keys, cf_getms() - t1);
+	}
+
+	cf_free(slices);
+	cf_free(threads);
+	return ret;
+}
+
+LOCAL_HELPER bool
+_hdr_matches(const struct digest_file_hdr_s* hdr, const char* ns,
+		const char* set, uint64_t key_start, uint64_t n_keys)
+{
+	return memcmp(hdr->magic, DIGEST_TABLE_MAGIC, sizeof(hdr->magic)) == 0 &&
+		hdr->key_start == key_start &&
+		hdr->n_keys == n_keys &&
+		strncmp(hdr->ns, ns, sizeof(hdr->ns)) == 0 &&
+		strncmp(hdr->set, set, sizeof(hdr->set)) == 0;
+}
+
+/*
+ * maps the file at path read/write, resizing it to map_size if it isn't
+ * already that size. Returns NULL on failure
+ */
+LOCAL_HELPER void*
+_map_file(const char* path, size_t map_size)
+{
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		blog_error("Failed to open digest table file %s: %s\n", path,
+				strerror(errno));
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		blog_error("Failed to stat digest table file %s: %s\n", path,
+				strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	// a file of any other size can't hold a matching table, and its header
+	// will be rejected once mapped
+	if ((size_t) st.st_size != map_size &&
+			ftruncate(fd, (off_t) map_size) != 0) {
+		blog_error("Failed to resize digest table file %s: %s\n", path,
+				strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// the mapping holds its own reference to the file
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		blog_error("Failed to map digest table file %s: %s\n", path,
+				strerror(errno));
+		return NULL;
+	}
+	return map;
+}
+
@@ -0,0 +1,253 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <aerospike/as_error.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <error_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// the slot codes outside of [ERROR_STATS_MIN_CODE, ERROR_STATS_MAX_CODE] go in
+#define OTHER_CODE_IDX (ERROR_STATS_N_CODES - 1)
+
+// failed transactions can take much longer than successful ones, so their
+// histograms go up to a minute
+#define ERROR_HDR_MAX_US 60000000
+
+static const char* const error_op_strs[ERROR_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER uint32_t _code_idx(as_status status);
+LOCAL_HELPER as_status _idx_code(uint32_t idx);
+LOCAL_HELPER void _print_code(uint32_t idx);
+LOCAL_HELPER void _print_hdr_row(const char* op, const char* kind,
+		struct hdr_histogram* h);
+
+
+//==========================================================
+// Public API.
+//
+
+error_stats_t*
+error_stats_create(uint32_t log_rate)
+{
+	error_stats_t* es = (error_stats_t*) cf_malloc(sizeof(error_stats_t));
+
+	for (uint32_t op = 0; op < ERROR_OP_COUNT; op++) {
+		struct error_op_stats_s* stats = &es->ops[op];
+
+		for (uint32_t i = 0; i < ERROR_STATS_N_CODES; i++) {
+			atomic_init(&stats->period_counts[i], 0);
+			atomic_init(&stats->total_counts[i], 0);
+		}
+		hdr_init(1, ERROR_HDR_MAX_US, 3, &stats->timeout_hdr);
+		hdr_init(1, ERROR_HDR_MAX_US, 3, &stats->error_hdr);
+	}
+	es->log_rate = log_rate;
+	atomic_init(&es->log_window, 0);
+	atomic_init(&es->log_count, 0);
+	return es;
+}
+
+void
+error_stats_free(error_stats_t* es)
+{
+	for (uint32_t op = 0; op < ERROR_OP_COUNT; op++) {
+		hdr_close(es->ops[op].timeout_hdr);
+		hdr_close(es->ops[op].error_hdr);
+	}
+	cf_free(es);
+}
+
+void
+error_stats_record(error_stats_t* es, error_op_t op, as_status status,
+		uint64_t dt_us)
+{
+	struct error_op_stats_s* stats = &es->ops[op];
+	uint32_t idx = _code_idx(status);
+
+	atomic_fetch_add_explicit(&stats->period_counts[idx], 1,
+			memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->total_counts[idx], 1,
+			memory_order_relaxed);
+	hdr_record_value_atomic(status == AEROSPIKE_ERR_TIMEOUT ?
+			stats->timeout_hdr : stats->error_hdr,
+			(int64_t) MIN(dt_us, ERROR_HDR_MAX_US));
+}
+
+bool
+error_stats_should_log(error_stats_t* es)
+{
+	if (es->log_rate == 0) {
+		return false;
+	}
+
+	uint64_t now_s = cf_getms() / 1000;
+	uint64_t window = atomic_load_explicit(&es->log_window,
+			memory_order_relaxed);
+
+	if (window != now_s) {
+		// whoever moves the window forward reports what the last one dropped
+		if (atomic_compare_exchange_strong(&es->log_window, &window, now_s)) {
+			uint32_t prev_count = atomic_exchange(&es->log_count, 0);
+
+			if (prev_count > es->log_rate) {
+				blog_warn("%u errors were not logged\n",
+						prev_count - es->log_rate);
+			}
+		}
+	}
+	return atomic_fetch_add_explicit(&es->log_count, 1,
+			memory_order_relaxed) < es->log_rate;
+}
+
+void
+error_stats_print_period(error_stats_t* es)
+{
+	bool any_errors = false;
+
+	for (uint32_t op = 0; op < ERROR_OP_COUNT; op++) {
+		struct error_op_stats_s* stats = &es->ops[op];
+		bool op_errors = false;
+
+		for (uint32_t i = 0; i < ERROR_STATS_N_CODES; i++) {
+			uint64_t count = atomic_exchange(&stats->period_counts[i], 0);
+
+			if (count == 0) {
+				continue;
+			}
+			if (!any_errors) {
+				blog_info("");
+				printf("errors ");
+				any_errors = true;
+			}
+			if (!op_errors) {
+				printf("%s(", error_op_strs[op]);
+				op_errors = true;
+			}
+			else {
+				printf(" ");
+			}
+			_print_code(i);
+			printf("=%" PRIu64, count);
+		}
+		if (op_errors) {
+			printf(") ");
+		}
+	}
+	if (any_errors) {
+		printf("\n");
+	}
+}
+
+void
+error_stats_print_summary(error_stats_t* es)
+{
+	bool any_errors = false;
+
+	for (uint32_t op = 0; op < ERROR_OP_COUNT; op++) {
+		struct error_op_stats_s* stats = &es->ops[op];
+
+		for (uint32_t i = 0; i < ERROR_STATS_N_CODES; i++) {
+			uint64_t count = stats->total_counts[i];
+
+			if (count == 0) {
+				continue;
+			}
+			if (!any_errors) {
+				printf("error summary:\n");
+				printf("%-5s %6s %12s  %s\n", "op", "code", "count", "status");
+				any_errors = true;
+			}
+			printf("%-5s ", error_op_strs[op]);
+			if (i == OTHER_CODE_IDX) {
+				printf("%6s %12" PRIu64 "  %s\n", "other", count,
+						"out of range status codes");
+			}
+			else {
+				printf("%6d %12" PRIu64 "  %s\n", _idx_code(i), count,
+						as_error_string(_idx_code(i)));
+			}
+		}
+	}
+
+	if (!any_errors) {
+		return;
+	}
+
+	printf("failed transaction latency summary (us):\n");
+	printf("%-5s %-7s %12s %8s %8s %8s %8s %8s\n", "op", "kind", "count",
+			"p50", "p90", "p99", "p99.9", "max");
+	for (uint32_t op = 0; op < ERROR_OP_COUNT; op++) {
+		_print_hdr_row(error_op_strs[op], "timeout", es->ops[op].timeout_hdr);
+		_print_hdr_row(error_op_strs[op], "error", es->ops[op].error_hdr);
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER uint32_t
+_code_idx(as_status status)
+{
+	if (status < ERROR_STATS_MIN_CODE || status > ERROR_STATS_MAX_CODE) {
+		return OTHER_CODE_IDX;
+	}
+	return (uint32_t) (status - ERROR_STATS_MIN_CODE);
+}
+
+LOCAL_HELPER as_status
+_idx_code(uint32_t idx)
+{
+	return (as_status) ((int32_t) idx + ERROR_STATS_MIN_CODE);
+}
+
+LOCAL_HELPER void
+_print_code(uint32_t idx)
+{
+	if (idx == OTHER_CODE_IDX) {
+		printf("other");
+	}
+	else if (_idx_code(idx) == AEROSPIKE_ERR_TIMEOUT) {
+		printf("timeout");
+	}
+	else {
+		printf("code%d", _idx_code(idx));
+	}
+}
+
+LOCAL_HELPER void
+_print_hdr_row(const char* op, const char* kind, struct hdr_histogram* h)
+{
+	static const double pcts[] = { 50., 90., 99., 99.9 };
+	int64_t total = hdr_total_count(h);
+
+	if (total == 0) {
+		return;
+	}
+
+	printf("%-5s %-7s %12" PRId64, op, kind, total);
+	for (uint32_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++) {
+		printf(" %8" PRId64, hdr_value_at_percentile(h, pcts[i]));
+	}
+	printf(" %8" PRId64 "\n", hdr_max(h));
+}
+
@@ -0,0 +1,204 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <stdio.h>
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <group_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const group_op_strs[GROUP_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+// the order the totals print their latencies in
+static const group_op_t latency_order[GROUP_OP_COUNT] = {
+	GROUP_OP_WRITE,
+	GROUP_OP_READ,
+	GROUP_OP_UDF
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER bool _workload_does(const stage_t* stage, group_op_t op);
+
+
+//==========================================================
+// Public API.
+//
+
+group_stats_t*
+group_stats_create(const stages_t* stages, bool latency)
+{
+	group_stats_t* gs = (group_stats_t*) cf_malloc(sizeof(group_stats_t));
+
+	gs->n_workloads = stages->n_stages;
+	gs->workloads = cf_malloc(stages->n_stages * sizeof(*gs->workloads));
+
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			struct group_op_stats_s* stats = &gs->workloads[i][op];
+
+			atomic_init(&stats->ok, 0);
+			atomic_init(&stats->miss, 0);
+			atomic_init(&stats->timeouts, 0);
+			atomic_init(&stats->errors, 0);
+
+			stats->hdr = NULL;
+			if (latency && _workload_does(&stages->stages[i], op)) {
+				hdr_init(1, 1000000, 3, &stats->hdr);
+			}
+		}
+	}
+	return gs;
+}
+
+void
+group_stats_free(group_stats_t* gs)
+{
+	for (uint32_t i = 0; i < gs->n_workloads; i++) {
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			if (gs->workloads[i][op].hdr != NULL) {
+				hdr_close(gs->workloads[i][op].hdr);
+			}
+		}
+	}
+	cf_free(gs->workloads);
+	cf_free(gs);
+}
+
+void
+group_stats_record(group_stats_t* gs, uint32_t stage_idx, group_op_t op,
+		uint64_t dt_us, as_status status)
+{
+	group_op_stats_record(&gs->workloads[stage_idx][op], op, dt_us, status);
+}
+
+void
+group_op_stats_record(struct group_op_stats_s* stats, group_op_t op,
+		uint64_t dt_us, as_status status)
+{
+	// the same split as the totals: a read of a missing record is a miss,
+	// while a UDF applied to one still succeeded
+	if (status == AEROSPIKE_OK ||
+			(status == AEROSPIKE_ERR_RECORD_NOT_FOUND && op == GROUP_OP_UDF)) {
+		if (stats->hdr != NULL) {
+			hdr_record_value_atomic(stats->hdr, dt_us);
+		}
+		atomic_fetch_add_explicit(&stats->ok, 1, memory_order_relaxed);
+	}
+	else if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND && op == GROUP_OP_READ) {
+		atomic_fetch_add_explicit(&stats->miss, 1, memory_order_relaxed);
+	}
+	else if (status == AEROSPIKE_ERR_TIMEOUT) {
+		atomic_fetch_add_explicit(&stats->timeouts, 1, memory_order_relaxed);
+	}
+	else {
+		atomic_fetch_add_explicit(&stats->errors, 1, memory_order_relaxed);
+	}
+}
+
+void
+group_stats_print_period(group_stats_t* gs, const stages_t* stages,
+		uint32_t first, uint64_t elapsed_us)
+{
+	uint32_t end = stages_group_end(stages, first);
+
+	if (end - first == 1) {
+		return;
+	}
+
+	for (uint32_t i = first; i < end; i++) {
+		const stage_t* stage = &stages->stages[i];
+
+		blog_info("");
+		printf("[%s] ", stage->desc);
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			struct group_op_stats_s* stats = &gs->workloads[i][op];
+			uint64_t ok = atomic_exchange(&stats->ok, 0);
+			uint64_t miss = atomic_exchange(&stats->miss, 0);
+			uint64_t timeouts = atomic_exchange(&stats->timeouts, 0);
+			uint64_t errors = atomic_exchange(&stats->errors, 0);
+
+			if (!_workload_does(stage, op)) {
+				continue;
+			}
+			if (op == GROUP_OP_READ) {
+				printf("%s(tps=%" PRIu64 " (hit=%" PRIu64 " miss=%" PRIu64 ") "
+						"timeouts=%" PRIu64 " errors=%" PRIu64 ") ",
+						group_op_strs[op], per_sec(ok + miss, elapsed_us),
+						per_sec(ok, elapsed_us), per_sec(miss, elapsed_us),
+						timeouts, errors);
+			}
+			else {
+				printf("%s(tps=%" PRIu64 " timeouts=%" PRIu64 " errors=%"
+						PRIu64 ") ",
+						group_op_strs[op], per_sec(ok, elapsed_us), timeouts,
+						errors);
+			}
+		}
+		printf("\n");
+	}
+}
+
+void
+group_stats_print_latency(group_stats_t* gs, const stages_t* stages,
+		uint32_t first, uint64_t elapsed_s, as_vector* percentiles,
+		FILE* out_file)
+{
+	uint32_t end = stages_group_end(stages, first);
+
+	if (end - first == 1) {
+		return;
+	}
+
+	for (uint32_t i = first; i < end; i++) {
+		for (uint32_t j = 0; j < GROUP_OP_COUNT; j++) {
+			group_op_t op = latency_order[j];
+			struct hdr_histogram* h = gs->workloads[i][op].hdr;
+			char name[128];
+
+			if (h == NULL) {
+				continue;
+			}
+			snprintf(name, sizeof(name), "%s[%s]", group_op_strs[op],
+					stages->stages[i].desc);
+			print_hdr_percentiles(h, name, elapsed_s, percentiles, out_file);
+		}
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER bool
+_workload_does(const stage_t* stage, group_op_t op)
+{
+	switch (op) {
+		case GROUP_OP_READ:
+			return workload_contains_reads(&stage->workload);
+		case GROUP_OP_WRITE:
+			return workload_contains_writes(&stage->workload) ||
+				workload_contains_deletes(&stage->workload);
+		case GROUP_OP_UDF:
+			return workload_contains_udfs(&stage->workload);
+		default:
+			return false;
+	}
+}
+
@@ -0,0 +1,70 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <stdio.h>
+
+#include <aerospike/as_random.h>
+
+#include <common.h>
+#include <instance.h>
+
+
+//==========================================================
+// Public API.
+//
+
+void
+instance_shard_range(uint64_t start, uint64_t end, uint32_t id,
+		uint32_t count, uint64_t* shard_start, uint64_t* shard_end)
+{
+	uint64_t n = end - start;
+	uint64_t per = n / count;
+	uint64_t rem = n % count;
+
+	*shard_start = start + id * per + MIN(id, rem);
+	*shard_end = *shard_start + per + (id < rem ? 1 : 0);
+}
+
+uint64_t
+instance_shard_count(uint64_t total, uint32_t id, uint32_t count)
+{
+	if (total == 0) {
+		return 0;
+	}
+
+	uint64_t start;
+	uint64_t end;
+	instance_shard_range(0, total, id, count, &start, &end);
+	return MAX(end - start, 1);
+}
+
+int
+instance_shard_stages(stages_t* stages, uint32_t id, uint32_t count)
+{
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		stage_t* stage = &stages->stages[i];
+
+		if (stage->key_end - stage->key_start < count) {
+			fprintf(stderr, "Stage %u: %" PRIu64 " keys can't be split "
+					"between %u instances\n",
+					i + 1, stage->key_end - stage->key_start, count);
+			return -1;
+		}
+
+		instance_shard_range(stage->key_start, stage->key_end, id, count,
+				&stage->key_start, &stage->key_end);
+		stage->tps = instance_shard_count(stage->tps, id, count);
+		stage->ops = instance_shard_count(stage->ops, id, count);
+		stage->bytes = instance_shard_count(stage->bytes, id, count);
+
+		if (stage->workload.shuffle) {
+			// shuffle within the instance's own keys
+			key_perm_init(&stage->key_perm, stage->key_end - stage->key_start,
+					as_random_next_uint64(as_random_instance()));
+		}
+	}
+	return 0;
+}
+
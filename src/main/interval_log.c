@@ -0,0 +1,725 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <interval_log.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const interval_op_strs[GROUP_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+static const char hdr_log_suffix[] = ".hlog";
+static const char counts_suffix[] = ".csv";
+
+/*
+ * one period of the merged logs, the sum of every log's intervals that
+ * began in it
+ */
+struct merge_period_s {
+	uint64_t start_s;
+	// NULL for the ops no log recorded latencies of in the period
+	struct hdr_histogram* hdrs[GROUP_OP_COUNT];
+	struct interval_counts_s counts[GROUP_OP_COUNT];
+};
+
+typedef struct merge_s {
+	// ordered by start_s
+	struct merge_period_s* periods;
+	uint32_t n_periods;
+	uint32_t capacity;
+
+	uint32_t n_logs;
+	// the ops that any of the logs did
+	bool has_op[GROUP_OP_COUNT];
+} merge_t;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER int _open_files(interval_log_t* log, const char* dir,
+		const char* name, const char* header, uint64_t start_us);
+LOCAL_HELPER void _close_files(interval_log_t* log);
+LOCAL_HELPER void _take_interval(struct hdr_histogram* cur,
+		struct hdr_histogram* prev, struct hdr_histogram* interval);
+LOCAL_HELPER void _write_entry(interval_log_t* log, group_op_t op,
+		uint64_t begin_us, uint64_t end_us, struct hdr_histogram* h,
+		const struct interval_counts_s* counts);
+LOCAL_HELPER void _to_timespec(hdr_timespec* ts, uint64_t us);
+LOCAL_HELPER int _op_from_str(const char* str);
+LOCAL_HELPER bool _has_suffix(const char* str, const char* suffix);
+LOCAL_HELPER int _merge_path(merge_t* m, const char* path);
+LOCAL_HELPER int _merge_log(merge_t* m, const char* path);
+LOCAL_HELPER int _merge_counts(merge_t* m, const char* path);
+LOCAL_HELPER struct merge_period_s* _get_period(merge_t* m, uint64_t start_s);
+LOCAL_HELPER void _add_counts(struct interval_counts_s* to,
+		const struct interval_counts_s* from);
+LOCAL_HELPER void _print_merged(merge_t* m, as_vector* percentiles,
+		FILE* out);
+LOCAL_HELPER void _print_merged_counts(FILE* out, uint64_t time_s,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const bool has_op[GROUP_OP_COUNT], uint64_t elapsed_us);
+LOCAL_HELPER void _print_percentiles(FILE* out, const char* name,
+		uint64_t time_s, uint64_t elapsed_s, struct hdr_histogram* h,
+		as_vector* percentiles);
+LOCAL_HELPER int _write_merged(merge_t* m, const char* out_dir);
+LOCAL_HELPER void _merge_free(merge_t* m);
+
+
+//==========================================================
+// Public API.
+//
+
+interval_log_t*
+interval_log_create(const char* dir, uint32_t id, uint32_t count,
+		time_t start_time)
+{
+	interval_log_t* log = (interval_log_t*) cf_malloc(sizeof(interval_log_t));
+	char name[64];
+	char header[64];
+
+	snprintf(name, sizeof(name), "intervals_%u_%s", id,
+			utc_time_str(start_time));
+	snprintf(header, sizeof(header), "asbench instance %u of %u", id, count);
+
+	if (_open_files(log, dir, name, header,
+				(uint64_t) start_time * 1000000) != 0) {
+		cf_free(log);
+		return NULL;
+	}
+
+	// the same ranges as the cumulative histograms they're taken from
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		hdr_init(1, 1000000, 3, &log->prev[op]);
+	}
+	hdr_init(1, 1000000, 3, &log->interval);
+
+	log->begin_us = interval_log_now();
+	return log;
+}
+
+void
+interval_log_free(interval_log_t* log)
+{
+	_close_files(log);
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		hdr_close(log->prev[op]);
+	}
+	hdr_close(log->interval);
+	cf_free(log);
+}
+
+uint64_t
+interval_log_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return timespec_to_us(&now);
+}
+
+uint64_t
+interval_log_next_boundary(uint64_t now_us)
+{
+	return ((now_us + INTERVAL_LOG_PERIOD_US / 2) / INTERVAL_LOG_PERIOD_US + 1) *
+		INTERVAL_LOG_PERIOD_US;
+}
+
+void
+interval_log_restart(interval_log_t* log, uint64_t now_us)
+{
+	log->begin_us = now_us;
+}
+
+void
+interval_log_write(interval_log_t* log, uint64_t end_us,
+		struct hdr_histogram* const hdrs[GROUP_OP_COUNT],
+		const struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (hdrs[op] == NULL) {
+			continue;
+		}
+		_take_interval(hdrs[op], log->prev[op], log->interval);
+		_write_entry(log, op, log->begin_us, end_us, log->interval,
+				&counts[op]);
+	}
+	fflush(log->hdr_out);
+	fflush(log->counts_out);
+
+	log->begin_us = end_us;
+}
+
+int
+interval_log_merge(const char* paths, as_vector* percentiles,
+		const char* out_dir, FILE* out)
+{
+	merge_t m;
+	memset(&m, 0, sizeof(m));
+
+	char* list = strdup(paths);
+	char* save;
+	int ret = 0;
+
+	for (char* path = strtok_r(list, ",", &save); path != NULL && ret == 0;
+			path = strtok_r(NULL, ",", &save)) {
+		ret = _merge_path(&m, path);
+	}
+	cf_free(list);
+
+	if (ret == 0 && m.n_logs == 0) {
+		blog_error("No interval logs found in \"%s\"\n", paths);
+		ret = -1;
+	}
+	else if (ret == 0 && m.n_periods == 0) {
+		// every run ended before its first interval did
+		blog_error("No intervals in the interval logs in \"%s\"\n", paths);
+		ret = -1;
+	}
+
+	if (ret == 0) {
+		_print_merged(&m, percentiles, out);
+		if (out_dir != NULL) {
+			ret = _write_merged(&m, out_dir);
+		}
+	}
+
+	_merge_free(&m);
+	return ret;
+}
+
+void
+interval_log_print_counts(FILE* out,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const bool has_op[GROUP_OP_COUNT], uint64_t elapsed_us,
+		const char* extra)
+{
+	const struct interval_counts_s* read = &counts[GROUP_OP_READ];
+	const struct interval_counts_s* write = &counts[GROUP_OP_WRITE];
+	const struct interval_counts_s* udf = &counts[GROUP_OP_UDF];
+
+	uint64_t write_tps = per_sec(write->ok, elapsed_us);
+	uint64_t read_hit_tps = per_sec(read->ok, elapsed_us);
+	uint64_t read_miss_tps = per_sec(read->miss, elapsed_us);
+	uint64_t udf_tps = per_sec(udf->ok, elapsed_us);
+
+	if (has_op[GROUP_OP_WRITE]) {
+		fprintf(out, "write(tps=%" PRIu64 " (hit=%" PRIu64 " miss=%lu) "
+				"timeouts=%" PRIu64 " errors=%" PRIu64 " bytes/s=%" PRIu64 ") ",
+				write_tps, write_tps, 0lu, write->timeouts, write->errors,
+				per_sec(write->bytes, elapsed_us));
+	}
+	if (has_op[GROUP_OP_READ]) {
+		fprintf(out, "read(tps=%" PRIu64 " (hit=%" PRIu64 " miss=%" PRIu64 ") "
+				"timeouts=%" PRIu64 " errors=%" PRIu64 ") ",
+				read_hit_tps + read_miss_tps, read_hit_tps, read_miss_tps,
+				read->timeouts, read->errors);
+	}
+	if (has_op[GROUP_OP_UDF]) {
+		fprintf(out, "udf(tps=%" PRIu64 " (hit=%" PRIu64 " miss=%lu) "
+				"timeouts=%" PRIu64 " errors=%" PRIu64 ") ",
+				udf_tps, udf_tps, 0lu, udf->timeouts, udf->errors);
+	}
+	if (extra != NULL) {
+		fputs(extra, out);
+	}
+	fprintf(out, "total(tps=%" PRIu64 " (hit=%" PRIu64 " miss=%" PRIu64 ") "
+			"timeouts=%" PRIu64 " errors=%" PRIu64 ")\n",
+			write_tps + read_hit_tps + read_miss_tps + udf_tps,
+			write_tps + read_hit_tps + udf_tps, read_miss_tps,
+			write->timeouts + read->timeouts + udf->timeouts,
+			write->errors + read->errors + udf->errors);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER int
+_open_files(interval_log_t* log, const char* dir, const char* name,
+		const char* header, uint64_t start_us)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s%s", dir, name, hdr_log_suffix);
+	log->hdr_out = fopen(path, "w");
+	if (log->hdr_out == NULL) {
+		blog_error("Unable to open interval log \"%s\": %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s%s", dir, name, counts_suffix);
+	log->counts_out = fopen(path, "w");
+	if (log->counts_out == NULL) {
+		blog_error("Unable to open interval log \"%s\": %s\n", path,
+				strerror(errno));
+		fclose(log->hdr_out);
+		return -1;
+	}
+
+	hdr_timespec start;
+	_to_timespec(&start, start_us);
+
+	hdr_log_writer_init(&log->writer);
+	hdr_log_write_header(&log->writer, log->hdr_out, header, &start);
+
+	fprintf(log->counts_out, "#[%s]\n", header);
+	fprintf(log->counts_out,
+			"start,interval,op,ok,miss,timeouts,errors,bytes\n");
+	return 0;
+}
+
+LOCAL_HELPER void
+_close_files(interval_log_t* log)
+{
+	fclose(log->hdr_out);
+	fclose(log->counts_out);
+}
+
+/*
+ * sets interval to what was recorded in cur since prev, and brings prev up
+ * to date. Other threads may be recording into cur, so each count is read
+ * once
+ */
+LOCAL_HELPER void
+_take_interval(struct hdr_histogram* cur, struct hdr_histogram* prev,
+		struct hdr_histogram* interval)
+{
+	for (int32_t i = 0; i < cur->counts_len; i++) {
+		int64_t count = __atomic_load_n(&cur->counts[i], __ATOMIC_RELAXED);
+
+		interval->counts[i] = count - prev->counts[i];
+		prev->counts[i] = count;
+	}
+	hdr_reset_internal_counters(interval);
+}
+
+LOCAL_HELPER void
+_write_entry(interval_log_t* log, group_op_t op, uint64_t begin_us,
+		uint64_t end_us, struct hdr_histogram* h,
+		const struct interval_counts_s* counts)
+{
+	const char* op_str = interval_op_strs[op];
+
+	// intervals with no latencies are left out of the HDR log, their counts
+	// still say what happened
+	if (h != NULL && hdr_total_count(h) != 0) {
+		struct hdr_log_entry entry;
+
+		_to_timespec(&entry.start_timestamp, begin_us);
+		_to_timespec(&entry.interval, end_us - begin_us);
+		entry.tag = (char*) op_str;
+		entry.tag_len = strlen(op_str);
+		hdr_log_write_entry(&log->writer, log->hdr_out, &entry, h);
+	}
+
+	fprintf(log->counts_out, "%.3f,%.3f,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64
+			",%" PRIu64 ",%" PRIu64 "\n",
+			begin_us / 1000000., (end_us - begin_us) / 1000000., op_str,
+			counts->ok, counts->miss, counts->timeouts, counts->errors,
+			counts->bytes);
+}
+
+LOCAL_HELPER void
+_to_timespec(hdr_timespec* ts, uint64_t us)
+{
+	ts->tv_sec = us / 1000000;
+	ts->tv_nsec = (us % 1000000) * 1000;
+}
+
+LOCAL_HELPER int
+_op_from_str(const char* str)
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (strcmp(str, interval_op_strs[op]) == 0) {
+			return (int) op;
+		}
+	}
+	return -1;
+}
+
+LOCAL_HELPER bool
+_has_suffix(const char* str, const char* suffix)
+{
+	size_t len = strlen(str);
+	size_t suffix_len = strlen(suffix);
+
+	return len > suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+/*
+ * merges the log at path, or every log in it if it's a directory
+ */
+LOCAL_HELPER int
+_merge_path(merge_t* m, const char* path)
+{
+	struct stat st;
+
+	if (stat(path, &st) != 0) {
+		blog_error("Unable to open \"%s\": %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		return _merge_log(m, path);
+	}
+
+	DIR* dir = opendir(path);
+	if (dir == NULL) {
+		blog_error("Unable to open \"%s\": %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct dirent* ent;
+	int ret = 0;
+
+	while (ret == 0 && (ent = readdir(dir)) != NULL) {
+		if (_has_suffix(ent->d_name, hdr_log_suffix)) {
+			char log_path[PATH_MAX];
+
+			snprintf(log_path, sizeof(log_path), "%s/%s", path, ent->d_name);
+			ret = _merge_log(m, log_path);
+		}
+	}
+	closedir(dir);
+	return ret;
+}
+
+/*
+ * adds the intervals of the HDR log at path, and of the counts file next to
+ * it, to the periods they began in
+ */
+LOCAL_HELPER int
+_merge_log(merge_t* m, const char* path)
+{
+	if (!_has_suffix(path, hdr_log_suffix)) {
+		blog_error("\"%s\" is not an interval log (%s)\n", path,
+				hdr_log_suffix);
+		return -1;
+	}
+
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		blog_error("Unable to open interval log \"%s\": %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+
+	struct hdr_log_reader reader;
+	hdr_log_reader_init(&reader);
+
+	int rc = hdr_log_read_header(&reader, f);
+	if (rc != 0) {
+		blog_error("\"%s\" is not an HDR log: %s\n", path, hdr_strerror(rc));
+		fclose(f);
+		return -1;
+	}
+
+	int ret = 0;
+
+	while (ret == 0) {
+		char tag[16] = "";
+		struct hdr_log_entry entry;
+		struct hdr_histogram* h = NULL;
+
+		memset(&entry, 0, sizeof(entry));
+		entry.tag = tag;
+		entry.tag_len = sizeof(tag) - 1;
+
+		rc = hdr_log_read_entry(&reader, f, &entry, &h);
+		if (rc == EOF) {
+			break;
+		}
+		if (rc != 0) {
+			blog_error("Unable to read \"%s\": %s\n", path, hdr_strerror(rc));
+			ret = -1;
+			break;
+		}
+
+		int op = _op_from_str(tag);
+		if (op < 0) {
+			blog_error("Interval with unknown op \"%s\" in \"%s\"\n", tag,
+					path);
+			ret = -1;
+		}
+		else {
+			struct merge_period_s* period = _get_period(m,
+					(uint64_t) entry.start_timestamp.tv_sec);
+
+			if (period->hdrs[op] == NULL) {
+				hdr_init(1, 1000000, 3, &period->hdrs[op]);
+			}
+			hdr_add(period->hdrs[op], h);
+			m->has_op[op] = true;
+		}
+		hdr_close(h);
+	}
+	fclose(f);
+
+	if (ret == 0) {
+		char counts_path[PATH_MAX];
+		size_t base_len = strlen(path) - (sizeof(hdr_log_suffix) - 1);
+
+		snprintf(counts_path, sizeof(counts_path), "%.*s%s", (int) base_len,
+				path, counts_suffix);
+		ret = _merge_counts(m, counts_path);
+	}
+
+	if (ret == 0) {
+		m->n_logs++;
+	}
+	return ret;
+}
+
+LOCAL_HELPER int
+_merge_counts(merge_t* m, const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		blog_error("Unable to open interval counts \"%s\": %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+
+	char line[256];
+	int ret = 0;
+
+	while (ret == 0 && fgets(line, sizeof(line), f) != NULL) {
+		double start;
+		double interval;
+		char op_str[16];
+		struct interval_counts_s counts;
+
+		// skip the header
+		if (line[0] < '0' || line[0] > '9') {
+			continue;
+		}
+
+		if (sscanf(line, "%lf,%lf,%15[^,],%" SCNu64 ",%" SCNu64 ",%" SCNu64
+					",%" SCNu64 ",%" SCNu64,
+					&start, &interval, op_str, &counts.ok, &counts.miss,
+					&counts.timeouts, &counts.errors, &counts.bytes) != 8) {
+			line[strcspn(line, "\n")] = '\0';
+			blog_error("Malformed line in \"%s\": %s\n", path, line);
+			ret = -1;
+			break;
+		}
+
+		int op = _op_from_str(op_str);
+		if (op < 0) {
+			blog_error("Interval with unknown op \"%s\" in \"%s\"\n", op_str,
+					path);
+			ret = -1;
+			break;
+		}
+
+		struct merge_period_s* period = _get_period(m, (uint64_t) start);
+		_add_counts(&period->counts[op], &counts);
+		m->has_op[op] = true;
+	}
+	fclose(f);
+	return ret;
+}
+
+/*
+ * finds the period beginning at start_s, adding it if it's new
+ */
+LOCAL_HELPER struct merge_period_s*
+_get_period(merge_t* m, uint64_t start_s)
+{
+	uint32_t lo = 0;
+	uint32_t hi = m->n_periods;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (m->periods[mid].start_s < start_s) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	if (lo < m->n_periods && m->periods[lo].start_s == start_s) {
+		return &m->periods[lo];
+	}
+
+	if (m->n_periods == m->capacity) {
+		m->capacity = m->capacity == 0 ? 64 : m->capacity * 2;
+		m->periods = (struct merge_period_s*) cf_realloc(m->periods,
+				m->capacity * sizeof(struct merge_period_s));
+	}
+
+	struct merge_period_s* period = &m->periods[lo];
+
+	memmove(period + 1, period, (m->n_periods - lo) * sizeof(*period));
+	m->n_periods++;
+
+	memset(period, 0, sizeof(*period));
+	period->start_s = start_s;
+	return period;
+}
+
+LOCAL_HELPER void
+_add_counts(struct interval_counts_s* to, const struct interval_counts_s* from)
+{
+	to->ok += from->ok;
+	to->miss += from->miss;
+	to->timeouts += from->timeouts;
+	to->errors += from->errors;
+	to->bytes += from->bytes;
+}
+
+/*
+ * prints every period, then the whole run, in the format of the periodic
+ * output and --latency
+ */
+LOCAL_HELPER void
+_print_merged(merge_t* m, as_vector* percentiles, FILE* out)
+{
+	struct hdr_histogram* totals[GROUP_OP_COUNT] = { NULL };
+	struct interval_counts_s total_counts[GROUP_OP_COUNT];
+	uint64_t first_s = m->periods[0].start_s;
+	uint64_t last_s = m->periods[m->n_periods - 1].start_s;
+
+	memset(total_counts, 0, sizeof(total_counts));
+
+	fprintf(out, "Merged %u interval logs over %" PRIu64 " seconds\n",
+			m->n_logs, last_s - first_s + 1);
+
+	for (uint32_t i = 0; i < m->n_periods; i++) {
+		struct merge_period_s* period = &m->periods[i];
+		uint64_t elapsed_s = period->start_s - first_s + 1;
+
+		_print_merged_counts(out, period->start_s, period->counts, m->has_op,
+				INTERVAL_LOG_PERIOD_US);
+
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			_add_counts(&total_counts[op], &period->counts[op]);
+
+			if (period->hdrs[op] == NULL) {
+				continue;
+			}
+			_print_percentiles(out, interval_op_strs[op], period->start_s,
+					elapsed_s, period->hdrs[op], percentiles);
+
+			if (totals[op] == NULL) {
+				hdr_init(1, 1000000, 3, &totals[op]);
+			}
+			hdr_add(totals[op], period->hdrs[op]);
+		}
+	}
+
+	fprintf(out, "Total:\n");
+	_print_merged_counts(out, last_s, total_counts, m->has_op,
+			(last_s - first_s + 1) * INTERVAL_LOG_PERIOD_US);
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (totals[op] != NULL) {
+			_print_percentiles(out, interval_op_strs[op], last_s,
+					last_s - first_s + 1, totals[op], percentiles);
+			hdr_close(totals[op]);
+		}
+	}
+}
+
+LOCAL_HELPER void
+_print_merged_counts(FILE* out, uint64_t time_s,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const bool has_op[GROUP_OP_COUNT], uint64_t elapsed_us)
+{
+	fprintf(out, "%s ", utc_time_str((time_t) time_s));
+	interval_log_print_counts(out, counts, has_op, elapsed_us, NULL);
+}
+
+/*
+ * the same line as print_hdr_percentiles, for the time of the period rather
+ * than the current time
+ */
+LOCAL_HELPER void
+_print_percentiles(FILE* out, const char* name, uint64_t time_s,
+		uint64_t elapsed_s, struct hdr_histogram* h, as_vector* percentiles)
+{
+	int64_t total_cnt = hdr_total_count(h);
+
+	fprintf(out, "hdr: %-5s %.24s %" PRIu64 ", %" PRId64 ", %" PRId64
+			", %" PRId64,
+			name, utc_time_str((time_t) time_s), elapsed_s, total_cnt,
+			total_cnt == 0 ? 0 : hdr_min(h), hdr_max(h));
+	for (uint32_t i = 0; i < percentiles->size; i++) {
+		double p = *(double*) as_vector_get(percentiles, i);
+		fprintf(out, ", %" PRId64, hdr_value_at_percentile(h, p));
+	}
+	fprintf(out, "\n");
+}
+
+/*
+ * writes the merged periods as an interval log of their own, which can be
+ * merged again
+ */
+LOCAL_HELPER int
+_write_merged(merge_t* m, const char* out_dir)
+{
+	interval_log_t log;
+	uint64_t first_s = m->periods[0].start_s;
+	char name[64];
+	char header[64];
+
+	snprintf(name, sizeof(name), "merged_%s", utc_time_str((time_t) first_s));
+	snprintf(header, sizeof(header), "asbench merge of %u interval logs",
+			m->n_logs);
+
+	if (_open_files(&log, out_dir, name, header, first_s * 1000000) != 0) {
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < m->n_periods; i++) {
+		struct merge_period_s* period = &m->periods[i];
+		uint64_t begin_us = period->start_s * 1000000;
+
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			if (m->has_op[op]) {
+				_write_entry(&log, op, begin_us,
+						begin_us + INTERVAL_LOG_PERIOD_US, period->hdrs[op],
+						&period->counts[op]);
+			}
+		}
+	}
+
+	_close_files(&log);
+	return 0;
+}
+
+LOCAL_HELPER void
+_merge_free(merge_t* m)
+{
+	for (uint32_t i = 0; i < m->n_periods; i++) {
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			if (m->periods[i].hdrs[op] != NULL) {
+				hdr_close(m->periods[i].hdrs[op]);
+			}
+		}
+	}
+	cf_free(m->periods);
+}
+
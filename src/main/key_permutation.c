@@ -0,0 +1,87 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <common.h>
+#include <key_permutation.h>
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER uint64_t _mix(uint64_t x);
+LOCAL_HELPER uint64_t _feistel(const key_perm_t* perm, uint64_t x);
+
+
+//==========================================================
+// Public API.
+//
+
+void
+key_perm_init(key_perm_t* perm, uint64_t n, uint64_t seed)
+{
+	// the smallest even number of bits that can represent n - 1, so the
+	// Feistel domain is never more than 4x the size of the range
+	uint32_t bits = n > 1 ? 64 - __builtin_clzll(n - 1) : 0;
+	uint32_t half_bits = MAX((bits + 1) / 2, 1);
+
+	perm->n = n;
+	perm->half_bits = half_bits;
+	perm->half_mask = (1LU << half_bits) - 1;
+
+	for (uint32_t i = 0; i < KEY_PERM_ROUNDS; i++) {
+		seed = _mix(seed + i);
+		perm->round_keys[i] = seed;
+	}
+}
+
+uint64_t
+key_perm_apply(const key_perm_t* perm, uint64_t idx)
+{
+	if (idx >= perm->n) {
+		return idx;
+	}
+
+	// cycle walk: the Feistel network permutes the whole power-of-two domain,
+	// so keep applying it until the result lands back inside [0, n). Since
+	// idx started inside the range this always terminates, and it stays a
+	// bijection on [0, n)
+	do {
+		idx = _feistel(perm, idx);
+	} while (idx >= perm->n);
+
+	return idx;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * the splitmix64 finalizer
+ */
+LOCAL_HELPER uint64_t
+_mix(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9LU;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebLU;
+	return x ^ (x >> 31);
+}
+
+LOCAL_HELPER uint64_t
+_feistel(const key_perm_t* perm, uint64_t x)
+{
+	uint64_t l = x >> perm->half_bits;
+	uint64_t r = x & perm->half_mask;
+
+	for (uint32_t i = 0; i < KEY_PERM_ROUNDS; i++) {
+		uint64_t tmp = r;
+		r = l ^ (_mix(r ^ perm->round_keys[i]) & perm->half_mask);
+		l = tmp;
+	}
+	return (l << perm->half_bits) | r;
+}
+
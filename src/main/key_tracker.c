@@ -0,0 +1,261 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <key_tracker.h>
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER uint64_t _next_unit(uint64_t pos, uint64_t end,
+		uint64_t max_len);
+LOCAL_HELPER uint64_t _unit_count(const key_tracker_t* kt, uint64_t pos,
+		uint64_t len, bool live);
+LOCAL_HELPER uint64_t _count_range(const key_tracker_t* kt, uint64_t begin,
+		uint64_t end, bool live);
+LOCAL_HELPER bool _select_range(const key_tracker_t* kt, uint64_t begin,
+		uint64_t end, bool live, uint64_t rank, uint64_t* idx);
+
+
+//==========================================================
+// Public API.
+//
+
+void
+key_tracker_init(key_tracker_t* kt, uint64_t key_start, uint64_t n_keys)
+{
+	uint64_t n_words = (n_keys + 63) / 64;
+	uint64_t n_blocks =
+		(n_keys + KEY_TRACKER_BLOCK_KEYS - 1) / KEY_TRACKER_BLOCK_KEYS;
+	uint64_t n_supers =
+		(n_keys + KEY_TRACKER_SUPER_KEYS - 1) / KEY_TRACKER_SUPER_KEYS;
+
+	kt->key_start = key_start;
+	kt->n_keys = n_keys;
+	kt->words = (_Atomic(uint64_t)*) cf_calloc(n_words, sizeof(uint64_t));
+	kt->block_live =
+		(_Atomic(uint32_t)*) cf_calloc(n_blocks, sizeof(uint32_t));
+	kt->super_live =
+		(_Atomic(uint32_t)*) cf_calloc(n_supers, sizeof(uint32_t));
+	atomic_init(&kt->n_live, 0);
+}
+
+void
+key_tracker_free(key_tracker_t* kt)
+{
+	cf_free(kt->words);
+	cf_free(kt->block_live);
+	cf_free(kt->super_live);
+}
+
+void
+key_tracker_set_live(key_tracker_t* kt, uint64_t key, bool live)
+{
+	uint64_t idx = key - kt->key_start;
+	if (idx >= kt->n_keys) {
+		return;
+	}
+
+	uint64_t bit = 1LU << (idx % 64);
+	_Atomic(uint64_t)* word = &kt->words[idx / 64];
+	_Atomic(uint32_t)* block = &kt->block_live[idx / KEY_TRACKER_BLOCK_KEYS];
+	_Atomic(uint32_t)* super = &kt->super_live[idx / KEY_TRACKER_SUPER_KEYS];
+
+	// only adjust the counts if this call is the one that flipped the bit
+	if (live) {
+		if ((atomic_fetch_or(word, bit) & bit) == 0) {
+			atomic_fetch_add_explicit(block, 1, memory_order_relaxed);
+			atomic_fetch_add_explicit(super, 1, memory_order_relaxed);
+			kt->n_live++;
+		}
+	}
+	else {
+		if ((atomic_fetch_and(word, ~bit) & bit) != 0) {
+			atomic_fetch_sub_explicit(block, 1, memory_order_relaxed);
+			atomic_fetch_sub_explicit(super, 1, memory_order_relaxed);
+			kt->n_live--;
+		}
+	}
+}
+
+bool
+key_tracker_is_live(const key_tracker_t* kt, uint64_t key)
+{
+	uint64_t idx = key - kt->key_start;
+	if (idx >= kt->n_keys) {
+		return false;
+	}
+	return (atomic_load_explicit(&kt->words[idx / 64], memory_order_relaxed) &
+			(1LU << (idx % 64))) != 0;
+}
+
+bool
+key_tracker_pick(const key_tracker_t* kt, as_random* random,
+		uint64_t key_start, uint64_t key_end, bool live, uint64_t* key)
+{
+	// nothing to look for if every key is in the other state
+	uint64_t n_live = atomic_load(&kt->n_live);
+	if (live ? n_live == 0 : n_live == kt->n_keys) {
+		return false;
+	}
+
+	// clamp to the tracked range, keys outside it are never live
+	key_start = MAX(key_start, kt->key_start);
+	key_end = MIN(key_end, kt->key_start + kt->n_keys);
+	if (key_start >= key_end) {
+		return false;
+	}
+
+	uint64_t n_keys = key_end - key_start;
+	for (uint32_t i = 0; i < KEY_TRACKER_MAX_TRIES; i++) {
+		uint64_t k = key_start + gen_rand_range_64(random, n_keys);
+		if (key_tracker_is_live(kt, k) == live) {
+			*key = k;
+			return true;
+		}
+	}
+
+	// keys in the wanted state are sparse, so count them and select one of
+	// them uniformly by its rank
+	uint64_t lo = key_start - kt->key_start;
+	uint64_t hi = key_end - kt->key_start;
+	uint64_t n_wanted = _count_range(kt, lo, hi, live);
+	uint64_t idx;
+
+	if (n_wanted != 0 && _select_range(kt, lo, hi, live,
+			gen_rand_range_64(random, n_wanted), &idx)) {
+		*key = kt->key_start + idx;
+		return true;
+	}
+	return false;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * the length of the largest unit of the bitmap starting at pos and ending by
+ * end, no longer than max_len: a superblock, a block, or else the rest of the
+ * word pos is in
+ */
+LOCAL_HELPER uint64_t
+_next_unit(uint64_t pos, uint64_t end, uint64_t max_len)
+{
+	if (max_len >= KEY_TRACKER_SUPER_KEYS &&
+			pos % KEY_TRACKER_SUPER_KEYS == 0 &&
+			end - pos >= KEY_TRACKER_SUPER_KEYS) {
+		return KEY_TRACKER_SUPER_KEYS;
+	}
+	if (max_len >= KEY_TRACKER_BLOCK_KEYS &&
+			pos % KEY_TRACKER_BLOCK_KEYS == 0 &&
+			end - pos >= KEY_TRACKER_BLOCK_KEYS) {
+		return KEY_TRACKER_BLOCK_KEYS;
+	}
+	return MIN(64 - pos % 64, end - pos);
+}
+
+/*
+ * the number of keys in the state live in a unit returned by _next_unit
+ */
+LOCAL_HELPER uint64_t
+_unit_count(const key_tracker_t* kt, uint64_t pos, uint64_t len, bool live)
+{
+	uint64_t n;
+
+	if (len == KEY_TRACKER_SUPER_KEYS) {
+		n = atomic_load_explicit(&kt->super_live[pos / KEY_TRACKER_SUPER_KEYS],
+				memory_order_relaxed);
+	}
+	else if (len == KEY_TRACKER_BLOCK_KEYS) {
+		n = atomic_load_explicit(&kt->block_live[pos / KEY_TRACKER_BLOCK_KEYS],
+				memory_order_relaxed);
+	}
+	else {
+		uint64_t w = atomic_load_explicit(&kt->words[pos / 64],
+				memory_order_relaxed) >> (pos % 64);
+		if (len < 64) {
+			w &= (1LU << len) - 1;
+		}
+		n = (uint64_t) __builtin_popcountll(w);
+	}
+
+	// a block or superblock can't hold more live keys than it has, but its
+	// count may lag behind the bitmap
+	n = MIN(n, len);
+	return live ? n : len - n;
+}
+
+/*
+ * the number of keys in [begin, end) in the state live
+ */
+LOCAL_HELPER uint64_t
+_count_range(const key_tracker_t* kt, uint64_t begin, uint64_t end, bool live)
+{
+	uint64_t n = 0;
+
+	for (uint64_t pos = begin; pos < end; ) {
+		uint64_t len = _next_unit(pos, end, KEY_TRACKER_SUPER_KEYS);
+		n += _unit_count(kt, pos, len, live);
+		pos += len;
+	}
+	return n;
+}
+
+/*
+ * finds the bit index of the key of the given rank among the keys in
+ * [begin, end) in the state live, skipping whole superblocks and blocks by
+ * their counts and descending into the one the key is in
+ */
+LOCAL_HELPER bool
+_select_range(const key_tracker_t* kt, uint64_t begin, uint64_t end, bool live,
+		uint64_t rank, uint64_t* idx)
+{
+	uint64_t max_len = KEY_TRACKER_SUPER_KEYS;
+	uint64_t pos = begin;
+
+	while (pos < end) {
+		uint64_t len = _next_unit(pos, end, max_len);
+		uint64_t n = _unit_count(kt, pos, len, live);
+
+		if (rank >= n) {
+			rank -= n;
+			pos += len;
+			continue;
+		}
+
+		if (len <= 64) {
+			uint64_t w = atomic_load_explicit(&kt->words[pos / 64],
+					memory_order_relaxed) >> (pos % 64);
+			if (!live) {
+				w = ~w;
+			}
+			if (len < 64) {
+				w &= (1LU << len) - 1;
+			}
+
+			// drop the keys of lower rank, the bit may have been flipped since
+			// it was counted
+			for (; rank != 0 && w != 0; rank--) {
+				w &= w - 1;
+			}
+			if (w == 0) {
+				return false;
+			}
+			*idx = pos + (uint64_t) __builtin_ctzll(w);
+			return true;
+		}
+
+		// the key is in this unit, look through its blocks or words
+		end = pos + len;
+		max_len = len / 64;
+	}
+	return false;
+}
@@ -18,6 +18,17 @@
 #include <transaction.h>
 
 
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER bool _any_counts(
+		const struct interval_counts_s counts[GROUP_OP_COUNT]);
+LOCAL_HELPER void _print_counts(tdata_t* tdata,
+		const struct interval_counts_s counts[GROUP_OP_COUNT], int64_t elapsed);
+LOCAL_HELPER void* _publish_worker(tdata_t* tdata);
+
+
 //==========================================================
 // Public API.
 //
@@ -215,7 +226,15 @@ initialize_histograms(cdata_t* cdata, args_t* args, time_t* start_time,
 		hdr_gettime(start_timespec);
 	}
 
-	if (args->latency || args->hdr_output) {
+	if (cdata->proc_stats != NULL) {
+		// recorded straight to shared memory, where the parent reads them
+		proc_slot_t* slot = proc_stats_slot(cdata->proc_stats, cdata->proc_idx);
+
+		cdata->write_hdr = slot->hdrs[GROUP_OP_WRITE];
+		cdata->read_hdr = slot->hdrs[GROUP_OP_READ];
+		cdata->udf_hdr = slot->hdrs[GROUP_OP_UDF];
+	}
+	else if (args->latency || args->hdr_output) {
 		if (has_writes) {
 			hdr_init(1, 1000000, 3, &cdata->write_hdr);
 		}
@@ -226,6 +245,29 @@ initialize_histograms(cdata_t* cdata, args_t* args, time_t* start_time,
 			hdr_init(1, 1000000, 3, &cdata->udf_hdr);
 		}
 	}
+
+	if (args->latency_corrected) {
+		if (has_writes) {
+			hdr_init(1, 1000000, 3, &cdata->write_corrected_hdr);
+		}
+		if (has_reads) {
+			hdr_init(1, 1000000, 3, &cdata->read_corrected_hdr);
+		}
+		if (has_udfs) {
+			hdr_init(1, 1000000, 3, &cdata->udf_corrected_hdr);
+		}
+	}
+
+	// instances of a split run log each interval so their latencies can be
+	// merged afterwards
+	if (args->hdr_output && args->instance_count > 1) {
+		cdata->interval_log = interval_log_create(args->hdr_output,
+				(uint32_t) args->instance_id, (uint32_t) args->instance_count,
+				*start_time);
+		if (cdata->interval_log == NULL) {
+			ret = -1;
+		}
+	}
 	return ret;
 }
 
@@ -285,7 +327,8 @@ free_histograms(cdata_t* cdata, args_t* args)
 		}
 	}
 
-	if (args->latency || args->hdr_output) {
+	// the histograms of a worker process belong to the shared memory
+	if ((args->latency || args->hdr_output) && cdata->proc_stats == NULL) {
 		if (has_writes) {
 			hdr_close(cdata->write_hdr);
 		}
@@ -296,6 +339,22 @@ free_histograms(cdata_t* cdata, args_t* args)
 			hdr_close(cdata->udf_hdr);
 		}
 	}
+
+	if (args->latency_corrected) {
+		if (has_writes) {
+			hdr_close(cdata->write_corrected_hdr);
+		}
+		if (has_reads) {
+			hdr_close(cdata->read_corrected_hdr);
+		}
+		if (has_udfs) {
+			hdr_close(cdata->udf_corrected_hdr);
+		}
+	}
+
+	if (cdata->interval_log != NULL) {
+		interval_log_free(cdata->interval_log);
+	}
 }
 
 void
@@ -358,6 +417,11 @@ periodic_output_worker(void* udata)
 	cdata_t* cdata = tdata->cdata;
 	thr_coord_t* coord = tdata->coord;
 
+	// a worker process leaves the output to the parent
+	if (cdata->proc_stats != NULL) {
+		return _publish_worker(tdata);
+	}
+
 	bool latency = cdata->latency;
 	bool has_writes = stages_contain_writes(&cdata->stages);
 	bool has_reads = stages_contain_reads(&cdata->stages);
@@ -377,6 +441,11 @@ periodic_output_worker(void* udata)
 	uint64_t prev_time_hist = start_time;
 	uint64_t pause_us;
 
+	// when set, wake-ups land on the period boundaries of the wall clock so
+	// every instance's intervals line up
+	interval_log_t* interval_log = cdata->interval_log;
+	uint64_t boundary_us = 0;
+
 	// first indicate that this thread has no required work to do
 	thr_coordinator_complete(coord);
 
@@ -387,16 +456,21 @@ periodic_output_worker(void* udata)
 	// stage and move onto the next one, but we want the logger to still print
 	// out the last bit of latency data before moving onto the next stage, so
 	// we always check the status at the beginning of the loop and update it
-	// right after that
+	// right after that. the last stage ends with finished already set, so the
+	// loop keeps going until its last report is out
 	int status;
 
 	// set to true when this is the first time logging latency data for the
 	// current stage
 	bool first_log_of_stage = true;
 
+	if (interval_log != NULL) {
+		interval_log_restart(interval_log, interval_log_now());
+	}
+
 	goto do_sleep;
 
-	while (!tdata->finished) {
+	while (!tdata->finished || status == COORD_SLEEP_INTERRUPTED) {
 
 		clock_gettime(COORD_CLOCK, &wake_up);
 		time = timespec_to_us(&wake_up);
@@ -419,54 +493,83 @@ periodic_output_worker(void* udata)
 			elapsed = 1000000;
 		}
 
-		uint64_t write_current = atomic_exchange(&cdata->write_count, 0);
-		uint64_t write_timeout_current = atomic_exchange(&cdata->write_timeout_count, 0);
-		uint64_t write_error_current = atomic_exchange(&cdata->write_error_count, 0);
-		uint64_t read_hit_current = atomic_exchange(&cdata->read_hit_count, 0);
-		uint64_t read_miss_current = atomic_exchange(&cdata->read_miss_count, 0);
-		uint64_t read_timeout_current = atomic_exchange(&cdata->read_timeout_count, 0);
-		uint64_t read_error_current = atomic_exchange(&cdata->read_error_count, 0);
-		uint64_t udf_current = atomic_exchange(&cdata->udf_count, 0);
-		uint64_t udf_timeout_current = atomic_exchange(&cdata->udf_timeout_count, 0);
-		uint64_t udf_error_current = atomic_exchange(&cdata->udf_error_count, 0);
+		const struct interval_counts_s counts[GROUP_OP_COUNT] = {
+			[GROUP_OP_READ] = {
+				.ok = atomic_exchange(&cdata->read_hit_count, 0),
+				.miss = atomic_exchange(&cdata->read_miss_count, 0),
+				.timeouts = atomic_exchange(&cdata->read_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->read_error_count, 0)
+			},
+			[GROUP_OP_WRITE] = {
+				.ok = atomic_exchange(&cdata->write_count, 0),
+				.timeouts = atomic_exchange(&cdata->write_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->write_error_count, 0),
+				.bytes = atomic_exchange(&cdata->write_bytes, 0)
+			},
+			[GROUP_OP_UDF] = {
+				.ok = atomic_exchange(&cdata->udf_count, 0),
+				.timeouts = atomic_exchange(&cdata->udf_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->udf_error_count, 0)
+			}
+		};
+
+		// what finished while the stage warmed up was counted apart, so a
+		// period the warmup ends in prints a line for each side of it
+		struct interval_counts_s warmup_counts[GROUP_OP_COUNT];
+		warmup_stats_take_period(cdata->warmup_stats, warmup_counts);
 
 		cdata->period_begin = time;
 
-		uint64_t write_tps = (uint64_t)((double)write_current * 1000000 / elapsed + 0.5);
-		uint64_t read_hit_tps = (uint64_t)((double)read_hit_current * 1000000 / elapsed + 0.5);
-		uint64_t read_miss_tps = (uint64_t)((double)read_miss_current * 1000000 / elapsed + 0.5);
-		uint64_t udf_tps = (uint64_t)((double)udf_current * 1000000 / elapsed + 0.5);
-
-		bool any_records = write_current + write_timeout_current +
-			write_error_current + read_hit_current + read_miss_current +
-			read_timeout_current + read_error_current + udf_current +
-			udf_timeout_current + udf_error_current != 0;
-		if (any_records) {
-			blog_info("");
-			if (has_writes) {
-				printf("write(tps=%" PRId64 " (hit=%" PRId64 " miss=%lu) "
-						"timeouts=%" PRId64 " errors=%" PRId64 ") ",
-						write_tps, write_tps, 0lu,
-						write_timeout_current, write_error_current);
+		if (interval_log != NULL) {
+			// a stage cut short ends its interval early
+			uint64_t end_us = status == COORD_SLEEP_INTERRUPTED ?
+				interval_log_now() : boundary_us;
+
+			if (warmup_stats_active(cdata->warmup_stats)) {
+				interval_log_restart(interval_log, end_us);
+			}
+			else {
+				struct hdr_histogram* const hdrs[GROUP_OP_COUNT] = {
+					[GROUP_OP_READ] = has_reads ? cdata->read_hdr : NULL,
+					[GROUP_OP_WRITE] = has_writes ? cdata->write_hdr : NULL,
+					[GROUP_OP_UDF] = has_udfs ? cdata->udf_hdr : NULL
+				};
+				interval_log_write(interval_log, end_us, hdrs, counts);
 			}
-			if (has_reads) {
-				printf("read(tps=%" PRId64 " (hit=%" PRId64 " miss=%" PRId64 ") "
-						"timeouts=%" PRId64 " errors=%" PRId64 ") ",
-						read_hit_tps + read_miss_tps, read_hit_tps, read_miss_tps,
-						read_timeout_current, read_error_current);
+		}
+
+		bool any_records = _any_counts(counts);
+		bool any_warmup = _any_counts(warmup_counts);
+		if (any_records || any_warmup) {
+			if (any_warmup) {
+				blog_info("");
+				printf("warmup ");
+				_print_counts(tdata, warmup_counts, elapsed);
 			}
-			if (has_udfs) {
-				printf("udf(tps=%" PRId64 " (hit=%" PRId64 " miss=%lu) "
-						"timeouts=%" PRId64 " errors=%" PRId64 ") ",
-						udf_tps, udf_tps, 0lu,
-						udf_timeout_current, udf_error_current);
+			if (any_records) {
+				blog_info("");
+				_print_counts(tdata, counts, elapsed);
+			}
+
+			if (cdata->group_stats != NULL) {
+				group_stats_print_period(cdata->group_stats, &cdata->stages,
+						tdata->stage_idx, elapsed);
+			}
+			error_stats_print_period(cdata->error_stats);
+			if (cdata->node_stats != NULL) {
+				node_stats_print_period(cdata->node_stats, elapsed);
+			}
+			if (cdata->perf_counters != NULL) {
+				perf_counters_print_period(cdata->perf_counters);
 			}
-			printf("total(tps=%" PRId64 " (hit=%" PRId64 " miss=%" PRId64 ") "
-					"timeouts=%" PRId64 " errors=%" PRId64 ")\n",
-					write_tps + read_hit_tps + read_miss_tps + udf_tps,
-					write_tps + read_hit_tps + udf_tps, read_miss_tps,
-					write_timeout_current + read_timeout_current + udf_timeout_current,
-					write_error_current + read_error_current + udf_error_current);
+		}
+
+		if (cdata->slow_ops != NULL) {
+			slow_ops_dump(cdata->slow_ops,
+					cdata->stages.stages[tdata->stage_idx].group);
+		}
+		if (cdata->self_stats != NULL) {
+			self_stats_print_period(cdata->self_stats);
 		}
 
 		++gen_count;
@@ -484,16 +587,37 @@ periodic_output_worker(void* udata)
 					if (has_writes) {
 						print_hdr_percentiles(cdata->write_hdr, "write", elapsed_s,
 								&cdata->latency_percentiles, stdout);
+						if (cdata->latency_corrected) {
+							print_hdr_percentiles(cdata->write_corrected_hdr,
+									"write-corrected", elapsed_s,
+									&cdata->latency_percentiles, stdout);
+						}
 					}
 
 					if (has_reads) {
 						print_hdr_percentiles(cdata->read_hdr,  "read",  elapsed_s,
 								&cdata->latency_percentiles, stdout);
+						if (cdata->latency_corrected) {
+							print_hdr_percentiles(cdata->read_corrected_hdr,
+									"read-corrected", elapsed_s,
+									&cdata->latency_percentiles, stdout);
+						}
 					}
 
 					if (has_udfs) {
 						print_hdr_percentiles(cdata->udf_hdr,  "udf",  elapsed_s,
 								&cdata->latency_percentiles, stdout);
+						if (cdata->latency_corrected) {
+							print_hdr_percentiles(cdata->udf_corrected_hdr,
+									"udf-corrected", elapsed_s,
+									&cdata->latency_percentiles, stdout);
+						}
+					}
+
+					if (cdata->group_stats != NULL) {
+						group_stats_print_latency(cdata->group_stats,
+								&cdata->stages, tdata->stage_idx, elapsed_s,
+								&cdata->latency_percentiles, stdout);
 					}
 				}
 				if (histogram_output != NULL) {
@@ -523,7 +647,7 @@ periodic_output_worker(void* udata)
 		}
 
 		if (status == COORD_SLEEP_INTERRUPTED) {
-			thr_coordinator_wait(coord);
+			thr_coordinator_wait(coord, tdata);
 
 			// check to make sure we're not finished before resetting everything
 			if (!tdata->finished) {
@@ -533,8 +657,8 @@ periodic_output_worker(void* udata)
 				status = COORD_SLEEP_TIMEOUT;
 
 				// and lastly set the throttler to think it was called one
-				// second ago (since we don't want the time spent at the
-				// synchronization barrier to mess with it)
+				// second ago (since we don't want the time spent waiting for
+				// the next stage to mess with it)
 				clock_gettime(COORD_CLOCK, &wake_up);
 				time = timespec_to_us(&wake_up);
 				dyn_throttle_reset_time(&tdata->dyn_throttle, time);
@@ -542,6 +666,11 @@ periodic_output_worker(void* udata)
 				prev_time = time;
 				prev_time_hist = time;
 				gen_count = 0;
+
+				// the wait for the next stage isn't part of any interval
+				if (interval_log != NULL) {
+					interval_log_restart(interval_log, interval_log_now());
+				}
 			}
 			else {
 				// no need to check again
@@ -556,10 +685,124 @@ periodic_output_worker(void* udata)
 
 do_sleep:
 		// sleep for 1 second
-		pause_us = dyn_throttle_pause_for(&tdata->dyn_throttle, time);
+		if (interval_log != NULL) {
+			uint64_t now_us = interval_log_now();
+
+			boundary_us = interval_log_next_boundary(now_us);
+			pause_us = boundary_us - now_us;
+			clock_gettime(COORD_CLOCK, &wake_up);
+		}
+		else {
+			pause_us = dyn_throttle_pause_for(&tdata->dyn_throttle, time);
+		}
 		timespec_add_us(&wake_up, pause_us);
-		status = thr_coordinator_sleep(coord, &wake_up);
+		status = thr_coordinator_sleep(coord, tdata->epoch, &wake_up);
 	}
 	return 0;
 }
 
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * whether any transaction finished in the period counts are for
+ */
+LOCAL_HELPER bool
+_any_counts(const struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (counts[op].ok + counts[op].miss + counts[op].timeouts +
+				counts[op].errors != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * prints the periodic line of the counts of a period elapsed us long, with
+ * the state of the adaptive limit if the stage is async
+ */
+LOCAL_HELPER void
+_print_counts(tdata_t* tdata,
+		const struct interval_counts_s counts[GROUP_OP_COUNT], int64_t elapsed)
+{
+	cdata_t* cdata = tdata->cdata;
+	const bool has_op[GROUP_OP_COUNT] = {
+		[GROUP_OP_READ] = stages_contain_reads(&cdata->stages),
+		[GROUP_OP_WRITE] = stages_contain_writes(&cdata->stages),
+		[GROUP_OP_UDF] = stages_contain_udfs(&cdata->stages)
+	};
+	char async_str[64];
+	const char* extra = NULL;
+
+	if (cdata->async_adaptive &&
+			stages_group_contains_async(&cdata->stages, tdata->stage_idx)) {
+		snprintf(async_str, sizeof(async_str),
+				"async(limit=%u in-flight=%u) ",
+				conc_limiter_limit(&cdata->async_limiter),
+				conc_limiter_in_flight(&cdata->async_limiter));
+		extra = async_str;
+	}
+	interval_log_print_counts(stdout, counts, has_op, elapsed, extra);
+}
+
+/*
+ * the output thread of a worker process of --processes, which adds what the
+ * process has done to its slot in shared memory every PROC_STATS_PUBLISH_US
+ * instead of printing it
+ */
+LOCAL_HELPER void*
+_publish_worker(tdata_t* tdata)
+{
+	cdata_t* cdata = tdata->cdata;
+	thr_coord_t* coord = tdata->coord;
+	proc_slot_t* slot = proc_stats_slot(cdata->proc_stats, cdata->proc_idx);
+	struct timespec wake_up;
+	int status;
+
+	// this thread has no required work to do
+	thr_coordinator_complete(coord);
+
+	do {
+		clock_gettime(COORD_CLOCK, &wake_up);
+		timespec_add_us(&wake_up, PROC_STATS_PUBLISH_US);
+		status = thr_coordinator_sleep(coord, tdata->epoch, &wake_up);
+
+		const struct interval_counts_s counts[GROUP_OP_COUNT] = {
+			[GROUP_OP_READ] = {
+				.ok = atomic_exchange(&cdata->read_hit_count, 0),
+				.miss = atomic_exchange(&cdata->read_miss_count, 0),
+				.timeouts = atomic_exchange(&cdata->read_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->read_error_count, 0)
+			},
+			[GROUP_OP_WRITE] = {
+				.ok = atomic_exchange(&cdata->write_count, 0),
+				.timeouts = atomic_exchange(&cdata->write_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->write_error_count, 0),
+				.bytes = atomic_exchange(&cdata->write_bytes, 0)
+			},
+			[GROUP_OP_UDF] = {
+				.ok = atomic_exchange(&cdata->udf_count, 0),
+				.timeouts = atomic_exchange(&cdata->udf_timeout_count, 0),
+				.errors = atomic_exchange(&cdata->udf_error_count, 0)
+			}
+		};
+		struct interval_counts_s warmup_counts[GROUP_OP_COUNT];
+
+		warmup_stats_take_period(cdata->warmup_stats, warmup_counts);
+		proc_stats_publish(slot, counts, warmup_counts);
+
+		if (status == COORD_SLEEP_INTERRUPTED) {
+			thr_coordinator_wait(coord, tdata);
+
+			if (!tdata->finished) {
+				thr_coordinator_complete(coord);
+			}
+		}
+	} while (!tdata->finished);
+
+	return NULL;
+}
@@ -0,0 +1,288 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <len_dist.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef double (*cdf_fn)(double x, double p1, double p2);
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER double _normal_cdf(double x, double mean, double stddev);
+LOCAL_HELPER double _lognormal_cdf(double x, double mu, double sigma);
+LOCAL_HELPER len_dist_t* _discretize(double lo_f, double hi_f, cdf_fn cdf,
+		double p1, double p2);
+LOCAL_HELPER len_dist_t* _len_dist_build(const uint32_t* los,
+		const uint32_t* his, const double* weights, uint32_t n);
+
+
+//==========================================================
+// Public API.
+//
+
+len_dist_t*
+len_dist_uniform(uint32_t min_len, uint32_t max_len)
+{
+	uint32_t lo = MIN(min_len, max_len);
+	uint32_t hi = MAX(min_len, max_len);
+	double weight = 1;
+
+	return _len_dist_build(&lo, &hi, &weight, 1);
+}
+
+len_dist_t*
+len_dist_normal(double mean, double stddev)
+{
+	if (stddev <= 0) {
+		if (mean < 0 || mean > UINT32_MAX) {
+			return NULL;
+		}
+		return len_dist_uniform((uint32_t) round(mean), (uint32_t) round(mean));
+	}
+	return _discretize(mean - LEN_DIST_N_SIGMAS * stddev,
+			mean + LEN_DIST_N_SIGMAS * stddev, _normal_cdf, mean, stddev);
+}
+
+len_dist_t*
+len_dist_lognormal(double median, double sigma)
+{
+	if (median <= 0) {
+		return NULL;
+	}
+	if (sigma <= 0) {
+		return len_dist_normal(median, 0);
+	}
+
+	double mu = log(median);
+	return _discretize(exp(mu - LEN_DIST_N_SIGMAS * sigma),
+			exp(mu + LEN_DIST_N_SIGMAS * sigma), _lognormal_cdf, mu, sigma);
+}
+
+len_dist_t*
+len_dist_from_file(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		blog_error("Unable to open length distribution file \"%s\": %s\n",
+				path, strerror(errno));
+		return NULL;
+	}
+
+	uint32_t n = 0;
+	uint32_t cap = 64;
+	uint32_t* lens = (uint32_t*) cf_malloc(cap * sizeof(uint32_t));
+	double* weights = (double*) cf_malloc(cap * sizeof(double));
+	len_dist_t* dist = NULL;
+
+	char line[256];
+	uint32_t line_no = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char* p = line;
+		char* endptr;
+		line_no++;
+
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+			continue;
+		}
+
+		errno = 0;
+		uint64_t len = strtoull(p, &endptr, 10);
+		if (endptr == p || errno != 0 || *p == '-' || len != (uint32_t) len) {
+			blog_error("%s:%u: invalid length\n", path, line_no);
+			goto done;
+		}
+		p = endptr;
+		double weight = strtod(p, &endptr);
+		if (endptr == p || !(weight >= 0) || isinf(weight)) {
+			blog_error("%s:%u: invalid weight\n", path, line_no);
+			goto done;
+		}
+
+		if (n == cap) {
+			cap *= 2;
+			lens = (uint32_t*) cf_realloc(lens, cap * sizeof(uint32_t));
+			weights = (double*) cf_realloc(weights, cap * sizeof(double));
+		}
+		lens[n] = (uint32_t) len;
+		weights[n] = weight;
+		n++;
+	}
+
+	dist = _len_dist_build(lens, lens, weights, n);
+	if (dist == NULL) {
+		blog_error("Length distribution file \"%s\" has no entries with a "
+				"positive weight\n", path);
+	}
+
+done:
+	fclose(f);
+	cf_free(lens);
+	cf_free(weights);
+	return dist;
+}
+
+void
+len_dist_free(len_dist_t* dist)
+{
+	cf_free(dist->buckets);
+	cf_free(dist);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER double
+_normal_cdf(double x, double mean, double stddev)
+{
+	return 0.5 * erfc(-(x - mean) / (stddev * M_SQRT2));
+}
+
+LOCAL_HELPER double
+_lognormal_cdf(double x, double mu, double sigma)
+{
+	if (x <= 0) {
+		return 0;
+	}
+	return _normal_cdf(log(x), mu, sigma);
+}
+
+/*
+ * splits the integer lengths covering [lo_f, hi_f] (clamped at 0) into at
+ * most LEN_DIST_N_BUCKETS equal-width buckets, each weighted by the
+ * probability mass the cdf gives it
+ */
+LOCAL_HELPER len_dist_t*
+_discretize(double lo_f, double hi_f, cdf_fn cdf, double p1, double p2)
+{
+	if (hi_f < 0 || hi_f > UINT32_MAX) {
+		return NULL;
+	}
+
+	uint32_t lo = (uint32_t) floor(MAX(lo_f, 0));
+	uint32_t hi = (uint32_t) ceil(hi_f);
+	uint64_t span = (uint64_t) hi - lo + 1;
+	uint32_t n = (uint32_t) MIN(span, LEN_DIST_N_BUCKETS);
+
+	uint32_t los[LEN_DIST_N_BUCKETS];
+	uint32_t his[LEN_DIST_N_BUCKETS];
+	double weights[LEN_DIST_N_BUCKETS];
+
+	for (uint32_t i = 0; i < n; i++) {
+		los[i] = (uint32_t) (lo + span * i / n);
+		his[i] = (uint32_t) (lo + span * (i + 1) / n - 1);
+		// each integer length owns the half-open interval around it
+		weights[i] = cdf(his[i] + 0.5, p1, p2) - cdf(los[i] - 0.5, p1, p2);
+	}
+	return _len_dist_build(los, his, weights, n);
+}
+
+/*
+ * builds the alias table with Vose's method. Buckets with zero weight are
+ * dropped. Returns NULL if no bucket has a positive weight
+ */
+LOCAL_HELPER len_dist_t*
+_len_dist_build(const uint32_t* los, const uint32_t* his, const double* weights,
+		uint32_t n)
+{
+	double total = 0;
+	uint32_t n_buckets = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (weights[i] > 0) {
+			total += weights[i];
+			n_buckets++;
+		}
+	}
+	if (n_buckets == 0) {
+		return NULL;
+	}
+
+	len_dist_t* dist = (len_dist_t*) cf_malloc(sizeof(len_dist_t));
+	dist->n_buckets = n_buckets;
+	dist->min_len = UINT32_MAX;
+	dist->max_len = 0;
+	dist->buckets = (struct len_dist_bucket_s*)
+		cf_malloc(n_buckets * sizeof(struct len_dist_bucket_s));
+
+	double* probs = (double*) cf_malloc(n_buckets * sizeof(double));
+	uint32_t* small = (uint32_t*) cf_malloc(n_buckets * sizeof(uint32_t));
+	uint32_t* large = (uint32_t*) cf_malloc(n_buckets * sizeof(uint32_t));
+	uint32_t n_small = 0;
+	uint32_t n_large = 0;
+
+	for (uint32_t i = 0, j = 0; i < n; i++) {
+		if (!(weights[i] > 0)) {
+			continue;
+		}
+		struct len_dist_bucket_s* b = &dist->buckets[j];
+		b->lo = MIN(los[i], his[i]);
+		b->hi = MAX(los[i], his[i]);
+		b->alias = j;
+		dist->min_len = MIN(dist->min_len, b->lo);
+		dist->max_len = MAX(dist->max_len, b->hi);
+
+		// scale so the average probability is 1
+		probs[j] = weights[i] * n_buckets / total;
+		if (probs[j] < 1) {
+			small[n_small++] = j;
+		}
+		else {
+			large[n_large++] = j;
+		}
+		j++;
+	}
+
+	while (n_small != 0 && n_large != 0) {
+		uint32_t s = small[--n_small];
+		uint32_t l = large[--n_large];
+
+		dist->buckets[s].threshold = (uint64_t) (probs[s] * 4294967296.);
+		dist->buckets[s].alias = l;
+
+		// l donates the rest of s's column
+		probs[l] -= 1 - probs[s];
+		if (probs[l] < 1) {
+			small[n_small++] = l;
+		}
+		else {
+			large[n_large++] = l;
+		}
+	}
+
+	// whatever is left is only off from 1 by rounding error
+	while (n_large != 0) {
+		dist->buckets[large[--n_large]].threshold = 1LU << 32;
+	}
+	while (n_small != 0) {
+		dist->buckets[small[--n_small]].threshold = 1LU << 32;
+	}
+
+	cf_free(probs);
+	cf_free(small);
+	cf_free(large);
+	return dist;
+}
+
@@ -0,0 +1,304 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <string.h>
+
+#include <aerospike/as_atomic.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <node_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const node_op_strs[NODE_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER struct node_entry_s* _get_entry(node_stats_t* ns,
+		const char* name);
+LOCAL_HELPER int64_t _entry_p99(const struct node_entry_s* entry);
+LOCAL_HELPER uint32_t _sort_by_p99(node_stats_t* ns, uint32_t* order);
+
+
+//==========================================================
+// Public API.
+//
+
+node_stats_t*
+node_stats_create(uint32_t top_n)
+{
+	node_stats_t* ns = (node_stats_t*) cf_malloc(sizeof(node_stats_t));
+
+	for (uint32_t i = 0; i < NODE_STATS_MAX_NODES; i++) {
+		struct node_entry_s* entry = &ns->entries[i];
+
+		atomic_init(&entry->claimed, false);
+		atomic_init(&entry->ready, false);
+		entry->name[0] = '\0';
+
+		for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+			entry->ops[op].hdr = NULL;
+			atomic_init(&entry->ops[op].count, 0);
+			atomic_init(&entry->ops[op].timeout_count, 0);
+			atomic_init(&entry->ops[op].error_count, 0);
+		}
+	}
+	ns->top_n = top_n;
+	return ns;
+}
+
+void
+node_stats_free(node_stats_t* ns)
+{
+	for (uint32_t i = 0; i < NODE_STATS_MAX_NODES; i++) {
+		struct node_entry_s* entry = &ns->entries[i];
+
+		for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+			if (entry->ops[op].hdr != NULL) {
+				hdr_close(entry->ops[op].hdr);
+			}
+		}
+	}
+	cf_free(ns);
+}
+
+void
+node_stats_record(node_stats_t* ns, aerospike* client, as_key* key,
+		node_op_t op, uint64_t dt_us, as_status status)
+{
+	char name[AS_NODE_NAME_SIZE];
+	if (!node_stats_key_node(client, key, name)) {
+		return;
+	}
+
+	struct node_entry_s* entry = _get_entry(ns, name);
+	if (entry == NULL) {
+		return;
+	}
+
+	struct node_op_stats_s* stats = &entry->ops[op];
+	if (status == AEROSPIKE_OK || status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+		hdr_record_value_atomic(stats->hdr, dt_us);
+		stats->count++;
+	}
+	else if (status == AEROSPIKE_ERR_TIMEOUT) {
+		stats->timeout_count++;
+	}
+	else {
+		stats->error_count++;
+	}
+}
+
+void
+node_stats_print_period(node_stats_t* ns, int64_t elapsed_us)
+{
+	uint32_t order[NODE_STATS_MAX_NODES];
+	uint32_t rank[NODE_STATS_MAX_NODES];
+	uint32_t n_nodes = _sort_by_p99(ns, order);
+
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		rank[order[i]] = i;
+	}
+
+	// print in registration order so each node stays on the same line from
+	// one period to the next
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		struct node_entry_s* entry = &ns->entries[i];
+
+		blog_info("");
+		printf("node %s ", entry->name);
+		for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+			struct node_op_stats_s* stats = &entry->ops[op];
+			uint64_t count = atomic_exchange(&stats->count, 0);
+			uint64_t timeouts = atomic_exchange(&stats->timeout_count, 0);
+			uint64_t errors = atomic_exchange(&stats->error_count, 0);
+
+			if (hdr_total_count(stats->hdr) + timeouts + errors == 0) {
+				continue;
+			}
+
+			printf("%s(tps=%" PRIu64 " timeouts=%" PRIu64 " errors=%" PRIu64
+					" p99=%" PRId64 ") ",
+					node_op_strs[op], per_sec(count, elapsed_us), timeouts, errors,
+					hdr_value_at_percentile(stats->hdr, 99.));
+		}
+		if (rank[i] < ns->top_n && _entry_p99(entry) > 0) {
+			printf("<- slowest #%u", rank[i] + 1);
+		}
+		printf("\n");
+	}
+}
+
+void
+node_stats_print_summary(node_stats_t* ns)
+{
+	static const double pcts[] = { 50., 90., 99., 99.9 };
+	uint32_t order[NODE_STATS_MAX_NODES];
+	uint32_t n_nodes = _sort_by_p99(ns, order);
+
+	if (n_nodes == 0) {
+		return;
+	}
+
+	printf("per-node latency summary (us), slowest first:\n");
+	printf("%-16s %-5s %12s %8s %8s %8s %8s %8s\n", "node", "op", "count",
+			"p50", "p90", "p99", "p99.9", "max");
+	for (uint32_t i = 0; i < n_nodes; i++) {
+		struct node_entry_s* entry = &ns->entries[order[i]];
+
+		for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+			struct hdr_histogram* h = entry->ops[op].hdr;
+			int64_t total = hdr_total_count(h);
+
+			if (total == 0) {
+				continue;
+			}
+
+			printf("%-16s %-5s %12" PRId64, entry->name, node_op_strs[op],
+					total);
+			for (uint32_t j = 0; j < sizeof(pcts) / sizeof(pcts[0]); j++) {
+				printf(" %8" PRId64, hdr_value_at_percentile(h, pcts[j]));
+			}
+			printf(" %8" PRId64 "\n", hdr_max(h));
+		}
+	}
+}
+
+bool
+node_stats_key_node(aerospike* client, as_key* key,
+		char name[AS_NODE_NAME_SIZE])
+{
+	as_cluster* cluster = client->cluster;
+	as_digest* digest = as_key_digest(key);
+
+	if (cluster == NULL || digest == NULL) {
+		return false;
+	}
+
+	as_partition_table* table =
+		as_partition_tables_get(&cluster->partition_tables, key->ns);
+	if (table == NULL) {
+		return false;
+	}
+
+	uint32_t pid = as_partition_getid(digest->value, cluster->n_partitions);
+	as_node* node = (as_node*) as_load_ptr(&table->partitions[pid].nodes[0]);
+	if (node == NULL) {
+		return false;
+	}
+
+	// hold the node only while copying its name, the tend thread may drop it
+	// from the cluster at any time after
+	as_node_reserve(node);
+	strncpy(name, node->name, AS_NODE_NAME_SIZE - 1);
+	name[AS_NODE_NAME_SIZE - 1] = '\0';
+	as_node_release(node);
+	return true;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * finds the entry for the node with this name, claiming a new one if this is
+ * the first time the node has been seen. Returns NULL if an entry that may be
+ * the node's isn't ready yet or if there are no free entries left
+ */
+LOCAL_HELPER struct node_entry_s*
+_get_entry(node_stats_t* ns, const char* name)
+{
+	for (uint32_t i = 0; i < NODE_STATS_MAX_NODES; i++) {
+		struct node_entry_s* entry = &ns->entries[i];
+
+		if (!entry->ready) {
+			bool claimed = false;
+
+			if (!atomic_compare_exchange_strong(&entry->claimed, &claimed,
+					true)) {
+				// somebody else claimed this entry first. Until they've
+				// filled in its name it may be this node's, so don't claim
+				// another one for it
+				if (!entry->ready) {
+					return NULL;
+				}
+				if (strcmp(entry->name, name) == 0) {
+					return entry;
+				}
+				continue;
+			}
+
+			strncpy(entry->name, name, sizeof(entry->name) - 1);
+			entry->name[sizeof(entry->name) - 1] = '\0';
+			for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+				hdr_init(1, 1000000, 3, &entry->ops[op].hdr);
+			}
+			entry->ready = true;
+			return entry;
+		}
+
+		if (strcmp(entry->name, name) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * the highest p99 latency of any op type on this node
+ */
+LOCAL_HELPER int64_t
+_entry_p99(const struct node_entry_s* entry)
+{
+	int64_t p99 = 0;
+	for (uint32_t op = 0; op < NODE_OP_COUNT; op++) {
+		if (hdr_total_count(entry->ops[op].hdr) != 0) {
+			p99 = MAX(p99, hdr_value_at_percentile(entry->ops[op].hdr, 99.));
+		}
+	}
+	return p99;
+}
+
+/*
+ * fills order with the indices of all ready entries, sorted by descending
+ * p99 latency, returning the number of entries
+ */
+LOCAL_HELPER uint32_t
+_sort_by_p99(node_stats_t* ns, uint32_t* order)
+{
+	int64_t p99s[NODE_STATS_MAX_NODES];
+	uint32_t n = 0;
+
+	while (n < NODE_STATS_MAX_NODES && ns->entries[n].ready) {
+		p99s[n] = _entry_p99(&ns->entries[n]);
+		n++;
+	}
+
+	// insertion sort, there will only ever be a handful of nodes
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t j = i;
+		while (j > 0 && p99s[order[j - 1]] < p99s[i]) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	return n;
+}
+
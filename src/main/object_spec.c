@@ -6,8 +6,12 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 
+#include <aerospike/as_msgpack.h>
 #include <aerospike/as_orderedmap.h>
 #include <aerospike/as_pair.h>
 #include <aerospike/as_string.h>
@@ -67,6 +71,68 @@ struct consumer_state_s {
 	uint32_t list_len;
 };
 
+// a list/map being built while executing a generation plan
+struct gen_frame_s {
+	as_val* val;
+	bool is_map;
+
+	// the op of the element (or the map key) currently being generated, and
+	// the end of the list/map's ops
+	uint32_t op;
+	uint32_t end;
+
+	// the number of times op has been generated so far
+	uint32_t rep;
+
+	// map only: a generated key waiting for its value, and the number of
+	// duplicate keys generated for the current kv pair
+	as_val* key;
+	uint32_t retries;
+};
+
+// compressible bytes are runs of random literals, each followed by a copy of
+// earlier bytes of the same value, which is what LZ77-style compressors (zlib,
+// lz4, zstd) look for. Copies stay within zlib's 32KB window
+#define COMPRESS_MATCH_MIN 32
+#define COMPRESS_MATCH_MAX 256
+#define COMPRESS_WINDOW (32 * 1024)
+// about how many bytes a compressor spends encoding a match
+#define COMPRESS_MATCH_COST 3
+
+// the largest msgpack header of a list, map, string or bytes value
+#define PACK_HEADER_MAX 5
+// the largest msgpack encoding of an integer or double
+#define PACK_NUMBER_MAX 9
+// packed strings and bytes are prefixed with their particle type
+#define PACK_PARTICLE_TYPE_SIZE 1
+
+// a list/map being packed while executing a generation plan
+struct pack_frame_s {
+	bool is_map;
+
+	// same as in gen_frame_s
+	uint32_t op;
+	uint32_t end;
+	uint32_t rep;
+	uint32_t retries;
+
+	// map only: the offset of the map's first entry in the output, the offset
+	// of the entry being packed, the map's first entry in the entry stack,
+	// and the entry waiting for its value (UINT32_MAX if none)
+	uint32_t start;
+	uint32_t cur;
+	uint32_t entry_base;
+	uint32_t pending;
+};
+
+// a packed map entry, whose key is at key_off in the output, directly
+// followed by its value
+struct pack_entry_s {
+	uint32_t key_off;
+	uint32_t key_len;
+	uint32_t val_len;
+};
+
 
 //==========================================================
 // Forward declarations.
@@ -82,18 +148,56 @@ LOCAL_HELPER int _parse_bin_types(as_vector* bin_specs, uint32_t* n_bins,
 		const char* const obj_spec_str);
 LOCAL_HELPER int _parse_const_val(const char* const obj_spec_str,
 		const char** stream, struct bin_spec_s* bin_spec, char delim, uint8_t type, uint8_t map_state);
+LOCAL_HELPER bool _len_dist_follows(const char* str);
+LOCAL_HELPER int _parse_len_dist(const char* const obj_spec_str,
+		const char** str_p, len_dist_t** dist, char** dist_str);
 LOCAL_HELPER void bin_spec_free(struct bin_spec_s* bin_spec);
+LOCAL_HELPER uint32_t _gen_len(uint32_t length, const len_dist_t* dist,
+		as_random* random);
 LOCAL_HELPER as_val* _gen_random_bool(as_random* random);
 LOCAL_HELPER as_val* _gen_random_int(uint8_t range, as_random* random);
+LOCAL_HELPER uint64_t _rand_int(uint8_t range, as_random* random);
 LOCAL_HELPER uint64_t raw_to_alphanum(uint64_t n);
 LOCAL_HELPER as_val* _gen_random_str(uint32_t length, as_random* random);
+LOCAL_HELPER void _fill_random_str(char* buf, uint32_t length,
+		as_random* random);
 LOCAL_HELPER as_val* _gen_random_bytes(uint32_t length, as_random* random,
 		float compression_ratio);
+LOCAL_HELPER void _fill_random_bytes(uint8_t* buf, uint32_t length,
+		as_random* random, float compression_ratio);
 LOCAL_HELPER as_val* _gen_random_double(as_random* random);
 LOCAL_HELPER as_val* _gen_random_list(const struct bin_spec_s* bin_spec,
 		as_random* random, float compression_ratio);
 LOCAL_HELPER as_val* _gen_random_map(const struct bin_spec_s* bin_spec,
 		as_random* random, float compression_ratio);
+LOCAL_HELPER struct gen_plan_s* _plan_create(const struct bin_spec_s* bin_specs,
+		uint32_t n_bins);
+LOCAL_HELPER void _plan_free(struct gen_plan_s* plan);
+LOCAL_HELPER uint32_t _plan_count_ops(const struct bin_spec_s* bin_spec,
+		uint32_t depth, uint32_t* max_depth);
+LOCAL_HELPER void _plan_compile_op(struct gen_op_s* ops, uint32_t* idx,
+		const struct bin_spec_s* bin_spec);
+LOCAL_HELPER as_val* _plan_gen_scalar(const struct gen_op_s* op,
+		as_random* random, float compression_ratio);
+LOCAL_HELPER as_val* _plan_gen_val(const struct gen_plan_s* plan, uint32_t root,
+		as_random* random, float compression_ratio, uint64_t* size);
+LOCAL_HELPER void _plan_pack_bounds(struct gen_op_s* ops, uint32_t idx);
+LOCAL_HELPER int _plan_pack_scalar(const struct gen_op_s* op,
+		as_random* random, float compression_ratio, as_packer* pk,
+		uint8_t* scratch);
+LOCAL_HELPER bool _plan_find_key(const uint8_t* buf,
+		const struct pack_entry_s* entries, uint32_t lo, uint32_t hi,
+		uint32_t key_off, uint32_t key_len, uint32_t* pos);
+LOCAL_HELPER void _plan_pack_map_finish(const struct gen_plan_s* plan,
+		const struct pack_frame_s* frame, as_packer* pk,
+		const struct pack_entry_s* entries, uint32_t n_entries,
+		uint8_t* scratch);
+LOCAL_HELPER as_val* _plan_pack_val(const struct gen_plan_s* plan,
+		uint32_t root, as_random* random, float compression_ratio);
+LOCAL_HELPER int _populate_bins(const struct obj_spec_s* obj_spec,
+		as_record* rec, as_random* random, const char* bin_name,
+		uint32_t* write_bins, uint32_t n_write_bins, float compression_ratio,
+		bool packed, uint64_t* size);
 LOCAL_HELPER as_val* bin_spec_random_val(const struct bin_spec_s* bin_spec,
 		as_random* random, float compression_ratio);
 LOCAL_HELPER size_t _sprint_bin(const struct bin_spec_s* bin, char** out_str,
@@ -110,8 +214,10 @@ LOCAL_HELPER bool _dbg_as_map_cmp(const as_map* m1, const as_map* m2, bool do_as
 
 LOCAL_HELPER bool _dbg_validate_bool(as_boolean* as_val, bool do_assert);
 LOCAL_HELPER bool _dbg_validate_int(uint8_t range, as_integer* as_val, bool do_assert);
-LOCAL_HELPER bool _dbg_validate_string(uint32_t length, as_string* as_val, bool do_assert);
-LOCAL_HELPER bool _dbg_validate_bytes(uint32_t length, as_bytes* as_val, bool do_assert);
+LOCAL_HELPER bool _dbg_validate_string(uint32_t min_len, uint32_t max_len,
+		as_string* as_val, bool do_assert);
+LOCAL_HELPER bool _dbg_validate_bytes(uint32_t min_len, uint32_t max_len,
+		as_bytes* as_val, bool do_assert);
 LOCAL_HELPER bool _dbg_validate_double(as_double* as_val, bool do_assert);
 LOCAL_HELPER bool _dbg_validate_list(const struct bin_spec_s* bin_spec,
 		const as_list* as_val, bool do_assert);
@@ -222,6 +328,20 @@ raw_to_alphanum(uint64_t n)
 		str_size = (str_size > __w ? str_size - __w : 0); \
 	} while (0)
 
+LOCAL_HELPER bool
+_val_size_list_fn(as_val* val, void* udata)
+{
+	*(uint64_t*) udata += obj_spec_val_size(val);
+	return true;
+}
+
+LOCAL_HELPER bool
+_val_size_map_fn(const as_val* key, const as_val* val, void* udata)
+{
+	*(uint64_t*) udata += obj_spec_val_size(key) + obj_spec_val_size(val);
+	return true;
+}
+
 #ifdef _TEST
 
 LOCAL_HELPER inline uint8_t
@@ -351,6 +471,8 @@ obj_spec_parse(struct obj_spec_s* base_obj, const char* obj_spec_str)
 #pragma GCC diagnostic pop
 #endif /* __linux__ */
 
+		base_obj->plan = _plan_create(base_obj->bin_specs,
+				base_obj->n_bin_specs);
 		base_obj->valid = true;
 	}
 	else {
@@ -370,6 +492,7 @@ obj_spec_free(struct obj_spec_s* obj_spec)
 			bin_spec_free(&obj_spec->bin_specs[i]);
 		}
 		cf_free(obj_spec->bin_specs);
+		_plan_free(obj_spec->plan);
 		obj_spec->valid = false;
 	}
 }
@@ -429,62 +552,20 @@ obj_spec_bin_name_compatible(const obj_spec_t* obj_spec, const char* bin_name)
 int
 obj_spec_populate_bins(const struct obj_spec_s* obj_spec, as_record* rec,
 		as_random* random, const char* bin_name, uint32_t* write_bins,
-		uint32_t n_write_bins, float compression_ratio)
+		uint32_t n_write_bins, float compression_ratio, uint64_t* size)
 {
-	uint32_t n_bin_specs =
-		write_bins == NULL ? obj_spec->n_bin_specs : n_write_bins;
-	as_bins* bins = &rec->bins;
-
-	if (n_bin_specs > bins->capacity) {
-		fprintf(stderr, "Not enough bins allocated for obj_spec\n");
-		return -1;
-	}
-
-	if (write_bins == NULL) {
-		for (uint32_t i = 0, cnt = 0; cnt < n_bin_specs; i++) {
-			const struct bin_spec_s* bin_spec = &obj_spec->bin_specs[i];
-
-			for (uint32_t j = 0; j < bin_spec->n_repeats; j++, cnt++) {
-				as_val* val = bin_spec_random_val(bin_spec, random,
-						compression_ratio);
-
-				if (val == NULL) {
-					return -1;
-				}
-
-				as_bin_name name;
-				gen_bin_name(name, bin_name, cnt);
-				if (!as_record_set(rec, name, (as_bin_value*) val)) {
-					// failed to set a record, meaning we ran out of space
-					fprintf(stderr, "Not enough free bin slots in record\n");
-					as_val_destroy(val);
-					return -1;
-				}
-			}
-		}
-	}
-	else {
-		FOR_EACH_WRITE_BIN(write_bins, n_write_bins, obj_spec, _k, idx, bin_spec) {
-			as_val* val = bin_spec_random_val(bin_spec, random,
-					compression_ratio);
-
-			if (val == NULL) {
-				return -1;
-			}
-
-			as_bin_name name;
-			gen_bin_name(name, bin_name, idx);
-			if (!as_record_set(rec, name, (as_bin_value*) val)) {
-				// failed to set a record, meaning we ran out of space
-				fprintf(stderr, "Not enough free bin slots in record\n");
-				as_val_destroy(val);
-				return -1;
-			}
-		}
-		END_FOR_EACH_WRITE_BIN(write_bins, n_write_bins, _k, idx);
-	}
+	return _populate_bins(obj_spec, rec, random, bin_name, write_bins,
+			n_write_bins, compression_ratio, false, size);
+}
 
-	return 0;
+int
+obj_spec_populate_packed_bins(const struct obj_spec_s* obj_spec,
+		as_record* rec, as_random* random, const char* bin_name,
+		uint32_t* write_bins, uint32_t n_write_bins, float compression_ratio,
+		uint64_t* size)
+{
+	return _populate_bins(obj_spec, rec, random, bin_name, write_bins,
+			n_write_bins, compression_ratio, true, size);
 }
 
 
@@ -501,32 +582,27 @@ obj_spec_gen_compressible_value(const struct obj_spec_s* obj_spec,
 		as_random* random, uint32_t* write_bins, uint32_t n_write_bins,
 		float compression_ratio)
 {
+	const struct gen_plan_s* plan = obj_spec->plan;
+	uint32_t n_bins =
+		write_bins == NULL ? obj_spec->n_bin_specs : n_write_bins;
+	as_arraylist* list = as_arraylist_new(n_bins, 0);
+	uint64_t size = 0;
 
-	if (write_bins == NULL) {
-		struct bin_spec_s tmp_list;
-		tmp_list.type = BIN_SPEC_TYPE_LIST;
-		tmp_list.list.length = obj_spec->n_bin_specs;
-		tmp_list.list.list = obj_spec->bin_specs;
-		return bin_spec_random_val(&tmp_list, random, compression_ratio);
-	}
-	else {
-		as_arraylist* list = as_arraylist_new(n_write_bins, 0);
-
-		FOR_EACH_WRITE_BIN(write_bins, n_write_bins, obj_spec, _k, _idx, bin_spec) {
-			as_val* val = bin_spec_random_val(bin_spec, random,
-					compression_ratio);
-
-			if (val == NULL) {
-				as_list_destroy((as_list*) list);
-				return NULL;
-			}
+	for (uint32_t i = 0; i < n_bins; i++) {
+		const struct gen_plan_bin_s* bin =
+			&plan->bins[write_bins == NULL ? i : write_bins[i]];
+		as_val* val = _plan_gen_val(plan, bin->op, random, compression_ratio,
+				&size);
 
-			as_list_append((as_list*) list, val);
+		if (val == NULL) {
+			as_list_destroy((as_list*) list);
+			return NULL;
 		}
-		END_FOR_EACH_WRITE_BIN(write_bins, n_write_bins, _k, _idx);
 
-		return (as_val*) list;
+		as_list_append((as_list*) list, val);
 	}
+
+	return (as_val*) list;
 }
 
 void
@@ -546,6 +622,32 @@ snprint_obj_spec(const struct obj_spec_s* obj_spec, char* out_str,
 	*out_str = '\0';
 }
 
+uint64_t
+obj_spec_val_size(const as_val* val)
+{
+	uint64_t size = 0;
+
+	switch (as_val_type(val)) {
+		case AS_BOOLEAN:
+			return 1;
+		case AS_INTEGER:
+		case AS_DOUBLE:
+			return 8;
+		case AS_STRING:
+			return as_string_len((as_string*) val);
+		case AS_BYTES:
+			return as_bytes_size((as_bytes*) val);
+		case AS_LIST:
+			as_list_foreach((const as_list*) val, _val_size_list_fn, &size);
+			return size;
+		case AS_MAP:
+			as_map_foreach((const as_map*) val, _val_size_map_fn, &size);
+			return size;
+		default:
+			return 0;
+	}
+}
+
 #ifdef _TEST
 
 void
@@ -661,11 +763,23 @@ _dbg_validate_bin_spec(const struct bin_spec_s* bin_spec, const as_val* val, boo
 
 			case BIN_SPEC_TYPE_STR: {
 				as_string* s = as_string_fromval(val);
-				return _dbg_validate_string(bin_spec->string.length, s, do_assert);
+				const len_dist_t* dist = bin_spec->string.dist;
+				return dist == NULL ?
+					_dbg_validate_string(bin_spec->string.length,
+							bin_spec->string.length, s, do_assert) :
+					_dbg_validate_string(dist->min_len, dist->max_len, s,
+							do_assert);
 			}
 
-			case BIN_SPEC_TYPE_BYTES:
-				return _dbg_validate_bytes(bin_spec->string.length, as_bytes_fromval(val), do_assert);
+			case BIN_SPEC_TYPE_BYTES: {
+				as_bytes* b = as_bytes_fromval(val);
+				const len_dist_t* dist = bin_spec->bytes.dist;
+				return dist == NULL ?
+					_dbg_validate_bytes(bin_spec->bytes.length,
+							bin_spec->bytes.length, b, do_assert) :
+					_dbg_validate_bytes(dist->min_len, dist->max_len, b,
+							do_assert);
+			}
 
 			case BIN_SPEC_TYPE_DOUBLE: {
 				as_double* d = as_double_fromval(val);
@@ -1116,6 +1230,19 @@ _parse_bin_types(as_vector* bin_specs, uint32_t* n_bins,
 					break;
 				}
 				case 'S': {
+					if (_len_dist_follows(str + 1)) {
+						str++;
+						if (_parse_len_dist(obj_spec_str, &str,
+									&bin_spec->string.dist,
+									&bin_spec->string.dist_str) != 0) {
+							_destroy_consumer_states(state);
+							return -1;
+						}
+						bin_spec->type = BIN_SPEC_TYPE_STR;
+						bin_spec->string.length = 0;
+						break;
+					}
+
 					uint64_t str_len;
 					char* endptr;
 					str_len = strtoul(str + 1, &endptr, 10);
@@ -1133,11 +1260,26 @@ _parse_bin_types(as_vector* bin_specs, uint32_t* n_bins,
 					}
 					bin_spec->type = BIN_SPEC_TYPE_STR;
 					bin_spec->string.length = (uint32_t) str_len;
+					bin_spec->string.dist = NULL;
+					bin_spec->string.dist_str = NULL;
 
 					str = endptr;
 					break;
 				}
 				case 'B': {
+					if (_len_dist_follows(str + 1)) {
+						str++;
+						if (_parse_len_dist(obj_spec_str, &str,
+									&bin_spec->bytes.dist,
+									&bin_spec->bytes.dist_str) != 0) {
+							_destroy_consumer_states(state);
+							return -1;
+						}
+						bin_spec->type = BIN_SPEC_TYPE_BYTES;
+						bin_spec->bytes.length = 0;
+						break;
+					}
+
 					uint64_t bytes_len;
 					char* endptr;
 					bytes_len = strtoul(str + 1, &endptr, 10);
@@ -1155,6 +1297,8 @@ _parse_bin_types(as_vector* bin_specs, uint32_t* n_bins,
 					}
 					bin_spec->type = BIN_SPEC_TYPE_BYTES;
 					bin_spec->bytes.length = (uint32_t) bytes_len;
+					bin_spec->bytes.dist = NULL;
+					bin_spec->bytes.dist_str = NULL;
 
 					str = endptr;
 					break;
@@ -1509,6 +1653,157 @@ _parse_const_val(const char* const obj_spec_str,
 	return -1;
 }
 
+/*
+ * returns true if the text following an 'S' or 'B' specifier is a length
+ * distribution rather than a fixed length
+ */
+LOCAL_HELPER bool
+_len_dist_follows(const char* str)
+{
+	if (*str == '~') {
+		return true;
+	}
+	if (!isdigit(*str)) {
+		return false;
+	}
+	while (isdigit(*str)) {
+		str++;
+	}
+	return *str == '-' && isdigit(*(str + 1));
+}
+
+/*
+ * parses one of the following length distributions, which must immediately
+ * follow an 'S' or 'B' specifier:
+ *
+ *   <min>-<max>           uniform over [min, max]
+ *   ~n(<mean>,<stddev>)   normal
+ *   ~ln(<median>,<sigma>) lognormal
+ *   ~f(<path>)            empirical, from a file of "<length> <weight>" lines
+ *
+ * on success, str_p is advanced past the distribution and dist_str is set to
+ * a copy of its text
+ */
+LOCAL_HELPER int
+_parse_len_dist(const char* const obj_spec_str, const char** str_p,
+		len_dist_t** dist, char** dist_str)
+{
+	const char* begin = *str_p;
+	const char* str = begin;
+	char* endptr;
+	len_dist_t* d;
+
+	if (*str != '~') {
+		uint64_t min_len = strtoul(str, &endptr, 10);
+		if (min_len != (uint32_t) min_len) {
+			_print_parse_error("Invalid length", obj_spec_str, str);
+			return -1;
+		}
+		// skip the '-', which _len_dist_follows has already checked for
+		str = endptr + 1;
+
+		uint64_t max_len = strtoul(str, &endptr, 10);
+		if (max_len != (uint32_t) max_len) {
+			_print_parse_error("Invalid length", obj_spec_str, str);
+			return -1;
+		}
+		if (max_len < min_len) {
+			_print_parse_error("Length range max is less than min",
+					obj_spec_str, str);
+			return -1;
+		}
+		d = len_dist_uniform((uint32_t) min_len, (uint32_t) max_len);
+		str = endptr;
+	}
+	else {
+		str++;
+		const char* name = str;
+		while (isalpha(*str)) {
+			str++;
+		}
+		size_t name_len = str - name;
+
+		if (*str != '(') {
+			_print_parse_error("Expect '(' following the length distribution "
+					"name", obj_spec_str, str);
+			return -1;
+		}
+		str++;
+
+		if (name_len == 1 && name[0] == 'f') {
+			const char* path_end = strchr(str, ')');
+			if (path_end == NULL || path_end == str) {
+				_print_parse_error("Expect a file path followed by ')'",
+						obj_spec_str, str);
+				return -1;
+			}
+
+			char* path = (char*) cf_malloc(path_end - str + 1);
+			memcpy(path, str, path_end - str);
+			path[path_end - str] = '\0';
+			d = len_dist_from_file(path);
+			cf_free(path);
+
+			if (d == NULL) {
+				_print_parse_error("Unable to load length distribution file",
+						obj_spec_str, str);
+				return -1;
+			}
+			str = path_end + 1;
+		}
+		else if ((name_len == 1 && name[0] == 'n') ||
+				(name_len == 2 && name[0] == 'l' && name[1] == 'n')) {
+			double params[2];
+
+			for (uint32_t i = 0; i < 2; i++) {
+				params[i] = strtod(str, &endptr);
+				if (endptr == str || !isfinite(params[i]) || params[i] < 0) {
+					_print_parse_error("Expect a non-negative number as a "
+							"length distribution parameter",
+							obj_spec_str, str);
+					return -1;
+				}
+				str = endptr;
+				if (*str == ' ') {
+					str++;
+				}
+				if (*str != (i == 0 ? ',' : ')')) {
+					_print_parse_error(i == 0 ?
+							"Expect ',' separating length distribution "
+							"parameters" :
+							"Expect ')' closing the length distribution",
+							obj_spec_str, str);
+					return -1;
+				}
+				str++;
+				if (*str == ' ' && i == 0) {
+					str++;
+				}
+			}
+
+			d = name_len == 1 ? len_dist_normal(params[0], params[1]) :
+				len_dist_lognormal(params[0], params[1]);
+			if (d == NULL) {
+				_print_parse_error("Length distribution is empty or exceeds "
+						"the maximum length (2**32 - 1)", obj_spec_str, begin);
+				return -1;
+			}
+		}
+		else {
+			_print_parse_error("Unknown length distribution, expect one of "
+					"n, ln, or f", obj_spec_str, name);
+			return -1;
+		}
+	}
+
+	*dist = d;
+	*dist_str = (char*) cf_malloc(str - begin + 1);
+	memcpy(*dist_str, begin, str - begin);
+	(*dist_str)[str - begin] = '\0';
+	*str_p = str;
+	return 0;
+}
+
 LOCAL_HELPER void
 bin_spec_free(struct bin_spec_s* bin_spec)
 {
@@ -1517,13 +1812,25 @@ bin_spec_free(struct bin_spec_s* bin_spec)
 		case BIN_SPEC_TYPE_BOOL | BIN_SPEC_TYPE_CONST:
 		case BIN_SPEC_TYPE_INT:
 		case BIN_SPEC_TYPE_INT | BIN_SPEC_TYPE_CONST:
-		case BIN_SPEC_TYPE_BYTES:
 		case BIN_SPEC_TYPE_DOUBLE:
 		case BIN_SPEC_TYPE_DOUBLE | BIN_SPEC_TYPE_CONST:
-		case BIN_SPEC_TYPE_STR:
 			// no-op, scalar types use no disjointed memory
 			break;
 
+		case BIN_SPEC_TYPE_STR:
+			if (bin_spec->string.dist != NULL) {
+				len_dist_free(bin_spec->string.dist);
+				cf_free(bin_spec->string.dist_str);
+			}
+			break;
+
+		case BIN_SPEC_TYPE_BYTES:
+			if (bin_spec->bytes.dist != NULL) {
+				len_dist_free(bin_spec->bytes.dist);
+				cf_free(bin_spec->bytes.dist_str);
+			}
+			break;
+
 		case BIN_SPEC_TYPE_STR | BIN_SPEC_TYPE_CONST:
 			as_string_destroy(&bin_spec->const_string.val);
 			break;
@@ -1555,6 +1862,12 @@ bin_spec_free(struct bin_spec_s* bin_spec)
 	}
 }
 
+LOCAL_HELPER inline uint32_t
+_gen_len(uint32_t length, const len_dist_t* dist, as_random* random)
+{
+	return dist == NULL ? length : len_dist_sample(dist, random);
+}
+
 LOCAL_HELPER as_val*
 _gen_random_bool(as_random* random)
 {
@@ -1565,16 +1878,21 @@ _gen_random_bool(as_random* random)
 LOCAL_HELPER as_val*
 _gen_random_int(uint8_t range, as_random* random)
 {
-	as_integer* val;
-	uint64_t r;
-	uint64_t min;
-	uint64_t range_size;
 	if (range > 7) {
 		fprintf(stderr, "bin_spec integer range must be between 0-7, got %u\n",
 				range);
 		return NULL;
 	}
 
+	return (as_val*) as_integer_new(_rand_int(range, random));
+}
+
+LOCAL_HELPER uint64_t
+_rand_int(uint8_t range, as_random* random)
+{
+	uint64_t min;
+	uint64_t range_size;
+
 	/*
 	 * min values for ranges are:
 	 * 	0: 0
@@ -1591,10 +1909,7 @@ _gen_random_int(uint8_t range, as_random* random)
 	min = (0x1LU << (range * 8)) & ~0x1LU;
 	range_size = (0xffLU << (range * 8)) + !range;
 
-	r = gen_rand_range_64(random, range_size) + min;
-
-	val = as_integer_new(r);
-	return (as_val*) val;
+	return gen_rand_range_64(random, range_size) + min;
 }
 
 /*
@@ -1616,11 +1931,19 @@ _gen_random_int(uint8_t range, as_random* random)
 LOCAL_HELPER as_val*
 _gen_random_str(uint32_t length, as_random* random)
 {
-	as_string* val;
-	char* buf;
-	uint32_t i = 0, j;
+	char* buf = (char*) cf_malloc(length + 1);
+
+	_fill_random_str(buf, length, random);
+	// null-terminate the string
+	buf[length] = '\0';
+
+	return (as_val*) as_string_new_wlen(buf, length, 1);
+}
 
-	buf = (char*) cf_malloc(length + 1);
+LOCAL_HELPER void
+_fill_random_str(char* buf, uint32_t length, as_random* random)
+{
+	uint32_t i = 0, j;
 
 	// take groups of 24 characters and batch-generate all random alphanumeric
 	// values with just 2 random 64-bit values
@@ -1681,26 +2004,72 @@ _gen_random_str(uint32_t length, as_random* random)
 		}
 		i += sz;
 	}
-
-	// null-terminate the string
-	buf[length] = '\0';
-
-	val = as_string_new_wlen(buf, length, 1);
-	return (as_val*) val;
 }
 
 LOCAL_HELPER as_val*
 _gen_random_bytes(uint32_t length, as_random* random, float compression_ratio)
 {
-	as_bytes* val;
-	uint8_t* buf;
+	uint8_t* buf = (uint8_t*) cf_malloc(length);
 
-	buf = (uint8_t*) cf_calloc(1, length);
-	uint32_t c_len = (uint32_t) (compression_ratio * length);
-	as_random_next_bytes(random, buf, c_len);
+	_fill_random_bytes(buf, length, random, compression_ratio);
+	return (as_val*) as_bytes_new_wrap(buf, length, 1);
+}
 
-	val = as_bytes_new_wrap(buf, length, 1);
-	return (as_val*) val;
+/*
+ * fills buf with bytes that compress to roughly compression_ratio of their
+ * size. Rather than padding random bytes with zeros, which any compressor
+ * squashes to nothing, literal runs are interleaved with copies of earlier
+ * runs, so the compressor has to find and encode real matches
+ */
+LOCAL_HELPER void
+_fill_random_bytes(uint8_t* buf, uint32_t length, as_random* random,
+		float compression_ratio)
+{
+	if (compression_ratio >= 1) {
+		as_random_next_bytes(random, buf, length);
+		return;
+	}
+
+	// the fraction of literal bytes for which the literals plus the cost of
+	// encoding the matches comes out at compression_ratio
+	double match_cost = (double) (2 * COMPRESS_MATCH_COST) /
+		(COMPRESS_MATCH_MIN + COMPRESS_MATCH_MAX);
+	double lit_frac = MAX(compression_ratio - match_cost, 0) / (1 - match_cost);
+	double lits_per_match_byte = lit_frac / (1 - lit_frac);
+	double lit_credit = 0;
+	uint32_t pos = 0;
+
+	while (pos < length) {
+		uint64_t r = as_random_next_uint64(random);
+		uint32_t match_len = COMPRESS_MATCH_MIN + (uint32_t) (r & 0xffff) %
+			(COMPRESS_MATCH_MAX - COMPRESS_MATCH_MIN + 1);
+
+		// carry the fractional part over so the overall fraction of literals
+		// is exact, and always start with enough literals to copy from
+		lit_credit += match_len * lits_per_match_byte;
+		uint32_t lit_len = (uint32_t) MAX(lit_credit, 0);
+		if (pos == 0) {
+			lit_len = MAX(lit_len, COMPRESS_MATCH_MIN);
+		}
+		lit_len = MIN(lit_len, length - pos);
+		lit_credit -= lit_len;
+
+		as_random_next_bytes(random, buf + pos, lit_len);
+		pos += lit_len;
+
+		match_len = MIN(match_len, MIN(pos, length - pos));
+		if (match_len == 0) {
+			continue;
+		}
+
+		// copies never overlap the bytes they're copied from
+		uint32_t max_dist = MIN(pos, COMPRESS_WINDOW);
+		uint32_t dist = match_len +
+			(uint32_t) ((r >> 32) % (max_dist - match_len + 1));
+
+		memcpy(buf + pos, buf + pos - dist, match_len);
+		pos += match_len;
+	}
 }
 
 LOCAL_HELPER as_val*
@@ -1778,7 +2147,7 @@ _gen_random_map(const struct bin_spec_s* bin_spec, as_random* random,
 				retry_count++;
 			}
 			if (retry_count >= MAX_KEY_ENTRY_RETRIES) {
-				as_val_destroy(key);
+				// the last duplicate key was already destroyed above
 				break;
 			}
 
@@ -1818,7 +2187,8 @@ bin_spec_random_val(const struct bin_spec_s* bin_spec, as_random* random,
 			break;
 
 		case BIN_SPEC_TYPE_STR:
-			val = _gen_random_str(bin_spec->string.length, random);
+			val = _gen_random_str(_gen_len(bin_spec->string.length,
+						bin_spec->string.dist, random), random);
 			break;
 
 		case BIN_SPEC_TYPE_STR | BIN_SPEC_TYPE_CONST:
@@ -1827,8 +2197,8 @@ bin_spec_random_val(const struct bin_spec_s* bin_spec, as_random* random,
 			break;
 
 		case BIN_SPEC_TYPE_BYTES:
-			val = _gen_random_bytes(bin_spec->bytes.length, random,
-					compression_ratio);
+			val = _gen_random_bytes(_gen_len(bin_spec->bytes.length,
+						bin_spec->bytes.dist, random), random, compression_ratio);
 			break;
 
 		case BIN_SPEC_TYPE_DOUBLE:
@@ -1867,43 +2237,776 @@ bin_spec_random_val(const struct bin_spec_s* bin_spec, as_random* random,
 	return val;
 }
 
-LOCAL_HELPER size_t
-_sprint_bin(const struct bin_spec_s* bin, char** out_str, size_t str_size)
+/*
+ * populates rec's bins from the obj_spec's generation plan. If packed is set,
+ * list/map bins are packed straight to msgpack. If size isn't NULL, it's set
+ * to the number of bytes of data in the bins, as obj_spec_val_size counts it
+ */
+LOCAL_HELPER int
+_populate_bins(const struct obj_spec_s* obj_spec, as_record* rec,
+		as_random* random, const char* bin_name, uint32_t* write_bins,
+		uint32_t n_write_bins, float compression_ratio, bool packed,
+		uint64_t* size)
 {
-	if (bin->n_repeats != 1) {
-		sprint(out_str, str_size, "%d*", bin->n_repeats);
-	}
-	switch (bin->type) {
-		case BIN_SPEC_TYPE_BOOL:
-			sprint(out_str, str_size, "b");
-			break;
-
-		case BIN_SPEC_TYPE_BOOL | BIN_SPEC_TYPE_CONST:
-			sprint(out_str, str_size, "%s", boolstring(as_boolean_get(&bin->const_bool.val)));
-			break;
+	const struct gen_plan_s* plan = obj_spec->plan;
+	uint32_t n_bins =
+		write_bins == NULL ? obj_spec->n_bin_specs : n_write_bins;
+	as_bins* bins = &rec->bins;
 
-		case BIN_SPEC_TYPE_INT:
-			sprint(out_str, str_size, "I%d", bin->integer.range + 1);
-			break;
+	if (n_bins > bins->capacity) {
+		fprintf(stderr, "Not enough bins allocated for obj_spec\n");
+		return -1;
+	}
 
-		case BIN_SPEC_TYPE_INT | BIN_SPEC_TYPE_CONST:
-			sprint(out_str, str_size, "%" PRId64, as_integer_get(&bin->const_integer.val));
-			break;
+	size_t base_len = MIN(strlen(bin_name), sizeof(as_bin_name) - 1);
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < n_bins; i++) {
+		const struct gen_plan_bin_s* bin =
+			&plan->bins[write_bins == NULL ? i : write_bins[i]];
+		const struct gen_op_s* op = &plan->ops[bin->op];
+		as_val* val;
+
+		if (packed && op->pack_size <= UINT32_MAX &&
+				(op->type == BIN_SPEC_TYPE_LIST ||
+				 op->type == BIN_SPEC_TYPE_MAP)) {
+			val = _plan_pack_val(plan, bin->op, random, compression_ratio);
+			if (val != NULL) {
+				total += as_bytes_size((as_bytes*) val);
+			}
+		}
+		else {
+			val = _plan_gen_val(plan, bin->op, random, compression_ratio,
+					&total);
+		}
 
-		case BIN_SPEC_TYPE_STR:
-			sprint(out_str, str_size, "S%u", bin->string.length);
-			break;
+		if (val == NULL) {
+			return -1;
+		}
 
-		case BIN_SPEC_TYPE_STR | BIN_SPEC_TYPE_CONST: {
-			int32_t len = (int32_t)
-				as_string_len((as_string*) &bin->const_string.val);
-			sprint(out_str, str_size, "\"%*.*s\"", len, len,
-					as_string_get(&bin->const_string.val));
-			break;
+		// equivalent to gen_bin_name, with the suffix already formatted
+		as_bin_name name;
+		size_t suffix_len = MIN(bin->suffix_len,
+				sizeof(as_bin_name) - 1 - base_len);
+		memcpy(name, bin_name, base_len);
+		memcpy(name + base_len, bin->suffix, suffix_len);
+		name[base_len + suffix_len] = '\0';
+
+		if (!as_record_set(rec, name, (as_bin_value*) val)) {
+			// failed to set a record, meaning we ran out of space
+			fprintf(stderr, "Not enough free bin slots in record\n");
+			as_val_destroy(val);
+			return -1;
 		}
+	}
 
+	if (size != NULL) {
+		*size = total;
+	}
+	return 0;
+}
+
+/*
+ * compiles the top-level bin_specs of an obj_spec into a generation plan
+ */
+LOCAL_HELPER struct gen_plan_s*
+_plan_create(const struct bin_spec_s* bin_specs, uint32_t n_bins)
+{
+	struct gen_plan_s* plan =
+		(struct gen_plan_s*) cf_malloc(sizeof(struct gen_plan_s));
+
+	plan->n_ops = 0;
+	plan->max_depth = 0;
+	for (uint32_t i = 0, cnt = 0; cnt < n_bins; i++) {
+		cnt += bin_specs[i].n_repeats;
+		plan->n_ops += _plan_count_ops(&bin_specs[i], 0, &plan->max_depth);
+	}
+
+	plan->ops = (struct gen_op_s*)
+		cf_malloc(MAX(plan->n_ops, 1) * sizeof(struct gen_op_s));
+	plan->bins = (struct gen_plan_bin_s*)
+		cf_malloc(MAX(n_bins, 1) * sizeof(struct gen_plan_bin_s));
+
+	uint32_t op_idx = 0;
+	for (uint32_t i = 0, cnt = 0; cnt < n_bins; i++) {
+		uint32_t root = op_idx;
+		_plan_compile_op(plan->ops, &op_idx, &bin_specs[i]);
+
+		// every repeat of a top-level bin_spec is its own bin, generated by
+		// the same op
+		for (uint32_t j = 0; j < bin_specs[i].n_repeats; j++, cnt++) {
+			struct gen_plan_bin_s* bin = &plan->bins[cnt];
+
+			bin->op = root;
+			if (cnt == 0) {
+				bin->suffix[0] = '\0';
+			}
+			else {
+				snprintf(bin->suffix, sizeof(bin->suffix), "_%u", cnt + 1);
+			}
+			bin->suffix_len = (uint8_t) strlen(bin->suffix);
+		}
+	}
+
+	// find out how as_orderedmap marks itself as key-ordered on the wire by
+	// packing an empty one, so packed maps can do the same
+	as_orderedmap empty;
+	uint8_t buf[1 + GEN_PLAN_MAP_PREAMBLE_MAX];
+	as_packer pk = { .buffer = buf, .offset = 0, .capacity = sizeof(buf) };
+
+	as_orderedmap_init(&empty, 1);
+	plan->map_preamble_len = 0;
+	plan->map_count_extra = 0;
+	if (as_pack_val(&pk, (as_val*) &empty) == 0 && (buf[0] & 0xf0) == 0x80) {
+		// a fixmap header, counting only the elements of the preamble
+		plan->map_count_extra = buf[0] & 0x0f;
+		plan->map_preamble_len = (uint8_t) (pk.offset - 1);
+		memcpy(plan->map_preamble, buf + 1, plan->map_preamble_len);
+	}
+	as_orderedmap_destroy(&empty);
+
+	return plan;
+}
+
+LOCAL_HELPER void
+_plan_free(struct gen_plan_s* plan)
+{
+	cf_free(plan->ops);
+	cf_free(plan->bins);
+	cf_free(plan);
+}
+
+/*
+ * the number of ops bin_spec compiles to, updating max_depth with the
+ * deepest list/map nesting found
+ */
+LOCAL_HELPER uint32_t
+_plan_count_ops(const struct bin_spec_s* bin_spec, uint32_t depth,
+		uint32_t* max_depth)
+{
+	uint32_t n_ops = 1;
+
+	switch (bin_spec->type) {
+		case BIN_SPEC_TYPE_LIST:
+			*max_depth = MAX(*max_depth, depth + 1);
+			for (uint32_t i = 0, cnt = 0; cnt < bin_spec->list.length; i++) {
+				cnt += bin_spec->list.list[i].n_repeats;
+				n_ops += _plan_count_ops(&bin_spec->list.list[i], depth + 1,
+						max_depth);
+			}
+			break;
+
+		case BIN_SPEC_TYPE_MAP:
+			*max_depth = MAX(*max_depth, depth + 1);
+			for (uint32_t i = 0; i < bin_spec->map.n_entries; i++) {
+				n_ops += _plan_count_ops(&bin_spec->map.kv_pairs[i].key,
+						depth + 1, max_depth);
+				n_ops += _plan_count_ops(&bin_spec->map.kv_pairs[i].val,
+						depth + 1, max_depth);
+			}
+			break;
+	}
+	return n_ops;
+}
+
+/*
+ * compiles bin_spec into ops starting at *idx, in pre-order, advancing *idx
+ * past them
+ */
+LOCAL_HELPER void
+_plan_compile_op(struct gen_op_s* ops, uint32_t* idx,
+		const struct bin_spec_s* bin_spec)
+{
+	uint32_t op_idx = (*idx)++;
+	struct gen_op_s* op = &ops[op_idx];
+
+	op->type = bin_spec->type;
+	op->range = 0;
+	op->n_repeats = bin_spec->n_repeats;
+	op->length = 0;
+	op->dist = NULL;
+	op->const_val = NULL;
+
+	switch (bin_spec->type) {
+		case BIN_SPEC_TYPE_BOOL:
+		case BIN_SPEC_TYPE_DOUBLE:
+			break;
+
+		case BIN_SPEC_TYPE_INT:
+			op->range = bin_spec->integer.range;
+			break;
+
+		case BIN_SPEC_TYPE_STR:
+			op->length = bin_spec->string.length;
+			op->dist = bin_spec->string.dist;
+			break;
+
+		case BIN_SPEC_TYPE_BYTES:
+			op->length = bin_spec->bytes.length;
+			op->dist = bin_spec->bytes.dist;
+			break;
+
+		case BIN_SPEC_TYPE_LIST:
+			op->length = bin_spec->list.length;
+			for (uint32_t i = 0, cnt = 0; cnt < bin_spec->list.length; i++) {
+				cnt += bin_spec->list.list[i].n_repeats;
+				_plan_compile_op(ops, idx, &bin_spec->list.list[i]);
+			}
+			break;
+
+		case BIN_SPEC_TYPE_MAP:
+			op->length = bin_spec->map.length;
+			for (uint32_t i = 0; i < bin_spec->map.n_entries; i++) {
+				_plan_compile_op(ops, idx, &bin_spec->map.kv_pairs[i].key);
+				_plan_compile_op(ops, idx, &bin_spec->map.kv_pairs[i].val);
+			}
+			break;
+
+		case BIN_SPEC_TYPE_BOOL | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_bool.val;
+			break;
+
+		case BIN_SPEC_TYPE_INT | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_integer.val;
+			break;
+
+		case BIN_SPEC_TYPE_STR | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_string.val;
+			break;
+
+		case BIN_SPEC_TYPE_DOUBLE | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_double.val;
+			break;
+
+		case BIN_SPEC_TYPE_LIST | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_list.val;
+			break;
+
+		case BIN_SPEC_TYPE_MAP | BIN_SPEC_TYPE_CONST:
+			op->const_val = (as_val*) &bin_spec->const_map.val;
+			break;
+	}
+	op->end = *idx;
+
+	_plan_pack_bounds(ops, op_idx);
+}
+
+LOCAL_HELPER as_val*
+_plan_gen_scalar(const struct gen_op_s* op, as_random* random,
+		float compression_ratio)
+{
+	as_val* val;
+
+	switch (op->type) {
+		case BIN_SPEC_TYPE_BOOL:
+			return _gen_random_bool(random);
+
+		case BIN_SPEC_TYPE_INT:
+			return _gen_random_int(op->range, random);
+
+		case BIN_SPEC_TYPE_STR:
+			return _gen_random_str(_gen_len(op->length, op->dist, random),
+					random);
+
+		case BIN_SPEC_TYPE_BYTES:
+			return _gen_random_bytes(_gen_len(op->length, op->dist, random),
+					random, compression_ratio);
+
+		case BIN_SPEC_TYPE_DOUBLE:
+			return _gen_random_double(random);
+
+		default:
+			if (op->const_val == NULL) {
+				fprintf(stderr, "Unknown bin_spec type (0x%x)\n", op->type);
+				return NULL;
+			}
+			val = op->const_val;
+			as_val_reserve(val);
+			return val;
+	}
+}
+
+/*
+ * generates a value from the subtree of ops rooted at root. This produces
+ * exactly what bin_spec_random_val would for the bin_spec the ops were
+ * compiled from, drawing from random in the same order, but with an explicit
+ * stack of the lists/maps being built in place of recursion. Adds the
+ * obj_spec_val_size of the value to size as it goes
+ */
+LOCAL_HELPER as_val*
+_plan_gen_val(const struct gen_plan_s* plan, uint32_t root, as_random* random,
+		float compression_ratio, uint64_t* size)
+{
+	const struct gen_op_s* ops = plan->ops;
+	struct gen_frame_s stack[MAX(plan->max_depth, 1)];
+	int32_t depth = -1;
+	uint32_t i = root;
+
+	for (;;) {
+		const struct gen_op_s* op = &ops[i];
+		as_val* val = NULL;
+
+		if (op->type == BIN_SPEC_TYPE_LIST || op->type == BIN_SPEC_TYPE_MAP) {
+			struct gen_frame_s* frame = &stack[++depth];
+
+			frame->is_map = op->type == BIN_SPEC_TYPE_MAP;
+			frame->val = frame->is_map ?
+				(as_val*) as_orderedmap_new(2 * op->length) :
+				(as_val*) as_arraylist_new(op->length, 0);
+			frame->op = i + 1;
+			frame->end = op->end;
+			frame->rep = 0;
+			frame->key = NULL;
+			frame->retries = 0;
+		}
+		else {
+			val = _plan_gen_scalar(op, random, compression_ratio);
+			if (val == NULL) {
+				for (; depth >= 0; depth--) {
+					if (stack[depth].key != NULL) {
+						as_val_destroy(stack[depth].key);
+					}
+					as_val_destroy(stack[depth].val);
+				}
+				return NULL;
+			}
+			*size += obj_spec_val_size(val);
+		}
+
+		// hand finished values up to their parents, and pick the next op to
+		// run from the innermost unfinished list/map
+		for (;;) {
+			if (val != NULL) {
+				if (depth < 0) {
+					return val;
+				}
+
+				struct gen_frame_s* frame = &stack[depth];
+				if (!frame->is_map) {
+					as_list_append((as_list*) frame->val, val);
+					frame->rep++;
+				}
+				else if (frame->key != NULL) {
+					as_orderedmap_set((as_orderedmap*) frame->val, frame->key,
+							val);
+					frame->key = NULL;
+					frame->rep++;
+				}
+				else if (as_orderedmap_get((as_orderedmap*) frame->val,
+							val) == NULL) {
+					frame->key = val;
+				}
+				else {
+					// a duplicate key, which was counted when it was made
+					*size -= obj_spec_val_size(val);
+					as_val_destroy(val);
+					if (++frame->retries >= MAX_KEY_ENTRY_RETRIES) {
+						// give up on the rest of this kv pair
+						frame->rep = ops[frame->op].n_repeats;
+					}
+				}
+				val = NULL;
+			}
+
+			struct gen_frame_s* frame = &stack[depth];
+			if (frame->key != NULL) {
+				// the value op directly follows the key's subtree
+				i = ops[frame->op].end;
+				break;
+			}
+
+			while (frame->op != frame->end &&
+					frame->rep >= ops[frame->op].n_repeats) {
+				// move on to the next element, or the next kv pair
+				frame->op = frame->is_map ?
+					ops[ops[frame->op].end].end : ops[frame->op].end;
+				frame->rep = 0;
+				frame->retries = 0;
+			}
+
+			if (frame->op != frame->end) {
+				i = frame->op;
+				break;
+			}
+
+			// this list/map is complete
+			val = frame->val;
+			depth--;
+		}
+	}
+}
+
+/*
+ * sets the packing bounds of ops[idx], whose children must already have
+ * theirs set
+ */
+LOCAL_HELPER void
+_plan_pack_bounds(struct gen_op_s* ops, uint32_t idx)
+{
+	struct gen_op_s* op = &ops[idx];
+	uint32_t max_len;
+
+	op->pack_size = 0;
+	op->pack_scratch = 0;
+	op->pack_entries = 0;
+
+	switch (op->type) {
+		case BIN_SPEC_TYPE_BOOL:
+			op->pack_size = 1;
+			break;
+
+		case BIN_SPEC_TYPE_INT:
+		case BIN_SPEC_TYPE_DOUBLE:
+			op->pack_size = PACK_NUMBER_MAX;
+			break;
+
+		case BIN_SPEC_TYPE_STR:
 		case BIN_SPEC_TYPE_BYTES:
-			sprint(out_str, str_size, "B%u", bin->bytes.length);
+			// the value is generated in scratch space before being packed
+			max_len = op->dist == NULL ? op->length : op->dist->max_len;
+			op->pack_size = PACK_HEADER_MAX + PACK_PARTICLE_TYPE_SIZE + max_len;
+			op->pack_scratch = max_len;
+			break;
+
+		case BIN_SPEC_TYPE_LIST:
+			for (uint32_t i = idx + 1; i < op->end; i = ops[i].end) {
+				const struct gen_op_s* ele = &ops[i];
+
+				op->pack_size += ele->n_repeats * ele->pack_size;
+				op->pack_scratch = MAX(op->pack_scratch, ele->pack_scratch);
+				op->pack_entries = MAX(op->pack_entries, ele->pack_entries);
+			}
+			op->pack_size += PACK_HEADER_MAX;
+			break;
+
+		case BIN_SPEC_TYPE_MAP:
+			for (uint32_t i = idx + 1; i < op->end; i = ops[ops[i].end].end) {
+				const struct gen_op_s* key = &ops[i];
+				const struct gen_op_s* val = &ops[key->end];
+
+				op->pack_size += key->n_repeats *
+					(key->pack_size + val->pack_size);
+				op->pack_scratch = MAX(op->pack_scratch,
+						MAX(key->pack_scratch, val->pack_scratch));
+				op->pack_entries = MAX(op->pack_entries,
+						MAX(key->pack_entries, val->pack_entries));
+			}
+			// the entries are moved through scratch space to sort them
+			op->pack_scratch = MAX(op->pack_scratch, op->pack_size);
+			op->pack_entries += op->length;
+			op->pack_size += PACK_HEADER_MAX + GEN_PLAN_MAP_PREAMBLE_MAX;
+			break;
+
+		default:
+			// consts are packed as they are, so just measure them
+			if (op->const_val != NULL) {
+				as_packer pk = { .buffer = NULL, .offset = 0,
+					.capacity = INT_MAX };
+
+				as_pack_val(&pk, op->const_val);
+				op->pack_size = pk.offset;
+			}
+			break;
+	}
+}
+
+/*
+ * packs a value from a scalar op, generating strings and bytes in scratch
+ * first so the only allocation is the output buffer
+ */
+LOCAL_HELPER int
+_plan_pack_scalar(const struct gen_op_s* op, as_random* random,
+		float compression_ratio, as_packer* pk, uint8_t* scratch)
+{
+	as_boolean b;
+	as_integer i;
+	as_double d;
+	as_string str;
+	as_bytes bytes;
+	uint32_t len;
+	uint64_t r;
+
+	switch (op->type) {
+		case BIN_SPEC_TYPE_BOOL:
+			as_boolean_init(&b, (as_random_next_uint32(random) & 1) != 0);
+			return as_pack_val(pk, (as_val*) &b);
+
+		case BIN_SPEC_TYPE_INT:
+			as_integer_init(&i, (int64_t) _rand_int(op->range, random));
+			return as_pack_val(pk, (as_val*) &i);
+
+		case BIN_SPEC_TYPE_STR:
+			len = _gen_len(op->length, op->dist, random);
+			_fill_random_str((char*) scratch, len, random);
+			as_string_init_wlen(&str, (char*) scratch, len, false);
+			return as_pack_val(pk, (as_val*) &str);
+
+		case BIN_SPEC_TYPE_BYTES:
+			len = _gen_len(op->length, op->dist, random);
+			_fill_random_bytes(scratch, len, random, compression_ratio);
+			as_bytes_init_wrap(&bytes, scratch, len, false);
+			return as_pack_val(pk, (as_val*) &bytes);
+
+		case BIN_SPEC_TYPE_DOUBLE:
+			r = as_random_next_uint64(random);
+			as_double_init(&d, *(double*) &r);
+			return as_pack_val(pk, (as_val*) &d);
+
+		default:
+			if (op->const_val == NULL) {
+				fprintf(stderr, "Unknown bin_spec type (0x%x)\n", op->type);
+				return -1;
+			}
+			return as_pack_val(pk, op->const_val);
+	}
+}
+
+/*
+ * binary searches entries [lo, hi), which are sorted by key, for the packed
+ * key at key_off in buf. Returns true if the key is already there, otherwise
+ * sets pos to where it should be inserted
+ */
+LOCAL_HELPER bool
+_plan_find_key(const uint8_t* buf, const struct pack_entry_s* entries,
+		uint32_t lo, uint32_t hi, uint32_t key_off, uint32_t key_len,
+		uint32_t* pos)
+{
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		const struct pack_entry_s* e = &entries[mid];
+		msgpack_compare_t cmp = as_unpack_buf_compare(buf + key_off, key_len,
+				buf + e->key_off, e->key_len);
+
+		if (cmp == MSGPACK_COMPARE_EQUAL) {
+			return true;
+		}
+		if (cmp == MSGPACK_COMPARE_LESS) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+	*pos = lo;
+	return false;
+}
+
+/*
+ * rewrites the entries packed so far for the map in frame, in the order they
+ * were generated, as a complete map with its entries sorted by key
+ */
+LOCAL_HELPER void
+_plan_pack_map_finish(const struct gen_plan_s* plan,
+		const struct pack_frame_s* frame, as_packer* pk,
+		const struct pack_entry_s* entries, uint32_t n_entries,
+		uint8_t* scratch)
+{
+	memcpy(scratch, pk->buffer + frame->start, pk->offset - frame->start);
+	pk->offset = frame->start;
+
+	as_pack_map_header(pk, n_entries + plan->map_count_extra);
+	memcpy(pk->buffer + pk->offset, plan->map_preamble,
+			plan->map_preamble_len);
+	pk->offset += plan->map_preamble_len;
+
+	for (uint32_t i = 0; i < n_entries; i++) {
+		const struct pack_entry_s* e = &entries[i];
+		uint32_t sz = e->key_len + e->val_len;
+
+		memcpy(pk->buffer + pk->offset, scratch + (e->key_off - frame->start),
+				sz);
+		pk->offset += sz;
+	}
+}
+
+/*
+ * generates a list/map value from the subtree of ops rooted at root, like
+ * _plan_gen_val does, but packs it straight to msgpack rather than building
+ * it out of as_vals. The result is an as_bytes of type AS_BYTES_LIST or
+ * AS_BYTES_MAP, which decodes to the same value _plan_gen_val would have
+ * generated
+ */
+LOCAL_HELPER as_val*
+_plan_pack_val(const struct gen_plan_s* plan, uint32_t root, as_random* random,
+		float compression_ratio)
+{
+	const struct gen_op_s* ops = plan->ops;
+	const struct gen_op_s* root_op = &ops[root];
+
+	// the output, the stack of pending map entries and the scratch space all
+	// share one allocation, with the output first so the as_bytes can own it
+	size_t entries_off = (root_op->pack_size + 7) & ~7LU;
+	size_t scratch_off = entries_off +
+		root_op->pack_entries * sizeof(struct pack_entry_s);
+	uint8_t* buf = (uint8_t*) cf_malloc(scratch_off + root_op->pack_scratch);
+	struct pack_entry_s* entries = (struct pack_entry_s*) (buf + entries_off);
+	uint8_t* scratch = buf + scratch_off;
+	uint32_t n_entries = 0;
+
+	as_packer pk = { .buffer = buf, .offset = 0,
+		.capacity = (uint32_t) root_op->pack_size };
+	struct pack_frame_s stack[MAX(plan->max_depth, 1)];
+	int32_t depth = -1;
+	uint32_t i = root;
+
+	for (;;) {
+		const struct gen_op_s* op = &ops[i];
+		bool packed = false;
+
+		if (op->type == BIN_SPEC_TYPE_LIST || op->type == BIN_SPEC_TYPE_MAP) {
+			struct pack_frame_s* frame = &stack[++depth];
+
+			frame->is_map = op->type == BIN_SPEC_TYPE_MAP;
+			frame->op = i + 1;
+			frame->end = op->end;
+			frame->rep = 0;
+			frame->retries = 0;
+			if (frame->is_map) {
+				// the header goes in once the number of entries is known
+				frame->start = pk.offset;
+				frame->cur = pk.offset;
+				frame->entry_base = n_entries;
+				frame->pending = UINT32_MAX;
+			}
+			else {
+				as_pack_list_header(&pk, op->length);
+			}
+		}
+		else {
+			if (_plan_pack_scalar(op, random, compression_ratio, &pk,
+						scratch) != 0) {
+				cf_free(buf);
+				return NULL;
+			}
+			packed = true;
+		}
+
+		// same as in _plan_gen_val, with values handed to their parents by
+		// recording where they were packed
+		for (;;) {
+			if (packed) {
+				if (depth < 0) {
+					as_bytes* bytes = as_bytes_new_wrap(buf, pk.offset, true);
+					as_bytes_set_type(bytes,
+							root_op->type == BIN_SPEC_TYPE_LIST ?
+							AS_BYTES_LIST : AS_BYTES_MAP);
+					return (as_val*) bytes;
+				}
+
+				struct pack_frame_s* frame = &stack[depth];
+				uint32_t pos;
+
+				if (!frame->is_map) {
+					frame->rep++;
+				}
+				else if (frame->pending != UINT32_MAX) {
+					struct pack_entry_s* e = &entries[frame->pending];
+
+					e->val_len = pk.offset - e->key_off - e->key_len;
+					frame->pending = UINT32_MAX;
+					frame->cur = pk.offset;
+					frame->rep++;
+				}
+				else if (!_plan_find_key(buf, entries, frame->entry_base,
+							n_entries, frame->cur, pk.offset - frame->cur,
+							&pos)) {
+					memmove(&entries[pos + 1], &entries[pos],
+							(n_entries - pos) * sizeof(struct pack_entry_s));
+					n_entries++;
+					entries[pos].key_off = frame->cur;
+					entries[pos].key_len = pk.offset - frame->cur;
+					entries[pos].val_len = 0;
+					frame->pending = pos;
+				}
+				else {
+					// duplicate key, drop it
+					pk.offset = frame->cur;
+					if (++frame->retries >= MAX_KEY_ENTRY_RETRIES) {
+						frame->rep = ops[frame->op].n_repeats;
+					}
+				}
+				packed = false;
+			}
+
+			struct pack_frame_s* frame = &stack[depth];
+			if (frame->is_map && frame->pending != UINT32_MAX) {
+				i = ops[frame->op].end;
+				break;
+			}
+
+			while (frame->op != frame->end &&
+					frame->rep >= ops[frame->op].n_repeats) {
+				frame->op = frame->is_map ?
+					ops[ops[frame->op].end].end : ops[frame->op].end;
+				frame->rep = 0;
+				frame->retries = 0;
+			}
+
+			if (frame->op != frame->end) {
+				i = frame->op;
+				break;
+			}
+
+			// this list/map is complete
+			if (frame->is_map) {
+				_plan_pack_map_finish(plan, frame, &pk,
+						&entries[frame->entry_base],
+						n_entries - frame->entry_base, scratch);
+				n_entries = frame->entry_base;
+			}
+			depth--;
+			packed = true;
+		}
+	}
+}
+
+LOCAL_HELPER size_t
+_sprint_bin(const struct bin_spec_s* bin, char** out_str, size_t str_size)
+{
+	if (bin->n_repeats != 1) {
+		sprint(out_str, str_size, "%d*", bin->n_repeats);
+	}
+	switch (bin->type) {
+		case BIN_SPEC_TYPE_BOOL:
+			sprint(out_str, str_size, "b");
+			break;
+
+		case BIN_SPEC_TYPE_BOOL | BIN_SPEC_TYPE_CONST:
+			sprint(out_str, str_size, "%s", boolstring(as_boolean_get(&bin->const_bool.val)));
+			break;
+
+		case BIN_SPEC_TYPE_INT:
+			sprint(out_str, str_size, "I%d", bin->integer.range + 1);
+			break;
+
+		case BIN_SPEC_TYPE_INT | BIN_SPEC_TYPE_CONST:
+			sprint(out_str, str_size, "%" PRId64, as_integer_get(&bin->const_integer.val));
+			break;
+
+		case BIN_SPEC_TYPE_STR:
+			if (bin->string.dist != NULL) {
+				sprint(out_str, str_size, "S%s", bin->string.dist_str);
+			}
+			else {
+				sprint(out_str, str_size, "S%u", bin->string.length);
+			}
+			break;
+
+		case BIN_SPEC_TYPE_STR | BIN_SPEC_TYPE_CONST: {
+			int32_t len = (int32_t)
+				as_string_len((as_string*) &bin->const_string.val);
+			sprint(out_str, str_size, "\"%*.*s\"", len, len,
+					as_string_get(&bin->const_string.val));
+			break;
+		}
+
+		case BIN_SPEC_TYPE_BYTES:
+			if (bin->bytes.dist != NULL) {
+				sprint(out_str, str_size, "B%s", bin->bytes.dist_str);
+			}
+			else {
+				sprint(out_str, str_size, "B%u", bin->bytes.length);
+			}
 			break;
 
 		case BIN_SPEC_TYPE_DOUBLE:
@@ -2117,12 +3220,19 @@ _dbg_validate_int(uint8_t range, as_integer* as_val, bool do_assert)
 }
 
 LOCAL_HELPER bool
-_dbg_validate_string(uint32_t length, as_string* as_val, bool do_assert)
+_dbg_validate_string(uint32_t min_len, uint32_t max_len, as_string* as_val,
+		bool do_assert)
 {
 	do_ck_assert_msg(as_val != NULL, "Expected a string, got something else");
 
 	size_t str_len = as_string_len(as_val);
-	do_ck_assert_int_eq(length, str_len);
+	if (min_len == max_len) {
+		do_ck_assert_int_eq(min_len, str_len);
+	}
+	else {
+		do_ck_assert_msg(min_len <= str_len && str_len <= max_len,
+				"String length %zu not in [%u, %u]", str_len, min_len, max_len);
+	}
 
 	for (uint32_t i = 0; i < str_len; i++) {
 		char c = as_string_get(as_val)[i];
@@ -2132,11 +3242,19 @@ _dbg_validate_string(uint32_t length, as_string* as_val, bool do_assert)
 }
 
 LOCAL_HELPER bool
-_dbg_validate_bytes(uint32_t length, as_bytes* as_val, bool do_assert)
+_dbg_validate_bytes(uint32_t min_len, uint32_t max_len, as_bytes* as_val,
+		bool do_assert)
 {
 	do_ck_assert_msg(as_val != NULL, "Expected a bytes array, got something else");
 
-	do_ck_assert_int_eq(length, as_bytes_size(as_val));
+	uint32_t bytes_len = as_bytes_size(as_val);
+	if (min_len == max_len) {
+		do_ck_assert_int_eq(min_len, bytes_len);
+	}
+	else {
+		do_ck_assert_msg(min_len <= bytes_len && bytes_len <= max_len,
+				"Bytes length %u not in [%u, %u]", bytes_len, min_len, max_len);
+	}
 	return true;
 }
 
@@ -0,0 +1,324 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <perf_counters.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const perf_op_strs[PERF_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+#ifdef __linux__
+static const uint64_t perf_ev_configs[PERF_EV_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+#endif /* __linux__ */
+
+/*
+ * the layout of a read from a group leader opened with PERF_FORMAT_GROUP,
+ * PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+ */
+struct perf_group_read_s {
+	uint64_t nr;
+	uint64_t time_enabled;
+	uint64_t time_running;
+	uint64_t values[PERF_EV_COUNT];
+};
+
+// instance ids start at 1 so a thread that has never opened counters
+// (tl_id == 0) never matches
+static _Atomic(uint64_t) next_id = 1;
+
+// the counters the calling thread owns in the instance with id tl_id
+static __thread uint64_t tl_id;
+static __thread struct perf_counters_thread_s* tl_thread;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER bool _open_group(int* fds, int* err);
+LOCAL_HELPER void _close_group(int* fds);
+LOCAL_HELPER bool _read_group(const struct perf_counters_thread_s* t,
+		struct perf_group_read_s* buf);
+
+
+//==========================================================
+// Public API.
+//
+
+perf_counters_t*
+perf_counters_create(uint32_t sample_every)
+{
+	perf_counters_t* pc = (perf_counters_t*) cf_malloc(sizeof(perf_counters_t));
+
+	pc->sample_every = sample_every;
+	pc->id = atomic_fetch_add(&next_id, 1);
+	atomic_init(&pc->unavailable, false);
+	atomic_init(&pc->n_threads, 0);
+	for (uint32_t i = 0; i < PERF_COUNTERS_MAX_THREADS; i++) {
+		atomic_init(&pc->threads[i], NULL);
+	}
+	return pc;
+}
+
+void
+perf_counters_free(perf_counters_t* pc)
+{
+	uint32_t n = MIN(pc->n_threads, PERF_COUNTERS_MAX_THREADS);
+
+	for (uint32_t i = 0; i < n; i++) {
+		struct perf_counters_thread_s* t = pc->threads[i];
+		if (t != NULL) {
+			_close_group(t->fds);
+			cf_free(t);
+		}
+	}
+	cf_free(pc);
+}
+
+bool
+perf_counters_thread_init(perf_counters_t* pc)
+{
+	// a thread whose counters can't be opened is never measured
+	tl_id = pc->id;
+	tl_thread = NULL;
+
+	// if one thread couldn't open them, none of the others can either
+	if (atomic_load(&pc->unavailable)) {
+		return false;
+	}
+
+	struct perf_counters_thread_s* t = (struct perf_counters_thread_s*)
+		cf_malloc(sizeof(struct perf_counters_thread_s));
+	int err;
+
+	if (!_open_group(t->fds, &err)) {
+		if (!atomic_exchange(&pc->unavailable, true)) {
+			blog_warn("Hardware performance counters are unavailable (%s), "
+					"transactions won't be measured\n", strerror(err));
+		}
+		cf_free(t);
+		return false;
+	}
+
+	uint32_t idx = atomic_fetch_add(&pc->n_threads, 1);
+	if (idx >= PERF_COUNTERS_MAX_THREADS) {
+		_close_group(t->fds);
+		cf_free(t);
+		return false;
+	}
+
+	t->countdown = 0;
+	t->measuring = false;
+	for (uint32_t op = 0; op < PERF_OP_COUNT; op++) {
+		atomic_init(&t->ops[op].count, 0);
+		for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+			atomic_init(&t->ops[op].events[ev], 0);
+		}
+	}
+
+	atomic_store_explicit(&pc->threads[idx], t, memory_order_release);
+	tl_thread = t;
+	return true;
+}
+
+void
+perf_counters_begin(perf_counters_t* pc)
+{
+	struct perf_counters_thread_s* t = tl_id == pc->id ? tl_thread : NULL;
+	if (t == NULL) {
+		return;
+	}
+
+	t->measuring = false;
+	if (t->countdown != 0) {
+		t->countdown--;
+		return;
+	}
+	t->countdown = pc->sample_every - 1;
+
+	struct perf_group_read_s buf;
+	if (!_read_group(t, &buf)) {
+		return;
+	}
+	memcpy(t->start, buf.values, sizeof(t->start));
+	t->start_enabled = buf.time_enabled;
+	t->start_running = buf.time_running;
+	t->measuring = true;
+}
+
+void
+perf_counters_end(perf_counters_t* pc, perf_op_t op)
+{
+	struct perf_counters_thread_s* t = tl_id == pc->id ? tl_thread : NULL;
+	if (t == NULL || !t->measuring) {
+		return;
+	}
+	t->measuring = false;
+
+	struct perf_group_read_s buf;
+	if (!_read_group(t, &buf)) {
+		return;
+	}
+
+	uint64_t enabled = buf.time_enabled - t->start_enabled;
+	uint64_t running = buf.time_running - t->start_running;
+
+	// the group wasn't on the PMU at all while the transaction ran
+	if (running == 0) {
+		return;
+	}
+
+	struct perf_op_stats_s* stats = &t->ops[op];
+	for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+		uint64_t delta = buf.values[ev] - t->start[ev];
+
+		// scale up for the time the group was multiplexed out
+		if (running < enabled) {
+			delta = (uint64_t) ((double) delta * enabled / running);
+		}
+		atomic_fetch_add_explicit(&stats->events[ev], delta,
+				memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&stats->count, 1, memory_order_relaxed);
+}
+
+void
+perf_counters_print_period(perf_counters_t* pc)
+{
+	uint32_t n_threads = MIN(pc->n_threads, PERF_COUNTERS_MAX_THREADS);
+	uint64_t counts[PERF_OP_COUNT] = { 0 };
+	uint64_t events[PERF_OP_COUNT][PERF_EV_COUNT] = { { 0 } };
+	bool any = false;
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		struct perf_counters_thread_s* t = pc->threads[i];
+		if (t == NULL) {
+			continue;
+		}
+		for (uint32_t op = 0; op < PERF_OP_COUNT; op++) {
+			counts[op] += atomic_exchange(&t->ops[op].count, 0);
+			for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+				events[op][ev] += atomic_exchange(&t->ops[op].events[ev], 0);
+			}
+			any = any || counts[op] != 0;
+		}
+	}
+
+	if (!any) {
+		return;
+	}
+
+	blog_info("");
+	printf("perf ");
+	for (uint32_t op = 0; op < PERF_OP_COUNT; op++) {
+		uint64_t* ev = events[op];
+		double n = (double) counts[op];
+
+		if (counts[op] == 0) {
+			continue;
+		}
+		printf("%s(cycles=%.0f instructions=%.0f ipc=%.2f cache-misses=%.1f "
+				"branch-misses=%.1f) ",
+				perf_op_strs[op], ev[PERF_EV_CYCLES] / n,
+				ev[PERF_EV_INSTRUCTIONS] / n,
+				ev[PERF_EV_CYCLES] == 0 ? 0 :
+					(double) ev[PERF_EV_INSTRUCTIONS] / ev[PERF_EV_CYCLES],
+				ev[PERF_EV_CACHE_MISSES] / n, ev[PERF_EV_BRANCH_MISSES] / n);
+	}
+	printf("\n");
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * opens the counter group of the calling thread, with the cycle counter as
+ * the leader. On failure, returns false with the reason in err
+ */
+LOCAL_HELPER bool
+_open_group(int* fds, int* err)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// user space only, which is also all that perf_event_paranoid 2 allows
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+		fds[ev] = -1;
+	}
+	for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+		attr.config = perf_ev_configs[ev];
+		fds[ev] = (int) syscall(SYS_perf_event_open, &attr, 0, -1,
+				ev == 0 ? -1 : fds[0], PERF_FLAG_FD_CLOEXEC);
+		if (fds[ev] < 0) {
+			*err = errno;
+			_close_group(fds);
+			return false;
+		}
+	}
+	return true;
+#else
+	for (uint32_t ev = 0; ev < PERF_EV_COUNT; ev++) {
+		fds[ev] = -1;
+	}
+	*err = ENOSYS;
+	return false;
+#endif /* __linux__ */
+}
+
+LOCAL_HELPER void
+_close_group(int* fds)
+{
+	// members first, so the leader goes last
+	for (uint32_t ev = PERF_EV_COUNT; ev-- > 0; ) {
+		if (fds[ev] >= 0) {
+			close(fds[ev]);
+			fds[ev] = -1;
+		}
+	}
+}
+
+LOCAL_HELPER bool
+_read_group(const struct perf_counters_thread_s* t,
+		struct perf_group_read_s* buf)
+{
+	return read(t->fds[0], buf, sizeof(*buf)) == (ssize_t) sizeof(*buf) &&
+		buf->nr == PERF_EV_COUNT;
+}
+
@@ -0,0 +1,227 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <common.h>
+#include <proc_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// how often a process waiting for its next stage checks whether it's begun
+#define PROC_STATS_WAIT_NS 1000000
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER size_t _hdr_size(const struct hdr_histogram_bucket_config* cfg);
+LOCAL_HELPER void _add(struct proc_counts_s to[GROUP_OP_COUNT],
+		const struct interval_counts_s from[GROUP_OP_COUNT]);
+LOCAL_HELPER void _sum(proc_stats_t* stats, bool warmup,
+		struct interval_counts_s counts[GROUP_OP_COUNT]);
+LOCAL_HELPER uint64_t _load(_Atomic(uint64_t)* counter);
+
+
+//==========================================================
+// Public API.
+//
+
+proc_stats_t*
+proc_stats_create(uint32_t n_procs, const bool has_op[GROUP_OP_COUNT])
+{
+	// the same ranges as the histograms of a single process
+	struct hdr_histogram_bucket_config cfg;
+	hdr_calculate_bucket_config(1, 1000000, 3, &cfg);
+
+	uint32_t n_ops = 0;
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		n_ops += has_op[op] ? 1 : 0;
+	}
+
+	size_t header_size = sizeof(proc_stats_t) + n_procs * sizeof(proc_slot_t);
+	size_t hdr_size = _hdr_size(&cfg);
+	size_t size = header_size + n_procs * n_ops * hdr_size;
+
+	// anonymous memory starts out zeroed, which is where every counter starts
+	void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		perror("Unable to map shared memory for --processes");
+		return NULL;
+	}
+
+	proc_stats_t* stats = (proc_stats_t*) mem;
+	stats->n_procs = n_procs;
+	stats->size = size;
+
+	uint8_t* next_hdr = (uint8_t*) mem + header_size;
+	for (uint32_t i = 0; i < n_procs; i++) {
+		proc_slot_t* slot = proc_stats_slot(stats, i);
+
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			if (!has_op[op]) {
+				continue;
+			}
+
+			// the counts follow the histogram they belong to
+			struct hdr_histogram* h = (struct hdr_histogram*) next_hdr;
+			h->counts = (int64_t*) (next_hdr + sizeof(struct hdr_histogram));
+			hdr_init_preallocated(h, &cfg);
+
+			slot->hdrs[op] = h;
+			next_hdr += hdr_size;
+		}
+	}
+
+	return stats;
+}
+
+void
+proc_stats_free(proc_stats_t* stats)
+{
+	munmap(stats, stats->size);
+}
+
+void
+proc_stats_publish(proc_slot_t* slot,
+		const struct interval_counts_s counts[GROUP_OP_COUNT],
+		const struct interval_counts_s warmup_counts[GROUP_OP_COUNT])
+{
+	_add(slot->counts, counts);
+	_add(slot->warmup_counts, warmup_counts);
+}
+
+void
+proc_stats_sum(proc_stats_t* stats,
+		struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	_sum(stats, false, counts);
+}
+
+void
+proc_stats_sum_warmup(proc_stats_t* stats,
+		struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	_sum(stats, true, counts);
+}
+
+void
+proc_stats_merge_hdr(proc_stats_t* stats, group_op_t op,
+		struct hdr_histogram* into)
+{
+	hdr_reset(into);
+
+	for (uint32_t i = 0; i < stats->n_procs; i++) {
+		struct hdr_histogram* from = proc_stats_slot(stats, i)->hdrs[op];
+
+		// read while the process is still recording to it, like the
+		// periodic output of a single process does
+		if (from != NULL) {
+			hdr_add(into, from);
+		}
+	}
+}
+
+void
+proc_stats_wait_stage(proc_stats_t* stats, uint32_t idx, uint32_t stage_idx)
+{
+	const struct timespec wait = { 0, PROC_STATS_WAIT_NS };
+
+	atomic_store(&proc_stats_slot(stats, idx)->ready, stage_idx + 1);
+
+	while (atomic_load(&stats->released) < stage_idx + 1) {
+		nanosleep(&wait, NULL);
+	}
+}
+
+bool
+proc_stats_all_ready(proc_stats_t* stats, uint32_t stage_idx)
+{
+	for (uint32_t i = 0; i < stats->n_procs; i++) {
+		if (atomic_load(&proc_stats_slot(stats, i)->ready) < stage_idx + 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+proc_stats_release(proc_stats_t* stats, uint32_t stage_idx)
+{
+	atomic_store(&stats->released, stage_idx + 1);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * the space a histogram and its counts take up in the segment, rounded up so
+ * the next one is aligned
+ */
+LOCAL_HELPER size_t
+_hdr_size(const struct hdr_histogram_bucket_config* cfg)
+{
+	size_t size = sizeof(struct hdr_histogram) +
+		(size_t) cfg->counts_len * sizeof(int64_t);
+	size_t align = _Alignof(max_align_t);
+
+	return (size + align - 1) / align * align;
+}
+
+LOCAL_HELPER void
+_add(struct proc_counts_s to[GROUP_OP_COUNT],
+		const struct interval_counts_s from[GROUP_OP_COUNT])
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		atomic_fetch_add_explicit(&to[op].ok, from[op].ok,
+				memory_order_relaxed);
+		atomic_fetch_add_explicit(&to[op].miss, from[op].miss,
+				memory_order_relaxed);
+		atomic_fetch_add_explicit(&to[op].timeouts, from[op].timeouts,
+				memory_order_relaxed);
+		atomic_fetch_add_explicit(&to[op].errors, from[op].errors,
+				memory_order_relaxed);
+		atomic_fetch_add_explicit(&to[op].bytes, from[op].bytes,
+				memory_order_relaxed);
+	}
+}
+
+LOCAL_HELPER void
+_sum(proc_stats_t* stats, bool warmup,
+		struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	memset(counts, 0, GROUP_OP_COUNT * sizeof(struct interval_counts_s));
+
+	for (uint32_t i = 0; i < stats->n_procs; i++) {
+		proc_slot_t* slot = proc_stats_slot(stats, i);
+		struct proc_counts_s* from = warmup ?
+			slot->warmup_counts : slot->counts;
+
+		for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+			counts[op].ok += _load(&from[op].ok);
+			counts[op].miss += _load(&from[op].miss);
+			counts[op].timeouts += _load(&from[op].timeouts);
+			counts[op].errors += _load(&from[op].errors);
+			counts[op].bytes += _load(&from[op].bytes);
+		}
+	}
+}
+
+LOCAL_HELPER uint64_t
+_load(_Atomic(uint64_t)* counter)
+{
+	return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
@@ -0,0 +1,393 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <aerospike/as_sleep.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <instance.h>
+#include <processes.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// how often the parent checks on its workers, which is also how long a
+// stage may wait for the parent to start it
+#define PROCESSES_POLL_MS 10
+
+static const char* const proc_op_strs[GROUP_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+// the order the ops are printed in, the same as a single process's output
+static const group_op_t proc_print_order[GROUP_OP_COUNT] = {
+	GROUP_OP_WRITE,
+	GROUP_OP_READ,
+	GROUP_OP_UDF
+};
+
+typedef struct supervisor_s {
+	args_t* args;
+	proc_stats_t* stats;
+
+	// 0 once a worker has been reaped
+	pid_t* pids;
+	uint32_t n_running;
+	// set once a worker couldn't be started or didn't succeed
+	bool failed;
+
+	bool has_op[GROUP_OP_COUNT];
+	// the latencies of every worker merged, for printing
+	struct hdr_histogram* hdrs[GROUP_OP_COUNT];
+
+	// the workers' counters as of the last period printed, and those of
+	// their warmups
+	struct interval_counts_s prev[GROUP_OP_COUNT];
+	struct interval_counts_s prev_warmup[GROUP_OP_COUNT];
+	// what the workers did outside of their warmups, and how long it took
+	struct interval_counts_s total[GROUP_OP_COUNT];
+	uint64_t total_us;
+
+	uint64_t start_us;
+	uint64_t prev_us;
+	uint64_t gen_count;
+
+	// the first workload of the next stage to start
+	uint32_t next_stage;
+} supervisor_t;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER int _run_worker(args_t* args, proc_stats_t* stats, uint32_t idx);
+LOCAL_HELPER void _supervise(supervisor_t* sup);
+LOCAL_HELPER void _reap(supervisor_t* sup, int flags);
+LOCAL_HELPER void _stop_workers(supervisor_t* sup);
+LOCAL_HELPER void _start_next_stage(supervisor_t* sup);
+LOCAL_HELPER void _print_period(supervisor_t* sup);
+LOCAL_HELPER void _print_summary(supervisor_t* sup);
+LOCAL_HELPER bool _take_period(proc_stats_t* stats, bool warmup,
+		struct interval_counts_s prev[GROUP_OP_COUNT],
+		struct interval_counts_s period[GROUP_OP_COUNT]);
+LOCAL_HELPER void _print_latencies(supervisor_t* sup, uint64_t elapsed_s);
+
+
+//==========================================================
+// Public API.
+//
+
+int
+run_processes(args_t* args)
+{
+	uint32_t n_procs = (uint32_t) args->processes;
+	supervisor_t sup;
+
+	memset(&sup, 0, sizeof(supervisor_t));
+	sup.args = args;
+	sup.has_op[GROUP_OP_READ] = stages_contain_reads(&args->stages);
+	sup.has_op[GROUP_OP_WRITE] = stages_contain_writes(&args->stages);
+	sup.has_op[GROUP_OP_UDF] = stages_contain_udfs(&args->stages);
+
+	sup.stats = proc_stats_create(n_procs, sup.has_op);
+	if (sup.stats == NULL) {
+		return -1;
+	}
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (sup.has_op[op]) {
+			hdr_init(1, 1000000, 3, &sup.hdrs[op]);
+		}
+	}
+	sup.pids = (pid_t*) cf_calloc(n_procs, sizeof(pid_t));
+
+	// so the workers don't inherit output that's yet to be written
+	fflush(stdout);
+	fflush(stderr);
+
+	for (uint32_t i = 0; i < n_procs; i++) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			exit(_run_worker(args, sup.stats, i));
+		}
+		if (pid < 0) {
+			fprintf(stderr, "Unable to start worker process %u: %s\n", i,
+					strerror(errno));
+			sup.failed = true;
+			break;
+		}
+		sup.pids[i] = pid;
+		sup.n_running++;
+	}
+
+	if (!sup.failed) {
+		blog_info("Started %u worker processes\n", n_procs);
+		_supervise(&sup);
+	}
+
+	if (sup.failed) {
+		_stop_workers(&sup);
+	}
+	else {
+		_print_summary(&sup);
+	}
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (sup.hdrs[op] != NULL) {
+			hdr_close(sup.hdrs[op]);
+		}
+	}
+	cf_free(sup.pids);
+	proc_stats_free(sup.stats);
+
+	return sup.failed ? -1 : 0;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * what a worker process does once it's been forked, returning its exit code
+ */
+LOCAL_HELPER int
+_run_worker(args_t* args, proc_stats_t* stats, uint32_t idx)
+{
+	// each worker takes its share of whatever this instance was given
+	if (instance_shard_stages(&args->stages, idx, stats->n_procs) != 0) {
+		return 1;
+	}
+
+	args->proc_stats = stats;
+	args->proc_idx = idx;
+	// the parent prints the latencies, so they're always recorded
+	args->latency = true;
+
+	return run_benchmark(args) == 0 ? 0 : 1;
+}
+
+/*
+ * starts each stage once the workers are ready for it and prints their stats
+ * every second, until every worker has exited or one has failed
+ */
+LOCAL_HELPER void
+_supervise(supervisor_t* sup)
+{
+	sup->start_us = cf_getus();
+	sup->prev_us = sup->start_us;
+
+	while (sup->n_running > 0 && !sup->failed) {
+		as_sleep(PROCESSES_POLL_MS);
+
+		_reap(sup, WNOHANG);
+		_start_next_stage(sup);
+
+		if (cf_getus() - sup->prev_us >= 1000000) {
+			_print_period(sup);
+		}
+	}
+
+	if (!sup->failed) {
+		// what the workers did since the last period
+		_print_period(sup);
+	}
+}
+
+/*
+ * collects the workers that have exited, or waits for all of them if flags
+ * is 0
+ */
+LOCAL_HELPER void
+_reap(supervisor_t* sup, int flags)
+{
+	int status;
+	pid_t pid;
+
+	while (sup->n_running > 0 && (pid = waitpid(-1, &status, flags)) > 0) {
+		for (uint32_t i = 0; i < sup->stats->n_procs; i++) {
+			if (sup->pids[i] != pid) {
+				continue;
+			}
+
+			sup->pids[i] = 0;
+			sup->n_running--;
+
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				fprintf(stderr, "Worker process %u failed\n", i);
+				sup->failed = true;
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * ends the run of the workers still running, since they can't go on with a
+ * share of the keys missing
+ */
+LOCAL_HELPER void
+_stop_workers(supervisor_t* sup)
+{
+	for (uint32_t i = 0; i < sup->stats->n_procs; i++) {
+		if (sup->pids[i] != 0) {
+			kill(sup->pids[i], SIGTERM);
+		}
+	}
+	_reap(sup, 0);
+}
+
+LOCAL_HELPER void
+_start_next_stage(supervisor_t* sup)
+{
+	const stages_t* stages = &sup->args->stages;
+	uint32_t stage_idx = sup->next_stage;
+
+	if (stage_idx == stages->n_stages ||
+			!proc_stats_all_ready(sup->stats, stage_idx)) {
+		return;
+	}
+
+	fprint_stage(stdout, stages, stage_idx);
+	proc_stats_release(sup->stats, stage_idx);
+	sup->next_stage = stages_group_end(stages, stage_idx);
+}
+
+/*
+ * prints what the workers did since the last period, in the same form as the
+ * periodic output of a single process
+ */
+LOCAL_HELPER void
+_print_period(supervisor_t* sup)
+{
+	uint64_t now = cf_getus();
+	uint64_t elapsed_us = now - sup->prev_us;
+	struct interval_counts_s period[GROUP_OP_COUNT];
+	struct interval_counts_s warmup[GROUP_OP_COUNT];
+
+	sup->prev_us = now;
+	if (elapsed_us == 0) {
+		return;
+	}
+
+	bool any_records = _take_period(sup->stats, false, sup->prev, period);
+	bool any_warmup = _take_period(sup->stats, true, sup->prev_warmup,
+			warmup);
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		sup->total[op].ok += period[op].ok;
+		sup->total[op].miss += period[op].miss;
+		sup->total[op].timeouts += period[op].timeouts;
+		sup->total[op].errors += period[op].errors;
+		sup->total[op].bytes += period[op].bytes;
+	}
+	// a period the workers only warmed up in isn't part of the run
+	if (any_records || !any_warmup) {
+		sup->total_us += elapsed_us;
+	}
+
+	if (!any_records && !any_warmup) {
+		return;
+	}
+
+	if (any_warmup) {
+		blog_info("");
+		printf("warmup ");
+		interval_log_print_counts(stdout, warmup, sup->has_op, elapsed_us,
+				NULL);
+	}
+	if (any_records) {
+		blog_info("");
+		interval_log_print_counts(stdout, period, sup->has_op, elapsed_us,
+				NULL);
+	}
+
+	++sup->gen_count;
+	if (sup->args->latency &&
+			sup->gen_count % sup->args->histogram_period == 0) {
+		_print_latencies(sup, (now - sup->start_us) / 1000000);
+	}
+}
+
+LOCAL_HELPER void
+_print_summary(supervisor_t* sup)
+{
+	uint64_t elapsed_s = sup->total_us / 1000000;
+
+	printf("Summary of %u worker processes over %" PRIu64 " seconds\n",
+			sup->stats->n_procs, elapsed_s);
+	if (sup->total_us != 0) {
+		interval_log_print_counts(stdout, sup->total, sup->has_op,
+				sup->total_us, NULL);
+	}
+	_print_latencies(sup, elapsed_s);
+}
+
+/*
+ * sets period to what the workers did since prev, either outside of or during
+ * their warmups, and moves prev up to now. Returns whether they did anything
+ */
+LOCAL_HELPER bool
+_take_period(proc_stats_t* stats, bool warmup,
+		struct interval_counts_s prev[GROUP_OP_COUNT],
+		struct interval_counts_s period[GROUP_OP_COUNT])
+{
+	struct interval_counts_s cur[GROUP_OP_COUNT];
+	bool any_records = false;
+
+	if (warmup) {
+		proc_stats_sum_warmup(stats, cur);
+	}
+	else {
+		proc_stats_sum(stats, cur);
+	}
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		period[op].ok = cur[op].ok - prev[op].ok;
+		period[op].miss = cur[op].miss - prev[op].miss;
+		period[op].timeouts = cur[op].timeouts - prev[op].timeouts;
+		period[op].errors = cur[op].errors - prev[op].errors;
+		period[op].bytes = cur[op].bytes - prev[op].bytes;
+		prev[op] = cur[op];
+
+		any_records = any_records || period[op].ok + period[op].miss +
+			period[op].timeouts + period[op].errors != 0;
+	}
+	return any_records;
+}
+
+/*
+ * the cumulative latencies of every worker merged together
+ */
+LOCAL_HELPER void
+_print_latencies(supervisor_t* sup, uint64_t elapsed_s)
+{
+	for (uint32_t i = 0; i < GROUP_OP_COUNT; i++) {
+		group_op_t op = proc_print_order[i];
+
+		if (!sup->has_op[op]) {
+			continue;
+		}
+
+		proc_stats_merge_hdr(sup->stats, op, sup->hdrs[op]);
+		print_hdr_percentiles(sup->hdrs[op], proc_op_strs[op], elapsed_s,
+				&sup->args->latency_percentiles, stdout);
+	}
+}
+
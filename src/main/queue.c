@@ -7,6 +7,11 @@
 #include <stdatomic.h>
 
 #include <pthread.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
 
 #include <citrusleaf/alloc.h>
 
@@ -19,6 +24,8 @@
 //
 
 LOCAL_HELPER uint32_t next_pow2(uint32_t n);
+LOCAL_HELPER void _park(queue_t* q);
+LOCAL_HELPER void _wake(queue_t* q);
 
 
 //==========================================================
@@ -44,12 +51,19 @@ queue_init(queue_t* q, uint32_t q_len)
 	q->len_mask = len - 1;
 	q->head = 0;
 	atomic_init(&q->pos, 0);
+
+	atomic_init(&q->waiting, 0);
+	q->spin_limit = QUEUE_SPIN_MIN;
+	pthread_cond_init(&q->empty_cond, NULL);
+	pthread_mutex_init(&q->e_lock, NULL);
 	return 0;
 }
 
 void
 queue_free(queue_t* q)
 {
+	pthread_mutex_destroy(&q->e_lock);
+	pthread_cond_destroy(&q->empty_cond);
 	cf_free(q->items);
 }
 
@@ -60,6 +74,12 @@ queue_push(queue_t* q, void* item)
 	uint32_t pos = atomic_fetch_add(&q->pos, 1);
 	// no race condition because 'head' is only incremented in pop if item is not null
 	q->items[pos & q->len_mask] = item;
+
+	// the popper sets waiting before its last look at the queue, so either it
+	// sees this item or this sees it waiting. Only one push wakes it
+	if (q->waiting != 0 && atomic_exchange(&q->waiting, 0) != 0) {
+		_wake(q);
+	}
 }
 
 
@@ -80,6 +100,54 @@ queue_pop(queue_t* q)
 }
 
 
+void*
+queue_pop_wait(queue_t* q, queue_wait_t* wait)
+{
+	void* item = queue_pop(q);
+	queue_wait_t how = QUEUE_WAIT_NONE;
+
+	if (item == NULL) {
+		uint32_t spins;
+
+		for (spins = 1; spins <= q->spin_limit; spins++) {
+			spin_pause();
+			if ((item = queue_pop(q)) != NULL) {
+				break;
+			}
+		}
+
+		if (item != NULL) {
+			how = QUEUE_WAIT_SPUN;
+			// poll for about twice as long as items have recently taken to
+			// arrive
+			uint32_t limit = (7 * q->spin_limit + 2 * spins) / 8;
+			q->spin_limit = limit < QUEUE_SPIN_MIN ? QUEUE_SPIN_MIN :
+				limit > QUEUE_SPIN_MAX ? QUEUE_SPIN_MAX : limit;
+		}
+		else {
+			how = QUEUE_WAIT_PARKED;
+			for (;;) {
+				q->waiting = 1;
+				// look once more, now that a push is sure to wake us
+				if ((item = queue_pop(q)) != NULL) {
+					q->waiting = 0;
+					break;
+				}
+				_park(q);
+			}
+			// polling was wasted this time, so poll for less next time
+			q->spin_limit = q->spin_limit / 2 < QUEUE_SPIN_MIN ?
+				QUEUE_SPIN_MIN : q->spin_limit / 2;
+		}
+	}
+
+	if (wait != NULL) {
+		*wait = how;
+	}
+	return item;
+}
+
+
 //==========================================================
 // Local helpers.
 //
@@ -91,3 +159,32 @@ next_pow2(uint32_t n)
 	// safe as long as n < 2**31
 	return 0x80000000LU >> (leading_bits - 1);
 }
+
+/*
+ * sleeps until a push clears q->waiting, or spuriously
+ */
+LOCAL_HELPER void
+_park(queue_t* q)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &q->waiting, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&q->e_lock);
+	while (q->waiting != 0) {
+		pthread_cond_wait(&q->empty_cond, &q->e_lock);
+	}
+	pthread_mutex_unlock(&q->e_lock);
+#endif /* __linux__ */
+}
+
+LOCAL_HELPER void
+_wake(queue_t* q)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &q->waiting, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&q->e_lock);
+	pthread_cond_signal(&q->empty_cond);
+	pthread_mutex_unlock(&q->e_lock);
+#endif /* __linux__ */
+}
@@ -0,0 +1,351 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <self_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// instance ids start at 1 so a thread that has never entered a phase
+// (tl_id == 0) never matches
+static _Atomic(uint64_t) next_id = 1;
+
+// the slot the calling thread owns in the instance with id tl_id
+static __thread uint64_t tl_id;
+static __thread struct self_stats_thread_s* tl_thread;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER struct self_stats_thread_s* _get_thread(self_stats_t* ss);
+LOCAL_HELPER bool _snapshot(struct self_stats_thread_s* t, uint64_t now,
+		uint64_t* ticks);
+LOCAL_HELPER uint32_t _count_cpus(void);
+LOCAL_HELPER uint64_t _cpu_us(const struct rusage* usage);
+LOCAL_HELPER void _print_sample(const self_stats_t* ss,
+		const self_stats_sample_t* sample);
+
+
+//==========================================================
+// Public API.
+//
+
+self_stats_t*
+self_stats_create(void)
+{
+	self_stats_t* ss = (self_stats_t*) cf_malloc(sizeof(self_stats_t));
+
+	ss->id = atomic_fetch_add(&next_id, 1);
+	ss->n_cpus = _count_cpus();
+	atomic_init(&ss->n_threads, 0);
+	for (uint32_t i = 0; i < SELF_STATS_MAX_THREADS; i++) {
+		atomic_init(&ss->threads[i], NULL);
+	}
+	atomic_init(&ss->spun_waits, 0);
+	atomic_init(&ss->parked_waits, 0);
+	ss->period_spun_waits = 0;
+	ss->period_parked_waits = 0;
+
+	getrusage(RUSAGE_SELF, &ss->start_usage);
+	ss->start_us = cf_getus();
+	ss->period_usage = ss->start_usage;
+	ss->period_us = ss->start_us;
+	return ss;
+}
+
+void
+self_stats_free(self_stats_t* ss)
+{
+	uint32_t n = MIN(ss->n_threads, SELF_STATS_MAX_THREADS);
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (ss->threads[i] != NULL) {
+			cf_free(ss->threads[i]);
+		}
+	}
+	cf_free(ss);
+}
+
+void
+self_stats_enter(self_stats_t* ss, self_phase_t phase)
+{
+	struct self_stats_thread_s* t = tl_id == ss->id ?
+		tl_thread : _get_thread(ss);
+	if (t == NULL) {
+		return;
+	}
+
+	uint64_t now = self_stats_ticks();
+	// only the owner writes these, so there's no need for atomic adds
+	uint32_t seq = atomic_load_explicit(&t->seq, memory_order_relaxed);
+	uint32_t prev = atomic_load_explicit(&t->phase, memory_order_relaxed);
+	uint64_t since = atomic_load_explicit(&t->since, memory_order_relaxed);
+	uint64_t ticks = atomic_load_explicit(&t->ticks[prev],
+			memory_order_relaxed);
+
+	atomic_store_explicit(&t->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	atomic_store_explicit(&t->ticks[prev], ticks + (now - since),
+			memory_order_relaxed);
+	atomic_store_explicit(&t->since, now, memory_order_relaxed);
+	atomic_store_explicit(&t->phase, phase, memory_order_relaxed);
+
+	atomic_store_explicit(&t->seq, seq + 2, memory_order_release);
+}
+
+void
+self_stats_count_wait(self_stats_t* ss, bool parked)
+{
+	atomic_fetch_add_explicit(parked ? &ss->parked_waits : &ss->spun_waits, 1,
+			memory_order_relaxed);
+}
+
+void
+self_stats_sample(self_stats_t* ss, bool cumulative,
+		self_stats_sample_t* sample)
+{
+	uint32_t n_threads = MIN(ss->n_threads, SELF_STATS_MAX_THREADS);
+	uint64_t now = self_stats_ticks();
+	uint64_t totals[SELF_PHASE_IDLE] = { 0 };
+	uint64_t total = 0;
+
+	sample->max_gen_pct = 0;
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		struct self_stats_thread_s* t = ss->threads[i];
+		uint64_t ticks[SELF_PHASE_IDLE];
+
+		if (t == NULL || !_snapshot(t, now, ticks)) {
+			continue;
+		}
+
+		uint64_t busy = 0;
+		uint64_t gen = 0;
+		for (uint32_t p = 0; p < SELF_PHASE_IDLE; p++) {
+			uint64_t base = cumulative ? 0 : t->period_base[p];
+			uint64_t delta = ticks[p] > base ? ticks[p] - base : 0;
+
+			if (!cumulative && ticks[p] > base) {
+				t->period_base[p] = ticks[p];
+			}
+			if (p == SELF_PHASE_GEN) {
+				gen = delta;
+			}
+			totals[p] += delta;
+			busy += delta;
+		}
+		total += busy;
+
+		if (busy != 0) {
+			sample->max_gen_pct = MAX(sample->max_gen_pct, 100. * gen / busy);
+		}
+	}
+
+	for (uint32_t p = 0; p < SELF_PHASE_IDLE; p++) {
+		sample->phase_pct[p] = total == 0 ? 0 : 100. * totals[p] / total;
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	uint64_t now_us = cf_getus();
+
+	const struct rusage* base = cumulative ?
+		&ss->start_usage : &ss->period_usage;
+	uint64_t base_us = cumulative ? ss->start_us : ss->period_us;
+
+	sample->cpu_pct = now_us > base_us ?
+		100. * (_cpu_us(&usage) - _cpu_us(base)) / (now_us - base_us) : 0;
+	sample->voluntary_csw = (uint64_t) (usage.ru_nvcsw - base->ru_nvcsw);
+	sample->involuntary_csw = (uint64_t) (usage.ru_nivcsw - base->ru_nivcsw);
+
+	uint64_t spun = atomic_load_explicit(&ss->spun_waits, memory_order_relaxed);
+	uint64_t parked = atomic_load_explicit(&ss->parked_waits,
+			memory_order_relaxed);
+
+	sample->spun_waits = cumulative ? spun : spun - ss->period_spun_waits;
+	sample->parked_waits = cumulative ? parked :
+		parked - ss->period_parked_waits;
+
+	if (!cumulative) {
+		ss->period_usage = usage;
+		ss->period_us = now_us;
+		ss->period_spun_waits = spun;
+		ss->period_parked_waits = parked;
+	}
+}
+
+self_saturation_t
+self_stats_saturation(const self_stats_t* ss,
+		const self_stats_sample_t* sample)
+{
+	if (sample->cpu_pct >= SELF_STATS_CPU_SATURATED_PCT * ss->n_cpus) {
+		return SELF_SATURATION_CPU;
+	}
+	if (sample->phase_pct[SELF_PHASE_GEN] +
+			sample->phase_pct[SELF_PHASE_RECORD] >=
+			SELF_STATS_GEN_SATURATED_PCT) {
+		return SELF_SATURATION_GEN;
+	}
+	return SELF_SATURATION_NONE;
+}
+
+void
+self_stats_print_period(self_stats_t* ss)
+{
+	self_stats_sample_t sample;
+	self_stats_sample(ss, false, &sample);
+
+	blog_info("");
+	_print_sample(ss, &sample);
+
+	switch (self_stats_saturation(ss, &sample)) {
+		case SELF_SATURATION_CPU:
+			blog_warn("Client saturation: asbench is using %.0f%% of the %u "
+					"CPUs available to it, so throughput is bound by the "
+					"client rather than the server\n",
+					sample.cpu_pct / ss->n_cpus, ss->n_cpus);
+			break;
+		case SELF_SATURATION_GEN:
+			blog_warn("Client saturation: worker threads spend %.0f%% of "
+					"their time generating transactions and recording "
+					"latencies, so throughput is bound by the client rather "
+					"than the server\n",
+					sample.phase_pct[SELF_PHASE_GEN] +
+					sample.phase_pct[SELF_PHASE_RECORD]);
+			break;
+		case SELF_SATURATION_NONE:
+			break;
+	}
+}
+
+void
+self_stats_print_summary(self_stats_t* ss)
+{
+	self_stats_sample_t sample;
+	self_stats_sample(ss, true, &sample);
+
+	blog_info("Client overhead: ");
+	_print_sample(ss, &sample);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * allocates a slot for the calling thread and caches it. Returns NULL if all
+ * SELF_STATS_MAX_THREADS slots have been handed out
+ */
+LOCAL_HELPER struct self_stats_thread_s*
+_get_thread(self_stats_t* ss)
+{
+	uint32_t idx = atomic_fetch_add(&ss->n_threads, 1);
+	struct self_stats_thread_s* t = NULL;
+
+	if (idx < SELF_STATS_MAX_THREADS) {
+		t = (struct self_stats_thread_s*)
+			cf_malloc(sizeof(struct self_stats_thread_s));
+		// the time before the thread's first call isn't charged to anything
+		atomic_init(&t->seq, 0);
+		atomic_init(&t->phase, SELF_PHASE_IDLE);
+		atomic_init(&t->since, self_stats_ticks());
+		for (uint32_t p = 0; p < SELF_PHASE_COUNT; p++) {
+			atomic_init(&t->ticks[p], 0);
+		}
+		for (uint32_t p = 0; p < SELF_PHASE_IDLE; p++) {
+			t->period_base[p] = 0;
+		}
+		atomic_store_explicit(&ss->threads[idx], t, memory_order_release);
+	}
+
+	// cache the failure too, so threads beyond the limit don't keep trying
+	tl_id = ss->id;
+	tl_thread = t;
+	return t;
+}
+
+/*
+ * takes a consistent copy of the ticks a thread has spent in each phase up to
+ * now, including the phase it's currently in. Returns false if the owner kept
+ * getting in the way
+ */
+LOCAL_HELPER bool
+_snapshot(struct self_stats_thread_s* t, uint64_t now, uint64_t* ticks)
+{
+	for (uint32_t attempt = 0; attempt < 1000; attempt++) {
+		uint32_t seq = atomic_load_explicit(&t->seq, memory_order_acquire);
+		if (seq & 1) {
+			continue;
+		}
+
+		uint32_t phase = atomic_load_explicit(&t->phase, memory_order_relaxed);
+		uint64_t since = atomic_load_explicit(&t->since, memory_order_relaxed);
+		for (uint32_t p = 0; p < SELF_PHASE_IDLE; p++) {
+			ticks[p] = atomic_load_explicit(&t->ticks[p], memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&t->seq, memory_order_relaxed) != seq) {
+			continue;
+		}
+
+		// the thread may have entered its phase after now was taken
+		if (phase < SELF_PHASE_IDLE && now > since) {
+			ticks[phase] += now - since;
+		}
+		return true;
+	}
+	return false;
+}
+
+LOCAL_HELPER uint32_t
+_count_cpus(void)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		return (uint32_t) CPU_COUNT(&set);
+	}
+#endif /* __linux__ */
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (uint32_t) n : 1;
+}
+
+LOCAL_HELPER uint64_t
+_cpu_us(const struct rusage* usage)
+{
+	return (uint64_t) (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) *
+		1000000 + (uint64_t) (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec);
+}
+
+LOCAL_HELPER void
+_print_sample(const self_stats_t* ss, const self_stats_sample_t* sample)
+{
+	printf("client(gen=%.1f%% call=%.1f%% record=%.1f%% throttle=%.1f%% "
+			"max-gen=%.1f%% cpu=%.0f%% cpus=%u vcsw=%" PRIu64 " ivcsw=%" PRIu64
+			" spun=%" PRIu64 " parked=%" PRIu64 ")\n",
+			sample->phase_pct[SELF_PHASE_GEN],
+			sample->phase_pct[SELF_PHASE_CLIENT],
+			sample->phase_pct[SELF_PHASE_RECORD],
+			sample->phase_pct[SELF_PHASE_THROTTLE],
+			sample->max_gen_pct, sample->cpu_pct / ss->n_cpus, ss->n_cpus,
+			sample->voluntary_csw, sample->involuntary_csw,
+			sample->spun_waits, sample->parked_waits);
+}
+
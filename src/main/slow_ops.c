@@ -0,0 +1,336 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <node_stats.h>
+#include <slow_ops.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const slow_op_strs[SLOW_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+// instance ids start at 1 so a thread that has never recorded anything
+// (tl_id == 0) never matches
+static _Atomic(uint64_t) next_id = 1;
+
+// the reservoir the calling thread owns in the instance with id tl_id
+static __thread uint64_t tl_id;
+static __thread struct slow_ops_reservoir_s* tl_reservoir;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER struct slow_ops_reservoir_s* _get_reservoir(slow_ops_t* so);
+LOCAL_HELPER void _heap_offer(struct slow_op_entry_s* heap, uint32_t* n,
+		uint32_t k, const struct slow_op_entry_s* entry);
+LOCAL_HELPER void _sift_down(struct slow_op_entry_s* heap, uint32_t n,
+		uint32_t i);
+LOCAL_HELPER bool _copy_heap(struct slow_ops_reservoir_s* r, uint32_t idx,
+		uint32_t k, uint64_t* interval, struct slow_op_entry_s* entries,
+		uint32_t* n_entries);
+LOCAL_HELPER void _print_entry(FILE* out, uint64_t interval,
+		uint32_t stage_idx, const struct slow_op_entry_s* entry);
+
+
+//==========================================================
+// Public API.
+//
+
+slow_ops_t*
+slow_ops_create(const char* path, uint32_t k, aerospike* client)
+{
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		blog_error("Unable to open slow ops file \"%s\": %s\n", path,
+				strerror(errno));
+		return NULL;
+	}
+	fprintf(out, "interval,stage,start,op,latency_us,key,batch_size,node,"
+			"status\n");
+
+	slow_ops_t* so = (slow_ops_t*) cf_malloc(sizeof(slow_ops_t));
+	so->out = out;
+	so->client = client;
+	so->k = k;
+	so->id = atomic_fetch_add(&next_id, 1);
+	atomic_init(&so->interval, 0);
+	atomic_init(&so->n_reservoirs, 0);
+	for (uint32_t i = 0; i < SLOW_OPS_MAX_THREADS; i++) {
+		atomic_init(&so->reservoirs[i], NULL);
+	}
+	so->merged = (struct slow_op_entry_s*)
+		cf_malloc(k * sizeof(struct slow_op_entry_s));
+	so->copy = (struct slow_op_entry_s*)
+		cf_malloc(k * sizeof(struct slow_op_entry_s));
+	return so;
+}
+
+void
+slow_ops_free(slow_ops_t* so)
+{
+	uint32_t n = MIN(so->n_reservoirs, SLOW_OPS_MAX_THREADS);
+
+	for (uint32_t i = 0; i < n; i++) {
+		struct slow_ops_reservoir_s* r = so->reservoirs[i];
+		if (r != NULL) {
+			cf_free(r->heaps[0].entries);
+			cf_free(r->heaps[1].entries);
+			cf_free(r);
+		}
+	}
+	fclose(so->out);
+	cf_free(so->merged);
+	cf_free(so->copy);
+	cf_free(so);
+}
+
+void
+slow_ops_record(slow_ops_t* so, slow_op_t op, uint64_t dt_us,
+		as_status status, uint32_t batch_size, as_key* key)
+{
+	struct slow_ops_reservoir_s* r = tl_id == so->id ?
+		tl_reservoir : _get_reservoir(so);
+	if (r == NULL) {
+		return;
+	}
+
+	uint64_t interval = atomic_load_explicit(&so->interval,
+			memory_order_acquire);
+	struct slow_ops_heap_s* heap = &r->heaps[interval & 1];
+
+	if (heap->interval == interval && dt_us <= heap->threshold) {
+		return;
+	}
+
+	struct slow_op_entry_s entry;
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	entry.latency_us = dt_us;
+	entry.start_us = timespec_to_us(&now) - dt_us;
+	entry.key = key != NULL ? key->value.integer.value : 0;
+	entry.batch_size = batch_size;
+	entry.status = status;
+	entry.op = op;
+	entry.node[0] = '\0';
+
+	if (so->client != NULL && key != NULL) {
+		node_stats_key_node(so->client, key, entry.node);
+	}
+
+	atomic_fetch_add_explicit(&r->seq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	if (heap->interval != interval) {
+		heap->interval = interval;
+		heap->n_entries = 0;
+	}
+	_heap_offer(heap->entries, &heap->n_entries, so->k, &entry);
+	heap->threshold = heap->n_entries == so->k ?
+		heap->entries[0].latency_us : 0;
+
+	atomic_fetch_add_explicit(&r->seq, 1, memory_order_release);
+}
+
+void
+slow_ops_dump(slow_ops_t* so, uint32_t stage_idx)
+{
+	// from here on, recording threads move over to the other heap
+	uint64_t interval = atomic_fetch_add(&so->interval, 1);
+	uint32_t n_reservoirs = MIN(so->n_reservoirs, SLOW_OPS_MAX_THREADS);
+	uint32_t n_merged = 0;
+
+	for (uint32_t i = 0; i < n_reservoirs; i++) {
+		struct slow_ops_reservoir_s* r = so->reservoirs[i];
+		uint64_t heap_interval;
+		uint32_t n_entries;
+
+		if (r == NULL || !_copy_heap(r, interval & 1, so->k, &heap_interval,
+					so->copy, &n_entries)) {
+			continue;
+		}
+		// a thread that recorded nothing this interval still has the heap
+		// from two intervals ago
+		if (heap_interval != interval) {
+			continue;
+		}
+		for (uint32_t j = 0; j < n_entries; j++) {
+			_heap_offer(so->merged, &n_merged, so->k, &so->copy[j]);
+		}
+	}
+
+	// heapsort leaves the min-heap sorted slowest first
+	for (uint32_t n = n_merged; n > 1; n--) {
+		struct slow_op_entry_s tmp = so->merged[0];
+		so->merged[0] = so->merged[n - 1];
+		so->merged[n - 1] = tmp;
+		_sift_down(so->merged, n - 1, 0);
+	}
+
+	for (uint32_t i = 0; i < n_merged; i++) {
+		_print_entry(so->out, interval, stage_idx, &so->merged[i]);
+	}
+	if (n_merged != 0) {
+		fflush(so->out);
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * allocates a reservoir for the calling thread and caches it. Returns NULL
+ * if all SLOW_OPS_MAX_THREADS reservoirs have been handed out
+ */
+LOCAL_HELPER struct slow_ops_reservoir_s*
+_get_reservoir(slow_ops_t* so)
+{
+	uint32_t idx = atomic_fetch_add(&so->n_reservoirs, 1);
+	struct slow_ops_reservoir_s* r = NULL;
+
+	if (idx < SLOW_OPS_MAX_THREADS) {
+		r = (struct slow_ops_reservoir_s*)
+			cf_malloc(sizeof(struct slow_ops_reservoir_s));
+		atomic_init(&r->seq, 0);
+		for (uint32_t i = 0; i < 2; i++) {
+			// no interval has the heap's parity yet, so the first insert
+			// always resets it
+			r->heaps[i].interval = i ^ 1;
+			r->heaps[i].n_entries = 0;
+			r->heaps[i].threshold = 0;
+			r->heaps[i].entries = (struct slow_op_entry_s*)
+				cf_malloc(so->k * sizeof(struct slow_op_entry_s));
+		}
+		atomic_store_explicit(&so->reservoirs[idx], r, memory_order_release);
+	}
+
+	// cache the failure too, so threads beyond the limit don't keep trying
+	tl_id = so->id;
+	tl_reservoir = r;
+	return r;
+}
+
+/*
+ * inserts entry into the min-heap of at most k entries, replacing the fastest
+ * entry if the heap is full and entry is slower than it
+ */
+LOCAL_HELPER void
+_heap_offer(struct slow_op_entry_s* heap, uint32_t* n, uint32_t k,
+		const struct slow_op_entry_s* entry)
+{
+	if (*n == k) {
+		if (k == 0 || entry->latency_us <= heap[0].latency_us) {
+			return;
+		}
+		heap[0] = *entry;
+		_sift_down(heap, k, 0);
+		return;
+	}
+
+	uint32_t i = (*n)++;
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+		if (heap[parent].latency_us <= entry->latency_us) {
+			break;
+		}
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = *entry;
+}
+
+LOCAL_HELPER void
+_sift_down(struct slow_op_entry_s* heap, uint32_t n, uint32_t i)
+{
+	struct slow_op_entry_s entry = heap[i];
+
+	for (;;) {
+		uint32_t child = 2 * i + 1;
+		if (child >= n) {
+			break;
+		}
+		if (child + 1 < n &&
+				heap[child + 1].latency_us < heap[child].latency_us) {
+			child++;
+		}
+		if (entry.latency_us <= heap[child].latency_us) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = entry;
+}
+
+/*
+ * takes a consistent copy of heap idx of a reservoir, retrying while its
+ * owner is writing to it. Returns false if the owner kept getting in the way
+ */
+LOCAL_HELPER bool
+_copy_heap(struct slow_ops_reservoir_s* r, uint32_t idx, uint32_t k,
+		uint64_t* interval, struct slow_op_entry_s* entries,
+		uint32_t* n_entries)
+{
+	struct slow_ops_heap_s* heap = &r->heaps[idx];
+
+	for (uint32_t attempt = 0; attempt < 1000; attempt++) {
+		uint32_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+		if (seq & 1) {
+			continue;
+		}
+
+		*interval = heap->interval;
+		*n_entries = MIN(heap->n_entries, k);
+		memcpy(entries, heap->entries,
+				*n_entries * sizeof(struct slow_op_entry_s));
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&r->seq, memory_order_relaxed) == seq) {
+			return true;
+		}
+	}
+	return false;
+}
+
+LOCAL_HELPER void
+_print_entry(FILE* out, uint64_t interval, uint32_t stage_idx,
+		const struct slow_op_entry_s* entry)
+{
+	time_t secs = (time_t) (entry->start_us / 1000000);
+	struct tm utc;
+	gmtime_r(&secs, &utc);
+
+	fprintf(out, "%" PRIu64 ",%u,%4d-%02d-%02dT%02d:%02d:%02d.%06" PRIu64 "Z,"
+			"%s,%" PRIu64 ",",
+			interval, stage_idx + 1,
+			1900 + utc.tm_year, utc.tm_mon + 1, utc.tm_mday,
+			utc.tm_hour, utc.tm_min, utc.tm_sec, entry->start_us % 1000000,
+			slow_op_strs[entry->op], entry->latency_us);
+	if (entry->batch_size == 0) {
+		fprintf(out, "%" PRId64 ",", entry->key);
+	}
+	else {
+		fprintf(out, ",");
+	}
+	fprintf(out, "%u,%s,%d\n", entry->batch_size, entry->node, entry->status);
+}
+
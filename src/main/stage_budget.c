@@ -0,0 +1,106 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <common.h>
+#include <stage_budget.h>
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER uint64_t _claim(_Atomic(uint64_t)* claimed, uint64_t limit,
+		uint64_t want);
+
+
+//==========================================================
+// Public API.
+//
+
+void
+stage_budget_init(stage_budget_t* budget, uint64_t ops, uint64_t bytes)
+{
+	budget->ops = ops;
+	budget->bytes = bytes;
+	atomic_init(&budget->ops_claimed, 0);
+	atomic_init(&budget->bytes_claimed, 0);
+}
+
+bool
+stage_budget_take_op(stage_budget_t* budget, budget_claim_t* claim)
+{
+	if (claim->spent) {
+		return false;
+	}
+
+	// a thread that never writes still stops once the others have written
+	// enough
+	if (budget->bytes != 0 && claim->bytes == 0 &&
+			atomic_load_explicit(&budget->bytes_claimed,
+				memory_order_relaxed) >= budget->bytes) {
+		claim->spent = true;
+		return false;
+	}
+
+	if (budget->ops == 0) {
+		return true;
+	}
+
+	if (claim->ops == 0) {
+		claim->ops = _claim(&budget->ops_claimed, budget->ops,
+				STAGE_BUDGET_OPS_CHUNK);
+		if (claim->ops == 0) {
+			claim->spent = true;
+			return false;
+		}
+	}
+	claim->ops--;
+	return true;
+}
+
+void
+stage_budget_take_bytes(stage_budget_t* budget, budget_claim_t* claim,
+		uint64_t n)
+{
+	if (budget->bytes == 0) {
+		return;
+	}
+
+	while (n > claim->bytes) {
+		n -= claim->bytes;
+		claim->bytes = _claim(&budget->bytes_claimed, budget->bytes,
+				MAX(n, STAGE_BUDGET_BYTES_CHUNK));
+		if (claim->bytes == 0) {
+			claim->spent = true;
+			return;
+		}
+	}
+	claim->bytes -= n;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * claims up to want of what's left below limit, returning how much it got
+ */
+LOCAL_HELPER uint64_t
+_claim(_Atomic(uint64_t)* claimed, uint64_t limit, uint64_t want)
+{
+	uint64_t cur = atomic_load_explicit(claimed, memory_order_relaxed);
+	uint64_t got;
+
+	do {
+		if (cur >= limit) {
+			return 0;
+		}
+		got = MIN(want, limit - cur);
+	} while (!atomic_compare_exchange_weak(claimed, &cur, cur + got));
+
+	return got;
+}
+
@@ -0,0 +1,79 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <common.h>
+#include <sustain_gate.h>
+
+
+//==========================================================
+// Public API.
+//
+
+void
+sustain_gate_init(sustain_gate_t* gate)
+{
+	atomic_init(&gate->stage, NULL);
+	atomic_init(&gate->n_entered, 0);
+	atomic_init(&gate->permit_next, 0);
+	gate->permit_period = 0;
+}
+
+void
+sustain_gate_open(sustain_gate_t* gate, const struct stage_s* stage,
+		uint64_t period, uint64_t now)
+{
+	// the gate is closed, so no callback reads these until the stage is set
+	gate->permit_period = period;
+	atomic_store(&gate->permit_next, now);
+	atomic_store(&gate->stage, stage);
+}
+
+void
+sustain_gate_close(sustain_gate_t* gate)
+{
+	atomic_store(&gate->stage, NULL);
+	while (atomic_load(&gate->n_entered) != 0) {
+		spin_pause();
+	}
+}
+
+const struct stage_s*
+sustain_gate_enter(sustain_gate_t* gate)
+{
+	// counted before looking at the stage, so that sustain_gate_close either
+	// sees this callback or this callback sees the stage is over
+	atomic_fetch_add(&gate->n_entered, 1);
+	return atomic_load(&gate->stage);
+}
+
+void
+sustain_gate_leave(sustain_gate_t* gate)
+{
+	atomic_fetch_sub(&gate->n_entered, 1);
+}
+
+bool
+sustain_gate_take_permit(sustain_gate_t* gate, uint64_t now)
+{
+	uint64_t period = gate->permit_period;
+
+	if (period == 0) {
+		return true;
+	}
+
+	uint64_t next = atomic_load(&gate->permit_next);
+	uint64_t from;
+	do {
+		if (next > now) {
+			return false;
+		}
+		// a late permit keeps to the schedule, but one more than a period
+		// late starts it over from now
+		from = next + period < now ? now : next;
+	} while (!atomic_compare_exchange_weak(&gate->permit_next, &next,
+				from + period));
+	return true;
+}
+
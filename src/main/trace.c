@@ -0,0 +1,302 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <trace.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+_Static_assert(sizeof(struct trace_header_s) == 64,
+		"the trace header must keep its on-disk size");
+_Static_assert(sizeof(struct trace_record_s) == 32,
+		"trace records must keep their on-disk size");
+_Static_assert(TRACE_SEGMENT_SIZE % sizeof(struct trace_record_s) == 0,
+		"trace records must not straddle segments");
+
+static const char* const trace_op_strs[TRACE_OP_COUNT] = {
+	"read",
+	"write",
+	"udf"
+};
+
+// instance ids start at 1 so a thread that has never traced anything
+// (tl_id == 0) never matches
+static _Atomic(uint64_t) next_id = 1;
+
+// the writer the calling thread owns in the instance with id tl_id
+static __thread uint64_t tl_id;
+static __thread struct trace_writer_s* tl_writer;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER struct trace_writer_s* _get_writer(trace_t* trace);
+LOCAL_HELPER bool _map_segment(struct trace_writer_s* w, uint64_t seg_idx);
+LOCAL_HELPER void _close_writer(struct trace_writer_s* w);
+
+
+//==========================================================
+// Public API.
+//
+
+trace_t*
+trace_create(const char* prefix, uint32_t sample_every)
+{
+	trace_t* trace = (trace_t*) cf_malloc(sizeof(trace_t));
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	trace->prefix = strdup(prefix);
+	trace->sample_every = sample_every;
+	trace->realtime_offset_us =
+		(int64_t) timespec_to_us(&now) - (int64_t) cf_getus();
+	trace->id = atomic_fetch_add(&next_id, 1);
+	atomic_init(&trace->n_writers, 0);
+	for (uint32_t i = 0; i < TRACE_MAX_WRITERS; i++) {
+		atomic_init(&trace->writers[i], NULL);
+	}
+	return trace;
+}
+
+void
+trace_free(trace_t* trace)
+{
+	uint32_t n = MIN(trace->n_writers, TRACE_MAX_WRITERS);
+
+	for (uint32_t i = 0; i < n; i++) {
+		struct trace_writer_s* w = trace->writers[i];
+		if (w != NULL) {
+			_close_writer(w);
+			cf_free(w);
+		}
+	}
+	cf_free(trace->prefix);
+	cf_free(trace);
+}
+
+void
+trace_record(trace_t* trace, trace_op_t op, uint64_t start_us,
+		uint64_t end_us, as_status status, uint32_t batch_size, as_key* key)
+{
+	struct trace_writer_s* w = tl_id == trace->id ?
+		tl_writer : _get_writer(trace);
+	if (w == NULL) {
+		return;
+	}
+
+	if (w->countdown != 0) {
+		w->countdown--;
+		return;
+	}
+	w->countdown = trace->sample_every - 1;
+
+	if (w->next == w->end) {
+		// a writer whose file couldn't be grown stays stopped
+		if (w->seg == NULL || !_map_segment(w, w->seg_idx + 1)) {
+			return;
+		}
+	}
+
+	struct trace_record_s* rec = w->next++;
+	rec->start_us = start_us;
+	// 0 marks the end of the trace, so nudge a transaction that finished
+	// at time 0
+	rec->end_us = end_us != 0 ? end_us : 1;
+	rec->key = key != NULL ? key->value.integer.value : 0;
+	rec->batch_size = batch_size;
+	rec->status = (int16_t) status;
+	rec->op = (uint8_t) op;
+	rec->pad = 0;
+}
+
+int
+trace_decode(const char* path, FILE* out)
+{
+	FILE* f = fopen(path, "r");
+	if (f == NULL) {
+		blog_error("Unable to open trace file \"%s\": %s\n", path,
+				strerror(errno));
+		return -1;
+	}
+
+	struct trace_header_s header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+			memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+		blog_error("\"%s\" is not a trace file\n", path);
+		fclose(f);
+		return -1;
+	}
+	if (header.version != TRACE_VERSION ||
+			header.record_size != sizeof(struct trace_record_s)) {
+		blog_error("Trace file \"%s\" has unsupported version %u\n", path,
+				header.version);
+		fclose(f);
+		return -1;
+	}
+
+	fprintf(out, "writer,start_us,end_us,latency_us,op,key,batch_size,"
+			"status\n");
+
+	struct trace_record_s recs[1024];
+	size_t n;
+	bool done = false;
+
+	while (!done && (n = fread(recs, sizeof(recs[0]), 1024, f)) != 0) {
+		for (size_t i = 0; i < n; i++) {
+			const struct trace_record_s* rec = &recs[i];
+
+			if (rec->end_us == 0) {
+				done = true;
+				break;
+			}
+
+			fprintf(out, "%u,%" PRId64 ",%" PRId64 ",%" PRIu64 ",%s,",
+					header.writer_idx,
+					(int64_t) rec->start_us + header.realtime_offset_us,
+					(int64_t) rec->end_us + header.realtime_offset_us,
+					rec->end_us - rec->start_us,
+					rec->op < TRACE_OP_COUNT ? trace_op_strs[rec->op] : "?");
+			if (rec->batch_size == 0) {
+				fprintf(out, "%" PRId64 ",", rec->key);
+			}
+			else {
+				fprintf(out, ",");
+			}
+			fprintf(out, "%u,%d\n", rec->batch_size, rec->status);
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+/*
+ * creates the calling thread's trace file and caches its writer. Returns
+ * NULL if all TRACE_MAX_WRITERS writers have been handed out or the file
+ * couldn't be created
+ */
+LOCAL_HELPER struct trace_writer_s*
+_get_writer(trace_t* trace)
+{
+	uint32_t idx = atomic_fetch_add(&trace->n_writers, 1);
+	struct trace_writer_s* w = NULL;
+
+	// cache the failure too, so the thread doesn't keep trying
+	tl_id = trace->id;
+	tl_writer = NULL;
+
+	if (idx >= TRACE_MAX_WRITERS) {
+		return NULL;
+	}
+
+	char path[strlen(trace->prefix) + 16];
+	snprintf(path, sizeof(path), "%s.%u", trace->prefix, idx);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		blog_error("Unable to create trace file \"%s\": %s\n", path,
+				strerror(errno));
+		return NULL;
+	}
+
+	w = (struct trace_writer_s*) cf_malloc(sizeof(struct trace_writer_s));
+	w->fd = fd;
+	w->seg = NULL;
+	w->next = NULL;
+	w->end = NULL;
+	w->countdown = 0;
+
+	if (!_map_segment(w, 0)) {
+		close(fd);
+		cf_free(w);
+		return NULL;
+	}
+
+	struct trace_header_s* header = (struct trace_header_s*) w->seg;
+	memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+	header->version = TRACE_VERSION;
+	header->record_size = sizeof(struct trace_record_s);
+	header->realtime_offset_us = trace->realtime_offset_us;
+	header->sample_every = trace->sample_every;
+	header->writer_idx = idx;
+	w->next = (struct trace_record_s*) (w->seg + sizeof(*header));
+
+	atomic_store_explicit(&trace->writers[idx], w, memory_order_release);
+	tl_writer = w;
+	return w;
+}
+
+/*
+ * grows the file to hold segment seg_idx and maps it in place of the current
+ * one. On failure, the writer stops tracing
+ */
+LOCAL_HELPER bool
+_map_segment(struct trace_writer_s* w, uint64_t seg_idx)
+{
+	if (w->seg != NULL) {
+		munmap(w->seg, TRACE_SEGMENT_SIZE);
+		w->seg = NULL;
+	}
+	w->next = NULL;
+	w->end = NULL;
+
+	off_t offset = (off_t) (seg_idx * TRACE_SEGMENT_SIZE);
+	if (ftruncate(w->fd, offset + TRACE_SEGMENT_SIZE) != 0) {
+		blog_error("Unable to grow trace file: %s\n", strerror(errno));
+		return false;
+	}
+
+	void* seg = mmap(NULL, TRACE_SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, w->fd, offset);
+	if (seg == MAP_FAILED) {
+		blog_error("Unable to map trace file: %s\n", strerror(errno));
+		return false;
+	}
+
+	w->seg = (uint8_t*) seg;
+	w->seg_idx = seg_idx;
+	w->next = (struct trace_record_s*) w->seg;
+	w->end = (struct trace_record_s*) (w->seg + TRACE_SEGMENT_SIZE);
+	return true;
+}
+
+/*
+ * cuts the file off after the last record written and closes it
+ */
+LOCAL_HELPER void
+_close_writer(struct trace_writer_s* w)
+{
+	if (w->seg != NULL) {
+		off_t used = (off_t) (w->seg_idx * TRACE_SEGMENT_SIZE) +
+			((uint8_t*) w->next - w->seg);
+
+		munmap(w->seg, TRACE_SEGMENT_SIZE);
+		if (ftruncate(w->fd, used) != 0) {
+			blog_error("Unable to truncate trace file: %s\n", strerror(errno));
+		}
+	}
+	close(w->fd);
+}
+
@@ -6,9 +6,6 @@
 #include <transaction.h>
 
 #include <assert.h>
-#ifndef __aarch64__
-#include <xmmintrin.h>
-#endif
 
 #include <aerospike/aerospike_batch.h>
 #include <aerospike/aerospike_key.h>
@@ -18,6 +15,7 @@
 #include <common.h>
 #include <coordinator.h>
 #include <queue.h>
+#include <sustain_gate.h>
 #include <workload.h>
 
 
@@ -27,9 +25,11 @@
 
 struct async_data_s {
 	cdata_t* cdata;
-	stage_t* stage;
-	// queue to place this item back on once the callback has finished
-	queue_t* adata_q;
+	// the workload that issued the command, which it's counted under even if
+	// the threads have moved on to the next stage by the time it completes
+	const stage_t* stage;
+	// the pool to hand this item back to once the callback has finished
+	struct async_pool_s* pool;
 
 	// keep each async_data in the same event loop to prevent the possibility
 	// of overflowing an event loop due to bad scheduling
@@ -37,10 +37,19 @@ struct async_data_s {
 
 	// the time at which the async call was made
 	uint64_t start_time;
+	// how long after start_time the issuing thread expected to be able to
+	// reuse this slot, see _expected_interval
+	uint64_t expected_interval;
 
 	// the key to be used in the async calls
 	as_key key;
 
+	// the number of bytes of bin data in the record or batch being written
+	uint64_t write_bytes;
+
+	// the number of records in the batch, only set for batch calls
+	uint32_t batch_size;
+
 	// what type of operation is being performed
 	enum {
 		read_op,
@@ -50,6 +59,49 @@ struct async_data_s {
 	} op;
 };
 
+/*
+ * what an event loop needs to generate commands on its own thread in
+ * self-sustaining mode: a copy of the issuing thread's state for the stage,
+ * with a random number generator of its own
+ */
+struct async_loop_s {
+	tdata_t tdata;
+	as_random random;
+};
+
+/*
+ * the async commands of an issuing thread, which are kept from stage to stage
+ * so the next stage can start issuing while the last one's commands are still
+ * completing
+ *
+ * in self-sustaining mode, the completion callback of a command issues the
+ * next one itself on its event loop, and only hands the command back to the
+ * issuing thread when it can't (the stage is over, or it's out of permits)
+ */
+struct async_pool_s {
+	struct async_data_s* adatas;
+	uint32_t n_adatas;
+	// the commands which aren't in flight
+	queue_t adata_q;
+	// the commands taken out of the queue so a stage can't issue them, for
+	// stages with fewer commands in flight than the pool has
+	struct async_data_s** held;
+	uint32_t n_held;
+
+	// the thread that owns the pool
+	tdata_t* tdata;
+	// what the event loops pass through to reissue commands
+	sustain_gate_t gate;
+	// one per event loop, only allocated in self-sustaining mode
+	struct async_loop_s* loops;
+	uint32_t n_loops;
+};
+
+// set on an event loop thread while a completion callback issues the next
+// command. The event loops aren't worker threads, so they're kept out of the
+// breakdown of the workers' time and the hardware counters
+static __thread bool tl_reissuing;
+
 
 //==========================================================
 // Forward Declarations.
@@ -60,13 +112,47 @@ LOCAL_HELPER uint32_t _pct_to_fp(float pct);
 LOCAL_HELPER uint32_t _random_fp(as_random*);
 
 // Latency recrding helpers
-LOCAL_HELPER void _record_read(cdata_t* cdata, uint64_t dt_us);
-LOCAL_HELPER void _record_write(cdata_t* cdata, uint64_t dt_us);
-LOCAL_HELPER void _record_udf(cdata_t* cdata, uint64_t dt_us);
+LOCAL_HELPER uint64_t _expected_interval(const cdata_t* cdata,
+		const tdata_t* tdata, bool async);
+LOCAL_HELPER bool _record_warmup(cdata_t* cdata, group_op_t op,
+		uint64_t dt_us, as_status status);
+LOCAL_HELPER void _record_error(cdata_t* cdata, error_op_t op,
+		as_status status, uint64_t dt_us);
+LOCAL_HELPER void _record_write_bytes(cdata_t* cdata, uint64_t n_bytes);
+LOCAL_HELPER void _record_read(cdata_t* cdata, uint64_t dt_us,
+		uint64_t expected_us);
+LOCAL_HELPER void _record_write(cdata_t* cdata, uint64_t dt_us,
+		uint64_t expected_us);
+LOCAL_HELPER void _record_udf(cdata_t* cdata, uint64_t dt_us,
+		uint64_t expected_us);
+LOCAL_HELPER void _record_node(cdata_t* cdata, as_key* key, node_op_t op,
+		uint64_t dt_us, as_status status);
+LOCAL_HELPER void _record_slow(cdata_t* cdata, slow_op_t op, uint64_t dt_us,
+		as_status status, uint32_t batch_size, as_key* key);
+LOCAL_HELPER void _record_trace(cdata_t* cdata, trace_op_t op, uint64_t start,
+		uint64_t end, as_status status, uint32_t batch_size, as_key* key);
+LOCAL_HELPER void _record_workload(cdata_t* cdata, uint32_t stage_idx,
+		group_op_t op, uint64_t dt_us, as_status status);
+LOCAL_HELPER void _enter_phase(cdata_t* cdata, self_phase_t phase);
+LOCAL_HELPER bool _take_op(cdata_t* cdata, tdata_t* tdata);
+LOCAL_HELPER void _take_bytes(cdata_t* cdata, tdata_t* tdata, uint64_t n);
+LOCAL_HELPER void _perf_begin(cdata_t* cdata);
+LOCAL_HELPER void _perf_end(cdata_t* cdata, perf_op_t op);
+LOCAL_HELPER uint64_t _batch_written_size(const as_batch_records* records,
+		uint64_t batch_bytes);
+
+// Key tracking helpers
+LOCAL_HELPER uint64_t _gen_tracked_key(const cdata_t* cdata, tdata_t* tdata,
+		const stage_t* stage, bool live);
+LOCAL_HELPER uint64_t _gen_read_key(const cdata_t* cdata, tdata_t* tdata,
+		const stage_t* stage);
+LOCAL_HELPER void _track_key(cdata_t* cdata, const as_key* key, bool live);
+LOCAL_HELPER void _track_batch(cdata_t* cdata, const as_batch_records* records,
+		bool live);
 
 // Read/Write singular/batch synchronous operations
 LOCAL_HELPER int _write_record_sync(tdata_t* tdata, cdata_t* cdata,
-		thr_coord_t* coord, as_key* key, as_record* rec);
+		thr_coord_t* coord, as_key* key, as_record* rec, uint64_t rec_size);
 LOCAL_HELPER int _read_record_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		const stage_t* stage, as_key* key);
 LOCAL_HELPER int _batch_read_record_sync(tdata_t* tdata, cdata_t* cdata,
@@ -74,39 +160,45 @@ LOCAL_HELPER int _batch_read_record_sync(tdata_t* tdata, cdata_t* cdata,
 LOCAL_HELPER int _apply_udf_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		const stage_t* stage, as_key* key);
 LOCAL_HELPER int _batch_write_record_sync(tdata_t* tdata, cdata_t* cdata,
-		thr_coord_t* coord, as_batch_records* records);
+		thr_coord_t* coord, as_batch_records* records, uint64_t batch_bytes);
 
 // Read/Write singular/batch asynchronous operations
 LOCAL_HELPER int _write_record_async(as_key* key, as_record* rec,
-		struct async_data_s* adata, tdata_t* tdata, cdata_t* cdata);
+		uint64_t rec_size, struct async_data_s* adata, tdata_t* tdata,
+		cdata_t* cdata);
 LOCAL_HELPER int _read_record_async(as_key* key, struct async_data_s* adata,
 		tdata_t* tdata, cdata_t* cdata, const stage_t* stage);
 LOCAL_HELPER int _batch_read_record_async(as_batch_read_records* keys,
 		struct async_data_s* adata, tdata_t* tdata, cdata_t* cdata);
 LOCAL_HELPER int _apply_udf_async(as_key* key, struct async_data_s* adata,
 		tdata_t* tdata, cdata_t* cdata, const stage_t* stage);
-LOCAL_HELPER int _batch_write_record_async(as_batch_records* keys, struct async_data_s* adata,
-		tdata_t* tdata, cdata_t* cdata);
+LOCAL_HELPER int _batch_write_record_async(as_batch_records* keys,
+		uint64_t batch_bytes, struct async_data_s* adata, tdata_t* tdata,
+		cdata_t* cdata);
 
 // Thread worker helper methods
 LOCAL_HELPER void _calculate_subrange(uint64_t key_start, uint64_t key_end,
 		uint32_t t_idx, uint32_t n_threads, uint64_t* t_start, uint64_t* t_end);
 LOCAL_HELPER void _gen_key(uint64_t key_val, as_key* key, const cdata_t* cdata);
 LOCAL_HELPER as_record* _gen_record(as_random* random, const cdata_t* cdata,
-		tdata_t* tdata, const stage_t* stage);
+		tdata_t* tdata, const stage_t* stage, uint64_t* size);
+LOCAL_HELPER void _populate_record(const cdata_t* cdata, const stage_t* stage,
+		as_record* rec, as_random* random, uint32_t* write_bins,
+		uint32_t n_write_bins, uint64_t* size);
 LOCAL_HELPER as_record* _gen_nil_record(tdata_t* tdata);
 LOCAL_HELPER void _destroy_record(as_record* rec, const stage_t* stage);
 LOCAL_HELPER as_batch_records* _gen_batch_writes(const cdata_t* cdata,
-		tdata_t* tdata, const stage_t* stage, bool randomKeys, uint64_t key_start);
+		tdata_t* tdata, const stage_t* stage, bool randomKeys,
+		uint64_t key_start, uint64_t* size);
 LOCAL_HELPER as_batch_records* _gen_batch_deletes(const cdata_t* cdata,
 		tdata_t* tdata,	const stage_t* stage, bool randomKeys,
 		uint64_t start_key);
 LOCAL_HELPER as_batch_records*
 _gen_batch_writes_sequential_keys(const cdata_t* cdata, tdata_t* tdata,	
-		const stage_t* stage, uint64_t start_key);
+		const stage_t* stage, uint64_t start_key, uint64_t* size);
 LOCAL_HELPER as_batch_records*
 _gen_batch_writes_random_keys(const cdata_t* cdata, tdata_t* tdata,	
-		const stage_t* stage);
+		const stage_t* stage, uint64_t* size);
 LOCAL_HELPER void throttle(tdata_t* tdata, thr_coord_t* coord);
 LOCAL_HELPER as_batch_records* _gen_batch_deletes_random_keys(
 		const cdata_t* cdata, tdata_t* tdata, const stage_t* stage);
@@ -146,7 +238,7 @@ LOCAL_HELPER void random_delete_async(tdata_t* tdata, cdata_t* cdata,
 
 // Asynchronous workload methods
 LOCAL_HELPER void _async_listener(as_error* err, void* udata,
-		as_event_loop* event_loop);
+		as_event_loop* event_loop, bool single_key);
 LOCAL_HELPER void _async_read_listener(as_error* err, as_record* rec, void* udata,
 		as_event_loop* event_loop);
 LOCAL_HELPER void _async_write_listener(as_error* err, void* udata,
@@ -157,17 +249,25 @@ LOCAL_HELPER void _async_batch_write_listener(as_error* err, as_batch_read_recor
 		void* udata, as_event_loop* event_loop);
 LOCAL_HELPER void _async_val_listener(as_error* err, as_val* val, void* udata,
 		as_event_loop* event_loop);
-LOCAL_HELPER struct async_data_s* queue_pop_wait(queue_t* adata_q);
+LOCAL_HELPER struct async_data_s* async_data_acquire(tdata_t* tdata,
+		cdata_t* cdata, const stage_t* stage, struct async_pool_s* pool);
+LOCAL_HELPER struct async_pool_s* _async_pool_create(tdata_t* tdata,
+		cdata_t* cdata);
+LOCAL_HELPER void _async_pool_hold(struct async_pool_s* pool, uint32_t n);
+LOCAL_HELPER void _async_pool_drain(struct async_pool_s* pool);
+LOCAL_HELPER void _async_pool_free(struct async_pool_s* pool);
+LOCAL_HELPER void _async_sustain_start(tdata_t* tdata, const stage_t* stage,
+		struct async_pool_s* pool);
+LOCAL_HELPER bool _async_reissue(struct async_data_s* adata, as_error* err,
+		as_event_loop* event_loop);
+LOCAL_HELPER void _random_op_async(tdata_t* tdata, cdata_t* cdata,
+		const stage_t* stage, struct async_data_s* adata);
 LOCAL_HELPER void linear_writes_async(tdata_t* tdata, cdata_t* cdata,
-	   thr_coord_t* coord, const stage_t* stage, queue_t* adata_q);
-LOCAL_HELPER void random_read_write_async(tdata_t* tdata, cdata_t* cdata,
-	   thr_coord_t* coord, const stage_t* stage, queue_t* adata_q);
-LOCAL_HELPER void random_read_write_udf_async(tdata_t* tdata, cdata_t* cdata,
-	   thr_coord_t* coord, const stage_t* stage, queue_t* adata_q);
+	   thr_coord_t* coord, const stage_t* stage, struct async_pool_s* pool);
+LOCAL_HELPER void random_async(tdata_t* tdata, cdata_t* cdata,
+	   thr_coord_t* coord, const stage_t* stage, struct async_pool_s* pool);
 LOCAL_HELPER void linear_deletes_async(tdata_t* tdata, cdata_t* cdata,
-	   thr_coord_t* coord, const stage_t* stage, queue_t* adata_q);
-LOCAL_HELPER void random_read_write_delete_async(tdata_t* tdata, cdata_t* cdata,
-	   thr_coord_t* coord, const stage_t* stage, queue_t* adata_q);
+	   thr_coord_t* coord, const stage_t* stage, struct async_pool_s* pool);
 
 // Main worker thread helper methods
 LOCAL_HELPER void _set_stage_policies(tdata_t* tdata, stage_t* stage);
@@ -194,11 +294,28 @@ transaction_worker(void* udata)
 	cdata_t* cdata = tdata->cdata;
 	thr_coord_t* coord = tdata->coord;
 
+	if (cdata->perf_counters != NULL) {
+		perf_counters_thread_init(cdata->perf_counters);
+	}
+
 	while (!tdata->finished) {
 		uint32_t stage_idx = tdata->stage_idx;
 		stage_t* stage = &cdata->stages.stages[stage_idx];
 
+		if (!stage_runs_thread(stage, tdata->t_idx)) {
+			// the stage runs on fewer threads than there are, so this one is
+			// parked until the next stage that needs it
+			thr_coordinator_complete(coord);
+			if (tdata->finished) {
+				break;
+			}
+			thr_coordinator_wait(coord, tdata);
+			continue;
+		}
+
 		init_stage(cdata, tdata, stage);
+		_enter_phase(cdata, SELF_PHASE_GEN);
+		_perf_begin(cdata);
 
 		if (stage->async) {
 			do_async_workload(tdata, cdata, coord, stage);
@@ -206,12 +323,18 @@ transaction_worker(void* udata)
 		else {
 			do_sync_workload(tdata, cdata, coord, stage);
 		}
-		// check tdata->finished before locking
+		// check tdata->finished before waiting
 		if (tdata->finished) {
 			break;
 		}
 		terminate_stage(cdata, tdata, stage);
-		thr_coordinator_wait(coord);
+		_enter_phase(cdata, SELF_PHASE_IDLE);
+		thr_coordinator_wait(coord, tdata);
+	}
+
+	// wait for the last async commands before the event loops are closed
+	if (tdata->async_pool != NULL) {
+		_async_pool_free(tdata->async_pool);
 	}
 
 	return NULL;
@@ -247,40 +370,340 @@ _random_fp(as_random* random)
  * Latency recording helpers
  *****************************************************************************/
 
+/*
+ * the interval between transactions the thread's throttle aims for, used to
+ * correct for coordinated omission, or 0 if the thread isn't throttled. An
+ * async thread spreads its throttle over up to its stage's async_max_commands
+ * commands in flight, so each of them is only expected back that many
+ * intervals later
+ */
+LOCAL_HELPER uint64_t
+_expected_interval(const cdata_t* cdata, const tdata_t* tdata, bool async)
+{
+	float period = tdata->dyn_throttle.target_period;
+
+	if (async) {
+		period *= cdata->stages.stages[tdata->stage_idx].async_max_commands;
+	}
+	return (uint64_t) period;
+}
+
+/*
+ * counts the transaction apart from the totals if the stage is warming up,
+ * returning whether it was
+ */
+LOCAL_HELPER bool
+_record_warmup(cdata_t* cdata, group_op_t op, uint64_t dt_us,
+		as_status status)
+{
+	if (!warmup_stats_active(cdata->warmup_stats)) {
+		return false;
+	}
+	warmup_stats_record(cdata->warmup_stats, op, dt_us, status);
+	return true;
+}
+
+/*
+ * counts a failed transaction as a timeout or an error of its op and in the
+ * error stats, or in the warmup stats while the stage is warming up
+ */
+LOCAL_HELPER void
+_record_error(cdata_t* cdata, error_op_t op, as_status status,
+		uint64_t dt_us)
+{
+	static const group_op_t group_ops[] = {
+		[ERROR_OP_READ] = GROUP_OP_READ,
+		[ERROR_OP_WRITE] = GROUP_OP_WRITE,
+		[ERROR_OP_UDF] = GROUP_OP_UDF
+	};
+
+	if (_record_warmup(cdata, group_ops[op], dt_us, status)) {
+		return;
+	}
+	error_stats_record(cdata->error_stats, op, status, dt_us);
+
+	_Atomic(uint64_t)* const timeouts[] = {
+		[ERROR_OP_READ] = &cdata->read_timeout_count,
+		[ERROR_OP_WRITE] = &cdata->write_timeout_count,
+		[ERROR_OP_UDF] = &cdata->udf_timeout_count
+	};
+	_Atomic(uint64_t)* const errors[] = {
+		[ERROR_OP_READ] = &cdata->read_error_count,
+		[ERROR_OP_WRITE] = &cdata->write_error_count,
+		[ERROR_OP_UDF] = &cdata->udf_error_count
+	};
+
+	if (status == AEROSPIKE_ERR_TIMEOUT) {
+		(*timeouts[op])++;
+	}
+	else {
+		(*errors[op])++;
+	}
+}
+
+/*
+ * counts the bytes of a successful write, apart from the totals if the stage
+ * is warming up
+ */
+LOCAL_HELPER void
+_record_write_bytes(cdata_t* cdata, uint64_t n_bytes)
+{
+	if (warmup_stats_active(cdata->warmup_stats)) {
+		warmup_stats_add_bytes(cdata->warmup_stats, n_bytes);
+	}
+	else {
+		cdata->write_bytes += n_bytes;
+	}
+}
+
 LOCAL_HELPER void
-_record_read(cdata_t* cdata, uint64_t dt_us)
+_record_read(cdata_t* cdata, uint64_t dt_us, uint64_t expected_us)
 {
+	if (_record_warmup(cdata, GROUP_OP_READ, dt_us, AEROSPIKE_OK)) {
+		return;
+	}
+	cdata->read_hit_count++;
+
 	if (cdata->latency) {
 		hdr_record_value_atomic(cdata->read_hdr, dt_us);
+		if (cdata->latency_corrected) {
+			hdr_record_corrected_value_atomic(cdata->read_corrected_hdr, dt_us,
+					expected_us);
+		}
 	}
 	if (cdata->histogram_output != NULL || cdata->hdr_comp_read_output != NULL) {
 		histogram_incr(&cdata->read_histogram, dt_us);
 	}
-	cdata->read_hit_count++;
 }
 
 LOCAL_HELPER void
-_record_write(cdata_t* cdata, uint64_t dt_us)
+_record_write(cdata_t* cdata, uint64_t dt_us, uint64_t expected_us)
 {
+	if (_record_warmup(cdata, GROUP_OP_WRITE, dt_us, AEROSPIKE_OK)) {
+		return;
+	}
+	cdata->write_count++;
+
 	if (cdata->latency) {
 		hdr_record_value_atomic(cdata->write_hdr, dt_us);
+		if (cdata->latency_corrected) {
+			hdr_record_corrected_value_atomic(cdata->write_corrected_hdr, dt_us,
+					expected_us);
+		}
 	}
 	if (cdata->histogram_output != NULL || cdata->hdr_comp_write_output != NULL) {
 		histogram_incr(&cdata->write_histogram, dt_us);
 	}
-	cdata->write_count++;
 }
 
 LOCAL_HELPER void
-_record_udf(cdata_t* cdata, uint64_t dt_us)
+_record_udf(cdata_t* cdata, uint64_t dt_us, uint64_t expected_us)
 {
+	if (_record_warmup(cdata, GROUP_OP_UDF, dt_us, AEROSPIKE_OK)) {
+		return;
+	}
+	cdata->udf_count++;
+
 	if (cdata->latency) {
 		hdr_record_value_atomic(cdata->udf_hdr, dt_us);
+		if (cdata->latency_corrected) {
+			hdr_record_corrected_value_atomic(cdata->udf_corrected_hdr, dt_us,
+					expected_us);
+		}
 	}
 	if (cdata->histogram_output != NULL || cdata->hdr_comp_udf_output != NULL) {
 		histogram_incr(&cdata->udf_histogram, dt_us);
 	}
-	cdata->udf_count++;
+}
+
+LOCAL_HELPER void
+_record_node(cdata_t* cdata, as_key* key, node_op_t op, uint64_t dt_us,
+		as_status status)
+{
+	if (cdata->node_stats != NULL) {
+		node_stats_record(cdata->node_stats, &cdata->client, key, op, dt_us,
+				status);
+	}
+}
+
+/*
+ * batch_size is 0 and key is the transaction's key for single-key
+ * transactions, key is NULL for batches
+ */
+LOCAL_HELPER void
+_record_slow(cdata_t* cdata, slow_op_t op, uint64_t dt_us, as_status status,
+		uint32_t batch_size, as_key* key)
+{
+	if (cdata->slow_ops != NULL) {
+		slow_ops_record(cdata->slow_ops, op, dt_us, status, batch_size, key);
+	}
+}
+
+LOCAL_HELPER void
+_record_trace(cdata_t* cdata, trace_op_t op, uint64_t start, uint64_t end,
+		as_status status, uint32_t batch_size, as_key* key)
+{
+	if (cdata->trace != NULL) {
+		trace_record(cdata->trace, op, start, end, status, batch_size, key);
+	}
+}
+
+/*
+ * counts the transaction against its own workload when its stage runs
+ * several at once
+ */
+LOCAL_HELPER void
+_record_workload(cdata_t* cdata, uint32_t stage_idx, group_op_t op,
+		uint64_t dt_us, as_status status)
+{
+	if (cdata->group_stats != NULL) {
+		group_stats_record(cdata->group_stats, stage_idx, op, dt_us, status);
+	}
+}
+
+/*
+ * moves the calling thread into phase for the breakdown of its own time
+ */
+LOCAL_HELPER void
+_enter_phase(cdata_t* cdata, self_phase_t phase)
+{
+	if (cdata->self_stats != NULL && !tl_reissuing) {
+		self_stats_enter(cdata->self_stats, phase);
+	}
+}
+
+/*
+ * takes the thread's next transaction out of its workload's budget,
+ * returning false once the budget is spent
+ */
+LOCAL_HELPER bool
+_take_op(cdata_t* cdata, tdata_t* tdata)
+{
+	if (cdata->budgets == NULL) {
+		return true;
+	}
+	return stage_budget_take_op(&cdata->budgets[tdata->stage_idx],
+			&tdata->budget_claim);
+}
+
+/*
+ * takes n bytes about to be written out of the workload's budget
+ */
+LOCAL_HELPER void
+_take_bytes(cdata_t* cdata, tdata_t* tdata, uint64_t n)
+{
+	if (cdata->budgets != NULL) {
+		stage_budget_take_bytes(&cdata->budgets[tdata->stage_idx],
+				&tdata->budget_claim, n);
+	}
+}
+
+/*
+ * mark the start and end of a transaction for the hardware counters, from
+ * building it to the return of the client call
+ */
+LOCAL_HELPER void
+_perf_begin(cdata_t* cdata)
+{
+	if (cdata->perf_counters != NULL && !tl_reissuing) {
+		perf_counters_begin(cdata->perf_counters);
+	}
+}
+
+LOCAL_HELPER void
+_perf_end(cdata_t* cdata, perf_op_t op)
+{
+	if (cdata->perf_counters != NULL && !tl_reissuing) {
+		perf_counters_end(cdata->perf_counters, op);
+	}
+}
+
+/*
+ * the number of bytes of bin data in every record of the batch that was
+ * written successfully, batch_bytes being that of the whole batch. Only the
+ * records that failed have their bins walked
+ */
+LOCAL_HELPER uint64_t
+_batch_written_size(const as_batch_records* records, uint64_t batch_bytes)
+{
+	uint64_t size = batch_bytes;
+	for (uint32_t i = 0; i < records->list.size; i++) {
+		as_batch_write_record* r =
+			as_vector_get((as_vector*) &records->list, i);
+		if (r->result == AEROSPIKE_OK) {
+			continue;
+		}
+		for (uint16_t j = 0; j < r->ops->binops.size; j++) {
+			size -= obj_spec_val_size(
+					(as_val*) r->ops->binops.entries[j].bin.valuep);
+		}
+	}
+	return size;
+}
+
+/******************************************************************************
+ * Key tracking helpers
+ *****************************************************************************/
+
+/*
+ * generates a random key for the stage. With key tracking enabled, RUD stages
+ * pick a key that exists if live is true and one that doesn't otherwise,
+ * falling back to any key if there is no key in that state
+ */
+LOCAL_HELPER uint64_t
+_gen_tracked_key(const cdata_t* cdata, tdata_t* tdata, const stage_t* stage,
+		bool live)
+{
+	uint64_t key_val;
+
+	if (cdata->key_tracker != NULL &&
+			stage->workload.type == WORKLOAD_TYPE_RUD &&
+			key_tracker_pick(cdata->key_tracker, tdata->random,
+				stage->key_start, stage->key_end, live, &key_val)) {
+		return key_val;
+	}
+	return stage_gen_random_key(stage, tdata->random);
+}
+
+/*
+ * reads target keys that exist, except for read_miss_pct percent of them
+ */
+LOCAL_HELPER uint64_t
+_gen_read_key(const cdata_t* cdata, tdata_t* tdata, const stage_t* stage)
+{
+	bool live = cdata->key_tracker == NULL ||
+		_random_fp(tdata->random) >= _pct_to_fp(cdata->read_miss_pct);
+	return _gen_tracked_key(cdata, tdata, stage, live);
+}
+
+LOCAL_HELPER void
+_track_key(cdata_t* cdata, const as_key* key, bool live)
+{
+	if (cdata->key_tracker != NULL) {
+		key_tracker_set_live(cdata->key_tracker,
+				(uint64_t) key->value.integer.value, live);
+	}
+}
+
+/*
+ * marks every record in the batch that was written successfully. Must only be
+ * called if the batch call itself succeeded, since the per-record results
+ * aren't filled in otherwise
+ */
+LOCAL_HELPER void
+_track_batch(cdata_t* cdata, const as_batch_records* records, bool live)
+{
+	if (cdata->key_tracker == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < records->list.size; i++) {
+		as_batch_write_record* r =
+			as_vector_get((as_vector*) &records->list, i);
+		if (r->result == AEROSPIKE_OK) {
+			_track_key(cdata, &r->key, live);
+		}
+	}
 }
 
 
@@ -290,34 +713,40 @@ _record_udf(cdata_t* cdata, uint64_t dt_us)
 
 LOCAL_HELPER int
 _write_record_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		as_key* key, as_record* rec)
+		as_key* key, as_record* rec, uint64_t rec_size)
 {
 	as_status status;
 	as_error err;
 
+	_take_bytes(cdata, tdata, rec_size);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	uint64_t start = cf_getus();
 	status = aerospike_key_put(&cdata->client, &err, &tdata->policies.write, key, rec);
 	uint64_t end = cf_getus();
+	_enter_phase(cdata, SELF_PHASE_RECORD);
+	_perf_end(cdata, PERF_OP_WRITE);
+	_record_node(cdata, key, NODE_OP_WRITE, end - start, status);
+	_record_slow(cdata, SLOW_OP_WRITE, end - start, status, 0, key);
+	_record_trace(cdata, TRACE_OP_WRITE, start, end, status, 0, key);
+	_record_workload(cdata, tdata->stage_idx, GROUP_OP_WRITE, end - start,
+			status);
 
 	if (status == AEROSPIKE_OK) {
-		_record_write(cdata, end - start);
+		_record_write(cdata, end - start,
+				_expected_interval(cdata, tdata, false));
+		_record_write_bytes(cdata, rec_size);
 		throttle(tdata, coord);
 		return 0;
 	}
 
 	// Handle error conditions.
-	if (status == AEROSPIKE_ERR_TIMEOUT) {
-		cdata->write_timeout_count++;
-	}
-	else {
-		cdata->write_error_count++;
-
-		if (cdata->debug) {
-			blog_error("Write error: ns=%s set=%s key=%d bin=%s code=%d "
-					"message=%s",
-					cdata->namespace, cdata->set, key, cdata->bin_name, status,
-					err.message);
-		}
+	_record_error(cdata, ERROR_OP_WRITE, status, end - start);
+	if (status != AEROSPIKE_ERR_TIMEOUT &&
+			error_stats_should_log(cdata->error_stats)) {
+		blog_error("Write error: ns=%s set=%s key=%d bin=%s code=%d "
+				"message=%s",
+				cdata->namespace, cdata->set, key, cdata->bin_name, status,
+				err.message);
 	}
 	throttle(tdata, coord);
 	return -1;
@@ -325,35 +754,42 @@ _write_record_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 LOCAL_HELPER int
 _batch_write_record_sync(tdata_t* tdata, cdata_t* cdata,
-		thr_coord_t* coord, as_batch_records* records)
+		thr_coord_t* coord, as_batch_records* records, uint64_t batch_bytes)
 {
 	as_status status;
 	as_error err;
 
+	_take_bytes(cdata, tdata, batch_bytes);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	uint64_t start = cf_getus();
 	status = aerospike_batch_write(&cdata->client, &err, &tdata->policies.batch,
 			records);
 	uint64_t end = cf_getus();
+	_enter_phase(cdata, SELF_PHASE_RECORD);
+	_perf_end(cdata, PERF_OP_WRITE);
+	_record_slow(cdata, SLOW_OP_WRITE, end - start, status, records->list.size,
+			NULL);
+	_record_trace(cdata, TRACE_OP_WRITE, start, end, status,
+			records->list.size, NULL);
+	_record_workload(cdata, tdata->stage_idx, GROUP_OP_WRITE, end - start,
+			status);
 
 	if (status == AEROSPIKE_OK) {
-		_record_write(cdata, end - start);
+		_record_write(cdata, end - start,
+				_expected_interval(cdata, tdata, false));
+		_record_write_bytes(cdata, _batch_written_size(records, batch_bytes));
 		throttle(tdata, coord);
 		return status;
 	}
 
 	// Handle error conditions.
-	if (status == AEROSPIKE_ERR_TIMEOUT) {
-		cdata->write_timeout_count++;
-	}
-	else {
-		cdata->write_error_count++;
-
-		if (cdata->debug) {
-			blog_error("Batch write error: ns=%s set=%s bin=%s code=%d "
-					"message=%s",
-					cdata->namespace, cdata->set, cdata->bin_name, status,
-					err.message);
-		}
+	_record_error(cdata, ERROR_OP_WRITE, status, end - start);
+	if (status != AEROSPIKE_ERR_TIMEOUT &&
+			error_stats_should_log(cdata->error_stats)) {
+		blog_error("Batch write error: ns=%s set=%s bin=%s code=%d "
+				"message=%s",
+				cdata->namespace, cdata->set, cdata->bin_name, status,
+				err.message);
 	}
 
 	throttle(tdata, coord);
@@ -370,20 +806,33 @@ _read_record_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	uint64_t start, end;
 	if (stage->read_bins) {
+		_enter_phase(cdata, SELF_PHASE_CLIENT);
 		start = cf_getus();
 		status = aerospike_key_select(&cdata->client, &err, &tdata->policies.read,
 				key, (const char**) stage->read_bins, &rec);
 		end = cf_getus();
+		_enter_phase(cdata, SELF_PHASE_RECORD);
+		_perf_end(cdata, PERF_OP_READ);
 	}
 	else {
+		_enter_phase(cdata, SELF_PHASE_CLIENT);
 		start = cf_getus();
 		status = aerospike_key_get(&cdata->client, &err, &tdata->policies.read,
 				key, &rec);
 		end = cf_getus();
+		_enter_phase(cdata, SELF_PHASE_RECORD);
+		_perf_end(cdata, PERF_OP_READ);
 	}
+	_record_node(cdata, key, NODE_OP_READ, end - start, status);
+	_record_slow(cdata, SLOW_OP_READ, end - start, status, 0, key);
+	_record_trace(cdata, TRACE_OP_READ, start, end, status, 0, key);
+	_record_workload(cdata, tdata->stage_idx, GROUP_OP_READ, end - start,
+			status);
 
 	if (status == AEROSPIKE_OK) {
-		_record_read(cdata, end - start);
+		_record_read(cdata, end - start,
+				_expected_interval(cdata, tdata, false));
+		_track_key(cdata, key, true);
 		as_record_destroy(rec);
 		throttle(tdata, coord);
 		return status;
@@ -391,15 +840,16 @@ _read_record_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	// Handle error conditions.
 	if (status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
-		cdata->read_miss_count++;
-	}
-	else if (status == AEROSPIKE_ERR_TIMEOUT) {
-		cdata->read_timeout_count++;
+		if (!_record_warmup(cdata, GROUP_OP_READ, end - start, status)) {
+			cdata->read_miss_count++;
+		}
+		_track_key(cdata, key, false);
 	}
 	else {
-		cdata->read_error_count++;
+		_record_error(cdata, ERROR_OP_READ, status, end - start);
 
-		if (cdata->debug) {
+		if (status != AEROSPIKE_ERR_TIMEOUT &&
+				error_stats_should_log(cdata->error_stats)) {
 			blog_error("Read error: ns=%s set=%s key=%d bin=%s code=%d "
 					"message=%s",
 					cdata->namespace, cdata->set, key->value.integer.value,
@@ -419,30 +869,35 @@ _batch_read_record_sync(tdata_t* tdata, cdata_t* cdata,
 	as_status status;
 	as_error err;
 
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	uint64_t start = cf_getus();
 	status = aerospike_batch_read(&cdata->client, &err, &tdata->policies.batch,
 			records);
 	uint64_t end = cf_getus();
+	_enter_phase(cdata, SELF_PHASE_RECORD);
+	_perf_end(cdata, PERF_OP_READ);
+	_record_slow(cdata, SLOW_OP_READ, end - start, status, records->list.size,
+			NULL);
+	_record_trace(cdata, TRACE_OP_READ, start, end, status,
+			records->list.size, NULL);
+	_record_workload(cdata, tdata->stage_idx, GROUP_OP_READ, end - start,
+			status);
 
 	if (status == AEROSPIKE_OK) {
-		_record_read(cdata, end - start);
+		_record_read(cdata, end - start,
+				_expected_interval(cdata, tdata, false));
 		throttle(tdata, coord);
 		return status;
 	}
 
 	// Handle error conditions.
-	if (status == AEROSPIKE_ERR_TIMEOUT) {
-		cdata->read_timeout_count++;
-	}
-	else {
-		cdata->read_error_count++;
-
-		if (cdata->debug) {
-			blog_error("Batch read error: ns=%s set=%s bin=%s code=%d "
-					"message=%s",
-					cdata->namespace, cdata->set, cdata->bin_name, status,
-					err.message);
-		}
+	_record_error(cdata, ERROR_OP_READ, status, end - start);
+	if (status != AEROSPIKE_ERR_TIMEOUT &&
+			error_stats_should_log(cdata->error_stats)) {
+		blog_error("Batch read error: ns=%s set=%s bin=%s code=%d "
+				"message=%s",
+				cdata->namespace, cdata->set, cdata->bin_name, status,
+				err.message);
 	}
 
 	throttle(tdata, coord);
@@ -468,13 +923,22 @@ _apply_udf_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		args = tdata->fixed_udf_fn_args;
 	}
 
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	start = cf_getus();
 	status = aerospike_key_apply(&cdata->client, &err, &tdata->policies.apply, key,
 			stage->udf_package_name, stage->udf_fn_name, args, &val);
 	end = cf_getus();
+	_enter_phase(cdata, SELF_PHASE_RECORD);
+	_perf_end(cdata, PERF_OP_UDF);
+	_record_node(cdata, key, NODE_OP_UDF, end - start, status);
+	_record_slow(cdata, SLOW_OP_UDF, end - start, status, 0, key);
+	_record_trace(cdata, TRACE_OP_UDF, start, end, status, 0, key);
+	_record_workload(cdata, tdata->stage_idx, GROUP_OP_UDF, end - start,
+			status);
 
 	if (status == AEROSPIKE_OK || status == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
-		_record_udf(cdata, end - start);
+		_record_udf(cdata, end - start,
+				_expected_interval(cdata, tdata, false));
 		as_val_destroy(val);
 		if (stage->random) {
 			as_val_destroy((as_val*) args);
@@ -484,18 +948,13 @@ _apply_udf_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	}
 
 	// Handle error conditions.
-	if (status == AEROSPIKE_ERR_TIMEOUT) {
-		cdata->udf_timeout_count++;
-	}
-	else {
-		cdata->udf_error_count++;
-
-		if (cdata->debug) {
-			blog_error("UDF error: ns=%s set=%s key=%d bin=%s code=%d "
-					"message=%s",
-					cdata->namespace, cdata->set, key->value.integer.value,
-					cdata->bin_name, status, err.message);
-		}
+	_record_error(cdata, ERROR_OP_UDF, status, end - start);
+	if (status != AEROSPIKE_ERR_TIMEOUT &&
+			error_stats_should_log(cdata->error_stats)) {
+		blog_error("UDF error: ns=%s set=%s key=%d bin=%s code=%d "
+				"message=%s",
+				cdata->namespace, cdata->set, key->value.integer.value,
+				cdata->bin_name, status, err.message);
 	}
 
 	as_val_destroy(val);
@@ -512,31 +971,42 @@ _apply_udf_sync(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
  *****************************************************************************/
 
 LOCAL_HELPER int
-_write_record_async(as_key* key, as_record* rec, struct async_data_s* adata,
-		tdata_t* tdata, cdata_t* cdata)
+_write_record_async(as_key* key, as_record* rec, uint64_t rec_size,
+		struct async_data_s* adata, tdata_t* tdata, cdata_t* cdata)
 {
 	as_status status;
 	as_error err;
 
+	adata->write_bytes = rec_size;
+	_take_bytes(cdata, tdata, adata->write_bytes);
+	adata->expected_interval = _expected_interval(cdata, tdata, true);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	adata->start_time = cf_getus();
 	status = aerospike_key_put_async(&cdata->client, &err, &tdata->policies.write,
 			key, rec, _async_write_listener, adata, adata->ev_loop, NULL);
 
 	if (status != AEROSPIKE_OK) {
 		// if the async call failed for any reason, call the callback directly
-		_async_write_listener(&err, adata, adata->ev_loop);
+		_async_write_listener(&err, adata, NULL);
 	}
 
+	_perf_end(cdata, PERF_OP_WRITE);
+	_enter_phase(cdata, SELF_PHASE_GEN);
 	return status;
 }
 
 LOCAL_HELPER int
-_batch_write_record_async(as_batch_records* keys, struct async_data_s* adata,
-		tdata_t* tdata, cdata_t* cdata)
+_batch_write_record_async(as_batch_records* keys, uint64_t batch_bytes,
+		struct async_data_s* adata, tdata_t* tdata, cdata_t* cdata)
 {
 	as_status status;
 	as_error err;
 
+	adata->batch_size = keys->list.size;
+	adata->write_bytes = batch_bytes;
+	_take_bytes(cdata, tdata, batch_bytes);
+	adata->expected_interval = _expected_interval(cdata, tdata, true);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	adata->start_time = cf_getus();
 	status = aerospike_batch_write_async(&cdata->client, &err,
 			&tdata->policies.batch, keys, _async_batch_write_listener, adata,
@@ -544,9 +1014,11 @@ _batch_write_record_async(as_batch_records* keys, struct async_data_s* adata,
 
 	if (status != AEROSPIKE_OK) {
 		// if the async call failed for any reason, call the callback directly
-		_async_batch_write_listener(&err, NULL, adata, adata->ev_loop);
+		_async_batch_write_listener(&err, NULL, adata, NULL);
 	}
 
+	_perf_end(cdata, PERF_OP_WRITE);
+	_enter_phase(cdata, SELF_PHASE_GEN);
 	return status;
 }
 
@@ -558,12 +1030,16 @@ _read_record_async(as_key* key, struct async_data_s* adata, tdata_t* tdata,
 	as_error err;
 
 	if (stage->read_bins) {
+		adata->expected_interval = _expected_interval(cdata, tdata, true);
+		_enter_phase(cdata, SELF_PHASE_CLIENT);
 		adata->start_time = cf_getus();
 		status = aerospike_key_select_async(&cdata->client, &err,
 				&tdata->policies.read, key, (const char**) stage->read_bins,
 				_async_read_listener, adata, adata->ev_loop, NULL);
 	}
 	else {
+		adata->expected_interval = _expected_interval(cdata, tdata, true);
+		_enter_phase(cdata, SELF_PHASE_CLIENT);
 		adata->start_time = cf_getus();
 		status = aerospike_key_get_async(&cdata->client, &err,
 				&tdata->policies.read, key, _async_read_listener, adata,
@@ -572,9 +1048,11 @@ _read_record_async(as_key* key, struct async_data_s* adata, tdata_t* tdata,
 
 	if (status != AEROSPIKE_OK) {
 		// if the async call failed for any reason, call the callback directly
-		_async_read_listener(&err, NULL, adata, adata->ev_loop);
+		_async_read_listener(&err, NULL, adata, NULL);
 	}
 
+	_perf_end(cdata, PERF_OP_READ);
+	_enter_phase(cdata, SELF_PHASE_GEN);
 	return status;
 }
 
@@ -585,6 +1063,9 @@ _batch_read_record_async(as_batch_read_records* keys, struct async_data_s* adata
 	as_status status;
 	as_error err;
 
+	adata->batch_size = keys->list.size;
+	adata->expected_interval = _expected_interval(cdata, tdata, true);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	adata->start_time = cf_getus();
 	status = aerospike_batch_read_async(&cdata->client, &err,
 			&tdata->policies.batch, keys, _async_batch_read_listener, adata,
@@ -592,9 +1073,11 @@ _batch_read_record_async(as_batch_read_records* keys, struct async_data_s* adata
 
 	if (status != AEROSPIKE_OK) {
 		// if the async call failed for any reason, call the callback directly
-		_async_batch_read_listener(&err, NULL, adata, adata->ev_loop);
+		_async_batch_read_listener(&err, NULL, adata, NULL);
 	}
 
+	_perf_end(cdata, PERF_OP_READ);
+	_enter_phase(cdata, SELF_PHASE_GEN);
 	return status;
 }
 
@@ -615,6 +1098,8 @@ _apply_udf_async(as_key* key, struct async_data_s* adata, tdata_t* tdata,
 		args = tdata->fixed_udf_fn_args;
 	}
 
+	adata->expected_interval = _expected_interval(cdata, tdata, true);
+	_enter_phase(cdata, SELF_PHASE_CLIENT);
 	adata->start_time = cf_getus();
 	status = aerospike_key_apply_async(&cdata->client, &err, &tdata->policies.apply,
 			key, stage->udf_package_name, stage->udf_fn_name, args,
@@ -626,9 +1111,11 @@ _apply_udf_async(as_key* key, struct async_data_s* adata, tdata_t* tdata,
 
 	if (status != AEROSPIKE_OK) {
 		// if the async call failed for any reason, call the callback directly
-		_async_read_listener(&err, NULL, adata, adata->ev_loop);
+		_async_read_listener(&err, NULL, adata, NULL);
 	}
 
+	_perf_end(cdata, PERF_OP_UDF);
+	_enter_phase(cdata, SELF_PHASE_GEN);
 	return status;
 }
 
@@ -654,14 +1141,25 @@ LOCAL_HELPER void
 _gen_key(uint64_t key_val, as_key* key, const cdata_t* cdata)
 {
 	as_key_init_int64(key, cdata->namespace, cdata->set, key_val);
+
+	if (cdata->digest_table != NULL) {
+		// the key value is kept so that send-key still works, but marking the
+		// digest as initialized stops the client from hashing the key again
+		const uint8_t* digest = digest_table_get(cdata->digest_table, key_val);
+		if (digest != NULL) {
+			memcpy(key->digest.value, digest, AS_DIGEST_VALUE_SIZE);
+			key->digest.init = true;
+		}
+	}
 }
 
 /*
- * generates a record with given key following the obj_spec in cdata
+ * generates a record with given key following the obj_spec in cdata, setting
+ * size to the number of bytes of bin data in it
  */
 LOCAL_HELPER as_record*
 _gen_record(as_random* random, const cdata_t* cdata, tdata_t* tdata,
-		const stage_t* stage)
+		const stage_t* stage, uint64_t* size)
 {
 	as_record* rec;
 	uint32_t write_all_pct = _pct_to_fp(stage->workload.write_all_pct);
@@ -672,30 +1170,52 @@ _gen_record(as_random* random, const cdata_t* cdata, tdata_t* tdata,
 			uint32_t n_objs = obj_spec_n_bins(&stage->obj_spec);
 			rec = as_record_new(n_objs);
 
-			obj_spec_populate_bins(&stage->obj_spec, rec, random,
-					cdata->bin_name, NULL, 0, cdata->compression_ratio);
+			_populate_record(cdata, stage, rec, random, NULL, 0, size);
 			rec->ttl = stage->ttl;
 		}
 		else {
 			rec = &tdata->fixed_full_record;
+			*size = tdata->fixed_full_size;
 		}
 	}
 	else {
 		if (stage->random) {
 			rec = as_record_new(stage->n_write_bins);
 
-			obj_spec_populate_bins(&stage->obj_spec, rec, random,
-					cdata->bin_name, stage->write_bins, stage->n_write_bins,
-					cdata->compression_ratio);
+			_populate_record(cdata, stage, rec, random, stage->write_bins,
+					stage->n_write_bins, size);
 			rec->ttl = stage->ttl;
 		}
 		else {
 			rec = &tdata->fixed_partial_record;
+			*size = tdata->fixed_partial_size;
 		}
 	}
 	return rec;
 }
 
+/*
+ * fills rec with bins generated from the stage's obj_spec, packing list/map
+ * bins directly to msgpack if requested, and sets size to the number of bytes
+ * of bin data generated
+ */
+LOCAL_HELPER void
+_populate_record(const cdata_t* cdata, const stage_t* stage, as_record* rec,
+		as_random* random, uint32_t* write_bins, uint32_t n_write_bins,
+		uint64_t* size)
+{
+	*size = 0;
+	if (cdata->packed_cdt) {
+		obj_spec_populate_packed_bins(&stage->obj_spec, rec, random,
+				cdata->bin_name, write_bins, n_write_bins,
+				cdata->compression_ratio, size);
+	}
+	else {
+		obj_spec_populate_bins(&stage->obj_spec, rec, random, cdata->bin_name,
+				write_bins, n_write_bins, cdata->compression_ratio, size);
+	}
+}
+
 /*
  * generates a batch of write records with nil bins, used for deleting bins
  * or entire records. keys are generated randomly between stage->key_start and stage->key_end
@@ -750,7 +1270,7 @@ _gen_batch_deletes(const cdata_t* cdata, tdata_t* tdata,
 		batch_write->policy = &tdata->policies.batch_write;
 
 		if (randomKeys) {
-			key_val = stage_gen_random_key(stage, tdata->random);
+			key_val = _gen_tracked_key(cdata, tdata, stage, true);
 			_gen_key(key_val, &batch_write->key, cdata);
 		}
 		else {
@@ -780,9 +1300,10 @@ _gen_batch_deletes(const cdata_t* cdata, tdata_t* tdata,
  */
 LOCAL_HELPER inline as_batch_records*
 _gen_batch_writes_random_keys(const cdata_t* cdata, tdata_t* tdata,	
-		const stage_t* stage)
+		const stage_t* stage, uint64_t* size)
 {
-	return _gen_batch_writes(cdata, tdata, stage, true, stage->key_start);
+	return _gen_batch_writes(cdata, tdata, stage, true, stage->key_start,
+			size);
 }
 
 /*
@@ -791,9 +1312,9 @@ _gen_batch_writes_random_keys(const cdata_t* cdata, tdata_t* tdata,
  */
 LOCAL_HELPER inline as_batch_records*
 _gen_batch_writes_sequential_keys(const cdata_t* cdata, tdata_t* tdata,	
-		const stage_t* stage, uint64_t start_key)
+		const stage_t* stage, uint64_t start_key, uint64_t* size)
 {
-	return _gen_batch_writes(cdata, tdata, stage, false, start_key);
+	return _gen_batch_writes(cdata, tdata, stage, false, start_key, size);
 }
 
 /*
@@ -801,19 +1322,25 @@ _gen_batch_writes_sequential_keys(const cdata_t* cdata, tdata_t* tdata,
  * if randomKeys == false the keys used in the batch writes will be sequential from key_start
  * otherwise keys are generated randomly between stage->key_start and stage->key_end
  * this function should only be called through its wrappers _gen_batch_writes_random_keys
- * and _gen_batch_writes_sequential_keys
+ * and _gen_batch_writes_sequential_keys. size is set to the number of bytes of
+ * bin data in the whole batch
  */
 LOCAL_HELPER as_batch_records*
 _gen_batch_writes(const cdata_t* cdata, tdata_t* tdata,	
-		const stage_t* stage, bool randomKeys, uint64_t start_key)
+		const stage_t* stage, bool randomKeys, uint64_t start_key,
+		uint64_t* size)
 {
 	uint32_t batch_size = stage->batch_write_size;
 	uint64_t key_val = start_key;
 
 	as_batch_records* batch = as_batch_records_create(batch_size);
+	*size = 0;
 
 	for (uint32_t i = 0; i < batch_size; i++) {
-		as_record* rec = _gen_record(tdata->random, cdata, tdata, stage);
+		uint64_t rec_size;
+		as_record* rec = _gen_record(tdata->random, cdata, tdata, stage,
+				&rec_size);
+		*size += rec_size;
 
 		as_batch_write_record* batch_write = as_batch_write_reserve(batch);
 		// set the batchwrite key value pointer to the address of its own
@@ -826,11 +1353,12 @@ _gen_batch_writes(const cdata_t* cdata, tdata_t* tdata,
 		batch_write->policy = &tdata->policies.batch_write;
 
 		if (randomKeys) {
-			key_val = stage_gen_random_key(stage, tdata->random);
+			key_val = _gen_tracked_key(cdata, tdata, stage, false);
 			_gen_key(key_val, &batch_write->key, cdata);
 		}
 		else {
-			_gen_key(key_val, &batch_write->key, cdata);
+			_gen_key(stage_linear_key(stage, key_val), &batch_write->key,
+					cdata);
 			++key_val;
 		}
 
@@ -879,13 +1407,17 @@ throttle(tdata_t* tdata, thr_coord_t* coord)
 	struct timespec wake_up;
 
 	if (tdata->dyn_throttle.target_period != 0) {
+		_enter_phase(tdata->cdata, SELF_PHASE_THROTTLE);
 		clock_gettime(COORD_CLOCK, &wake_up);
 
 		uint64_t pause_for = dyn_throttle_pause_for(&tdata->dyn_throttle,
 				timespec_to_us(&wake_up));
 		timespec_add_us(&wake_up, pause_for);
-		thr_coordinator_sleep(coord, &wake_up);
+		thr_coordinator_sleep(coord, tdata->epoch, &wake_up);
 	}
+	// whatever the thread does next is building its next transaction
+	_enter_phase(tdata->cdata, SELF_PHASE_GEN);
+	_perf_begin(tdata->cdata);
 }
 
 
@@ -902,7 +1434,7 @@ random_read(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	if (batch_size <= 1) {
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_read_key(cdata, tdata, stage);
 		_gen_key(key_val, &key, cdata);
 
 		_read_record_sync(tdata, cdata, coord, stage, &key);
@@ -912,8 +1444,7 @@ random_read(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		// generate a batch of random keys
 		as_batch_read_records* keys = as_batch_read_create(batch_size);
 		for (uint32_t i = 0; i < batch_size; i++) {
-			uint64_t key_val =
-				stage_gen_random_key(stage, tdata->random);
+			uint64_t key_val = _gen_read_key(cdata, tdata, stage);
 			as_batch_read_record* key = as_batch_read_reserve(keys);
 			_gen_key(key_val, &key->key, cdata);
 			if (stage->read_bins) {
@@ -938,25 +1469,33 @@ random_write(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	if (stage->batch_write_size <= 1) {
 		as_key key;
 		as_record* rec;
+		uint64_t rec_size;
 
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_tracked_key(cdata, tdata, stage, false);
 		_gen_key(key_val, &key, cdata);
 
 		// create a record
-		rec = _gen_record(tdata->random, cdata, tdata, stage);
+		rec = _gen_record(tdata->random, cdata, tdata, stage, &rec_size);
 
 		// write this record to the database
-		_write_record_sync(tdata, cdata, coord, &key, rec);
+		if (_write_record_sync(tdata, cdata, coord, &key, rec, rec_size) == 0) {
+			_track_key(cdata, &key, true);
+		}
 
 		_destroy_record(rec, stage);
 		as_key_destroy(&key);
 	}
 	else {
 		as_batch_records* batch;
+		uint64_t batch_bytes;
 
-		batch = _gen_batch_writes_random_keys(cdata, tdata, stage);
-		_batch_write_record_sync(tdata, cdata, coord, batch);
+		batch = _gen_batch_writes_random_keys(cdata, tdata, stage,
+				&batch_bytes);
+		if (_batch_write_record_sync(tdata, cdata, coord, batch,
+					batch_bytes) == AEROSPIKE_OK) {
+			_track_batch(cdata, batch, true);
+		}
 
 		for (uint32_t i = 0; i < batch->list.size; i++) {
 			as_batch_write_record* r = as_vector_get(&batch->list, i);
@@ -990,14 +1529,16 @@ random_delete(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		as_record* rec;
 
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_tracked_key(cdata, tdata, stage, true);
 		_gen_key(key_val, &key, cdata);
 
 		// create a record
 		rec = _gen_nil_record(tdata);
 
 		// write this record to the database
-		_write_record_sync(tdata, cdata, coord, &key, rec);
+		if (_write_record_sync(tdata, cdata, coord, &key, rec, 0) == 0) {
+			_track_key(cdata, &key, false);
+		}
 
 		// don't destroy delete records
 		as_key_destroy(&key);
@@ -1006,7 +1547,10 @@ random_delete(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		as_batch_records* batch;
 
 		batch = _gen_batch_deletes_random_keys(cdata, tdata, stage);
-		_batch_write_record_sync(tdata, cdata, coord, batch);
+		if (_batch_write_record_sync(tdata, cdata, coord, batch, 0) ==
+				AEROSPIKE_OK) {
+			_track_batch(cdata, batch, false);
+		}
 
 		for (uint32_t i = 0; i < batch->list.size; i++) {
 			as_batch_write_record* r = as_vector_get(&batch->list, i);
@@ -1035,23 +1579,27 @@ linear_writes(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	as_key key;
 	as_record* rec;
+	uint64_t rec_size;
 
-	// each worker thread takes a subrange of the total set of keys being
-	// inserted, all approximately equal in size
-	_calculate_subrange(stage->key_start, stage->key_end, t_idx,
-			cdata->transaction_worker_threads, &start_key, &end_key);
+	// each worker thread of the workload takes a subrange of the total set of
+	// keys being inserted, all approximately equal in size
+	_calculate_subrange(stage->key_start, stage->key_end,
+			t_idx - stage->first_thread, stage->n_threads, &start_key, &end_key);
 
 	key_val = start_key;
 	while (tdata->do_work &&
-			key_val < end_key) {
+			key_val < end_key && _take_op(cdata, tdata)) {
 
 		if (stage->batch_write_size <= 1) {
 			// create a record with given key
-			_gen_key(key_val, &key, cdata);
-			rec = _gen_record(tdata->random, cdata, tdata, stage);
+			_gen_key(stage_linear_key(stage, key_val), &key, cdata);
+			rec = _gen_record(tdata->random, cdata, tdata, stage, &rec_size);
 
 			// write this record to the database
-			_write_record_sync(tdata, cdata, coord, &key, rec);
+			if (_write_record_sync(tdata, cdata, coord, &key, rec,
+						rec_size) == 0) {
+				_track_key(cdata, &key, true);
+			}
 
 			_destroy_record(rec, stage);
 			as_key_destroy(&key);
@@ -1059,9 +1607,14 @@ linear_writes(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		}
 		else {
 			as_batch_records* batch;
+			uint64_t batch_bytes;
 
-			batch = _gen_batch_writes_sequential_keys(cdata, tdata, stage, key_val);
-			_batch_write_record_sync(tdata, cdata, coord, batch);
+			batch = _gen_batch_writes_sequential_keys(cdata, tdata, stage,
+					key_val, &batch_bytes);
+			if (_batch_write_record_sync(tdata, cdata, coord, batch,
+						batch_bytes) == AEROSPIKE_OK) {
+				_track_batch(cdata, batch, true);
+			}
 			key_val += stage->batch_write_size;
 
 			for (uint32_t i = 0; i < batch->list.size; i++) {
@@ -1083,12 +1636,15 @@ random_read_write(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 {
 	uint32_t read_pct = _pct_to_fp(stage->workload.read_pct);
 
-	// since there is no specific target number of transactions required before
-	// the stage is finished, only a timeout, tell the coordinator we are ready
-	// to finish as soon as the timer runs out
-	thr_coordinator_complete(coord);
+	// unless the workload has a budget to spend, there is no specific target
+	// number of transactions required before the stage is finished, only a
+	// timeout, so tell the coordinator we are ready to finish as soon as the
+	// timer runs out
+	if (!stage_has_budget(stage)) {
+		thr_coordinator_complete(coord);
+	}
 
-	while (tdata->do_work) {
+	while (tdata->do_work && _take_op(cdata, tdata)) {
 		// roll the die
 		uint32_t die = _random_fp(tdata->random);
 
@@ -1099,6 +1655,11 @@ random_read_write(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			random_write(tdata, cdata, coord, stage);
 		}
 	}
+
+	if (stage_has_budget(stage)) {
+		// the budget is spent, or the stage was stopped before it was
+		thr_coordinator_complete(coord);
+	}
 }
 
 LOCAL_HELPER void
@@ -1111,12 +1672,15 @@ random_read_write_udf(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	// store the cumulative probability in write_pct
 	write_pct = read_pct + write_pct;
 
-	// since there is no specific target number of transactions required before
-	// the stage is finished, only a timeout, tell the coordinator we are ready
-	// to finish as soon as the timer runs out
-	thr_coordinator_complete(coord);
+	// unless the workload has a budget to spend, there is no specific target
+	// number of transactions required before the stage is finished, only a
+	// timeout, so tell the coordinator we are ready to finish as soon as the
+	// timer runs out
+	if (!stage_has_budget(stage)) {
+		thr_coordinator_complete(coord);
+	}
 
-	while (tdata->do_work) {
+	while (tdata->do_work && _take_op(cdata, tdata)) {
 		// roll the die
 		uint32_t die = _random_fp(tdata->random);
 
@@ -1130,6 +1694,11 @@ random_read_write_udf(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			random_udf(tdata, cdata, coord, stage);
 		}
 	}
+
+	if (stage_has_budget(stage)) {
+		// the budget is spent, or the stage was stopped before it was
+		thr_coordinator_complete(coord);
+	}
 }
 
 LOCAL_HELPER void
@@ -1143,14 +1712,14 @@ linear_deletes(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	as_key key;
 	as_record* rec;
 
-	// each worker thread takes a subrange of the total set of keys being
-	// inserted, all approximately equal in size
-	_calculate_subrange(stage->key_start, stage->key_end, t_idx,
-			cdata->transaction_worker_threads, &start_key, &end_key);
+	// each worker thread of the workload takes a subrange of the total set of
+	// keys being inserted, all approximately equal in size
+	_calculate_subrange(stage->key_start, stage->key_end,
+			t_idx - stage->first_thread, stage->n_threads, &start_key, &end_key);
 
 	key_val = start_key;
 	while (tdata->do_work &&
-			key_val < end_key) {
+			key_val < end_key && _take_op(cdata, tdata)) {
 
 		if (stage->batch_delete_size <= 1) {
 			// create a record with given key
@@ -1158,7 +1727,9 @@ linear_deletes(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			rec = _gen_nil_record(tdata);
 
 			// delete this record from the database
-			_write_record_sync(tdata, cdata, coord, &key, rec);
+			if (_write_record_sync(tdata, cdata, coord, &key, rec, 0) == 0) {
+				_track_key(cdata, &key, false);
+			}
 
 			_destroy_record(rec, stage);
 			as_key_destroy(&key);
@@ -1169,7 +1740,10 @@ linear_deletes(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			as_batch_records* batch;
 
 			batch = _gen_batch_deletes_sequential_keys(cdata, tdata, stage, key_val);
-			_batch_write_record_sync(tdata, cdata, coord, batch);
+			if (_batch_write_record_sync(tdata, cdata, coord, batch, 0) ==
+					AEROSPIKE_OK) {
+				_track_batch(cdata, batch, false);
+			}
 			key_val += stage->batch_delete_size;
 
 			for (uint32_t i = 0; i < batch->list.size; i++) {
@@ -1194,12 +1768,15 @@ LOCAL_HELPER void random_read_write_delete(tdata_t* tdata, cdata_t* cdata,
 	// store the cumulative probability in write_pct
 	write_pct = read_pct + write_pct;
 
-	// since there is no specific target number of transactions required before
-	// the stage is finished, only a timeout, tell the coordinator we are ready
-	// to finish as soon as the timer runs out
-	thr_coordinator_complete(coord);
+	// unless the workload has a budget to spend, there is no specific target
+	// number of transactions required before the stage is finished, only a
+	// timeout, so tell the coordinator we are ready to finish as soon as the
+	// timer runs out
+	if (!stage_has_budget(stage)) {
+		thr_coordinator_complete(coord);
+	}
 
-	while (tdata->do_work) {
+	while (tdata->do_work && _take_op(cdata, tdata)) {
 		// roll the die
 		uint32_t die = _random_fp(tdata->random);
 
@@ -1213,6 +1790,11 @@ LOCAL_HELPER void random_read_write_delete(tdata_t* tdata, cdata_t* cdata,
 			random_delete(tdata, cdata, coord, stage);
 		}
 	}
+
+	if (stage_has_budget(stage)) {
+		// the budget is spent, or the stage was stopped before it was
+		thr_coordinator_complete(coord);
+	}
 }
 
 /******************************************************************************
@@ -1229,7 +1811,7 @@ random_read_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	if (batch_size <= 1) {
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_read_key(cdata, tdata, stage);
 
 		_gen_key(key_val, &adata->key, cdata);
 		_read_record_async(&adata->key, adata, tdata, cdata, stage);
@@ -1238,8 +1820,7 @@ random_read_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		// generate a batch of random keys
 		as_batch_read_records* keys = as_batch_read_create(batch_size);
 		for (uint32_t i = 0; i < batch_size; i++) {
-			uint64_t key_val =
-				stage_gen_random_key(stage, tdata->random);
+			uint64_t key_val = _gen_read_key(cdata, tdata, stage);
 			as_batch_read_record* key = as_batch_read_reserve(keys);
 			_gen_key(key_val, &key->key, cdata);
 			if (stage->read_bins) {
@@ -1264,22 +1845,25 @@ random_write_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 	if (stage->batch_write_size <= 1) {
 		as_record* rec;
+		uint64_t rec_size;
 
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_tracked_key(cdata, tdata, stage, false);
 
 		_gen_key(key_val, &adata->key, cdata);
-		rec = _gen_record(tdata->random, cdata, tdata, stage);
+		rec = _gen_record(tdata->random, cdata, tdata, stage, &rec_size);
 
-		_write_record_async(&adata->key, rec, adata, tdata, cdata);
+		_write_record_async(&adata->key, rec, rec_size, adata, tdata, cdata);
 
 		_destroy_record(rec, stage);
 	}
 	else {
 		as_batch_records* batch;
+		uint64_t batch_bytes;
 
-		batch = _gen_batch_writes_random_keys(cdata, tdata, stage);
-		_batch_write_record_async(batch, adata, tdata, cdata);
+		batch = _gen_batch_writes_random_keys(cdata, tdata, stage,
+				&batch_bytes);
+		_batch_write_record_async(batch, batch_bytes, adata, tdata, cdata);
 	}
 }
 
@@ -1299,17 +1883,18 @@ LOCAL_HELPER void
 random_delete_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		const stage_t* stage, struct async_data_s* adata)
 {
+	adata->op = delete_op;
+
 	if (stage->batch_delete_size <= 1) {
 		as_record* rec;
 
 		// generate a random key
-		uint64_t key_val = stage_gen_random_key(stage, tdata->random);
+		uint64_t key_val = _gen_tracked_key(cdata, tdata, stage, true);
 
 		_gen_key(key_val, &adata->key, cdata);
 		rec = _gen_nil_record(tdata);
-		adata->op = write_op;
 
-		_write_record_async(&adata->key, rec, adata, tdata, cdata);
+		_write_record_async(&adata->key, rec, 0, adata, tdata, cdata);
 
 		_destroy_record(rec, stage);
 	}
@@ -1317,7 +1902,7 @@ random_delete_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		as_batch_records* batch;
 
 		batch = _gen_batch_deletes_random_keys(cdata, tdata, stage);
-		_batch_write_record_async(batch, adata, tdata, cdata);
+		_batch_write_record_async(batch, 0, adata, tdata, cdata);
 	}
 }
 
@@ -1326,23 +1911,97 @@ random_delete_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
  * Asynchronous workload methods
  *****************************************************************************/
 
+/*
+ * single_key is false for batch commands, whose latency can't be attributed
+ * to any one node
+ */
 LOCAL_HELPER void
-_async_listener(as_error* err, void* udata, as_event_loop* event_loop)
+_async_listener(as_error* err, void* udata, as_event_loop* event_loop,
+		bool single_key)
 {
 	struct async_data_s* adata = (struct async_data_s*) udata;
 
 	cdata_t* cdata = adata->cdata;
 
+	if (single_key) {
+		static const node_op_t node_ops[] = {
+			[read_op] = NODE_OP_READ,
+			[write_op] = NODE_OP_WRITE,
+			[delete_op] = NODE_OP_WRITE,
+			[udf_op] = NODE_OP_UDF
+		};
+		_record_node(cdata, &adata->key, node_ops[adata->op],
+				cf_getus() - adata->start_time,
+				err == NULL ? AEROSPIKE_OK : err->code);
+	}
+
+	if (cdata->slow_ops != NULL) {
+		static const slow_op_t slow_ops[] = {
+			[read_op] = SLOW_OP_READ,
+			[write_op] = SLOW_OP_WRITE,
+			[delete_op] = SLOW_OP_WRITE,
+			[udf_op] = SLOW_OP_UDF
+		};
+		_record_slow(cdata, slow_ops[adata->op],
+				cf_getus() - adata->start_time,
+				err == NULL ? AEROSPIKE_OK : err->code,
+				single_key ? 0 : adata->batch_size,
+				single_key ? &adata->key : NULL);
+	}
+
+	if (cdata->group_stats != NULL) {
+		static const group_op_t group_ops[] = {
+			[read_op] = GROUP_OP_READ,
+			[write_op] = GROUP_OP_WRITE,
+			[delete_op] = GROUP_OP_WRITE,
+			[udf_op] = GROUP_OP_UDF
+		};
+		_record_workload(cdata, (uint32_t) (adata->stage - cdata->stages.stages),
+				group_ops[adata->op], cf_getus() - adata->start_time,
+				err == NULL ? AEROSPIKE_OK : err->code);
+	}
+
+	if (cdata->trace != NULL) {
+		static const trace_op_t trace_ops[] = {
+			[read_op] = TRACE_OP_READ,
+			[write_op] = TRACE_OP_WRITE,
+			[delete_op] = TRACE_OP_WRITE,
+			[udf_op] = TRACE_OP_UDF
+		};
+		_record_trace(cdata, trace_ops[adata->op], adata->start_time,
+				cf_getus(), err == NULL ? AEROSPIKE_OK : err->code,
+				single_key ? 0 : adata->batch_size,
+				single_key ? &adata->key : NULL);
+	}
+
+	if (single_key) {
+		if (err == NULL) {
+			if (adata->op != udf_op) {
+				_track_key(cdata, &adata->key, adata->op != delete_op);
+			}
+		}
+		else if (err->code == AEROSPIKE_ERR_RECORD_NOT_FOUND &&
+				adata->op == read_op) {
+			_track_key(cdata, &adata->key, false);
+		}
+	}
+
 	if (!err) {
 		uint64_t end = cf_getus();
 		if (adata->op == read_op) {
-			_record_read(cdata, end - adata->start_time);
+			_record_read(cdata, end - adata->start_time,
+					adata->expected_interval);
 		}
 		else if (adata->op == udf_op) {
-			_record_udf(cdata, end - adata->start_time);
+			_record_udf(cdata, end - adata->start_time,
+					adata->expected_interval);
 		}
 		else {
-			_record_write(cdata, end - adata->start_time);
+			_record_write(cdata, end - adata->start_time,
+					adata->expected_interval);
+			if (single_key) {
+				_record_write_bytes(cdata, adata->write_bytes);
+			}
 		}
 
 		// set the event loop (only effective the first time around but let's
@@ -1350,41 +2009,29 @@ _async_listener(as_error* err, void* udata, as_event_loop* event_loop)
 		adata->ev_loop = event_loop;
 	}
 	else {
-		if (err->code == AEROSPIKE_ERR_TIMEOUT) {
-			if (adata->op == read_op) {
-				cdata->read_timeout_count++;
-			}
-			else if (adata->op == udf_op) {
-				cdata->udf_timeout_count++;
-			}
-			else {
-				cdata->write_timeout_count++;
-			}
-		}
-		else {
-			if (adata->op == read_op) {
-				cdata->read_error_count++;
-			}
-			else if (adata->op == udf_op) {
-				cdata->udf_error_count++;
-			}
-			else {
-				cdata->write_error_count++;
-			}
-
-			if (cdata->debug) {
-				const static char* op_strs[] = {
-					"Read",
-					"Write",
-					"Delete",
-					"UDF"
-				};
-				blog_error("%s error: ns=%s set=%s key=%d bin=%s code=%d "
-						   "message=%s",
-						   op_strs[adata->op], cdata->namespace, cdata->set,
-						   adata->key.value.integer.value, cdata->bin_name,
-						   err->code, err->message);
-			}
+		static const error_op_t error_ops[] = {
+			[read_op] = ERROR_OP_READ,
+			[write_op] = ERROR_OP_WRITE,
+			[delete_op] = ERROR_OP_WRITE,
+			[udf_op] = ERROR_OP_UDF
+		};
+
+		_record_error(cdata, error_ops[adata->op], err->code,
+				cf_getus() - adata->start_time);
+
+		if (err->code != AEROSPIKE_ERR_TIMEOUT &&
+				error_stats_should_log(cdata->error_stats)) {
+			const static char* op_strs[] = {
+				"Read",
+				"Write",
+				"Delete",
+				"UDF"
+			};
+			blog_error("%s error: ns=%s set=%s key=%d bin=%s code=%d "
+					   "message=%s",
+					   op_strs[adata->op], cdata->namespace, cdata->set,
+					   adata->key.value.integer.value, cdata->bin_name,
+					   err->code, err->message);
 		}
 
 		if (err->code == AEROSPIKE_ERR_NO_MORE_CONNECTIONS) {
@@ -1393,28 +2040,44 @@ _async_listener(as_error* err, void* udata, as_event_loop* event_loop)
 		}
 	}
 
+	if (cdata->async_adaptive) {
+		// only timeouts and connection exhaustion indicate that too many
+		// commands are in flight, other errors say nothing about load
+		bool overloaded = err != NULL &&
+			(err->code == AEROSPIKE_ERR_TIMEOUT ||
+			 err->code == AEROSPIKE_ERR_NO_MORE_CONNECTIONS);
+		conc_limiter_release(&cdata->async_limiter,
+				cf_getus() - adata->start_time, overloaded);
+	}
+
+	// event_loop is NULL when the command failed to be issued, so the
+	// callback was called directly by whoever tried to issue it
+	if (event_loop != NULL && _async_reissue(adata, err, event_loop)) {
+		return;
+	}
+
 	// put this adata object back on the queue
-	queue_push(adata->adata_q, adata);
+	queue_push(&adata->pool->adata_q, adata);
 }
 
 LOCAL_HELPER void
 _async_read_listener(as_error* err, as_record* rec, void* udata,
 		as_event_loop* event_loop)
 {
-	_async_listener(err, udata, event_loop);
+	_async_listener(err, udata, event_loop, true);
 }
 
 LOCAL_HELPER void
 _async_write_listener(as_error* err, void* udata, as_event_loop* event_loop)
 {
-	_async_listener(err, udata, event_loop);
+	_async_listener(err, udata, event_loop, true);
 }
 
 LOCAL_HELPER void
 _async_batch_read_listener(as_error* err, as_batch_read_records* records,
 		void* udata, as_event_loop* event_loop)
 {
-	_async_listener(err, udata, event_loop);
+	_async_listener(err, udata, event_loop, false);
 	if (records != NULL) {
 		as_batch_read_destroy(records);
 	}
@@ -1424,7 +2087,15 @@ LOCAL_HELPER void
 _async_batch_write_listener(as_error* err, as_batch_records* records,
 		void* udata, as_event_loop* event_loop)
 {
-	_async_listener(err, udata, event_loop);
+	struct async_data_s* adata = (struct async_data_s*) udata;
+
+	// track before handing adata back, after which it may be reused
+	if (err == NULL && records != NULL) {
+		_track_batch(adata->cdata, records, adata->op != delete_op);
+		_record_write_bytes(adata->cdata,
+				_batch_written_size(records, adata->write_bytes));
+	}
+	_async_listener(err, udata, event_loop, false);
 
 	if (records != NULL) {
 		for (uint32_t i = 0; i < records->list.size; i++) {
@@ -1439,36 +2110,247 @@ LOCAL_HELPER void
 _async_val_listener(as_error* err, as_val* val, void* udata,
 		as_event_loop* event_loop)
 {
-	_async_listener(err, udata, event_loop);
+	_async_listener(err, udata, event_loop, true);
 	if (val != NULL) {
 		as_val_destroy(val);
 	}
 }
 
+/*
+ * pops an async_data struct off the pool's queue for the given workload and,
+ * if the number of in-flight commands is adaptive, waits until the
+ * concurrency limiter allows another command to be issued. Both waits spin
+ * for a while, then park until a command completes
+ *
+ * in throttled self-sustaining mode, waits for a permit instead, and returns
+ * NULL if the stage ends first
+ */
 LOCAL_HELPER struct async_data_s*
-queue_pop_wait(queue_t* adata_q)
+async_data_acquire(tdata_t* tdata, cdata_t* cdata, const stage_t* stage,
+		struct async_pool_s* pool)
 {
-	struct async_data_s* adata;
+	_enter_phase(cdata, SELF_PHASE_THROTTLE);
 
-	while (1) {
-		adata = queue_pop(adata_q);
-		if (adata == NULL) {
-			#ifdef __aarch64__
-			__asm__ __volatile__("yield");
-			#else
-			_mm_pause();
-			#endif
+	queue_wait_t wait;
+	struct async_data_s* adata =
+		(struct async_data_s*) queue_pop_wait(&pool->adata_q, &wait);
+	adata->stage = stage;
 
-			continue;
+	if (wait != QUEUE_WAIT_NONE && cdata->self_stats != NULL) {
+		self_stats_count_wait(cdata->self_stats, wait == QUEUE_WAIT_PARKED);
+	}
+
+	if (sustain_gate_throttled(&pool->gate)) {
+		while (1) {
+			uint64_t now = cf_getus();
+			if (sustain_gate_take_permit(&pool->gate, now)) {
+				break;
+			}
+			if (!tdata->do_work) {
+				queue_push(&pool->adata_q, adata);
+				return NULL;
+			}
+
+			struct timespec wake_time;
+			uint64_t next = sustain_gate_next_permit(&pool->gate);
+			clock_gettime(COORD_CLOCK, &wake_time);
+			timespec_add_us(&wake_time, next > now ? next - now : 0);
+			thr_coordinator_sleep(tdata->coord, tdata->epoch, &wake_time);
 		}
-		break;
 	}
+
+	if (cdata->async_adaptive) {
+		conc_limiter_t* cl = &cdata->async_limiter;
+
+		conc_limiter_update(cl, cf_getus());
+		while (!conc_limiter_try_acquire(cl)) {
+			bool parked = conc_limiter_wait(cl);
+			if (cdata->self_stats != NULL) {
+				self_stats_count_wait(cdata->self_stats, parked);
+			}
+			conc_limiter_update(cl, cf_getus());
+		}
+	}
+	_enter_phase(cdata, SELF_PHASE_GEN);
+	_perf_begin(cdata);
 	return adata;
 }
 
+LOCAL_HELPER struct async_pool_s*
+_async_pool_create(tdata_t* tdata, cdata_t* cdata)
+{
+	struct async_pool_s* pool =
+		(struct async_pool_s*) cf_malloc(sizeof(struct async_pool_s));
+
+	pool->tdata = tdata;
+	sustain_gate_init(&pool->gate);
+
+	pool->loops = NULL;
+	pool->n_loops = 0;
+	if (cdata->async_self_sustaining) {
+		pool->n_loops = as_event_loop_size;
+		pool->loops = (struct async_loop_s*) cf_malloc(pool->n_loops *
+				sizeof(struct async_loop_s));
+		for (uint32_t i = 0; i < pool->n_loops; i++) {
+			as_random_init(&pool->loops[i].random);
+		}
+	}
+
+	pool->n_adatas = cdata->async_max_commands;
+	pool->adatas = (struct async_data_s*) cf_malloc(pool->n_adatas *
+			sizeof(struct async_data_s));
+
+	queue_init(&pool->adata_q, pool->n_adatas);
+	pool->held = (struct async_data_s**) cf_malloc(pool->n_adatas *
+			sizeof(struct async_data_s*));
+	pool->n_held = 0;
+	for (uint32_t i = 0; i < pool->n_adatas; i++) {
+		struct async_data_s* adata = &pool->adatas[i];
+
+		adata->cdata = cdata;
+		adata->stage = NULL;
+		adata->pool = pool;
+		adata->ev_loop = NULL;
+
+		queue_push(&pool->adata_q, adata);
+	}
+	return pool;
+}
+
+/*
+ * holds back n of the pool's commands, taking more out of the queue as they
+ * complete or putting some back
+ */
+LOCAL_HELPER void
+_async_pool_hold(struct async_pool_s* pool, uint32_t n)
+{
+	while (pool->n_held < n) {
+		pool->held[pool->n_held++] =
+			(struct async_data_s*) queue_pop_wait(&pool->adata_q, NULL);
+	}
+	while (pool->n_held > n) {
+		queue_push(&pool->adata_q, pool->held[--pool->n_held]);
+	}
+}
+
+/*
+ * waits for every command of the pool to complete
+ */
+LOCAL_HELPER void
+_async_pool_drain(struct async_pool_s* pool)
+{
+	uint32_t n_held = pool->n_held;
+
+	_async_pool_hold(pool, pool->n_adatas);
+	_async_pool_hold(pool, n_held);
+}
+
+LOCAL_HELPER void
+_async_pool_free(struct async_pool_s* pool)
+{
+	_async_pool_drain(pool);
+	queue_free(&pool->adata_q);
+	cf_free(pool->held);
+	cf_free(pool->loops);
+	cf_free(pool->adatas);
+	cf_free(pool);
+}
+
+/*
+ * lets the event loops reissue the commands of the pool for the stage, each
+ * generating them from a copy of the issuing thread's state
+ */
+LOCAL_HELPER void
+_async_sustain_start(tdata_t* tdata, const stage_t* stage,
+		struct async_pool_s* pool)
+{
+	for (uint32_t i = 0; i < pool->n_loops; i++) {
+		struct async_loop_s* loop = &pool->loops[i];
+
+		loop->tdata = *tdata;
+		loop->tdata.random = &loop->random;
+		// each loop claims its own share of the budget
+		budget_claim_init(&loop->tdata.budget_claim);
+	}
+
+	sustain_gate_open(&pool->gate, stage,
+			(uint64_t) tdata->dyn_throttle.target_period, cf_getus());
+}
+
+/*
+ * called from the completion callback of a command, on its event loop, to
+ * issue the next command of the stage with the same async_data struct.
+ * Returns false if the command should be handed back to the issuing thread
+ * instead
+ */
+LOCAL_HELPER bool
+_async_reissue(struct async_data_s* adata, as_error* err,
+		as_event_loop* event_loop)
+{
+	struct async_pool_s* pool = adata->pool;
+	cdata_t* cdata = adata->cdata;
+	bool issued = false;
+
+	if (pool->loops == NULL) {
+		return false;
+	}
+
+	// a full event loop can't take the command, let the issuing thread find
+	// another
+	if (err != NULL && err->code == AEROSPIKE_ERR_NO_MORE_CONNECTIONS) {
+		return false;
+	}
+
+	const stage_t* stage = sustain_gate_enter(&pool->gate);
+	struct async_loop_s* loop = &pool->loops[event_loop->index];
+	if (stage != NULL && pool->tdata->do_work &&
+			sustain_gate_take_permit(&pool->gate, cf_getus()) &&
+			_take_op(cdata, &loop->tdata)) {
+		adata->stage = stage;
+		adata->ev_loop = event_loop;
+
+		tl_reissuing = true;
+		adata->start_time = cf_getus();
+		_random_op_async(&loop->tdata, cdata, stage, adata);
+		tl_reissuing = false;
+		issued = true;
+	}
+
+	sustain_gate_leave(&pool->gate);
+	return issued;
+}
+
+/*
+ * rolls the die for the next command of a random workload and issues it
+ */
+LOCAL_HELPER void
+_random_op_async(tdata_t* tdata, cdata_t* cdata, const stage_t* stage,
+		struct async_data_s* adata)
+{
+	const workload_t* workload = &stage->workload;
+	uint32_t read_pct = _pct_to_fp(workload->read_pct);
+	// the cumulative probability of a read or a write
+	uint32_t write_pct = read_pct + _pct_to_fp(workload->write_pct);
+	uint32_t die = _random_fp(tdata->random);
+
+	if (die < read_pct) {
+		random_read_async(tdata, cdata, NULL, stage, adata);
+	}
+	else if (workload->type == WORKLOAD_TYPE_RU ||
+			workload->type == WORKLOAD_TYPE_RR || die < write_pct) {
+		random_write_async(tdata, cdata, NULL, stage, adata);
+	}
+	else if (workload->type == WORKLOAD_TYPE_RUF) {
+		random_udf_async(tdata, cdata, NULL, stage, adata);
+	}
+	else {
+		random_delete_async(tdata, cdata, NULL, stage, adata);
+	}
+}
+
 LOCAL_HELPER void
 linear_writes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		const stage_t* stage, queue_t* adata_q)
+		const stage_t* stage, struct async_pool_s* pool)
 {
 	uint64_t key_val, end_key;
 	struct async_data_s* adata;
@@ -1479,9 +2361,9 @@ linear_writes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	key_val = stage->key_start;
 	end_key = stage->key_end;
 	while (tdata->do_work &&
-			key_val < end_key) {
+			key_val < end_key && _take_op(cdata, tdata)) {
 
-		adata = queue_pop_wait(adata_q);
+		adata = async_data_acquire(tdata, cdata, stage, pool);
 
 		clock_gettime(COORD_CLOCK, &wake_time);
 		start_time = timespec_to_us(&wake_time);
@@ -1491,125 +2373,115 @@ linear_writes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 
 		if (stage->batch_write_size <= 1) {
 			as_record* rec;
-			_gen_key(key_val, &adata->key, cdata);
-			rec = _gen_record(tdata->random, cdata, tdata, stage);
+			uint64_t rec_size;
 
-			_write_record_async(&adata->key, rec, adata, tdata, cdata);
+			_gen_key(stage_linear_key(stage, key_val), &adata->key, cdata);
+			rec = _gen_record(tdata->random, cdata, tdata, stage, &rec_size);
+
+			_write_record_async(&adata->key, rec, rec_size, adata, tdata,
+					cdata);
 
 			_destroy_record(rec, stage);
 			key_val++;
 		}
 		else {
 			as_batch_records* batch;
+			uint64_t batch_bytes;
 
-			batch = _gen_batch_writes_sequential_keys(cdata, tdata, stage, key_val);
-			_batch_write_record_async(batch, adata, tdata, cdata);
+			batch = _gen_batch_writes_sequential_keys(cdata, tdata, stage,
+					key_val, &batch_bytes);
+			_batch_write_record_async(batch, batch_bytes, adata, tdata, cdata);
 			key_val += stage->batch_write_size;
 		}
 
+		_enter_phase(cdata, SELF_PHASE_THROTTLE);
 		uint64_t pause_for =
 			dyn_throttle_pause_for(&tdata->dyn_throttle, start_time);
 		timespec_add_us(&wake_time, pause_for);
-		thr_coordinator_sleep(coord, &wake_time);
+		thr_coordinator_sleep(coord, tdata->epoch, &wake_time);
 	}
 
+	// the records aren't all written until the last commands complete
+	_async_pool_drain(pool);
+
 	// once we've written everything, there's nothing left to do, so tell
 	// coord we're done and exit
 	thr_coordinator_complete(coord);
 }
 
+/*
+ * RU, RR, RUF and RUD, which only differ in the ops they roll the die between
+ */
 LOCAL_HELPER void
-random_read_write_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		const stage_t* stage, queue_t* adata_q)
+random_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
+		const stage_t* stage, struct async_pool_s* pool)
 {
 	struct async_data_s* adata;
 
 	struct timespec wake_time;
 	uint64_t start_time;
 
-	uint32_t read_pct = _pct_to_fp(stage->workload.read_pct);
+	// the event loops take over issuing commands, and this thread only
+	// issues the ones they hand back
+	bool sustaining = pool->loops != NULL;
 
-	// since this workload has no target number of transactions to be made, we
-	// are always ready to be reaped, and so we notify the coordinator that we
-	// are finished with our required tasks and can be stopped whenever
-	thr_coordinator_complete(coord);
+	// unless this workload has a budget to spend, it has no target number of
+	// transactions to be made, so we are always ready to be reaped, and so we
+	// notify the coordinator that we are finished with our required tasks and
+	// can be stopped whenever
+	if (!stage_has_budget(stage)) {
+		thr_coordinator_complete(coord);
+	}
+
+	if (sustaining) {
+		_async_sustain_start(tdata, stage, pool);
+	}
 
-	while (tdata->do_work) {
+	while (tdata->do_work && _take_op(cdata, tdata)) {
 
-		adata = queue_pop_wait(adata_q);
+		adata = async_data_acquire(tdata, cdata, stage, pool);
+		if (adata == NULL) {
+			break;
+		}
 
 		clock_gettime(COORD_CLOCK, &wake_time);
 		start_time = timespec_to_us(&wake_time);
 		adata->start_time = start_time;
 
-		// roll the die
-		uint32_t die = _random_fp(tdata->random);
+		_random_op_async(tdata, cdata, stage, adata);
 
-		if (die < read_pct) {
-			random_read_async(tdata, cdata, coord, stage, adata);
-		}
-		else {
-			random_write_async(tdata, cdata, coord, stage, adata);
+		// the permits pace the commands when the event loops issue them
+		if (sustaining) {
+			continue;
 		}
 
+		_enter_phase(cdata, SELF_PHASE_THROTTLE);
 		uint64_t pause_for =
 			dyn_throttle_pause_for(&tdata->dyn_throttle, start_time);
 		timespec_add_us(&wake_time, pause_for);
-		thr_coordinator_sleep(coord, &wake_time);
+		thr_coordinator_sleep(coord, tdata->epoch, &wake_time);
 	}
-}
 
-LOCAL_HELPER void
-random_read_write_udf_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		const stage_t* stage, queue_t* adata_q)
-{
-	struct async_data_s* adata;
-
-	struct timespec wake_time;
-	uint64_t start_time;
-
-	uint32_t read_pct = _pct_to_fp(stage->workload.read_pct);
-	uint32_t write_pct = _pct_to_fp(stage->workload.write_pct);
-
-	// store the cumulative probability in write_pct
-	write_pct = read_pct + write_pct;
-
-	// since this workload has no target number of transactions to be made, we
-	// are always ready to be reaped, and so we notify the coordinator that we
-	// are finished with our required tasks and can be stopped whenever
-	thr_coordinator_complete(coord);
-
-	while (tdata->do_work) {
-
-		adata = queue_pop_wait(adata_q);
-
-		clock_gettime(COORD_CLOCK, &wake_time);
-		start_time = timespec_to_us(&wake_time);
-		adata->start_time = start_time;
-
-		// roll the die
-		uint32_t die = _random_fp(tdata->random);
+	if (stage_has_budget(stage)) {
+		// the event loops spend what they've claimed of the budget before
+		// handing the commands back
+		_async_pool_drain(pool);
+	}
 
-		if (die < read_pct) {
-			random_read_async(tdata, cdata, coord, stage, adata);
-		}
-		else if (die < write_pct) {
-			random_write_async(tdata, cdata, coord, stage, adata);
-		}
-		else {
-			random_udf_async(tdata, cdata, coord, stage, adata);
-		}
+	if (sustaining) {
+		// after which the stage's records and the loops' copies of the
+		// thread's state can go
+		sustain_gate_close(&pool->gate);
+	}
 
-		uint64_t pause_for =
-			dyn_throttle_pause_for(&tdata->dyn_throttle, start_time);
-		timespec_add_us(&wake_time, pause_for);
-		thr_coordinator_sleep(coord, &wake_time);
+	if (stage_has_budget(stage)) {
+		thr_coordinator_complete(coord);
 	}
 }
 
 LOCAL_HELPER void
 linear_deletes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		const stage_t* stage, queue_t* adata_q)
+		const stage_t* stage, struct async_pool_s* pool)
 {
 	uint64_t key_val, end_key;
 	struct async_data_s* adata;
@@ -1620,9 +2492,9 @@ linear_deletes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 	key_val = stage->key_start;
 	end_key = stage->key_end;
 	while (tdata->do_work &&
-			key_val < end_key) {
+			key_val < end_key && _take_op(cdata, tdata)) {
 
-			adata = queue_pop_wait(adata_q);
+			adata = async_data_acquire(tdata, cdata, stage, pool);
 
 			clock_gettime(COORD_CLOCK, &wake_time);
 			start_time = timespec_to_us(&wake_time);
@@ -1636,7 +2508,7 @@ linear_deletes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			_gen_key(key_val, &adata->key, cdata);
 			rec = _gen_nil_record(tdata);
 
-			_write_record_async(&adata->key, rec, adata, tdata, cdata);
+			_write_record_async(&adata->key, rec, 0, adata, tdata, cdata);
 
 			_destroy_record(rec, stage);
 			key_val++;
@@ -1645,69 +2517,25 @@ linear_deletes_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 			as_batch_records* batch;
 
 			batch = _gen_batch_deletes_sequential_keys(cdata, tdata, stage, key_val);
-			_batch_write_record_async(batch, adata, tdata, cdata);
+			_batch_write_record_async(batch, 0, adata, tdata, cdata);
 			key_val += stage->batch_delete_size;
 		}
 
+		_enter_phase(cdata, SELF_PHASE_THROTTLE);
 		uint64_t pause_for =
 			dyn_throttle_pause_for(&tdata->dyn_throttle, start_time);
 		timespec_add_us(&wake_time, pause_for);
-		thr_coordinator_sleep(coord, &wake_time);
+		thr_coordinator_sleep(coord, tdata->epoch, &wake_time);
 	}
 
+	// the records aren't all written until the last commands complete
+	_async_pool_drain(pool);
+
 	// once we've written everything, there's nothing left to do, so tell
 	// coord we're done and exit
 	thr_coordinator_complete(coord);
 }
 
-LOCAL_HELPER void
-random_read_write_delete_async(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
-		const stage_t* stage, queue_t* adata_q)
-{
-	struct async_data_s* adata;
-
-	struct timespec wake_time;
-	uint64_t start_time;
-
-	uint32_t read_pct = _pct_to_fp(stage->workload.read_pct);
-	uint32_t write_pct = _pct_to_fp(stage->workload.write_pct);
-
-	// store the cumulative probability in write_pct
-	write_pct = read_pct + write_pct;
-
-	// since this workload has no target number of transactions to be made, we
-	// are always ready to be reaped, and so we notify the coordinator that we
-	// are finished with our required tasks and can be stopped whenever
-	thr_coordinator_complete(coord);
-
-	while (tdata->do_work) {
-
-		adata = queue_pop_wait(adata_q);
-
-		clock_gettime(COORD_CLOCK, &wake_time);
-		start_time = timespec_to_us(&wake_time);
-		adata->start_time = start_time;
-
-		// roll the die
-		uint32_t die = _random_fp(tdata->random);
-
-		if (die < read_pct) {
-			random_read_async(tdata, cdata, coord, stage, adata);
-		}
-		else if (die < write_pct) {
-			random_write_async(tdata, cdata, coord, stage, adata);
-		}
-		else {
-			random_delete_async(tdata, cdata, coord, stage, adata);
-		}
-
-		uint64_t pause_for =
-			dyn_throttle_pause_for(&tdata->dyn_throttle, start_time);
-		timespec_add_us(&wake_time, pause_for);
-		thr_coordinator_sleep(coord, &wake_time);
-	}
-}
-
 
 /******************************************************************************
  * Main worker thread loop
@@ -1741,61 +2569,40 @@ LOCAL_HELPER void
 do_async_workload(tdata_t* tdata, cdata_t* cdata, thr_coord_t* coord,
 		stage_t* stage)
 {
-	struct async_data_s* adatas;
 	uint32_t t_idx = tdata->t_idx;
-	uint64_t n_adatas;
-	queue_t adata_q;
 
-	// thread 0 is designated to handle async calls, the rest can immediately
-	// terminate
-	if (t_idx != 0) {
+	// the first thread of the workload is designated to handle async calls,
+	// the rest can immediately terminate
+	if (t_idx != stage->first_thread) {
 		thr_coordinator_complete(coord);
 		return;
 	}
 
-	n_adatas = cdata->async_max_commands;
-	adatas =
-		(struct async_data_s*) cf_malloc(n_adatas * sizeof(struct async_data_s));
-
-	queue_init(&adata_q, n_adatas);
-	for (uint32_t i = 0; i < n_adatas; i++) {
-		struct async_data_s* adata = &adatas[i];
-
-		adata->cdata = cdata;
-		adata->stage = stage;
-		adata->adata_q = &adata_q;
-		adata->ev_loop = NULL;
-
-		queue_push(&adata_q, adata);
+	// the commands still in flight from the last stage this thread issued
+	// from are left to complete on their own, and are reused as they do
+	if (tdata->async_pool == NULL) {
+		tdata->async_pool = _async_pool_create(tdata, cdata);
 	}
+	struct async_pool_s* pool = tdata->async_pool;
+
+	// the stage may keep fewer commands in flight than the pool has
+	_async_pool_hold(pool, pool->n_adatas - stage->async_max_commands);
 
 	switch (stage->workload.type) {
 		case WORKLOAD_TYPE_I:
-			linear_writes_async(tdata, cdata, coord, stage, &adata_q);
+			linear_writes_async(tdata, cdata, coord, stage, pool);
 			break;
 		case WORKLOAD_TYPE_RU:
 		case WORKLOAD_TYPE_RR:
-			random_read_write_async(tdata, cdata, coord, stage, &adata_q);
-			break;
 		case WORKLOAD_TYPE_RUF:
-			random_read_write_udf_async(tdata, cdata, coord, stage, &adata_q);
+		case WORKLOAD_TYPE_RUD:
+			random_async(tdata, cdata, coord, stage, pool);
 			break;
 		case WORKLOAD_TYPE_D:
-			linear_deletes_async(tdata, cdata, coord, stage, &adata_q);
-			break;
-		case WORKLOAD_TYPE_RUD:
-			random_read_write_delete_async(tdata, cdata, coord, stage, &adata_q);
+			linear_deletes_async(tdata, cdata, coord, stage, pool);
 			break;
 	}
-
-	// wait for all the async calls to finish
-	for (uint32_t i = 0; i < n_adatas; i++) {
-		queue_pop_wait(&adata_q);
-	}
-	queue_free(&adata_q);
-
-	// free the async_data structs
-	cf_free(adatas);
+	_async_pool_hold(pool, 0);
 }
 
 LOCAL_HELPER void
@@ -1813,12 +2620,14 @@ _set_stage_policies(tdata_t* tdata, stage_t* stage)
 	}
 
 	tdata->policies.apply.ttl = stage->ttl;
+	tdata->policies.batch.concurrent = stage->batch_concurrent;
 }
 
 LOCAL_HELPER void
 init_stage(const cdata_t* cdata, tdata_t* tdata, stage_t* stage)
 {
 	_set_stage_policies(tdata, stage);
+	budget_claim_init(&tdata->budget_claim);
 
 	if (stage->tps == 0) {
 		// tps = 0 means no throttling
@@ -1828,8 +2637,7 @@ init_stage(const cdata_t* cdata, tdata_t* tdata, stage_t* stage)
 		// dyn_throttle uses a target delay between consecutive events, so
 		// calculate the target delay given the requested transactions per
 		// second and the number of concurrent transactions (i.e. num threads)
-		uint32_t n_threads = stage->async ? 1 :
-			cdata->transaction_worker_threads;
+		uint32_t n_threads = stage->async ? 1 : stage->n_threads;
 		dyn_throttle_init(&tdata->dyn_throttle,
 				(1000000.f * n_threads) / stage->tps);
 	}
@@ -1840,9 +2648,8 @@ init_stage(const cdata_t* cdata, tdata_t* tdata, stage_t* stage)
 			if (stage->workload.write_all_pct != 0) {
 				uint32_t n_bins = obj_spec_n_bins(&stage->obj_spec);
 				as_record_init(&tdata->fixed_full_record, n_bins);
-				obj_spec_populate_bins(&stage->obj_spec, &tdata->fixed_full_record,
-						tdata->random, cdata->bin_name, NULL, 0,
-						cdata->compression_ratio);
+				_populate_record(cdata, stage, &tdata->fixed_full_record,
+						tdata->random, NULL, 0, &tdata->fixed_full_size);
 
 				tdata->fixed_full_record.ttl = stage->ttl;
 			}
@@ -1850,9 +2657,9 @@ init_stage(const cdata_t* cdata, tdata_t* tdata, stage_t* stage)
 				uint32_t n_bins = stage->n_write_bins;
 
 				as_record_init(&tdata->fixed_partial_record, n_bins);
-				obj_spec_populate_bins(&stage->obj_spec, &tdata->fixed_partial_record,
-						tdata->random, cdata->bin_name, stage->write_bins, n_bins,
-						cdata->compression_ratio);
+				_populate_record(cdata, stage, &tdata->fixed_partial_record,
+						tdata->random, stage->write_bins, n_bins,
+						&tdata->fixed_partial_size);
 
 				tdata->fixed_partial_record.ttl = stage->ttl;
 			}
@@ -0,0 +1,202 @@
+
+//==========================================================
+// Includes.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <warmup_stats.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+static const char* const warmup_op_strs[GROUP_OP_COUNT] = {
+	"warmup-read",
+	"warmup-write",
+	"warmup-udf"
+};
+
+// the order the totals print their latencies in
+static const group_op_t latency_order[GROUP_OP_COUNT] = {
+	GROUP_OP_WRITE,
+	GROUP_OP_READ,
+	GROUP_OP_UDF
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+LOCAL_HELPER void _init_op(struct group_op_stats_s* stats);
+LOCAL_HELPER void _clear(struct group_op_stats_s* stats);
+
+
+//==========================================================
+// Public API.
+//
+
+warmup_stats_t*
+warmup_stats_create(bool latency)
+{
+	warmup_stats_t* ws = (warmup_stats_t*) cf_malloc(sizeof(warmup_stats_t));
+
+	atomic_init(&ws->active, false);
+	ws->begin_us = 0;
+	ws->elapsed_us = 0;
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		_init_op(&ws->ops[op]);
+		_init_op(&ws->period[op]);
+
+		if (latency) {
+			hdr_init(1, 1000000, 3, &ws->ops[op].hdr);
+		}
+	}
+	atomic_init(&ws->period_bytes, 0);
+	return ws;
+}
+
+void
+warmup_stats_free(warmup_stats_t* ws)
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		if (ws->ops[op].hdr != NULL) {
+			hdr_close(ws->ops[op].hdr);
+		}
+	}
+	cf_free(ws);
+}
+
+void
+warmup_stats_begin(warmup_stats_t* ws)
+{
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		_clear(&ws->ops[op]);
+	}
+	ws->begin_us = cf_getus();
+	ws->elapsed_us = 0;
+	atomic_store(&ws->active, true);
+}
+
+void
+warmup_stats_end(warmup_stats_t* ws)
+{
+	atomic_store(&ws->active, false);
+	ws->elapsed_us = cf_getus() - ws->begin_us;
+}
+
+void
+warmup_stats_record(warmup_stats_t* ws, group_op_t op, uint64_t dt_us,
+		as_status status)
+{
+	group_op_stats_record(&ws->ops[op], op, dt_us, status);
+	group_op_stats_record(&ws->period[op], op, dt_us, status);
+}
+
+void
+warmup_stats_add_bytes(warmup_stats_t* ws, uint64_t n_bytes)
+{
+	atomic_fetch_add_explicit(&ws->period_bytes, n_bytes,
+			memory_order_relaxed);
+}
+
+void
+warmup_stats_take_period(warmup_stats_t* ws,
+		struct interval_counts_s counts[GROUP_OP_COUNT])
+{
+	memset(counts, 0, GROUP_OP_COUNT * sizeof(struct interval_counts_s));
+
+	if (ws == NULL) {
+		return;
+	}
+
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		struct group_op_stats_s* stats = &ws->period[op];
+
+		counts[op].ok = atomic_exchange(&stats->ok, 0);
+		counts[op].miss = atomic_exchange(&stats->miss, 0);
+		counts[op].timeouts = atomic_exchange(&stats->timeouts, 0);
+		counts[op].errors = atomic_exchange(&stats->errors, 0);
+	}
+	counts[GROUP_OP_WRITE].bytes = atomic_exchange(&ws->period_bytes, 0);
+}
+
+void
+warmup_stats_print(warmup_stats_t* ws, as_vector* percentiles,
+		FILE* out_file)
+{
+	uint64_t elapsed_s = ws->elapsed_us / 1000000;
+
+	fprintf(out_file, "Warmup (excluded from the totals, %" PRIu64 "s): ",
+			elapsed_s);
+	for (uint32_t op = 0; op < GROUP_OP_COUNT; op++) {
+		struct group_op_stats_s* stats = &ws->ops[op];
+		uint64_t ok = atomic_load(&stats->ok);
+		uint64_t miss = atomic_load(&stats->miss);
+		uint64_t timeouts = atomic_load(&stats->timeouts);
+		uint64_t errors = atomic_load(&stats->errors);
+
+		if (ok + miss + timeouts + errors == 0) {
+			continue;
+		}
+		if (op == GROUP_OP_READ) {
+			fprintf(out_file, "read(count=%" PRIu64 " (hit=%" PRIu64 " miss=%"
+					PRIu64 ") timeouts=%" PRIu64 " errors=%" PRIu64 ") ",
+					ok + miss, ok, miss, timeouts, errors);
+		}
+		else {
+			fprintf(out_file, "%s(count=%" PRIu64 " timeouts=%" PRIu64
+					" errors=%" PRIu64 ") ",
+					op == GROUP_OP_WRITE ? "write" : "udf", ok, timeouts,
+					errors);
+		}
+	}
+	fprintf(out_file, "\n");
+
+	for (uint32_t i = 0; i < GROUP_OP_COUNT; i++) {
+		group_op_t op = latency_order[i];
+		struct hdr_histogram* h = ws->ops[op].hdr;
+
+		if (h == NULL || hdr_total_count(h) == 0) {
+			continue;
+		}
+		print_hdr_percentiles(h, warmup_op_strs[op], elapsed_s, percentiles,
+				out_file);
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+LOCAL_HELPER void
+_init_op(struct group_op_stats_s* stats)
+{
+	atomic_init(&stats->ok, 0);
+	atomic_init(&stats->miss, 0);
+	atomic_init(&stats->timeouts, 0);
+	atomic_init(&stats->errors, 0);
+	stats->hdr = NULL;
+}
+
+LOCAL_HELPER void
+_clear(struct group_op_stats_s* stats)
+{
+	atomic_store(&stats->ok, 0);
+	atomic_store(&stats->miss, 0);
+	atomic_store(&stats->timeouts, 0);
+	atomic_store(&stats->errors, 0);
+	if (stats->hdr != NULL) {
+		hdr_reset(stats->hdr);
+	}
+}
+
@@ -41,6 +41,10 @@ static const cyaml_schema_field_t stage_mapping_schema[] = {
 			0, CYAML_UNLIMITED),
 	CYAML_FIELD_UINT("duration", CYAML_FLAG_OPTIONAL | CYAML_FLAG_DEFAULT_ONES,
 			stage_def_t, duration),
+	CYAML_FIELD_UINT("ops", CYAML_FLAG_OPTIONAL,
+			stage_def_t, ops),
+	CYAML_FIELD_UINT("bytes", CYAML_FLAG_OPTIONAL,
+			stage_def_t, bytes),
 	CYAML_FIELD_STRING_PTR("workload", 0,
 			stage_def_t, workload_str,
 			0, CYAML_UNLIMITED),
@@ -64,6 +68,8 @@ static const cyaml_schema_field_t stage_mapping_schema[] = {
 			0, CYAML_UNLIMITED),
 	CYAML_FIELD_UINT("pause", CYAML_FLAG_OPTIONAL,
 			stage_def_t, pause),
+	CYAML_FIELD_UINT("warmup", CYAML_FLAG_OPTIONAL,
+			stage_def_t, warmup),
 	CYAML_FIELD_UINT("batch-size", CYAML_FLAG_OPTIONAL,
 			stage_def_t, batch_size),
 	CYAML_FIELD_UINT("batch-write-size", CYAML_FLAG_OPTIONAL,
@@ -80,6 +86,12 @@ static const cyaml_schema_field_t stage_mapping_schema[] = {
 			stage_def_t, ttl),
 	CYAML_FIELD_MAPPING("udf", CYAML_FLAG_DEFAULT | CYAML_FLAG_OPTIONAL,
 			stage_def_t, udf_spec, udf_spec_mapping_schema),
+	CYAML_FIELD_UINT("threads", CYAML_FLAG_OPTIONAL,
+			stage_def_t, threads),
+	CYAML_FIELD_UINT("async-max-commands", CYAML_FLAG_OPTIONAL,
+			stage_def_t, async_max_commands),
+	CYAML_FIELD_BOOL("batch-concurrent", CYAML_FLAG_OPTIONAL,
+			stage_def_t, batch_concurrent),
 	CYAML_FIELD_END
 };
 
@@ -148,6 +160,11 @@ LOCAL_HELPER void _parse_bins_destroy(as_vector* read_bins, uint8_t mode);
  * frees the bins selection array created from parse_bins_selection in STR mode
  */
 LOCAL_HELPER void _free_bins_selection(char** bins);
+/*
+ * splits the worker threads between the workloads of each group of stages
+ * that run concurrently, and gives them a common duration and pause
+ */
+LOCAL_HELPER int _resolve_groups(stages_t* stages, const args_t* args);
 
 
 //==========================================================
@@ -157,10 +174,17 @@ LOCAL_HELPER void _free_bins_selection(char** bins);
 int
 parse_workload_type(workload_t* workload, const char* workload_str)
 {
+	workload->shuffle = false;
+
 	if (strcmp(workload_str, "I") == 0) {
 		workload->type = WORKLOAD_TYPE_I;
 		workload->write_all_pct = WORKLOAD_UNSET_PCT;
 	}
+	else if (strcmp(workload_str, "I,shuffle") == 0) {
+		workload->type = WORKLOAD_TYPE_I;
+		workload->write_all_pct = WORKLOAD_UNSET_PCT;
+		workload->shuffle = true;
+	}
 	else if (strncmp(workload_str, "RUF", 3) == 0) {
 		float read_pct;
 		float write_pct;
@@ -351,10 +375,28 @@ stages_set_defaults_and_parse(stages_t* stages, const stage_defs_t* stage_defs,
 
 		stage->desc = stage_def->desc ? strdup(stage_def->desc) : stage_def->desc;
 		stage->tps = stage_def->tps;
+		stage->ops = stage_def->ops;
+		stage->bytes = stage_def->bytes;
 		stage->pause = stage_def->pause;
+		stage->warmup = stage_def->warmup;
 		stage->async = stage_def->async;
 		stage->random = stage_def->random;
 		stage->ttl = stage_def->ttl;
+		stage->batch_concurrent = stage_def->batch_concurrent;
+
+		if (stage_def->async_max_commands == 0) {
+			stage->async_max_commands = (uint32_t) args->async_max_commands;
+		}
+		else if (stage_def->async_max_commands > 5000) {
+			fprintf(stderr,
+					"Stage %d: async-max-commands must be > 0 and <= 5000, "
+					"not %" PRIu32 "\n",
+					i + 1, stage_def->async_max_commands);
+			ret = -1;
+		}
+		else {
+			stage->async_max_commands = stage_def->async_max_commands;
+		}
 
 		if (stage_def->key_start == -1LU) {
 			// if key_start wasn't specified, then inherit from the global context
@@ -388,18 +430,37 @@ stages_set_defaults_and_parse(stages_t* stages, const stage_defs_t* stage_defs,
 		stage->batch_write_size = stage_def->batch_write_size ? stage_def->batch_write_size : stage->batch_size;
 		stage->batch_delete_size = stage_def->batch_delete_size ? stage_def->batch_delete_size : stage->batch_size;
 
-		if (stage_def->stage_idx != i + 1) {
+		// a stage marked with the same index as the one before it runs
+		// concurrently with it
+		const stage_t* prev = i == 0 ? NULL : &stages->stages[i - 1];
+		uint32_t group = prev == NULL ? 0 : prev->group;
+		if (prev != NULL && stage_def->stage_idx == group + 2) {
+			group++;
+		}
+
+		if (stage_def->stage_idx != group + 1) {
 			fprintf(stderr,
 					"Stage %d is marked with index %d\n",
 					i + 1, stage_def->stage_idx);
 			ret = -1;
 		}
+		stage->group = group;
+		stage->group_pos = (prev != NULL && prev->group == group) ?
+			prev->group_pos + 1 : 0;
+		// the explicitly requested threads, 0 until the groups are resolved
+		stage->first_thread = 0;
+		stage->n_threads = stage_def->threads;
 
 		if (parse_workload_type(&stage->workload, stage_def->workload_str)
 				!= 0) {
 			ret = -1;
 		}
 
+		if (stage->workload.shuffle) {
+			key_perm_init(&stage->key_perm, stage->key_end - stage->key_start,
+					as_random_next_uint64(as_random_instance()));
+		}
+
 		if (stage->workload.type == WORKLOAD_TYPE_D && stage->random) {
 			fprintf(stderr,
 					"Stage %d is a delete workload, so you cannot have random "
@@ -429,7 +490,9 @@ stages_set_defaults_and_parse(stages_t* stages, const stage_defs_t* stage_defs,
 		}
 
 		if (stage_def->duration == -1LU) {
-			if (workload_is_infinite(&stage->workload)) {
+			// a workload with a budget runs until it's spent
+			if (workload_is_infinite(&stage->workload) &&
+					!stage_has_budget(stage)) {
 				stage->duration = DEFAULT_RANDOM_DURATION;
 			}
 			else {
@@ -440,6 +503,13 @@ stages_set_defaults_and_parse(stages_t* stages, const stage_defs_t* stage_defs,
 			stage->duration = stage_def->duration;
 		}
 
+		if (stage->bytes != 0 && !workload_contains_writes(&stage->workload)) {
+			fprintf(stderr, "Stage %d: cannot specify bytes on workload "
+					"without writes\n",
+					i + 1);
+			ret = -1;
+		}
+
 		if (stage_def->obj_spec_str == NULL) {
 			// inherit obj_spec either from the previous stage or from the
 			// global obj_spec
@@ -561,6 +631,10 @@ stages_set_defaults_and_parse(stages_t* stages, const stage_defs_t* stage_defs,
 		}
 	}
 
+	if (ret == 0) {
+		ret = _resolve_groups(stages, args);
+	}
+
 	if (ret != 0) {
 		free_workload_config(stages);
 		stages->valid = false;
@@ -657,6 +731,39 @@ bool stages_contain_udfs(const stages_t* stages)
 	return false;
 }
 
+void stages_key_range(const stages_t* stages, uint64_t* key_start,
+		uint64_t* key_end)
+{
+	*key_start = UINT64_MAX;
+	*key_end = 0;
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		*key_start = MIN(*key_start, stages->stages[i].key_start);
+		*key_end = MAX(*key_end, stages->stages[i].key_end);
+	}
+}
+
+uint32_t stages_n_threads(const stages_t* stages)
+{
+	uint32_t n_threads = 0;
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		const stage_t* stage = &stages->stages[i];
+		n_threads = MAX(n_threads, stage->first_thread + stage->n_threads);
+	}
+	return n_threads;
+}
+
+uint32_t stages_async_max_commands(const stages_t* stages)
+{
+	uint32_t max_commands = 0;
+	for (uint32_t i = 0; i < stages->n_stages; i++) {
+		if (stages->stages[i].async) {
+			max_commands = MAX(max_commands,
+					stages->stages[i].async_max_commands);
+		}
+	}
+	return max_commands;
+}
+
 uint64_t stage_gen_random_key(const stage_t* stage, as_random* random)
 {
 	return gen_rand_range_64(random, stage->key_end - stage->key_start) +
@@ -692,22 +799,30 @@ void stages_print(const stages_t* stages)
 
 		snprint_obj_spec(&stage->obj_spec, obj_spec_buf, sizeof(obj_spec_buf));
 		printf( "- duration: %" PRIu64 "\n"
+				"  ops: %" PRIu64 "\n"
+				"  bytes: %" PRIu64 "\n"
 				"  desc: %s\n"
 				"  tps: %" PRIu64 "\n"
 				"  key-start: %" PRIu64 "\n"
 				"  key-end: %" PRIu64 "\n"
 				"  pause: %" PRIu64 "\n"
+				"  warmup: %" PRIu64 "\n"
 				"  batch-size: %" PRIu32 "\n"
 				"  batch-write-size: %" PRIu32 "\n"
 				"  batch-delete-size: %" PRIu32 "\n"
 				"  batch-read-size: %" PRIu32 "\n"
+				"  batch-concurrent: %s\n"
 				"  async: %s\n"
+				"  async-max-commands: %" PRIu32 "\n"
 				"  random: %s\n"
 				"  ttl: %" PRId64 "\n",
-				stage->duration, stage->desc, stage->tps, stage->key_start,
-				stage->key_end, stage->pause, stage->batch_size, stage->batch_write_size,
-				stage->batch_delete_size, stage->batch_read_size, boolstring(stage->async),
-				boolstring(stage->random), stage->ttl);
+				stage->duration, stage->ops, stage->bytes, stage->desc,
+				stage->tps, stage->key_start, stage->key_end, stage->pause,
+				stage->warmup, stage->batch_size,
+				stage->batch_write_size, stage->batch_delete_size,
+				stage->batch_read_size,
+				boolstring(stage->batch_concurrent), boolstring(stage->async),
+				stage->async_max_commands, boolstring(stage->random), stage->ttl);
 
 		printf( "  workload: %s",
 				workloads[stage->workload.type]);
@@ -722,13 +837,17 @@ void stages_print(const stages_t* stages)
 					stage->workload.write_pct, stage->workload.read_all_pct,
 					stage->workload.write_all_pct);
 		}
+		else if (stage->workload.shuffle) {
+			printf(",shuffle\n");
+		}
 		else {
 			printf("\n");
 		}
 
 		printf( "  stage: %u\n"
+				"  threads: %u\n"
 				"  object-spec: %s\n",
-				i + 1, obj_spec_buf);
+				stage->group + 1, stage->n_threads, obj_spec_buf);
 
 
 		if (stage->read_bins) {
@@ -929,3 +1048,93 @@ _free_bins_selection(char** bins)
 		cf_free(bins);
 	}
 }
+
+LOCAL_HELPER int
+_resolve_groups(stages_t* stages, const args_t* args)
+{
+	uint32_t n_threads = (uint32_t) args->transaction_worker_threads;
+	uint32_t end;
+
+	for (uint32_t first = 0; first < stages->n_stages; first = end) {
+		end = stages_group_end(stages, first);
+
+		uint32_t n_workloads = end - first;
+		uint32_t n_split = 0;
+		uint32_t explicit_threads = 0;
+		uint32_t n_async = 0;
+		uint64_t duration = 0;
+		uint64_t pause = 0;
+		uint64_t warmup = 0;
+
+		for (uint32_t i = first; i < end; i++) {
+			const stage_t* stage = &stages->stages[i];
+
+			if (stage->n_threads == 0) {
+				n_split++;
+			}
+			explicit_threads += stage->n_threads;
+			n_async += stage->async ? 1 : 0;
+			duration = MAX(duration, stage->duration);
+			pause = MAX(pause, stage->pause);
+			warmup = MAX(warmup, stage->warmup);
+		}
+
+		uint32_t group = stages->stages[first].group + 1;
+
+		// a stage with the threads of all of its workloads given runs on
+		// just those, otherwise it runs on --threads
+		uint32_t group_threads = n_split == 0 ? explicit_threads : n_threads;
+
+		if (group_threads > 10000) {
+			fprintf(stderr, "Stage %u: the threads of its workloads add up to "
+					"%u, more than the 10000 allowed\n",
+					group, group_threads);
+			return -1;
+		}
+		if (n_split != 0 && (explicit_threads > n_threads ||
+				n_split > n_threads - explicit_threads)) {
+			fprintf(stderr, "Stage %u: not enough threads (--threads) left "
+					"for each of its workloads to get one\n", group);
+			return -1;
+		}
+		if (n_async > 1 && args->async_adaptive) {
+			// there is only one limiter for all of the async commands
+			fprintf(stderr, "Stage %u: --async-adaptive can only be used "
+					"with one async workload per stage\n", group);
+			return -1;
+		}
+
+		// the threads not explicitly given out are split evenly, with the
+		// first workloads getting one more when they don't divide
+		uint32_t rem = group_threads - explicit_threads;
+		uint32_t next_thread = 0;
+		uint32_t split_idx = 0;
+
+		for (uint32_t i = first; i < end; i++) {
+			stage_t* stage = &stages->stages[i];
+
+			if (stage->n_threads == 0) {
+				stage->n_threads = rem / n_split +
+					(split_idx < rem % n_split ? 1 : 0);
+				split_idx++;
+			}
+			stage->first_thread = next_thread;
+			next_thread += stage->n_threads;
+
+			// the group runs for as long as its longest workload
+			stage->duration = duration;
+			stage->pause = pause;
+			stage->warmup = warmup;
+
+			// workloads sharing a stage need a label to tell them apart
+			if (n_workloads > 1 && stage->desc == NULL) {
+				char desc[32];
+				snprintf(desc, sizeof(desc), "workload %u",
+						stage->group_pos + 1);
+				stage->desc = strdup(desc);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -4,12 +4,32 @@
 
 Suite* setup_suite(void);
 Suite* common_suite(void);
+Suite* conc_limiter_suite(void);
 Suite* coordinator_suite(void);
+Suite* cpu_affinity_suite(void);
+Suite* digest_table_suite(void);
 Suite* dyn_throttle_suite(void);
+Suite* error_stats_suite(void);
+Suite* group_stats_suite(void);
 Suite* sanity_suite(void);
 Suite* hdr_histogram_suite(void);
 Suite* hdr_histogram_log_suite(void);
 Suite* histogram_suite(void);
+Suite* instance_suite(void);
+Suite* interval_log_suite(void);
+Suite* key_permutation_suite(void);
+Suite* key_tracker_suite(void);
+Suite* len_dist_suite(void);
+Suite* node_stats_suite(void);
 Suite* obj_spec_suite(void);
+Suite* perf_counters_suite(void);
+Suite* proc_stats_suite(void);
+Suite* queue_suite(void);
+Suite* self_stats_suite(void);
+Suite* slow_ops_suite(void);
+Suite* stage_budget_suite(void);
+Suite* sustain_gate_suite(void);
+Suite* trace_suite(void);
+Suite* warmup_stats_suite(void);
 Suite* yaml_parse_suite(void);
 
@@ -0,0 +1,256 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <conc_limiter.h>
+
+
+#define TEST_SUITE_NAME "concurrency limiter"
+
+
+/*
+ * issues commands until the limiter refuses one, then completes all of them
+ * with the given latency, failing the first n_failed
+ */
+static void
+run_window(conc_limiter_t* cl, uint64_t latency, uint32_t n_failed)
+{
+	uint32_t n = 0;
+	while (conc_limiter_try_acquire(cl)) {
+		n++;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		conc_limiter_release(cl, latency, i < n_failed);
+	}
+}
+
+/*
+ * a command which takes its time completing
+ */
+static void*
+slow_release(void* udata)
+{
+	conc_limiter_t* cl = (conc_limiter_t*) udata;
+
+	usleep(100000);
+	conc_limiter_release(cl, 100, false);
+	return NULL;
+}
+
+
+START_TEST(init_clamps)
+{
+	conc_limiter_t cl;
+
+	conc_limiter_init(&cl, 1, 4, 0);
+	ck_assert_uint_eq(conc_limiter_limit(&cl), 4);
+
+	conc_limiter_init(&cl, 1, 1000, 0);
+	ck_assert_uint_eq(conc_limiter_limit(&cl), CONC_LIMITER_INIT_LIMIT);
+
+	conc_limiter_init(&cl, 100, 1000, 0);
+	ck_assert_uint_eq(conc_limiter_limit(&cl), 100);
+}
+END_TEST
+
+START_TEST(acquire_respects_limit)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	for (uint32_t i = 0; i < CONC_LIMITER_INIT_LIMIT; i++) {
+		ck_assert(conc_limiter_try_acquire(&cl));
+	}
+	ck_assert(!conc_limiter_try_acquire(&cl));
+	ck_assert_uint_eq(conc_limiter_in_flight(&cl), CONC_LIMITER_INIT_LIMIT);
+
+	conc_limiter_release(&cl, 100, false);
+	ck_assert(conc_limiter_try_acquire(&cl));
+}
+END_TEST
+
+/*
+ * the limit should not move before a full window has passed
+ */
+START_TEST(no_update_within_window)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	run_window(&cl, 100, 0);
+	conc_limiter_update(&cl, CONC_LIMITER_WINDOW_US - 1);
+	ck_assert_uint_eq(conc_limiter_limit(&cl), CONC_LIMITER_INIT_LIMIT);
+}
+END_TEST
+
+START_TEST(increase_when_saturated)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	uint64_t now = 0;
+	uint32_t prev = conc_limiter_limit(&cl);
+	for (uint32_t i = 0; i < 10; i++) {
+		run_window(&cl, 100, 0);
+		now += CONC_LIMITER_WINDOW_US;
+		conc_limiter_update(&cl, now);
+
+		ck_assert_uint_gt(conc_limiter_limit(&cl), prev);
+		prev = conc_limiter_limit(&cl);
+	}
+}
+END_TEST
+
+START_TEST(increase_bounded_by_max)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 40, 0);
+
+	uint64_t now = 0;
+	for (uint32_t i = 0; i < 100; i++) {
+		run_window(&cl, 100, 0);
+		now += CONC_LIMITER_WINDOW_US;
+		conc_limiter_update(&cl, now);
+	}
+	ck_assert_uint_eq(conc_limiter_limit(&cl), 40);
+}
+END_TEST
+
+START_TEST(decrease_on_errors)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	uint64_t now = 0;
+	for (uint32_t i = 0; i < 10; i++) {
+		run_window(&cl, 100, 0);
+		now += CONC_LIMITER_WINDOW_US;
+		conc_limiter_update(&cl, now);
+	}
+
+	uint32_t prev = conc_limiter_limit(&cl);
+	run_window(&cl, 100, prev / 10);
+	now += CONC_LIMITER_WINDOW_US;
+	conc_limiter_update(&cl, now);
+	ck_assert_uint_eq(conc_limiter_limit(&cl),
+			(uint32_t) (prev * CONC_LIMITER_BACKOFF));
+}
+END_TEST
+
+START_TEST(decrease_on_latency)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	uint64_t now = 0;
+	for (uint32_t i = 0; i < 10; i++) {
+		run_window(&cl, 100, 0);
+		now += CONC_LIMITER_WINDOW_US;
+		conc_limiter_update(&cl, now);
+	}
+
+	uint32_t prev = conc_limiter_limit(&cl);
+	run_window(&cl, 1000, 0);
+	now += CONC_LIMITER_WINDOW_US;
+	conc_limiter_update(&cl, now);
+	ck_assert_uint_lt(conc_limiter_limit(&cl), prev);
+}
+END_TEST
+
+START_TEST(decrease_bounded_by_min)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	uint64_t now = 0;
+	for (uint32_t i = 0; i < 100; i++) {
+		// release enough failures each window to meet the sample minimum
+		for (uint32_t j = 0; j < CONC_LIMITER_MIN_SAMPLES; j++) {
+			cl.in_flight++;
+			conc_limiter_release(&cl, 100, true);
+		}
+		now += CONC_LIMITER_WINDOW_US;
+		conc_limiter_update(&cl, now);
+	}
+	ck_assert_uint_eq(conc_limiter_limit(&cl), 1);
+}
+END_TEST
+
+/*
+ * if commands aren't waiting on the limit, there's no evidence more
+ * concurrency would help, so the limit should hold steady
+ */
+START_TEST(hold_when_unsaturated)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	for (uint32_t j = 0; j < CONC_LIMITER_MIN_SAMPLES; j++) {
+		ck_assert(conc_limiter_try_acquire(&cl));
+		conc_limiter_release(&cl, 100, false);
+	}
+	conc_limiter_update(&cl, CONC_LIMITER_WINDOW_US);
+	ck_assert_uint_eq(conc_limiter_limit(&cl), CONC_LIMITER_INIT_LIMIT);
+}
+END_TEST
+
+START_TEST(wait_free_slot)
+{
+	conc_limiter_t cl;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	ck_assert(conc_limiter_try_acquire(&cl));
+	ck_assert(!conc_limiter_wait(&cl));
+}
+END_TEST
+
+/*
+ * a thread waiting on the limit for longer than it polls parks, and the next
+ * release wakes it
+ */
+START_TEST(wait_parks_until_release)
+{
+	conc_limiter_t cl;
+	pthread_t thread;
+	conc_limiter_init(&cl, 1, 1000, 0);
+
+	while (conc_limiter_try_acquire(&cl)) {
+	}
+
+	pthread_create(&thread, NULL, slow_release, &cl);
+	ck_assert(conc_limiter_wait(&cl));
+	ck_assert(conc_limiter_try_acquire(&cl));
+	ck_assert_uint_eq(conc_limiter_in_flight(&cl), CONC_LIMITER_INIT_LIMIT);
+	pthread_join(thread, NULL);
+}
+END_TEST
+
+
+Suite*
+conc_limiter_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Concurrency Limiter");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, init_clamps);
+	tcase_add_test(tc_core, acquire_respects_limit);
+	tcase_add_test(tc_core, no_update_within_window);
+	tcase_add_test(tc_core, increase_when_saturated);
+	tcase_add_test(tc_core, increase_bounded_by_max);
+	tcase_add_test(tc_core, decrease_on_errors);
+	tcase_add_test(tc_core, decrease_on_latency);
+	tcase_add_test(tc_core, decrease_bounded_by_min);
+	tcase_add_test(tc_core, hold_when_unsaturated);
+	tcase_add_test(tc_core, wait_free_slot);
+	tcase_add_test(tc_core, wait_parks_until_release);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
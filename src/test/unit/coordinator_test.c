@@ -1,4 +1,5 @@
 
+#include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -24,14 +25,10 @@ typedef void (*sighandler_t)(int);
  */
 extern int _has_not_happened(const struct timespec* time);
 extern int _sleep_for(uint64_t n_secs);
-extern void _halt_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
-extern void _terminate_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
-extern void _release_threads(thr_coord_t* coord,
-		tdata_t** tdatas, uint32_t n_threads);
+extern void _halt_threads(tdata_t** tdatas, uint32_t n_threads);
+extern void _next_stage(thr_coord_t* coord, uint32_t stage_idx);
 extern void _finish_req_duration(thr_coord_t* coord);
-extern void clear_cdata_counts(cdata_t* cdata);
+extern void _wait_for_threads(thr_coord_t* coord, uint64_t n_secs);
 
 
 /*
@@ -69,6 +66,58 @@ sigusr1_handle(int signum)
 }
 
 
+/*
+ * stage 1 runs a single workload, stage 2 runs one workload on thread 0 next
+ * to another on thread 1
+ */
+static stage_t test_stages[] = {
+	{ .group = 0, .group_pos = 0, .first_thread = 0, .n_threads = 2 },
+	{ .group = 1, .group_pos = 0, .first_thread = 0, .n_threads = 1 },
+	{ .group = 1, .group_pos = 1, .first_thread = 1, .n_threads = 1 }
+};
+
+static cdata_t test_cdata = {
+	.stages = {
+		test_stages,
+		sizeof(test_stages) / sizeof(test_stages[0]),
+		false
+	}
+};
+
+static void
+init_test_tdata(tdata_t* tdata, thr_coord_t* coord, uint32_t t_idx)
+{
+	tdata->cdata = &test_cdata;
+	tdata->coord = coord;
+	tdata->t_idx = t_idx;
+	atomic_init(&tdata->stage_idx, 0);
+	atomic_init(&tdata->epoch, 0);
+	atomic_init(&tdata->do_work, true);
+	atomic_init(&tdata->finished, false);
+}
+
+static void*
+wait_for_stage(void* udata)
+{
+	tdata_t* tdata = (tdata_t*) udata;
+
+	thr_coordinator_wait(tdata->coord, tdata);
+	return NULL;
+}
+
+static void*
+sleep_through_stage(void* udata)
+{
+	tdata_t* tdata = (tdata_t*) udata;
+	struct timespec wake_up;
+
+	clock_gettime(COORD_CLOCK, &wake_up);
+	wake_up.tv_sec += 100;
+	return (void*) (intptr_t) thr_coordinator_sleep(tdata->coord,
+			tdata->epoch, &wake_up);
+}
+
+
 START_TEST(test_sleep_for_simple)
 {
 	SLEEP_FOR_TEST(1);
@@ -118,10 +167,143 @@ START_TEST(test_sleep_for_signal_interrupts)
 END_TEST
 
 
+/*
+ * threads waiting for the next stage pick it up, each on its own workload,
+ * once the coordinator moves the epoch on
+ */
+START_TEST(test_next_stage)
+{
+	thr_coord_t coord;
+	tdata_t tdatas[2];
+	tdata_t* tdata_ptrs[2] = { &tdatas[0], &tdatas[1] };
+	pthread_t threads[2];
+
+	thr_coordinator_init(&coord, 2);
+	for (uint32_t i = 0; i < 2; i++) {
+		init_test_tdata(&tdatas[i], &coord, i);
+	}
+
+	_halt_threads(tdata_ptrs, 2);
+	for (uint32_t i = 0; i < 2; i++) {
+		ck_assert(!tdatas[i].do_work);
+		pthread_create(&threads[i], NULL, wait_for_stage, &tdatas[i]);
+	}
+	_next_stage(&coord, 1);
+
+	for (uint32_t i = 0; i < 2; i++) {
+		pthread_join(threads[i], NULL);
+		ck_assert_uint_eq(tdatas[i].epoch, 1);
+		ck_assert_uint_eq(tdatas[i].stage_idx, i + 1);
+		ck_assert(tdatas[i].do_work);
+	}
+
+	// a thread that already moved on doesn't wait for the epoch after
+	tdatas[0].epoch = 0;
+	wait_for_stage(&tdatas[0]);
+	ck_assert_uint_eq(tdatas[0].epoch, 1);
+
+	thr_coordinator_free(&coord);
+}
+END_TEST
+
+START_TEST(test_terminate)
+{
+	thr_coord_t coord;
+	tdata_t tdata;
+	tdata_t* tdata_ptr = &tdata;
+	pthread_t thread;
+
+	thr_coordinator_init(&coord, 1);
+	init_test_tdata(&tdata, &coord, 0);
+
+	pthread_create(&thread, NULL, wait_for_stage, &tdata);
+	thr_coordinator_terminate(&coord, &tdata_ptr, 1);
+	pthread_join(thread, NULL);
+
+	ck_assert(tdata.finished);
+	ck_assert(!tdata.do_work);
+	ck_assert_uint_eq(tdata.epoch, 1);
+
+	thr_coordinator_free(&coord);
+}
+END_TEST
+
+/*
+ * a thread sleeping through a stage wakes as soon as the coordinator has moved
+ * on from it, even though other threads haven't finished the next one
+ */
+START_TEST(test_sleep_interrupted)
+{
+	thr_coord_t coord;
+	tdata_t tdata;
+	pthread_t thread;
+	void* status;
+
+	thr_coordinator_init(&coord, 1);
+	init_test_tdata(&tdata, &coord, 0);
+
+	pthread_create(&thread, NULL, sleep_through_stage, &tdata);
+	usleep(10000);
+	_next_stage(&coord, 1);
+	pthread_join(thread, &status);
+	ck_assert_int_eq((int) (intptr_t) status, COORD_SLEEP_INTERRUPTED);
+
+	// and sleeping on an old epoch returns right away
+	ck_assert_int_eq((int) (intptr_t) sleep_through_stage(&tdata),
+			COORD_SLEEP_INTERRUPTED);
+
+	thr_coordinator_free(&coord);
+}
+END_TEST
+
+static void*
+complete_later(void* udata)
+{
+	usleep(10000);
+	thr_coordinator_complete((thr_coord_t*) udata);
+	return NULL;
+}
+
+/*
+ * the warmup of a stage without a duration ends once its threads are done,
+ * and otherwise runs its full length
+ */
+START_TEST(test_wait_for_threads)
+{
+	thr_coord_t coord;
+	pthread_t thread;
+	struct timespec before, after;
+
+	thr_coordinator_init(&coord, 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	pthread_create(&thread, NULL, complete_later, &coord);
+	_wait_for_threads(&coord, 5);
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	pthread_join(thread, NULL);
+	ck_assert_int_lt(after.tv_sec - before.tv_sec, 5);
+	ck_assert_uint_eq(coord.unfinished_threads, 1);
+
+	thr_coordinator_free(&coord);
+
+	thr_coordinator_init(&coord, 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	_wait_for_threads(&coord, 1);
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	ck_assert_int_ge((after.tv_sec - before.tv_sec) * 1000000000L +
+			(after.tv_nsec - before.tv_nsec), 1000000000L);
+
+	thr_coordinator_free(&coord);
+}
+END_TEST
+
+
 Suite* coordinator_suite(void)
 {
 	Suite* s;
 	TCase* tc_core;
+	TCase* tc_stages;
 
 	s = suite_create("Thread Coordinator");
 
@@ -134,6 +316,14 @@ Suite* coordinator_suite(void)
 	tcase_add_test(tc_core, test_sleep_for_signal_interrupts);
 	suite_add_tcase(s, tc_core);
 
+	tc_stages = tcase_create("Stages");
+	tcase_set_timeout(tc_stages, 10);
+	tcase_add_test(tc_stages, test_next_stage);
+	tcase_add_test(tc_stages, test_terminate);
+	tcase_add_test(tc_stages, test_sleep_interrupted);
+	tcase_add_test(tc_stages, test_wait_for_threads);
+	suite_add_tcase(s, tc_stages);
+
 	return s;
 }
 
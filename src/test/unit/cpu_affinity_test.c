@@ -0,0 +1,268 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common.h>
+#include <cpu_affinity.h>
+
+
+#define TEST_SUITE_NAME "cpu affinity"
+
+
+static void
+assert_list(const char* str, const uint32_t* expected, uint32_t n_expected)
+{
+	uint32_t* cpus;
+	uint32_t n_cpus;
+
+	ck_assert_int_eq(cpu_affinity_parse_list(str, &cpus, &n_cpus), 0);
+	ck_assert_uint_eq(n_cpus, n_expected);
+	for (uint32_t i = 0; i < n_expected; i++) {
+		ck_assert_uint_eq(cpus[i], expected[i]);
+	}
+	free(cpus);
+}
+
+static void
+assert_invalid(const char* str)
+{
+	uint32_t* cpus;
+	uint32_t n_cpus;
+
+	ck_assert_int_eq(cpu_affinity_parse_list(str, &cpus, &n_cpus), -1);
+}
+
+/*
+ * a CPU the test is allowed to run on
+ */
+static uint32_t
+usable_cpu(void)
+{
+	return (uint32_t) sched_getcpu();
+}
+
+static void*
+report_cpu(void* udata)
+{
+	*(int*) udata = sched_getcpu();
+	return NULL;
+}
+
+
+START_TEST(parse_list)
+{
+	assert_list("3", (uint32_t[]) { 3 }, 1);
+	assert_list("0-3", (uint32_t[]) { 0, 1, 2, 3 }, 4);
+	assert_list("0-1,8,10-11", (uint32_t[]) { 0, 1, 8, 10, 11 }, 5);
+	assert_list("5-5,2", (uint32_t[]) { 5, 2 }, 2);
+	assert_list("1023", (uint32_t[]) { 1023 }, 1);
+
+	// enough CPUs to grow the list
+	uint32_t* cpus;
+	uint32_t n_cpus;
+	ck_assert_int_eq(cpu_affinity_parse_list("0-127", &cpus, &n_cpus), 0);
+	ck_assert_uint_eq(n_cpus, 128);
+	ck_assert_uint_eq(cpus[127], 127);
+	free(cpus);
+}
+END_TEST
+
+START_TEST(parse_list_invalid)
+{
+	assert_invalid("");
+	assert_invalid(",");
+	assert_invalid("1,");
+	assert_invalid("-1");
+	assert_invalid("1-");
+	assert_invalid("3-1");
+	assert_invalid("1 ,2");
+	assert_invalid("a");
+	assert_invalid("1024");
+	assert_invalid("0-4096");
+	assert_invalid("99999999999");
+}
+END_TEST
+
+START_TEST(format_list)
+{
+	char buf[64];
+
+	cpu_affinity_format_list((uint32_t[]) { 0, 1, 2, 3, 8, 10, 11 }, 7, buf,
+			sizeof(buf));
+	ck_assert_str_eq(buf, "0-3,8,10-11");
+
+	cpu_affinity_format_list((uint32_t[]) { 4 }, 1, buf, sizeof(buf));
+	ck_assert_str_eq(buf, "4");
+
+	cpu_affinity_format_list((uint32_t[]) { 2, 3, 0, 1 }, 4, buf, sizeof(buf));
+	ck_assert_str_eq(buf, "2-3,0-1");
+
+	cpu_affinity_format_list(NULL, 0, buf, sizeof(buf));
+	ck_assert_str_eq(buf, "");
+
+	// truncated, but still terminated
+	cpu_affinity_format_list((uint32_t[]) { 100, 200, 300 }, 3, buf, 6);
+	ck_assert_str_eq(buf, "100,2");
+}
+END_TEST
+
+START_TEST(slots)
+{
+	cpu_affinity_t aff;
+	cpu_affinity_init(&aff);
+
+	ck_assert(!cpu_affinity_enabled(&aff));
+	ck_assert_int_eq(cpu_affinity_cpu(&aff, 0), -1);
+
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, "4-6"), 0);
+	ck_assert(cpu_affinity_enabled(&aff));
+	ck_assert_int_eq(cpu_affinity_cpu(&aff, 0), 4);
+	ck_assert_int_eq(cpu_affinity_cpu(&aff, 2), 6);
+	// more threads than CPUs wrap around
+	ck_assert_int_eq(cpu_affinity_cpu(&aff, 3), 4);
+
+	// an invalid list leaves the old one
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, "x"), -1);
+	ck_assert_uint_eq(aff.n_cpus, 3);
+
+	cpu_affinity_free(&aff);
+	ck_assert(!cpu_affinity_enabled(&aff));
+}
+END_TEST
+
+START_TEST(numa_node)
+{
+	cpu_affinity_t aff;
+	cpu_affinity_init(&aff);
+
+	ck_assert_int_eq(cpu_affinity_set_numa_node(&aff, -1), -1);
+	ck_assert_int_eq(cpu_affinity_set_numa_node(&aff, 100000), -1);
+	ck_assert_int_eq(aff.numa_node, -1);
+
+	// no sysfs NUMA topology (not Linux, or a restricted container)
+	int node = cpu_affinity_cpu_node(usable_cpu());
+	if (node < 0) {
+		cpu_affinity_free(&aff);
+		return;
+	}
+
+	// the node's CPUs become the CPU list
+	ck_assert_int_eq(cpu_affinity_set_numa_node(&aff, node), 0);
+	ck_assert_int_eq(aff.numa_node, node);
+	ck_assert_uint_gt(aff.n_cpus, 0);
+	for (uint32_t i = 0; i < aff.n_cpus; i++) {
+		ck_assert_int_eq(cpu_affinity_cpu_node(aff.cpus[i]), node);
+	}
+	cpu_affinity_free(&aff);
+
+	// but an explicit CPU list is kept
+	cpu_affinity_init(&aff);
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, "7"), 0);
+	ck_assert_int_eq(cpu_affinity_set_numa_node(&aff, node), 0);
+	ck_assert_uint_eq(aff.n_cpus, 1);
+	ck_assert_uint_eq(aff.cpus[0], 7);
+	cpu_affinity_free(&aff);
+}
+END_TEST
+
+START_TEST(unavailable_cpu)
+{
+	cpu_affinity_t aff;
+	char list[16];
+
+	cpu_affinity_init(&aff);
+	snprintf(list, sizeof(list), "%u", usable_cpu());
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, list), 0);
+	ck_assert_int_eq(cpu_affinity_unavailable_cpu(&aff), -1);
+
+	// there are no machines with this many CPUs to test on
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, "1023"), 0);
+	ck_assert_int_eq(cpu_affinity_unavailable_cpu(&aff), 1023);
+
+	cpu_affinity_free(&aff);
+}
+END_TEST
+
+START_TEST(pinned_thread)
+{
+	cpu_affinity_t aff;
+	char list[16];
+	uint32_t cpu = usable_cpu();
+
+	cpu_affinity_init(&aff);
+	snprintf(list, sizeof(list), "%u", cpu);
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, list), 0);
+
+	pthread_attr_t attr;
+	pthread_t thread;
+	int ran_on = -1;
+
+	pthread_attr_init(&attr);
+	ck_assert(cpu_affinity_set_attr(&aff, &attr, 5));
+	ck_assert_int_eq(pthread_create(&thread, &attr, report_cpu, &ran_on), 0);
+	pthread_join(thread, NULL);
+	pthread_attr_destroy(&attr);
+	ck_assert_int_eq(ran_on, (int) cpu);
+
+	ck_assert(cpu_affinity_pin_thread(&aff, pthread_self(), 0));
+	ck_assert_int_eq(sched_getcpu(), (int) cpu);
+
+	cpu_affinity_free(&aff);
+}
+END_TEST
+
+START_TEST(alloc)
+{
+	cpu_affinity_t aff;
+	char list[16];
+
+	cpu_affinity_init(&aff);
+
+	// unpinned, it's an ordinary allocation
+	uint8_t* ptr = (uint8_t*) cpu_affinity_alloc(&aff, 100, 0);
+	ck_assert_ptr_ne(ptr, NULL);
+	ck_assert_uint_eq(ptr[99], 0);
+	cpu_affinity_dealloc(&aff, ptr, 100);
+
+	// pinned, it gets pages of its own
+	snprintf(list, sizeof(list), "%u", usable_cpu());
+	ck_assert_int_eq(cpu_affinity_set_cpu_list(&aff, list), 0);
+	ptr = (uint8_t*) cpu_affinity_alloc(&aff, 10000, 0);
+	ck_assert_ptr_ne(ptr, NULL);
+	for (uint32_t i = 0; i < 10000; i++) {
+		ck_assert_uint_eq(ptr[i], 0);
+	}
+	memset(ptr, 0xff, 10000);
+	cpu_affinity_dealloc(&aff, ptr, 10000);
+
+	cpu_affinity_free(&aff);
+}
+END_TEST
+
+
+Suite*
+cpu_affinity_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("CPU Affinity");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, parse_list);
+	tcase_add_test(tc_core, parse_list_invalid);
+	tcase_add_test(tc_core, format_list);
+	tcase_add_test(tc_core, slots);
+	tcase_add_test(tc_core, numa_node);
+	tcase_add_test(tc_core, unavailable_cpu);
+	tcase_add_test(tc_core, pinned_thread);
+	tcase_add_test(tc_core, alloc);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
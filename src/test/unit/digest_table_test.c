@@ -0,0 +1,154 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <aerospike/as_key.h>
+
+#include <common.h>
+#include <digest_table.h>
+
+
+#define TEST_SUITE_NAME "digest table"
+
+#define TEST_NS "test"
+#define TEST_SET "testset"
+#define TEST_FILE "/tmp/asbench_digest_table_test.bin"
+
+
+static void
+assert_digest_eq(const digest_table_t* dt, uint64_t key_val)
+{
+	as_key key;
+	as_key_init_int64(&key, TEST_NS, TEST_SET, key_val);
+
+	const uint8_t* digest = digest_table_get(dt, key_val);
+	ck_assert_ptr_nonnull(digest);
+	ck_assert_int_eq(memcmp(digest, as_key_digest(&key)->value,
+				AS_DIGEST_VALUE_SIZE), 0);
+	as_key_destroy(&key);
+}
+
+
+START_TEST(matches_client_digests)
+{
+	digest_table_t dt;
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 100, 1000, 4,
+				NULL), 0);
+
+	for (uint64_t key_val = 100; key_val < 1100; key_val++) {
+		assert_digest_eq(&dt, key_val);
+	}
+	digest_table_free(&dt);
+}
+END_TEST
+
+START_TEST(out_of_range)
+{
+	digest_table_t dt;
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 100, 10, 1,
+				NULL), 0);
+
+	ck_assert_ptr_null(digest_table_get(&dt, 0));
+	ck_assert_ptr_null(digest_table_get(&dt, 99));
+	ck_assert_ptr_nonnull(digest_table_get(&dt, 100));
+	ck_assert_ptr_nonnull(digest_table_get(&dt, 109));
+	ck_assert_ptr_null(digest_table_get(&dt, 110));
+	digest_table_free(&dt);
+}
+END_TEST
+
+/*
+ * more threads than keys should still build every digest
+ */
+START_TEST(more_threads_than_keys)
+{
+	digest_table_t dt;
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 0, 3, 16,
+				NULL), 0);
+
+	for (uint64_t key_val = 0; key_val < 3; key_val++) {
+		assert_digest_eq(&dt, key_val);
+	}
+	digest_table_free(&dt);
+}
+END_TEST
+
+/*
+ * a persisted table for the same keys is mapped as-is rather than rebuilt,
+ * which is detected by tampering with it between runs
+ */
+START_TEST(file_reused)
+{
+	digest_table_t dt;
+	unlink(TEST_FILE);
+
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 0, 100, 2,
+				TEST_FILE), 0);
+	assert_digest_eq(&dt, 50);
+	((uint8_t*) digest_table_get(&dt, 50))[0] ^= 0xff;
+	uint8_t tampered = digest_table_get(&dt, 50)[0];
+	digest_table_free(&dt);
+
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 0, 100, 2,
+				TEST_FILE), 0);
+	ck_assert_uint_eq(digest_table_get(&dt, 50)[0], tampered);
+	digest_table_free(&dt);
+
+	unlink(TEST_FILE);
+}
+END_TEST
+
+/*
+ * a persisted table for a different key range or set is rebuilt
+ */
+START_TEST(file_rebuilt)
+{
+	digest_table_t dt;
+	unlink(TEST_FILE);
+
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 0, 100, 2,
+				TEST_FILE), 0);
+	((uint8_t*) digest_table_get(&dt, 50))[0] ^= 0xff;
+	digest_table_free(&dt);
+
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, TEST_SET, 10, 100, 2,
+				TEST_FILE), 0);
+	assert_digest_eq(&dt, 50);
+	assert_digest_eq(&dt, 109);
+	digest_table_free(&dt);
+
+	as_key key;
+	as_key_init_int64(&key, TEST_NS, "otherset", 50);
+	ck_assert_int_eq(digest_table_init(&dt, TEST_NS, "otherset", 10, 100, 2,
+				TEST_FILE), 0);
+	ck_assert_int_eq(memcmp(digest_table_get(&dt, 50),
+				as_key_digest(&key)->value, AS_DIGEST_VALUE_SIZE), 0);
+	digest_table_free(&dt);
+	as_key_destroy(&key);
+
+	unlink(TEST_FILE);
+}
+END_TEST
+
+
+Suite*
+digest_table_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Digest Table");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, matches_client_digests);
+	tcase_add_test(tc_core, out_of_range);
+	tcase_add_test(tc_core, more_threads_than_keys);
+	tcase_add_test(tc_core, file_reused);
+	tcase_add_test(tc_core, file_rebuilt);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
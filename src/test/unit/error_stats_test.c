@@ -0,0 +1,131 @@
+
+#include <check.h>
+
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <error_stats.h>
+
+
+#define TEST_SUITE_NAME "error stats"
+
+
+extern uint32_t _code_idx(as_status status);
+
+
+START_TEST(counts_by_code)
+{
+	error_stats_t* es = error_stats_create(0);
+
+	error_stats_record(es, ERROR_OP_WRITE, AEROSPIKE_ERR_TIMEOUT, 100);
+	error_stats_record(es, ERROR_OP_WRITE, AEROSPIKE_ERR_TIMEOUT, 200);
+	error_stats_record(es, ERROR_OP_WRITE, AEROSPIKE_ERR_RECORD_TOO_BIG, 300);
+	error_stats_record(es, ERROR_OP_READ, AEROSPIKE_ERR_CLIENT, 400);
+
+	struct error_op_stats_s* w = &es->ops[ERROR_OP_WRITE];
+	struct error_op_stats_s* r = &es->ops[ERROR_OP_READ];
+	ck_assert_uint_eq(w->total_counts[_code_idx(AEROSPIKE_ERR_TIMEOUT)], 2);
+	ck_assert_uint_eq(w->period_counts[_code_idx(AEROSPIKE_ERR_TIMEOUT)], 2);
+	ck_assert_uint_eq(w->total_counts[_code_idx(AEROSPIKE_ERR_RECORD_TOO_BIG)],
+			1);
+	ck_assert_uint_eq(r->total_counts[_code_idx(AEROSPIKE_ERR_CLIENT)], 1);
+	ck_assert_uint_eq(r->total_counts[_code_idx(AEROSPIKE_ERR_TIMEOUT)], 0);
+	ck_assert_uint_eq(es->ops[ERROR_OP_UDF].total_counts[
+			_code_idx(AEROSPIKE_ERR_TIMEOUT)], 0);
+
+	// timeouts and other errors are kept apart
+	ck_assert_int_eq(hdr_total_count(w->timeout_hdr), 2);
+	ck_assert_int_eq(hdr_total_count(w->error_hdr), 1);
+	ck_assert_int_eq(hdr_total_count(r->timeout_hdr), 0);
+	ck_assert_int_eq(hdr_total_count(r->error_hdr), 1);
+
+	error_stats_free(es);
+}
+END_TEST
+
+START_TEST(out_of_range_codes)
+{
+	ck_assert_uint_eq(_code_idx(ERROR_STATS_MIN_CODE), 0);
+	ck_assert_uint_eq(_code_idx(ERROR_STATS_MAX_CODE), ERROR_STATS_N_CODES - 2);
+	ck_assert_uint_eq(_code_idx(ERROR_STATS_MIN_CODE - 1),
+			ERROR_STATS_N_CODES - 1);
+	ck_assert_uint_eq(_code_idx(ERROR_STATS_MAX_CODE + 1),
+			ERROR_STATS_N_CODES - 1);
+
+	// latencies past the top of the histograms are still recorded
+	error_stats_t* es = error_stats_create(0);
+	error_stats_record(es, ERROR_OP_UDF, (as_status) 1000, 3600000000LU);
+	ck_assert_uint_eq(
+			es->ops[ERROR_OP_UDF].total_counts[ERROR_STATS_N_CODES - 1], 1);
+	ck_assert_int_eq(hdr_total_count(es->ops[ERROR_OP_UDF].error_hdr), 1);
+	error_stats_free(es);
+}
+END_TEST
+
+START_TEST(period_cleared)
+{
+	error_stats_t* es = error_stats_create(0);
+	uint32_t idx = _code_idx(AEROSPIKE_ERR_TIMEOUT);
+
+	error_stats_record(es, ERROR_OP_READ, AEROSPIKE_ERR_TIMEOUT, 10);
+	error_stats_print_period(es);
+	ck_assert_uint_eq(es->ops[ERROR_OP_READ].period_counts[idx], 0);
+	ck_assert_uint_eq(es->ops[ERROR_OP_READ].total_counts[idx], 1);
+
+	error_stats_free(es);
+}
+END_TEST
+
+START_TEST(log_disabled)
+{
+	error_stats_t* es = error_stats_create(0);
+
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(!error_stats_should_log(es));
+	}
+	error_stats_free(es);
+}
+END_TEST
+
+START_TEST(log_rate_limited)
+{
+	error_stats_t* es = error_stats_create(5);
+
+	for (;;) {
+		uint64_t start_s = cf_getms() / 1000;
+		uint32_t n_logged = 0;
+
+		for (uint32_t i = 0; i < 100; i++) {
+			n_logged += error_stats_should_log(es);
+		}
+		// try again if the window happened to roll over mid-way
+		if (cf_getms() / 1000 == start_s) {
+			ck_assert_uint_eq(n_logged, 5);
+			break;
+		}
+		es->log_window = 0;
+	}
+	error_stats_free(es);
+}
+END_TEST
+
+
+Suite*
+error_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Error Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, counts_by_code);
+	tcase_add_test(tc_core, out_of_range_codes);
+	tcase_add_test(tc_core, period_cleared);
+	tcase_add_test(tc_core, log_disabled);
+	tcase_add_test(tc_core, log_rate_limited);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,163 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common.h>
+#include <group_stats.h>
+
+
+#define TEST_SUITE_NAME "group stats"
+
+
+/*
+ * stage 1 runs an insert on its own, stage 2 runs a read/update workload on
+ * 3 threads next to a UDF workload on 1
+ */
+static stage_t test_stages[] = {
+	{
+		.desc = "load",
+		.workload = { .type = WORKLOAD_TYPE_I },
+		.group = 0,
+		.group_pos = 0,
+		.first_thread = 0,
+		.n_threads = 4
+	},
+	{
+		.desc = "ru",
+		.workload = { .type = WORKLOAD_TYPE_RU, .read_pct = 50 },
+		.group = 1,
+		.group_pos = 0,
+		.first_thread = 0,
+		.n_threads = 3
+	},
+	{
+		.desc = "udf",
+		.workload = { .type = WORKLOAD_TYPE_RUF, .read_pct = 0,
+			.write_pct = 0 },
+		.group = 1,
+		.group_pos = 1,
+		.first_thread = 3,
+		.n_threads = 1
+	}
+};
+
+static stages_t stages = {
+	test_stages,
+	sizeof(test_stages) / sizeof(test_stages[0]),
+	false
+};
+
+static uint64_t
+period_count(group_stats_t* gs, uint32_t stage_idx, group_op_t op)
+{
+	struct group_op_stats_s* stats = &gs->workloads[stage_idx][op];
+	return stats->ok + stats->miss + stats->timeouts + stats->errors;
+}
+
+
+START_TEST(groups)
+{
+	ck_assert_uint_eq(stages_group_end(&stages, 0), 1);
+	ck_assert_uint_eq(stages_group_end(&stages, 1), 3);
+	ck_assert(stages_contain_groups(&stages));
+
+	ck_assert_uint_eq(stages_assign_thread(&stages, 0, 3), 0);
+	ck_assert_uint_eq(stages_assign_thread(&stages, 1, 0), 1);
+	ck_assert_uint_eq(stages_assign_thread(&stages, 1, 2), 1);
+	ck_assert_uint_eq(stages_assign_thread(&stages, 1, 3), 2);
+	// the output thread follows the first workload
+	ck_assert_uint_eq(stages_assign_thread(&stages, 1, 4), 1);
+}
+END_TEST
+
+START_TEST(record)
+{
+	group_stats_t* gs = group_stats_create(&stages, false);
+
+	group_stats_record(gs, 1, GROUP_OP_READ, 10, AEROSPIKE_OK);
+	group_stats_record(gs, 1, GROUP_OP_READ, 10, AEROSPIKE_ERR_RECORD_NOT_FOUND);
+	group_stats_record(gs, 1, GROUP_OP_READ, 10, AEROSPIKE_ERR_TIMEOUT);
+	group_stats_record(gs, 1, GROUP_OP_READ, 10, AEROSPIKE_ERR_CLIENT);
+	group_stats_record(gs, 1, GROUP_OP_WRITE, 10,
+			AEROSPIKE_ERR_RECORD_NOT_FOUND);
+	group_stats_record(gs, 2, GROUP_OP_UDF, 10, AEROSPIKE_ERR_RECORD_NOT_FOUND);
+
+	struct group_op_stats_s* read = &gs->workloads[1][GROUP_OP_READ];
+	ck_assert_uint_eq(read->ok, 1);
+	ck_assert_uint_eq(read->miss, 1);
+	ck_assert_uint_eq(read->timeouts, 1);
+	ck_assert_uint_eq(read->errors, 1);
+
+	// only reads can miss
+	ck_assert_uint_eq(gs->workloads[1][GROUP_OP_WRITE].errors, 1);
+	ck_assert_uint_eq(gs->workloads[2][GROUP_OP_UDF].ok, 1);
+
+	// the workloads are counted apart
+	ck_assert_uint_eq(period_count(gs, 2, GROUP_OP_READ), 0);
+	ck_assert_uint_eq(period_count(gs, 0, GROUP_OP_READ), 0);
+
+	group_stats_free(gs);
+}
+END_TEST
+
+START_TEST(latency)
+{
+	group_stats_t* gs = group_stats_create(&stages, true);
+
+	// histograms only for the ops each workload does
+	ck_assert_ptr_ne(gs->workloads[0][GROUP_OP_WRITE].hdr, NULL);
+	ck_assert_ptr_eq(gs->workloads[0][GROUP_OP_READ].hdr, NULL);
+	ck_assert_ptr_ne(gs->workloads[1][GROUP_OP_READ].hdr, NULL);
+	ck_assert_ptr_ne(gs->workloads[1][GROUP_OP_WRITE].hdr, NULL);
+	ck_assert_ptr_eq(gs->workloads[1][GROUP_OP_UDF].hdr, NULL);
+	ck_assert_ptr_eq(gs->workloads[2][GROUP_OP_READ].hdr, NULL);
+	ck_assert_ptr_ne(gs->workloads[2][GROUP_OP_UDF].hdr, NULL);
+
+	group_stats_record(gs, 1, GROUP_OP_READ, 100, AEROSPIKE_OK);
+	group_stats_record(gs, 1, GROUP_OP_READ, 100, AEROSPIKE_ERR_TIMEOUT);
+	ck_assert_int_eq(hdr_total_count(gs->workloads[1][GROUP_OP_READ].hdr), 1);
+
+	group_stats_free(gs);
+}
+END_TEST
+
+START_TEST(print_period)
+{
+	group_stats_t* gs = group_stats_create(&stages, false);
+
+	group_stats_record(gs, 0, GROUP_OP_WRITE, 10, AEROSPIKE_OK);
+	group_stats_record(gs, 1, GROUP_OP_WRITE, 10, AEROSPIKE_OK);
+	group_stats_record(gs, 2, GROUP_OP_UDF, 10, AEROSPIKE_OK);
+
+	// a stage of one workload is already covered by the totals
+	group_stats_print_period(gs, &stages, 0, 1000000);
+	ck_assert_uint_eq(period_count(gs, 0, GROUP_OP_WRITE), 1);
+
+	group_stats_print_period(gs, &stages, 1, 1000000);
+	ck_assert_uint_eq(period_count(gs, 1, GROUP_OP_WRITE), 0);
+	ck_assert_uint_eq(period_count(gs, 2, GROUP_OP_UDF), 0);
+
+	group_stats_free(gs);
+}
+END_TEST
+
+
+Suite*
+group_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Group Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, groups);
+	tcase_add_test(tc_core, record);
+	tcase_add_test(tc_core, latency);
+	tcase_add_test(tc_core, print_period);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,142 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common.h>
+#include <instance.h>
+
+
+#define TEST_SUITE_NAME "instance"
+
+
+static stage_t
+make_stage(uint64_t key_start, uint64_t key_end, uint64_t tps, uint64_t ops,
+		uint64_t bytes)
+{
+	stage_t stage = {
+		.desc = "stage",
+		.workload = { .type = WORKLOAD_TYPE_RU, .read_pct = 50 },
+		.key_start = key_start,
+		.key_end = key_end,
+		.tps = tps,
+		.ops = ops,
+		.bytes = bytes
+	};
+	return stage;
+}
+
+
+START_TEST(shard_range)
+{
+	uint64_t start;
+	uint64_t end;
+
+	// the first 10 % 4 instances get the extra keys
+	instance_shard_range(100, 110, 0, 4, &start, &end);
+	ck_assert_uint_eq(start, 100);
+	ck_assert_uint_eq(end, 103);
+	instance_shard_range(100, 110, 1, 4, &start, &end);
+	ck_assert_uint_eq(start, 103);
+	ck_assert_uint_eq(end, 106);
+	instance_shard_range(100, 110, 2, 4, &start, &end);
+	ck_assert_uint_eq(start, 106);
+	ck_assert_uint_eq(end, 108);
+	instance_shard_range(100, 110, 3, 4, &start, &end);
+	ck_assert_uint_eq(start, 108);
+	ck_assert_uint_eq(end, 110);
+
+	// a single instance keeps them all
+	instance_shard_range(5, 1000, 0, 1, &start, &end);
+	ck_assert_uint_eq(start, 5);
+	ck_assert_uint_eq(end, 1000);
+}
+END_TEST
+
+START_TEST(shard_range_covers)
+{
+	uint64_t n = 1000003;
+	uint32_t count = 7;
+	uint64_t prev_end = 0;
+
+	// the shards line up end to end and differ in size by at most one key
+	for (uint32_t id = 0; id < count; id++) {
+		uint64_t start;
+		uint64_t end;
+
+		instance_shard_range(0, n, id, count, &start, &end);
+		ck_assert_uint_eq(start, prev_end);
+		ck_assert_uint_ge(end - start, n / count);
+		ck_assert_uint_le(end - start, n / count + 1);
+		prev_end = end;
+	}
+	ck_assert_uint_eq(prev_end, n);
+}
+END_TEST
+
+START_TEST(shard_count)
+{
+	ck_assert_uint_eq(instance_shard_count(1000, 0, 8), 125);
+	ck_assert_uint_eq(instance_shard_count(1001, 0, 8), 126);
+	ck_assert_uint_eq(instance_shard_count(1001, 1, 8), 125);
+
+	// unlimited stays unlimited, and a limit never becomes unlimited
+	ck_assert_uint_eq(instance_shard_count(0, 3, 8), 0);
+	ck_assert_uint_eq(instance_shard_count(3, 5, 8), 1);
+}
+END_TEST
+
+START_TEST(shard_stages)
+{
+	stage_t test_stages[] = {
+		make_stage(0, 1000, 0, 0, 0),
+		make_stage(500, 600, 90, 30, 4000)
+	};
+	stages_t stages = { test_stages, 2, false };
+
+	ck_assert_int_eq(instance_shard_stages(&stages, 2, 3), 0);
+
+	ck_assert_uint_eq(test_stages[0].key_start, 667);
+	ck_assert_uint_eq(test_stages[0].key_end, 1000);
+	ck_assert_uint_eq(test_stages[0].tps, 0);
+	ck_assert(!stage_has_budget(&test_stages[0]));
+
+	ck_assert_uint_eq(test_stages[1].key_start, 567);
+	ck_assert_uint_eq(test_stages[1].key_end, 600);
+	ck_assert_uint_eq(test_stages[1].tps, 30);
+	ck_assert_uint_eq(test_stages[1].ops, 10);
+	ck_assert_uint_eq(test_stages[1].bytes, 1333);
+}
+END_TEST
+
+START_TEST(shard_stages_too_few_keys)
+{
+	stage_t test_stages[] = {
+		make_stage(0, 3, 0, 0, 0)
+	};
+	stages_t stages = { test_stages, 1, false };
+
+	ck_assert_int_eq(instance_shard_stages(&stages, 0, 4), -1);
+}
+END_TEST
+
+
+Suite*
+instance_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Instance");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, shard_range);
+	tcase_add_test(tc_core, shard_range_covers);
+	tcase_add_test(tc_core, shard_count);
+	tcase_add_test(tc_core, shard_stages);
+	tcase_add_test(tc_core, shard_stages_too_few_keys);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
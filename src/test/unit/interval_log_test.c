@@ -0,0 +1,255 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <interval_log.h>
+
+
+#define TEST_SUITE_NAME "interval log"
+
+// 2001-09-09T01:46:40Z, a whole second
+#define T0_US 1000000000000000LU
+
+
+static as_vector percentiles;
+
+static void
+setup(void)
+{
+	double p[] = { 20, 50 };
+
+	as_vector_init(&percentiles, sizeof(double), 2);
+	as_vector_append(&percentiles, &p[0]);
+	as_vector_append(&percentiles, &p[1]);
+}
+
+static void
+teardown(void)
+{
+	as_vector_destroy(&percentiles);
+}
+
+static void
+make_dir(char* path)
+{
+	strcpy(path, "/tmp/interval_log_test_XXXXXX");
+	ck_assert_ptr_nonnull(mkdtemp(path));
+}
+
+static void
+remove_dir(const char* path)
+{
+	char cmd[128];
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+	ck_assert_int_eq(system(cmd), 0);
+}
+
+/*
+ * everything written to out, which the caller frees
+ */
+static char*
+read_all(FILE* out)
+{
+	long len = ftell(out);
+	char* buf = (char*) malloc(len + 1);
+
+	rewind(out);
+	ck_assert_int_eq(fread(buf, 1, len, out), len);
+	buf[len] = '\0';
+	return buf;
+}
+
+static void
+record_n(struct hdr_histogram* h, int64_t value, int64_t n)
+{
+	for (int64_t i = 0; i < n; i++) {
+		hdr_record_value(h, value);
+	}
+}
+
+/*
+ * logs two periods of writes as instance id of 2: n_first writes of
+ * first_us, then 50 of 200us
+ */
+static void
+write_instance(const char* dir, uint32_t id, int64_t first_us,
+		uint64_t n_first)
+{
+	struct hdr_histogram* write_hdr;
+	hdr_init(1, 1000000, 3, &write_hdr);
+
+	struct hdr_histogram* hdrs[GROUP_OP_COUNT] = {
+		[GROUP_OP_WRITE] = write_hdr
+	};
+	struct interval_counts_s counts[GROUP_OP_COUNT];
+
+	interval_log_t* log = interval_log_create(dir, id, 2, T0_US / 1000000);
+	ck_assert_ptr_nonnull(log);
+	interval_log_restart(log, T0_US);
+
+	memset(counts, 0, sizeof(counts));
+	record_n(write_hdr, first_us, n_first);
+	counts[GROUP_OP_WRITE].ok = n_first;
+	counts[GROUP_OP_WRITE].bytes = n_first * 10;
+	interval_log_write(log, T0_US + 1000000, hdrs, counts);
+
+	// the second interval holds only what was recorded since the first
+	memset(counts, 0, sizeof(counts));
+	record_n(write_hdr, 200, 50);
+	counts[GROUP_OP_WRITE].ok = 50;
+	counts[GROUP_OP_WRITE].timeouts = 1;
+	interval_log_write(log, T0_US + 2000000, hdrs, counts);
+
+	interval_log_free(log);
+	hdr_close(write_hdr);
+}
+
+
+START_TEST(next_boundary)
+{
+	// a wake-up just after or just before a boundary moves on to the next
+	ck_assert_uint_eq(interval_log_next_boundary(T0_US + 1000), T0_US + 1000000);
+	ck_assert_uint_eq(interval_log_next_boundary(T0_US - 500), T0_US + 1000000);
+	// and one well into a period skips the rest of it
+	ck_assert_uint_eq(interval_log_next_boundary(T0_US + 600000),
+			T0_US + 2000000);
+}
+END_TEST
+
+START_TEST(merge)
+{
+	char dir0[64];
+	char dir1[64];
+	char out_dir[64];
+	char paths[256];
+
+	make_dir(dir0);
+	make_dir(dir1);
+	make_dir(out_dir);
+	write_instance(dir0, 0, 100, 100);
+	write_instance(dir1, 1, 1000, 300);
+
+	FILE* out = tmpfile();
+	snprintf(paths, sizeof(paths), "%s,%s", dir0, dir1);
+	ck_assert_int_eq(interval_log_merge(paths, &percentiles, out_dir, out), 0);
+
+	char* res = read_all(out);
+	ck_assert_ptr_nonnull(strstr(res,
+				"Merged 2 interval logs over 2 seconds\n"));
+
+	// the periods add up both instances
+	ck_assert_ptr_nonnull(strstr(res, "2001-09-09T01:46:40Z write(tps=400 "
+				"(hit=400 miss=0) timeouts=0 errors=0 bytes/s=4000) "
+				"total(tps=400 (hit=400 miss=0) timeouts=0 errors=0)\n"));
+	ck_assert_ptr_nonnull(strstr(res, "hdr: write 2001-09-09T01:46:40Z 1, "
+				"400, 100, 1000, 100, 1000\n"));
+	ck_assert_ptr_nonnull(strstr(res, "2001-09-09T01:46:41Z write(tps=100 "
+				"(hit=100 miss=0) timeouts=2 errors=0 bytes/s=0)"));
+	ck_assert_ptr_nonnull(strstr(res, "hdr: write 2001-09-09T01:46:41Z 2, "
+				"100, 200, 200, 200, 200\n"));
+
+	// and the total is their sum
+	ck_assert_ptr_nonnull(strstr(res, "Total:\n2001-09-09T01:46:41Z "
+				"write(tps=250 (hit=250 miss=0) timeouts=2 errors=0 "
+				"bytes/s=2000)"));
+	ck_assert_ptr_nonnull(strstr(res, "hdr: write 2001-09-09T01:46:41Z 2, "
+				"500, 100, 1000, 100, 1000\n"));
+	free(res);
+	fclose(out);
+
+	// the merged log merges again to the same totals
+	out = tmpfile();
+	ck_assert_int_eq(interval_log_merge(out_dir, &percentiles, NULL, out), 0);
+	res = read_all(out);
+	ck_assert_ptr_nonnull(strstr(res,
+				"Merged 1 interval logs over 2 seconds\n"));
+	ck_assert_ptr_nonnull(strstr(res, "hdr: write 2001-09-09T01:46:41Z 2, "
+				"500, 100, 1000, 100, 1000\n"));
+	free(res);
+	fclose(out);
+
+	remove_dir(dir0);
+	remove_dir(dir1);
+	remove_dir(out_dir);
+}
+END_TEST
+
+START_TEST(merge_invalid)
+{
+	char dir[64];
+	char path[128];
+	FILE* out = tmpfile();
+
+	make_dir(dir);
+	ck_assert_int_eq(interval_log_merge(dir, &percentiles, NULL, out), -1);
+
+	snprintf(path, sizeof(path), "%s/missing.hlog", dir);
+	ck_assert_int_eq(interval_log_merge(path, &percentiles, NULL, out), -1);
+
+	// a log without its counts
+	write_instance(dir, 0, 100, 10);
+	char cmd[192];
+	snprintf(cmd, sizeof(cmd), "rm %s/*.csv", dir);
+	ck_assert_int_eq(system(cmd), 0);
+	ck_assert_int_eq(interval_log_merge(dir, &percentiles, NULL, out), -1);
+	remove_dir(dir);
+
+	// a run that ended before its first interval did
+	make_dir(dir);
+	interval_log_t* log = interval_log_create(dir, 0, 1, T0_US / 1000000);
+	ck_assert_ptr_nonnull(log);
+	interval_log_free(log);
+	ck_assert_int_eq(interval_log_merge(dir, &percentiles, NULL, out), -1);
+
+	fclose(out);
+	remove_dir(dir);
+}
+END_TEST
+
+START_TEST(print_counts)
+{
+	const struct interval_counts_s counts[GROUP_OP_COUNT] = {
+		[GROUP_OP_READ] = { .ok = 30, .miss = 10, .errors = 1 },
+		[GROUP_OP_UDF] = { .ok = 20, .timeouts = 3 }
+	};
+	const bool has_op[GROUP_OP_COUNT] = {
+		[GROUP_OP_READ] = true,
+		[GROUP_OP_UDF] = true
+	};
+	FILE* out = tmpfile();
+
+	interval_log_print_counts(out, counts, has_op, 2000000, "extra ");
+
+	char* res = read_all(out);
+	ck_assert_str_eq(res, "read(tps=20 (hit=15 miss=5) timeouts=0 errors=1) "
+			"udf(tps=10 (hit=10 miss=0) timeouts=3 errors=0) extra "
+			"total(tps=30 (hit=25 miss=5) timeouts=3 errors=1)\n");
+	free(res);
+	fclose(out);
+}
+END_TEST
+
+
+Suite*
+interval_log_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Interval Log");
+
+	tc_core = tcase_create("Core");
+	tcase_add_checked_fixture(tc_core, setup, teardown);
+	tcase_add_test(tc_core, next_boundary);
+	tcase_add_test(tc_core, merge);
+	tcase_add_test(tc_core, merge_invalid);
+	tcase_add_test(tc_core, print_counts);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
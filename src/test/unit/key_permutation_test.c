@@ -0,0 +1,130 @@
+
+#include <check.h>
+#include <stdio.h>
+
+#include <citrusleaf/alloc.h>
+
+#include <common.h>
+#include <key_permutation.h>
+
+
+#define TEST_SUITE_NAME "key permutation"
+
+
+/*
+ * checks that the permutation over [0, n) hits every value exactly once
+ */
+static void
+assert_bijection(uint64_t n, uint64_t seed)
+{
+	key_perm_t perm;
+	key_perm_init(&perm, n, seed);
+
+	uint8_t* seen = (uint8_t*) cf_calloc(n, 1);
+	for (uint64_t i = 0; i < n; i++) {
+		uint64_t v = key_perm_apply(&perm, i);
+		ck_assert_uint_lt(v, n);
+		ck_assert_uint_eq(seen[v], 0);
+		seen[v] = 1;
+	}
+	cf_free(seen);
+}
+
+
+START_TEST(bijection_small)
+{
+	for (uint64_t n = 1; n <= 70; n++) {
+		assert_bijection(n, n * 31);
+	}
+}
+END_TEST
+
+START_TEST(bijection_large)
+{
+	assert_bijection(100000, 1);
+	assert_bijection(1 << 20, 2);
+	assert_bijection((1 << 20) + 1, 3);
+}
+END_TEST
+
+START_TEST(outside_range_fixed)
+{
+	key_perm_t perm;
+	key_perm_init(&perm, 1000, 7);
+
+	ck_assert_uint_eq(key_perm_apply(&perm, 1000), 1000);
+	ck_assert_uint_eq(key_perm_apply(&perm, 123456), 123456);
+}
+END_TEST
+
+/*
+ * the permutation shouldn't leave the keys anywhere near sorted order
+ */
+START_TEST(shuffled)
+{
+	key_perm_t perm;
+	key_perm_init(&perm, 100000, 42);
+
+	uint64_t n_ascending = 0;
+	uint64_t prev = key_perm_apply(&perm, 0);
+	for (uint64_t i = 1; i < 100000; i++) {
+		uint64_t v = key_perm_apply(&perm, i);
+		if (v > prev) {
+			n_ascending++;
+		}
+		prev = v;
+	}
+	// a random order ascends about half of the time
+	ck_assert_uint_gt(n_ascending, 45000);
+	ck_assert_uint_lt(n_ascending, 55000);
+}
+END_TEST
+
+START_TEST(seed_changes_order)
+{
+	key_perm_t a;
+	key_perm_t b;
+	key_perm_init(&a, 100000, 1);
+	key_perm_init(&b, 100000, 2);
+
+	uint64_t n_same = 0;
+	for (uint64_t i = 0; i < 1000; i++) {
+		if (key_perm_apply(&a, i) == key_perm_apply(&b, i)) {
+			n_same++;
+		}
+	}
+	ck_assert_uint_lt(n_same, 10);
+}
+END_TEST
+
+START_TEST(full_width)
+{
+	key_perm_t perm;
+	key_perm_init(&perm, UINT64_MAX, 5);
+
+	ck_assert_uint_eq(perm.half_bits, 32);
+	ck_assert_uint_lt(key_perm_apply(&perm, UINT64_MAX - 1), UINT64_MAX);
+}
+END_TEST
+
+
+Suite*
+key_permutation_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Key Permutation");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, bijection_small);
+	tcase_add_test(tc_core, bijection_large);
+	tcase_add_test(tc_core, outside_range_fixed);
+	tcase_add_test(tc_core, shuffled);
+	tcase_add_test(tc_core, seed_changes_order);
+	tcase_add_test(tc_core, full_width);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,252 @@
+
+#include <check.h>
+#include <stdio.h>
+
+#include <aerospike/as_random.h>
+
+#include <common.h>
+#include <key_tracker.h>
+
+
+#define TEST_SUITE_NAME "key tracker"
+
+
+START_TEST(starts_dead)
+{
+	key_tracker_t kt;
+	key_tracker_init(&kt, 100, 1000);
+
+	for (uint64_t k = 100; k < 1100; k++) {
+		ck_assert(!key_tracker_is_live(&kt, k));
+	}
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 0);
+	key_tracker_free(&kt);
+}
+END_TEST
+
+START_TEST(set_and_clear)
+{
+	key_tracker_t kt;
+	key_tracker_init(&kt, 100, 1000);
+
+	key_tracker_set_live(&kt, 100, true);
+	key_tracker_set_live(&kt, 163, true);
+	key_tracker_set_live(&kt, 164, true);
+	key_tracker_set_live(&kt, 1099, true);
+	ck_assert(key_tracker_is_live(&kt, 100));
+	ck_assert(key_tracker_is_live(&kt, 163));
+	ck_assert(key_tracker_is_live(&kt, 164));
+	ck_assert(key_tracker_is_live(&kt, 1099));
+	ck_assert(!key_tracker_is_live(&kt, 101));
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 4);
+
+	// setting a live key again doesn't change the count
+	key_tracker_set_live(&kt, 163, true);
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 4);
+
+	key_tracker_set_live(&kt, 163, false);
+	ck_assert(!key_tracker_is_live(&kt, 163));
+	ck_assert(key_tracker_is_live(&kt, 164));
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 3);
+
+	key_tracker_set_live(&kt, 163, false);
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 3);
+	key_tracker_free(&kt);
+}
+END_TEST
+
+START_TEST(out_of_range_ignored)
+{
+	key_tracker_t kt;
+	key_tracker_init(&kt, 100, 1000);
+
+	key_tracker_set_live(&kt, 99, true);
+	key_tracker_set_live(&kt, 1100, true);
+	ck_assert(!key_tracker_is_live(&kt, 99));
+	ck_assert(!key_tracker_is_live(&kt, 1100));
+	ck_assert_uint_eq(key_tracker_n_live(&kt), 0);
+	key_tracker_free(&kt);
+}
+END_TEST
+
+START_TEST(pick_none)
+{
+	key_tracker_t kt;
+	as_random random;
+	uint64_t key;
+
+	as_random_init(&random);
+	key_tracker_init(&kt, 0, 1000);
+
+	ck_assert(!key_tracker_pick(&kt, &random, 0, 1000, true, &key));
+
+	for (uint64_t k = 0; k < 1000; k++) {
+		key_tracker_set_live(&kt, k, true);
+	}
+	ck_assert(!key_tracker_pick(&kt, &random, 0, 1000, false, &key));
+	key_tracker_free(&kt);
+}
+END_TEST
+
+/*
+ * a single live key among many dead ones can only be found by its rank
+ */
+START_TEST(pick_sparse)
+{
+	key_tracker_t kt;
+	as_random random;
+	uint64_t key;
+
+	as_random_init(&random);
+	key_tracker_init(&kt, 1000, 100000);
+	key_tracker_set_live(&kt, 54321, true);
+
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, 1000, 101000, true, &key));
+		ck_assert_uint_eq(key, 54321);
+	}
+
+	// and the same for a single dead key
+	for (uint64_t k = 1000; k < 101000; k++) {
+		key_tracker_set_live(&kt, k, k != 2000);
+	}
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, 1000, 101000, false, &key));
+		ck_assert_uint_eq(key, 2000);
+	}
+	key_tracker_free(&kt);
+}
+END_TEST
+
+/*
+ * picks are restricted to the requested subrange
+ */
+START_TEST(pick_subrange)
+{
+	key_tracker_t kt;
+	as_random random;
+	uint64_t key;
+
+	as_random_init(&random);
+	key_tracker_init(&kt, 0, 1000);
+	key_tracker_set_live(&kt, 10, true);
+	key_tracker_set_live(&kt, 500, true);
+
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, 100, 600, true, &key));
+		ck_assert_uint_eq(key, 500);
+
+		ck_assert(key_tracker_pick(&kt, &random, 100, 600, false, &key));
+		ck_assert_uint_ge(key, 100);
+		ck_assert_uint_lt(key, 600);
+		ck_assert_uint_ne(key, 500);
+	}
+	ck_assert(!key_tracker_pick(&kt, &random, 501, 600, true, &key));
+	key_tracker_free(&kt);
+}
+END_TEST
+
+/*
+ * keys found by their rank are picked uniformly, not by how many dead keys
+ * come before them
+ */
+START_TEST(pick_uniform)
+{
+	key_tracker_t kt;
+	as_random random;
+	uint64_t key;
+	uint32_t counts[4] = { 0 };
+	// bunched together, so a scan from a random position would nearly always
+	// land on the first
+	uint64_t live_keys[4] = { 10, 11, 12, 100000 };
+
+	as_random_init(&random);
+	key_tracker_init(&kt, 0, 1000000);
+	for (uint32_t i = 0; i < 4; i++) {
+		key_tracker_set_live(&kt, live_keys[i], true);
+	}
+
+	for (uint32_t i = 0; i < 4000; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, 0, 1000000, true, &key));
+		for (uint32_t j = 0; j < 4; j++) {
+			if (key == live_keys[j]) {
+				counts[j]++;
+			}
+		}
+	}
+
+	for (uint32_t j = 0; j < 4; j++) {
+		ck_assert_uint_gt(counts[j], 800);
+		ck_assert_uint_lt(counts[j], 1200);
+	}
+	key_tracker_free(&kt);
+}
+END_TEST
+
+/*
+ * ranges that start and end partway through words, blocks and superblocks
+ * count and select exactly the keys inside them
+ */
+START_TEST(pick_unaligned)
+{
+	key_tracker_t kt;
+	as_random random;
+	uint64_t key;
+	uint64_t n_keys = 3 * KEY_TRACKER_SUPER_KEYS + 1000;
+	uint64_t lo = KEY_TRACKER_SUPER_KEYS - KEY_TRACKER_BLOCK_KEYS - 3;
+	uint64_t hi = 2 * KEY_TRACKER_SUPER_KEYS + KEY_TRACKER_BLOCK_KEYS + 5;
+
+	as_random_init(&random);
+	key_tracker_init(&kt, 0, n_keys);
+
+	// live keys just outside the range on both sides
+	key_tracker_set_live(&kt, lo - 1, true);
+	key_tracker_set_live(&kt, hi, true);
+	ck_assert(!key_tracker_pick(&kt, &random, lo, hi, true, &key));
+
+	key_tracker_set_live(&kt, lo, true);
+	key_tracker_set_live(&kt, hi - 1, true);
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, lo, hi, true, &key));
+		ck_assert(key == lo || key == hi - 1);
+	}
+
+	// and with every key live but a few in the middle of a superblock
+	for (uint64_t k = 0; k < n_keys; k++) {
+		key_tracker_set_live(&kt, k, true);
+	}
+	uint64_t mid = KEY_TRACKER_SUPER_KEYS + KEY_TRACKER_SUPER_KEYS / 2;
+	key_tracker_set_live(&kt, mid, false);
+	key_tracker_set_live(&kt, mid + 64, false);
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert(key_tracker_pick(&kt, &random, lo, hi, false, &key));
+		ck_assert(key == mid || key == mid + 64);
+	}
+	ck_assert(!key_tracker_pick(&kt, &random, 0, mid, false, &key));
+	key_tracker_free(&kt);
+}
+END_TEST
+
+
+Suite*
+key_tracker_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Key Tracker");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, starts_dead);
+	tcase_add_test(tc_core, set_and_clear);
+	tcase_add_test(tc_core, out_of_range_ignored);
+	tcase_add_test(tc_core, pick_none);
+	tcase_add_test(tc_core, pick_sparse);
+	tcase_add_test(tc_core, pick_subrange);
+	tcase_add_test(tc_core, pick_uniform);
+	tcase_add_test(tc_core, pick_unaligned);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
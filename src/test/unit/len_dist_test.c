@@ -0,0 +1,275 @@
+
+#include <check.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <len_dist.h>
+
+
+#define TEST_SUITE_NAME "length distribution"
+
+#define N_SAMPLES 100000
+
+
+/*
+ * writes contents to a fresh temp file, returning its path in buf
+ */
+static void
+write_tmp(char* buf, const char* contents)
+{
+	strcpy(buf, "/tmp/len_dist_test_XXXXXX");
+	int fd = mkstemp(buf);
+	ck_assert_int_ge(fd, 0);
+	FILE* f = fdopen(fd, "w");
+	fputs(contents, f);
+	fclose(f);
+}
+
+/*
+ * the probability of picking each bucket implied by the alias table
+ */
+static void
+bucket_probs(const len_dist_t* dist, double* probs)
+{
+	uint32_t n = dist->n_buckets;
+
+	for (uint32_t i = 0; i < n; i++) {
+		probs[i] = 0;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		double p = dist->buckets[i].threshold / 4294967296.;
+		probs[i] += p / n;
+		probs[dist->buckets[i].alias] += (1 - p) / n;
+	}
+}
+
+
+START_TEST(uniform_bounds)
+{
+	as_random random;
+	as_random_init(&random);
+
+	len_dist_t* dist = len_dist_uniform(10, 20);
+	ck_assert_ptr_nonnull(dist);
+	ck_assert_uint_eq(dist->min_len, 10);
+	ck_assert_uint_eq(dist->max_len, 20);
+
+	uint32_t counts[11] = { 0 };
+	for (uint32_t i = 0; i < N_SAMPLES; i++) {
+		uint32_t len = len_dist_sample(dist, &random);
+		ck_assert_uint_ge(len, 10);
+		ck_assert_uint_le(len, 20);
+		counts[len - 10]++;
+	}
+	for (uint32_t i = 0; i < 11; i++) {
+		ck_assert_uint_gt(counts[i], N_SAMPLES / 11 / 2);
+	}
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(uniform_single)
+{
+	as_random random;
+	as_random_init(&random);
+
+	len_dist_t* dist = len_dist_uniform(7, 7);
+	for (uint32_t i = 0; i < 100; i++) {
+		ck_assert_uint_eq(len_dist_sample(dist, &random), 7);
+	}
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(uniform_full_range)
+{
+	len_dist_t* dist = len_dist_uniform(0, UINT32_MAX);
+	ck_assert_uint_eq(dist->min_len, 0);
+	ck_assert_uint_eq(dist->max_len, UINT32_MAX);
+	len_dist_free(dist);
+}
+END_TEST
+
+/*
+ * the alias table must reproduce the weights it was built from exactly (up to
+ * the fixed-point precision of the thresholds)
+ */
+START_TEST(alias_table_exact)
+{
+	char path[64];
+	write_tmp(path, "# len weight\n"
+			"1 1\n"
+			"2 2\n"
+			"\n"
+			"3 3\n"
+			"4 0\n"
+			"5 4\n");
+
+	len_dist_t* dist = len_dist_from_file(path);
+	unlink(path);
+	ck_assert_ptr_nonnull(dist);
+
+	// the zero-weight entry is dropped
+	ck_assert_uint_eq(dist->n_buckets, 4);
+	ck_assert_uint_eq(dist->min_len, 1);
+	ck_assert_uint_eq(dist->max_len, 5);
+
+	double probs[4];
+	bucket_probs(dist, probs);
+	for (uint32_t i = 0; i < 4; i++) {
+		uint32_t len = dist->buckets[i].lo;
+		double expected = (len == 5 ? 4 : len) / 10.;
+		ck_assert_uint_eq(dist->buckets[i].hi, len);
+		ck_assert_double_eq_tol(probs[i], expected, 1e-9);
+	}
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(file_sampling)
+{
+	as_random random;
+	as_random_init(&random);
+
+	char path[64];
+	write_tmp(path, "100 9\n10000 1\n");
+
+	len_dist_t* dist = len_dist_from_file(path);
+	unlink(path);
+	ck_assert_ptr_nonnull(dist);
+
+	uint32_t n_large = 0;
+	for (uint32_t i = 0; i < N_SAMPLES; i++) {
+		uint32_t len = len_dist_sample(dist, &random);
+		ck_assert(len == 100 || len == 10000);
+		n_large += len == 10000;
+	}
+	ck_assert_double_eq_tol(n_large / (double) N_SAMPLES, 0.1, 0.01);
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(file_invalid)
+{
+	char path[64];
+
+	ck_assert_ptr_null(len_dist_from_file("/nonexistent/len_dist"));
+
+	write_tmp(path, "# nothing here\n");
+	ck_assert_ptr_null(len_dist_from_file(path));
+	unlink(path);
+
+	write_tmp(path, "10 0\n20 0\n");
+	ck_assert_ptr_null(len_dist_from_file(path));
+	unlink(path);
+
+	write_tmp(path, "10 1\nabc 1\n");
+	ck_assert_ptr_null(len_dist_from_file(path));
+	unlink(path);
+
+	write_tmp(path, "10\n");
+	ck_assert_ptr_null(len_dist_from_file(path));
+	unlink(path);
+
+	write_tmp(path, "-10 1\n");
+	ck_assert_ptr_null(len_dist_from_file(path));
+	unlink(path);
+}
+END_TEST
+
+START_TEST(normal_moments)
+{
+	as_random random;
+	as_random_init(&random);
+
+	len_dist_t* dist = len_dist_normal(1000, 100);
+	ck_assert_ptr_nonnull(dist);
+	ck_assert_uint_le(dist->n_buckets, LEN_DIST_N_BUCKETS);
+	ck_assert_uint_ge(dist->min_len, 1000 - LEN_DIST_N_SIGMAS * 100);
+	ck_assert_uint_le(dist->max_len, 1000 + LEN_DIST_N_SIGMAS * 100);
+
+	double sum = 0;
+	double sum_sq = 0;
+	for (uint32_t i = 0; i < N_SAMPLES; i++) {
+		double len = len_dist_sample(dist, &random);
+		sum += len;
+		sum_sq += len * len;
+	}
+	double mean = sum / N_SAMPLES;
+	double stddev = sqrt(sum_sq / N_SAMPLES - mean * mean);
+	ck_assert_double_eq_tol(mean, 1000, 5);
+	ck_assert_double_eq_tol(stddev, 100, 5);
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(normal_truncated_at_zero)
+{
+	as_random random;
+	as_random_init(&random);
+
+	len_dist_t* dist = len_dist_normal(2, 10);
+	ck_assert_ptr_nonnull(dist);
+	ck_assert_uint_eq(dist->min_len, 0);
+	for (uint32_t i = 0; i < 1000; i++) {
+		ck_assert_uint_le(len_dist_sample(dist, &random), 42);
+	}
+	len_dist_free(dist);
+}
+END_TEST
+
+START_TEST(normal_out_of_range)
+{
+	ck_assert_ptr_null(len_dist_normal(4294967295., 100));
+	ck_assert_ptr_null(len_dist_normal(-1000, 10));
+}
+END_TEST
+
+START_TEST(lognormal_median)
+{
+	as_random random;
+	as_random_init(&random);
+
+	len_dist_t* dist = len_dist_lognormal(1000, 0.5);
+	ck_assert_ptr_nonnull(dist);
+
+	uint32_t n_below = 0;
+	for (uint32_t i = 0; i < N_SAMPLES; i++) {
+		n_below += len_dist_sample(dist, &random) < 1000;
+	}
+	ck_assert_double_eq_tol(n_below / (double) N_SAMPLES, 0.5, 0.02);
+	len_dist_free(dist);
+
+	ck_assert_ptr_null(len_dist_lognormal(0, 1));
+}
+END_TEST
+
+
+Suite*
+len_dist_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Length Distribution");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, uniform_bounds);
+	tcase_add_test(tc_core, uniform_single);
+	tcase_add_test(tc_core, uniform_full_range);
+	tcase_add_test(tc_core, alias_table_exact);
+	tcase_add_test(tc_core, file_sampling);
+	tcase_add_test(tc_core, file_invalid);
+	tcase_add_test(tc_core, normal_moments);
+	tcase_add_test(tc_core, normal_truncated_at_zero);
+	tcase_add_test(tc_core, normal_out_of_range);
+	tcase_add_test(tc_core, lognormal_median);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
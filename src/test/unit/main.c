@@ -38,12 +38,32 @@ main(void) {
 	g_sr = srunner_create(s);
 	srunner_add_suite(g_sr, setup_suite());
 	srunner_add_suite(g_sr, common_suite());
+	srunner_add_suite(g_sr, conc_limiter_suite());
 	srunner_add_suite(g_sr, coordinator_suite());
+	srunner_add_suite(g_sr, cpu_affinity_suite());
+	srunner_add_suite(g_sr, digest_table_suite());
 	srunner_add_suite(g_sr, dyn_throttle_suite());
+	srunner_add_suite(g_sr, error_stats_suite());
+	srunner_add_suite(g_sr, group_stats_suite());
 	srunner_add_suite(g_sr, hdr_histogram_suite());
 	srunner_add_suite(g_sr, hdr_histogram_log_suite());
 	srunner_add_suite(g_sr, histogram_suite());
+	srunner_add_suite(g_sr, instance_suite());
+	srunner_add_suite(g_sr, interval_log_suite());
+	srunner_add_suite(g_sr, key_permutation_suite());
+	srunner_add_suite(g_sr, key_tracker_suite());
+	srunner_add_suite(g_sr, len_dist_suite());
+	srunner_add_suite(g_sr, node_stats_suite());
 	srunner_add_suite(g_sr, obj_spec_suite());
+	srunner_add_suite(g_sr, perf_counters_suite());
+	srunner_add_suite(g_sr, proc_stats_suite());
+	srunner_add_suite(g_sr, queue_suite());
+	srunner_add_suite(g_sr, self_stats_suite());
+	srunner_add_suite(g_sr, slow_ops_suite());
+	srunner_add_suite(g_sr, stage_budget_suite());
+	srunner_add_suite(g_sr, sustain_gate_suite());
+	srunner_add_suite(g_sr, trace_suite());
+	srunner_add_suite(g_sr, warmup_stats_suite());
 	srunner_add_suite(g_sr, yaml_parse_suite());
 
 	//srunner_set_fork_status(g_sr, CK_NOFORK);
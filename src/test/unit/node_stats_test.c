@@ -0,0 +1,112 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <common.h>
+#include <node_stats.h>
+
+
+#define TEST_SUITE_NAME "node stats"
+
+
+extern struct node_entry_s* _get_entry(node_stats_t* ns, const char* name);
+extern uint32_t _sort_by_p99(node_stats_t* ns, uint32_t* order);
+
+
+START_TEST(same_node_same_entry)
+{
+	node_stats_t* ns = node_stats_create(NODE_STATS_DEFAULT_TOP_N);
+
+	struct node_entry_s* e1 = _get_entry(ns, "A");
+	ck_assert_ptr_nonnull(e1);
+	ck_assert_str_eq(e1->name, "A");
+
+	// the name is all that identifies the node, so one that left the
+	// cluster and came back keeps its entry
+	char name[AS_NODE_NAME_SIZE] = "A";
+	struct node_entry_s* e2 = _get_entry(ns, name);
+	ck_assert_ptr_eq(e1, e2);
+
+	node_stats_free(ns);
+}
+END_TEST
+
+START_TEST(distinct_nodes_distinct_entries)
+{
+	node_stats_t* ns = node_stats_create(NODE_STATS_DEFAULT_TOP_N);
+
+	struct node_entry_s* ea = _get_entry(ns, "A");
+	struct node_entry_s* eb = _get_entry(ns, "B");
+	ck_assert_ptr_nonnull(ea);
+	ck_assert_ptr_nonnull(eb);
+	ck_assert_ptr_ne(ea, eb);
+	ck_assert_ptr_eq(ea, &ns->entries[0]);
+	ck_assert_ptr_eq(eb, &ns->entries[1]);
+
+	node_stats_free(ns);
+}
+END_TEST
+
+START_TEST(table_full)
+{
+	node_stats_t* ns = node_stats_create(NODE_STATS_DEFAULT_TOP_N);
+	char name[AS_NODE_NAME_SIZE];
+
+	for (uint32_t i = 0; i < NODE_STATS_MAX_NODES; i++) {
+		snprintf(name, sizeof(name), "N%u", i);
+		ck_assert_ptr_nonnull(_get_entry(ns, name));
+	}
+	snprintf(name, sizeof(name), "N%u", NODE_STATS_MAX_NODES);
+	ck_assert_ptr_null(_get_entry(ns, name));
+
+	// the nodes already registered are still found
+	ck_assert_ptr_eq(_get_entry(ns, "N0"), &ns->entries[0]);
+
+	node_stats_free(ns);
+}
+END_TEST
+
+START_TEST(sort_slowest_first)
+{
+	node_stats_t* ns = node_stats_create(NODE_STATS_DEFAULT_TOP_N);
+
+	struct node_entry_s* ea = _get_entry(ns, "A");
+	struct node_entry_s* eb = _get_entry(ns, "B");
+	struct node_entry_s* ec = _get_entry(ns, "C");
+
+	for (uint32_t i = 0; i < 100; i++) {
+		hdr_record_value(ea->ops[NODE_OP_READ].hdr, 200);
+		hdr_record_value(eb->ops[NODE_OP_WRITE].hdr, 5000);
+		hdr_record_value(ec->ops[NODE_OP_READ].hdr, 100);
+	}
+
+	uint32_t order[NODE_STATS_MAX_NODES];
+	ck_assert_uint_eq(_sort_by_p99(ns, order), 3);
+	ck_assert_uint_eq(order[0], 1);
+	ck_assert_uint_eq(order[1], 0);
+	ck_assert_uint_eq(order[2], 2);
+
+	node_stats_free(ns);
+}
+END_TEST
+
+
+Suite*
+node_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Node Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, same_node_same_entry);
+	tcase_add_test(tc_core, distinct_nodes_distinct_entries);
+	tcase_add_test(tc_core, table_full);
+	tcase_add_test(tc_core, sort_slowest_first);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -1,8 +1,10 @@
 
 #include <check.h>
 #include <stdio.h>
+#include <zlib.h>
 
 #include <aerospike/as_msgpack.h>
+#include <citrusleaf/alloc.h>
 #include <cyaml/cyaml.h>
 
 #include <benchmark.h>
@@ -61,7 +63,7 @@ START_TEST(test_free_after_move)
 
 	as_record_init(&rec, obj_spec_n_bins(&p));
 	obj_spec_populate_bins(&p, &rec, as_random_instance(), "test", NULL, 0,
-			1.f);
+			1.f, NULL);
 	_dbg_obj_spec_assert_valid(&p, &rec, NULL, 0, "test");
 	as_record_destroy(&rec);
 	obj_spec_free(&p);
@@ -79,7 +81,7 @@ START_TEST(test_shallow_copy)
 
 	as_record_init(&rec, obj_spec_n_bins(&p));
 	obj_spec_populate_bins(&p, &rec, as_random_instance(), "test", NULL, 0,
-			1.f);
+			1.f, NULL);
 	_dbg_obj_spec_assert_valid(&p, &rec, NULL, 0, "test");
 	as_record_destroy(&rec);
 	obj_spec_free(&p);
@@ -99,7 +101,7 @@ START_TEST(test_free_after_shallow_copy)
 
 	as_record_init(&rec, obj_spec_n_bins(&o));
 	obj_spec_populate_bins(&o, &rec, as_random_instance(), "test", NULL, 0,
-			1.f);
+			1.f, NULL);
 	_dbg_obj_spec_assert_valid(&o, &rec, NULL, 0, "test");
 	as_record_destroy(&rec);
 	obj_spec_free(&o);
@@ -115,7 +117,7 @@ START_TEST(test_not_enough_bins)
 
 	as_record_init(&rec, 2);
 	ck_assert_int_ne(0, obj_spec_populate_bins(&o, &rec, as_random_instance(),
-				"test", NULL, 0, 1.f));
+				"test", NULL, 0, 1.f, NULL));
 	as_record_destroy(&rec);
 	obj_spec_free(&o);
 }
@@ -131,7 +133,7 @@ START_TEST(test_not_enough_bins_write_bins)
 
 	as_record_init(&rec, 1);
 	ck_assert_int_ne(0, obj_spec_populate_bins(&o, &rec, as_random_instance(),
-				"test", bins, 2, 1.f));
+				"test", bins, 2, 1.f, NULL));
 	as_record_destroy(&rec);
 	obj_spec_free(&o);
 }
@@ -150,7 +152,7 @@ START_TEST(test_bins_already_occupied)
 	as_bin_name bin_name = "extra_bin";
 	as_record_set(&rec, bin_name, (as_bin_value*) &i);
 	ck_assert_int_ne(0, obj_spec_populate_bins(&o, &rec, as_random_instance(),
-				"test", NULL, 0, 1.f));
+				"test", NULL, 0, 1.f, NULL));
 	as_record_destroy(&rec);
 	obj_spec_free(&o);
 }
@@ -168,7 +170,7 @@ START_TEST(test_bins_already_occupied_write_bins)
 	as_bin_name bin_name = "extra_bin";
 	as_record_set_int64(&rec, bin_name, 1);
 	ck_assert_int_ne(0, obj_spec_populate_bins(&o, &rec, as_random_instance(),
-				"test", bins, 2, 1.f));
+				"test", bins, 2, 1.f, NULL));
 	as_record_destroy(&rec);
 	obj_spec_free(&o);
 }
@@ -206,7 +208,7 @@ _test_valid(const char* obj_spec_str,
 	ck_assert_int_eq(obj_spec_parse(&o, obj_spec_str), 0);
 	as_record_init(&rec, obj_spec_n_bins(&o));
 	ck_assert_int_eq(obj_spec_populate_bins(&o, &rec, &random,
-				"test", write_bins, n_write_bins, 1.f), 0);
+				"test", write_bins, n_write_bins, 1.f, NULL), 0);
 	_dbg_obj_spec_assert_valid(&o, &rec, write_bins, n_write_bins, "test");
 
 	val = obj_spec_gen_value(&o, &random2, write_bins, n_write_bins);
@@ -314,6 +316,37 @@ DEFINE_FAILING_TCASE(test_Bneg1, "B-1", "negative-length binary data are not all
 DEFINE_FAILING_TCASE(test_B4294967296, "B4294967296", "this is beyond the max "
 		"allowed binary data length (2^32 - 1)");
 
+/*
+ * Length distribution test cases
+ */
+
+DEFINE_TCASE(test_S_range, "S10-20");
+DEFINE_TCASE(test_B_range, "B0-100");
+DEFINE_TCASE(test_B_range_single, "B7-7");
+DEFINE_TCASE(test_B_normal, "B~n(1000,100)");
+DEFINE_TCASE(test_S_normal_zero_stddev, "S~n(16,0)");
+DEFINE_TCASE(test_B_lognormal, "B~ln(1000,0.5)");
+DEFINE_TCASE(test_S_lognormal, "S~ln(20,1)");
+DEFINE_TCASE(test_list_range, "[3*B10-20,S~n(8,2)]");
+DEFINE_TCASE(test_map_range, "{5*S1-4:B~ln(10,0.2)}");
+DEFINE_TCASE(test_multi_range, "B10-20, I2, S~n(100,10)");
+DEFINE_FAILING_TCASE(test_B_range_reversed, "B20-10", "range max is below min");
+DEFINE_FAILING_TCASE(test_B_range_dangling, "B10-", "range needs a max");
+DEFINE_FAILING_TCASE(test_S_range_too_large, "S10-4294967296", "this is beyond "
+		"the max allowed string length (2^32 - 1)");
+DEFINE_FAILING_TCASE(test_B_dist_unknown, "B~x(1,2)", "unknown distribution");
+DEFINE_FAILING_TCASE(test_B_dist_no_paren, "B~n", "distribution needs parameters");
+DEFINE_FAILING_TCASE(test_B_normal_one_param, "B~n(1000)", "normal needs a stddev");
+DEFINE_FAILING_TCASE(test_B_normal_unclosed, "B~n(1000,10", "missing ')'");
+DEFINE_FAILING_TCASE(test_B_normal_neg, "B~n(-10,2)", "negative mean");
+DEFINE_FAILING_TCASE(test_B_normal_too_large, "B~n(4294967295,100)",
+		"the upper tail is beyond the max allowed length (2^32 - 1)");
+DEFINE_FAILING_TCASE(test_B_lognormal_zero, "B~ln(0,1)", "lognormal median "
+		"must be positive");
+DEFINE_FAILING_TCASE(test_B_file_empty_path, "B~f()", "file needs a path");
+DEFINE_FAILING_TCASE(test_B_file_missing, "B~f(/nonexistent/len_dist)",
+		"file does not exist");
+
 /*
  * Constants test cases
  */
@@ -578,6 +611,275 @@ DEFINE_TCASE_WRITE_BINS(test_wb_repeats, "30*I3, 27*S10, D, I1, I2, b, I5, 10*[5
 		((uint32_t[]) { 14, 27, 30, 56, 57, 59, 63, 66, 71 }), 9);
 
 
+/*
+ * Generation plan test cases
+ */
+extern as_val* bin_spec_random_val(const struct bin_spec_s* bin_spec,
+		as_random* random, float compression_ratio);
+extern as_val* _plan_gen_val(const struct gen_plan_s* plan, uint32_t root,
+		as_random* random, float compression_ratio, uint64_t* size);
+
+/*
+ * checks that the generation plan produces exactly the same values as the
+ * recursive generator, consuming the same random numbers
+ */
+static void
+_test_plan_matches(const char* obj_spec_str)
+{
+	struct obj_spec_s o;
+	as_random random, random2;
+
+	as_random_init(&random);
+	memcpy(&random2, &random, sizeof(as_random));
+
+	ck_assert_int_eq(obj_spec_parse(&o, obj_spec_str), 0);
+	for (uint32_t iter = 0; iter < 100; iter++) {
+		for (uint32_t i = 0, cnt = 0; cnt < o.n_bin_specs; i++) {
+			const struct bin_spec_s* bin_spec = &o.bin_specs[i];
+
+			for (uint32_t j = 0; j < bin_spec->n_repeats; j++, cnt++) {
+				uint64_t size = 0;
+				as_val* expected = bin_spec_random_val(bin_spec, &random, 0.5f);
+				as_val* val = _plan_gen_val(o.plan, o.plan->bins[cnt].op,
+						&random2, 0.5f, &size);
+
+				ck_assert_ptr_nonnull(val);
+				ck_assert(as_val_cmp(val, expected) == MSGPACK_COMPARE_EQUAL);
+				ck_assert_uint_eq(size, obj_spec_val_size(val));
+				as_val_destroy(expected);
+				as_val_destroy(val);
+			}
+		}
+		ck_assert_int_eq(memcmp(&random, &random2, sizeof(as_random)), 0);
+	}
+	obj_spec_free(&o);
+}
+
+#define DEFINE_PLAN_TCASE(test_name, obj_spec_str) \
+START_TEST(test_name) \
+{ \
+	_test_plan_matches(obj_spec_str); \
+} \
+END_TEST
+
+DEFINE_PLAN_TCASE(test_plan_scalars, "b, I3, S10, B20, D, 5*I1");
+DEFINE_PLAN_TCASE(test_plan_len_dist, "S4-12, B~n(20,5), 3*S~ln(10,0.5)");
+DEFINE_PLAN_TCASE(test_plan_consts, "\"abc\", 12, 1.5, true, [1,\"x\"], {1:2}");
+DEFINE_PLAN_TCASE(test_plan_list, "[I4,D,B100]");
+DEFINE_PLAN_TCASE(test_plan_empty, "[], {}, [[],{}]");
+DEFINE_PLAN_TCASE(test_plan_nested, "[{S10:[I4,D,B100]}], [[[S1,[I1]]]]");
+DEFINE_PLAN_TCASE(test_plan_repeats, "2*[5*I1,3*I2,100*S3], 3*[2*[I1,b]]");
+DEFINE_PLAN_TCASE(test_plan_map_entries, "{5*S1-4:B~ln(10,0.2),I1:[S2,b]}");
+// small keyspaces force duplicate keys, and eventually running out of retries
+DEFINE_PLAN_TCASE(test_plan_dup_keys, "30*{I1:[5*S20]}, {300*I1:I2}, {20*S1:{I1:b}}");
+
+START_TEST(test_plan_bin_names)
+{
+	struct obj_spec_s o;
+	as_record rec;
+	uint32_t write_bins[] = { 0, 1, 9, 10, 11 };
+
+	ck_assert_int_eq(obj_spec_parse(&o, "I1, 10*S1, [b]"), 0);
+	as_record_init(&rec, 5);
+	ck_assert_int_eq(obj_spec_populate_bins(&o, &rec, as_random_instance(),
+				"abcdefghijkl", write_bins, 5, 1.f, NULL), 0);
+	ck_assert_ptr_nonnull(as_record_get(&rec, "abcdefghijkl"));
+	ck_assert_ptr_nonnull(as_record_get(&rec, "abcdefghijkl_2"));
+	ck_assert_ptr_nonnull(as_record_get(&rec, "abcdefghijkl_10"));
+	ck_assert_ptr_nonnull(as_record_get(&rec, "abcdefghijkl_11"));
+	// truncated to fit in an as_bin_name, like gen_bin_name does
+	ck_assert_ptr_nonnull(as_record_get(&rec, "abcdefghijkl_12"));
+	_dbg_obj_spec_assert_valid(&o, &rec, write_bins, 5, "abcdefghijkl");
+	as_record_destroy(&rec);
+	obj_spec_free(&o);
+}
+END_TEST
+
+
+/*
+ * Packed value test cases
+ */
+
+/*
+ * checks that packing list/map bins straight to msgpack produces values that
+ * decode to exactly what the as_val path generates, consuming the same random
+ * numbers
+ */
+static void
+_test_packed_matches(const char* obj_spec_str, uint32_t* write_bins,
+		uint32_t n_write_bins)
+{
+	struct obj_spec_s o;
+	as_random random, random2;
+
+	as_random_init(&random);
+	memcpy(&random2, &random, sizeof(as_random));
+
+	ck_assert_int_eq(obj_spec_parse(&o, obj_spec_str), 0);
+	uint32_t n_bins = write_bins == NULL ? obj_spec_n_bins(&o) : n_write_bins;
+
+	for (uint32_t iter = 0; iter < 100; iter++) {
+		as_record expected, rec;
+		uint64_t size, packed_size;
+		uint64_t val_size = 0, packed_val_size = 0;
+
+		as_record_init(&expected, n_bins);
+		as_record_init(&rec, n_bins);
+		ck_assert_int_eq(obj_spec_populate_bins(&o, &expected, &random,
+					"bin", write_bins, n_write_bins, 0.5f, &size), 0);
+		ck_assert_int_eq(obj_spec_populate_packed_bins(&o, &rec, &random2,
+					"bin", write_bins, n_write_bins, 0.5f, &packed_size), 0);
+		ck_assert_int_eq(memcmp(&random, &random2, sizeof(as_random)), 0);
+		ck_assert_uint_eq(rec.bins.size, expected.bins.size);
+
+		// the sizes tallied while generating match the values generated
+		for (uint32_t i = 0; i < expected.bins.size; i++) {
+			val_size += obj_spec_val_size(
+					(as_val*) expected.bins.entries[i].valuep);
+			packed_val_size += obj_spec_val_size(
+					(as_val*) rec.bins.entries[i].valuep);
+		}
+		ck_assert_uint_eq(size, val_size);
+		ck_assert_uint_eq(packed_size, packed_val_size);
+
+		for (uint32_t i = 0; i < expected.bins.size; i++) {
+			as_val* val = (as_val*) rec.bins.entries[i].valuep;
+			as_val* exp_val = (as_val*) expected.bins.entries[i].valuep;
+			as_val_t type = as_val_type(exp_val);
+
+			ck_assert_str_eq(rec.bins.entries[i].name,
+					expected.bins.entries[i].name);
+			if (as_val_type(val) == AS_BYTES &&
+					(type == AS_LIST || type == AS_MAP)) {
+				as_bytes* bytes = as_bytes_fromval(val);
+				as_unpacker pk = { .buffer = as_bytes_get(bytes), .offset = 0,
+					.length = as_bytes_size(bytes) };
+				as_val* unpacked;
+
+				ck_assert_int_eq(bytes->type,
+						type == AS_LIST ? AS_BYTES_LIST : AS_BYTES_MAP);
+				ck_assert_int_eq(as_unpack_val(&pk, &unpacked), 0);
+				ck_assert_uint_eq(pk.offset, pk.length);
+				ck_assert(as_val_cmp(unpacked, exp_val) == MSGPACK_COMPARE_EQUAL);
+				as_val_destroy(unpacked);
+			}
+			else {
+				// scalars and constants are left as they are
+				ck_assert_int_eq(as_val_type(val), type);
+				ck_assert(as_val_cmp(val, exp_val) == MSGPACK_COMPARE_EQUAL);
+			}
+		}
+		as_record_destroy(&expected);
+		as_record_destroy(&rec);
+	}
+	obj_spec_free(&o);
+}
+
+#define DEFINE_PACKED_TCASE(test_name, obj_spec_str) \
+START_TEST(test_name) \
+{ \
+	_test_packed_matches(obj_spec_str, NULL, 0); \
+} \
+END_TEST
+
+DEFINE_PACKED_TCASE(test_packed_scalars, "b, I3, S10, B20, D");
+DEFINE_PACKED_TCASE(test_packed_list, "[b,I1,I2,I3,I4,I5,I6,I7,I8,S10,B20,D]");
+DEFINE_PACKED_TCASE(test_packed_empty, "[], {}, [[],{}], {I1:[]}");
+DEFINE_PACKED_TCASE(test_packed_consts, "[1,\"x\"], {1:2}, [[1,2],{\"a\":[3]},true,1.5]");
+DEFINE_PACKED_TCASE(test_packed_len_dist, "[S4-12,B~n(20,5),3*S~ln(10,0.5)], {5*S1-8:B0-30}");
+DEFINE_PACKED_TCASE(test_packed_map, "{S10:B20}, {5*I4:S5,3*S3:[I1,b]}, {10*B2:b}");
+DEFINE_PACKED_TCASE(test_packed_nested, "[{S10:[I4,D,B100]}], [[[S1,[I1]]]], {I2:{I2:{I2:S4}}}");
+// large lists/maps need the wider headers
+DEFINE_PACKED_TCASE(test_packed_large, "[100*I1], {200*I4:S1}, [20*[20*b]]");
+// small keyspaces force duplicate keys, and eventually running out of retries
+DEFINE_PACKED_TCASE(test_packed_dup_keys, "30*{I1:[5*S20]}, {300*I1:I2}, {20*S1:{I1:b}}");
+
+START_TEST(test_packed_write_bins)
+{
+	_test_packed_matches("I1, [S2,b], {I1:D}, 3*[I2], {S3:[I1]}",
+			(uint32_t[]) { 1, 3, 6 }, 3);
+}
+END_TEST
+
+
+/*
+ * Compressible bytes test cases
+ */
+extern void _fill_random_bytes(uint8_t* buf, uint32_t length,
+		as_random* random, float compression_ratio);
+
+#define COMPRESS_TEST_LEN (256 * 1024)
+
+/*
+ * checks that zlib compresses the generated bytes to about the requested
+ * ratio
+ */
+static void
+_test_compression_ratio(float compression_ratio)
+{
+	as_random random;
+	uint8_t* buf = (uint8_t*) cf_malloc(COMPRESS_TEST_LEN);
+	uLongf c_len = compressBound(COMPRESS_TEST_LEN);
+	uint8_t* c_buf = (uint8_t*) cf_malloc(c_len);
+
+	as_random_init(&random);
+	_fill_random_bytes(buf, COMPRESS_TEST_LEN, &random, compression_ratio);
+	ck_assert_int_eq(compress2(c_buf, &c_len, buf, COMPRESS_TEST_LEN,
+				Z_DEFAULT_COMPRESSION), Z_OK);
+	ck_assert_double_eq_tol((double) c_len / COMPRESS_TEST_LEN,
+			compression_ratio, 0.03);
+
+	cf_free(buf);
+	cf_free(c_buf);
+}
+
+#define DEFINE_COMPRESSION_TCASE(test_name, compression_ratio) \
+START_TEST(test_name) \
+{ \
+	_test_compression_ratio(compression_ratio); \
+} \
+END_TEST
+
+DEFINE_COMPRESSION_TCASE(test_compress_10, 0.1f);
+DEFINE_COMPRESSION_TCASE(test_compress_25, 0.25f);
+DEFINE_COMPRESSION_TCASE(test_compress_50, 0.5f);
+DEFINE_COMPRESSION_TCASE(test_compress_75, 0.75f);
+DEFINE_COMPRESSION_TCASE(test_compress_100, 1.f);
+
+START_TEST(test_compress_no_zero_fill)
+{
+	as_random random;
+	uint8_t buf[4096];
+	uint32_t n_zeros = 0;
+
+	as_random_init(&random);
+	_fill_random_bytes(buf, sizeof(buf), &random, 0.1f);
+	for (uint32_t i = 0; i < sizeof(buf); i++) {
+		n_zeros += buf[i] == 0;
+	}
+	// no more zeros than random bytes would have
+	ck_assert_uint_lt(n_zeros, 2 * sizeof(buf) / 256);
+}
+END_TEST
+
+START_TEST(test_compress_short)
+{
+	as_random random;
+	uint8_t buf[600];
+
+	as_random_init(&random);
+	for (uint32_t len = 0; len <= sizeof(buf); len++) {
+		memset(buf, 0, sizeof(buf));
+		_fill_random_bytes(buf, len, &random, 0.3f);
+		// nothing is written past the end
+		for (uint32_t i = len; i < sizeof(buf); i++) {
+			ck_assert_uint_eq(buf[i], 0);
+		}
+	}
+}
+END_TEST
+
+
 /*
  * Bin name test cases
  */
@@ -644,6 +946,7 @@ obj_spec_suite(void)
 	Suite* s;
 	TCase* tc_memory;
 	TCase* tc_simple;
+	TCase* tc_len_dist;
 	TCase* tc_constants;
 	TCase* tc_list;
 	TCase* tc_map;
@@ -653,6 +956,9 @@ obj_spec_suite(void)
 	TCase* tc_const_colx;
 	TCase* tc_multipliers;
 	TCase* tc_write_bins;
+	TCase* tc_plan;
+	TCase* tc_packed;
+	TCase* tc_compress;
 	TCase* tc_bin_names;
 	TCase* tc_spacing;
 
@@ -714,6 +1020,32 @@ obj_spec_suite(void)
 	tcase_add_ftest(tc_simple, test_B4294967296);
 	suite_add_tcase(s, tc_simple);
 
+	tc_len_dist = tcase_create("Length distributions");
+	tcase_add_checked_fixture(tc_len_dist, simple_setup, simple_teardown);
+	tcase_add_ptest(tc_len_dist, test_S_range);
+	tcase_add_ptest(tc_len_dist, test_B_range);
+	tcase_add_ptest(tc_len_dist, test_B_range_single);
+	tcase_add_ptest(tc_len_dist, test_B_normal);
+	tcase_add_ptest(tc_len_dist, test_S_normal_zero_stddev);
+	tcase_add_ptest(tc_len_dist, test_B_lognormal);
+	tcase_add_ptest(tc_len_dist, test_S_lognormal);
+	tcase_add_ptest(tc_len_dist, test_list_range);
+	tcase_add_ptest(tc_len_dist, test_map_range);
+	tcase_add_ptest(tc_len_dist, test_multi_range);
+	tcase_add_ftest(tc_len_dist, test_B_range_reversed);
+	tcase_add_ftest(tc_len_dist, test_B_range_dangling);
+	tcase_add_ftest(tc_len_dist, test_S_range_too_large);
+	tcase_add_ftest(tc_len_dist, test_B_dist_unknown);
+	tcase_add_ftest(tc_len_dist, test_B_dist_no_paren);
+	tcase_add_ftest(tc_len_dist, test_B_normal_one_param);
+	tcase_add_ftest(tc_len_dist, test_B_normal_unclosed);
+	tcase_add_ftest(tc_len_dist, test_B_normal_neg);
+	tcase_add_ftest(tc_len_dist, test_B_normal_too_large);
+	tcase_add_ftest(tc_len_dist, test_B_lognormal_zero);
+	tcase_add_ftest(tc_len_dist, test_B_file_empty_path);
+	tcase_add_ftest(tc_len_dist, test_B_file_missing);
+	suite_add_tcase(s, tc_len_dist);
+
 	tc_constants = tcase_create("Constants");
 	tcase_add_checked_fixture(tc_constants, simple_setup, simple_teardown);
 	tcase_add_ptest(tc_constants, test_const_b_true);
@@ -932,6 +1264,44 @@ obj_spec_suite(void)
 	tcase_add_ptest(tc_write_bins, test_wb_repeats);
 	suite_add_tcase(s, tc_write_bins);
 
+	tc_plan = tcase_create("Generation plan");
+	tcase_add_checked_fixture(tc_plan, simple_setup, simple_teardown);
+	tcase_add_test(tc_plan, test_plan_scalars);
+	tcase_add_test(tc_plan, test_plan_len_dist);
+	tcase_add_test(tc_plan, test_plan_consts);
+	tcase_add_test(tc_plan, test_plan_list);
+	tcase_add_test(tc_plan, test_plan_empty);
+	tcase_add_test(tc_plan, test_plan_nested);
+	tcase_add_test(tc_plan, test_plan_repeats);
+	tcase_add_test(tc_plan, test_plan_map_entries);
+	tcase_add_test(tc_plan, test_plan_dup_keys);
+	tcase_add_test(tc_plan, test_plan_bin_names);
+	suite_add_tcase(s, tc_plan);
+
+	tc_packed = tcase_create("Packed values");
+	tcase_add_checked_fixture(tc_packed, simple_setup, simple_teardown);
+	tcase_add_test(tc_packed, test_packed_scalars);
+	tcase_add_test(tc_packed, test_packed_list);
+	tcase_add_test(tc_packed, test_packed_empty);
+	tcase_add_test(tc_packed, test_packed_consts);
+	tcase_add_test(tc_packed, test_packed_len_dist);
+	tcase_add_test(tc_packed, test_packed_map);
+	tcase_add_test(tc_packed, test_packed_nested);
+	tcase_add_test(tc_packed, test_packed_large);
+	tcase_add_test(tc_packed, test_packed_dup_keys);
+	tcase_add_test(tc_packed, test_packed_write_bins);
+	suite_add_tcase(s, tc_packed);
+
+	tc_compress = tcase_create("Compressible bytes");
+	tcase_add_test(tc_compress, test_compress_10);
+	tcase_add_test(tc_compress, test_compress_25);
+	tcase_add_test(tc_compress, test_compress_50);
+	tcase_add_test(tc_compress, test_compress_75);
+	tcase_add_test(tc_compress, test_compress_100);
+	tcase_add_test(tc_compress, test_compress_no_zero_fill);
+	tcase_add_test(tc_compress, test_compress_short);
+	suite_add_tcase(s, tc_compress);
+
 	tc_bin_names = tcase_create("Bin names");
 	tcase_add_checked_fixture(tc_bin_names, simple_setup, simple_teardown);
 	tcase_add_test(tc_bin_names, bin_name_single_ok);
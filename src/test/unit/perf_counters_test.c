@@ -0,0 +1,129 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common.h>
+#include <perf_counters.h>
+
+
+#define TEST_SUITE_NAME "perf counters"
+
+#define N_ITERS 100000
+
+
+static uint64_t
+busy_loop(void)
+{
+	volatile uint64_t sum = 0;
+	for (uint64_t i = 0; i < N_ITERS; i++) {
+		sum += i;
+	}
+	return sum;
+}
+
+static uint64_t
+total_count(perf_counters_t* pc, perf_op_t op)
+{
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < pc->n_threads; i++) {
+		count += pc->threads[i]->ops[op].count;
+	}
+	return count;
+}
+
+
+/*
+ * without counters (no PMU in a VM or container, or not Linux), everything
+ * must quietly do nothing
+ */
+START_TEST(degrades_gracefully)
+{
+	perf_counters_t* pc = perf_counters_create(1);
+
+	if (perf_counters_thread_init(pc)) {
+		perf_counters_free(pc);
+		return;
+	}
+	ck_assert(pc->unavailable);
+	ck_assert_uint_eq(pc->n_threads, 0);
+
+	// later threads don't even try
+	ck_assert(!perf_counters_thread_init(pc));
+
+	perf_counters_begin(pc);
+	busy_loop();
+	perf_counters_end(pc, PERF_OP_READ);
+	perf_counters_print_period(pc);
+
+	perf_counters_free(pc);
+}
+END_TEST
+
+START_TEST(measures_transactions)
+{
+	perf_counters_t* pc = perf_counters_create(1);
+
+	if (!perf_counters_thread_init(pc)) {
+		perf_counters_free(pc);
+		return;
+	}
+
+	perf_counters_begin(pc);
+	busy_loop();
+	perf_counters_end(pc, PERF_OP_WRITE);
+
+	struct perf_op_stats_s* stats = &pc->threads[0]->ops[PERF_OP_WRITE];
+	ck_assert_uint_eq(stats->count, 1);
+	ck_assert_uint_ge(stats->events[PERF_EV_INSTRUCTIONS], N_ITERS);
+	ck_assert_uint_gt(stats->events[PERF_EV_CYCLES], 0);
+	ck_assert_uint_eq(total_count(pc, PERF_OP_READ), 0);
+
+	// an end without a begin isn't measured
+	perf_counters_end(pc, PERF_OP_WRITE);
+	ck_assert_uint_eq(stats->count, 1);
+
+	perf_counters_print_period(pc);
+	ck_assert_uint_eq(stats->count, 0);
+
+	perf_counters_free(pc);
+}
+END_TEST
+
+START_TEST(sampling)
+{
+	perf_counters_t* pc = perf_counters_create(4);
+
+	if (!perf_counters_thread_init(pc)) {
+		perf_counters_free(pc);
+		return;
+	}
+
+	for (uint32_t i = 0; i < 20; i++) {
+		perf_counters_begin(pc);
+		perf_counters_end(pc, PERF_OP_UDF);
+	}
+	ck_assert_uint_eq(total_count(pc, PERF_OP_UDF), 5);
+
+	perf_counters_free(pc);
+}
+END_TEST
+
+
+Suite*
+perf_counters_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Perf Counters");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, degrades_gracefully);
+	tcase_add_test(tc_core, measures_transactions);
+	tcase_add_test(tc_core, sampling);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,196 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <proc_stats.h>
+
+
+#define TEST_SUITE_NAME "proc stats"
+
+
+static const bool writes_only[GROUP_OP_COUNT] = {
+	[GROUP_OP_WRITE] = true
+};
+
+// nothing done while warming up
+static const struct interval_counts_s none[GROUP_OP_COUNT];
+
+/*
+ * waits for the child and checks it succeeded
+ */
+static void
+join(pid_t pid)
+{
+	int status;
+
+	ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+	ck_assert(WIFEXITED(status));
+	ck_assert_int_eq(WEXITSTATUS(status), 0);
+}
+
+
+START_TEST(create)
+{
+	proc_stats_t* stats = proc_stats_create(3, writes_only);
+	ck_assert_ptr_nonnull(stats);
+
+	// only the ops the run does get histograms
+	for (uint32_t i = 0; i < 3; i++) {
+		proc_slot_t* slot = proc_stats_slot(stats, i);
+
+		ck_assert_ptr_null(slot->hdrs[GROUP_OP_READ]);
+		ck_assert_ptr_nonnull(slot->hdrs[GROUP_OP_WRITE]);
+		ck_assert_ptr_null(slot->hdrs[GROUP_OP_UDF]);
+		ck_assert_int_eq(hdr_total_count(slot->hdrs[GROUP_OP_WRITE]), 0);
+	}
+
+	// and they don't overlap
+	hdr_record_value(proc_stats_slot(stats, 1)->hdrs[GROUP_OP_WRITE], 1000000);
+	ck_assert_int_eq(hdr_total_count(
+				proc_stats_slot(stats, 0)->hdrs[GROUP_OP_WRITE]), 0);
+	ck_assert_int_eq(hdr_total_count(
+				proc_stats_slot(stats, 2)->hdrs[GROUP_OP_WRITE]), 0);
+
+	proc_stats_free(stats);
+}
+END_TEST
+
+START_TEST(sum)
+{
+	proc_stats_t* stats = proc_stats_create(2, writes_only);
+	struct interval_counts_s counts[GROUP_OP_COUNT] = {
+		[GROUP_OP_WRITE] = { .ok = 10, .timeouts = 1, .bytes = 100 }
+	};
+	struct interval_counts_s warmup_counts[GROUP_OP_COUNT] = {
+		[GROUP_OP_WRITE] = { .ok = 5, .bytes = 50 }
+	};
+
+	proc_stats_publish(proc_stats_slot(stats, 0), counts, none);
+	proc_stats_publish(proc_stats_slot(stats, 0), counts, warmup_counts);
+	counts[GROUP_OP_WRITE].errors = 2;
+	proc_stats_publish(proc_stats_slot(stats, 1), counts, warmup_counts);
+
+	proc_stats_sum(stats, counts);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].ok, 30);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].timeouts, 3);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].errors, 2);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].bytes, 300);
+	ck_assert_uint_eq(counts[GROUP_OP_READ].ok, 0);
+
+	// the warmups are kept apart
+	proc_stats_sum_warmup(stats, warmup_counts);
+	ck_assert_uint_eq(warmup_counts[GROUP_OP_WRITE].ok, 10);
+	ck_assert_uint_eq(warmup_counts[GROUP_OP_WRITE].timeouts, 0);
+	ck_assert_uint_eq(warmup_counts[GROUP_OP_WRITE].bytes, 100);
+
+	proc_stats_free(stats);
+}
+END_TEST
+
+START_TEST(shared_between_processes)
+{
+	proc_stats_t* stats = proc_stats_create(2, writes_only);
+	pid_t pids[2];
+
+	for (uint32_t i = 0; i < 2; i++) {
+		pids[i] = fork();
+		ck_assert_int_ge(pids[i], 0);
+
+		if (pids[i] == 0) {
+			proc_slot_t* slot = proc_stats_slot(stats, i);
+			struct interval_counts_s counts[GROUP_OP_COUNT] = {
+				[GROUP_OP_WRITE] = { .ok = 100 }
+			};
+
+			for (uint32_t j = 0; j < 100; j++) {
+				hdr_record_value_atomic(slot->hdrs[GROUP_OP_WRITE],
+						(i + 1) * 100);
+			}
+			proc_stats_publish(slot, counts, none);
+			_exit(0);
+		}
+	}
+	join(pids[0]);
+	join(pids[1]);
+
+	// what the children recorded is visible to the parent
+	struct interval_counts_s counts[GROUP_OP_COUNT];
+	proc_stats_sum(stats, counts);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].ok, 200);
+
+	struct hdr_histogram* h;
+	hdr_init(1, 1000000, 3, &h);
+	hdr_record_value(h, 5);
+	proc_stats_merge_hdr(stats, GROUP_OP_WRITE, h);
+	ck_assert_int_eq(hdr_total_count(h), 200);
+	ck_assert_int_eq(hdr_min(h), 100);
+	ck_assert_int_eq(hdr_max(h), 200);
+	ck_assert_int_eq(hdr_value_at_percentile(h, 50), 100);
+	hdr_close(h);
+
+	proc_stats_free(stats);
+}
+END_TEST
+
+START_TEST(stage_barrier)
+{
+	proc_stats_t* stats = proc_stats_create(2, writes_only);
+
+	ck_assert(!proc_stats_all_ready(stats, 0));
+
+	// one process is waiting, the other hasn't got there yet
+	pid_t pid = fork();
+	ck_assert_int_ge(pid, 0);
+	if (pid == 0) {
+		proc_stats_wait_stage(stats, 0, 0);
+		proc_stats_wait_stage(stats, 0, 3);
+		_exit(0);
+	}
+
+	while (atomic_load(&proc_stats_slot(stats, 0)->ready) != 1) {
+		usleep(1000);
+	}
+	ck_assert(!proc_stats_all_ready(stats, 0));
+
+	atomic_store(&proc_stats_slot(stats, 1)->ready, 1);
+	ck_assert(proc_stats_all_ready(stats, 0));
+
+	// released from the first stage, the child moves on to wait for the next
+	proc_stats_release(stats, 0);
+	while (atomic_load(&proc_stats_slot(stats, 0)->ready) != 4) {
+		usleep(1000);
+	}
+	ck_assert(!proc_stats_all_ready(stats, 3));
+
+	atomic_store(&proc_stats_slot(stats, 1)->ready, 4);
+	ck_assert(proc_stats_all_ready(stats, 3));
+	proc_stats_release(stats, 3);
+	join(pid);
+
+	proc_stats_free(stats);
+}
+END_TEST
+
+
+Suite*
+proc_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Proc Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, create);
+	tcase_add_test(tc_core, sum);
+	tcase_add_test(tc_core, shared_between_processes);
+	tcase_add_test(tc_core, stage_barrier);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
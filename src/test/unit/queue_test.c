@@ -0,0 +1,176 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <queue.h>
+
+
+#define TEST_SUITE_NAME "queue"
+
+
+struct delayed_push_s {
+	queue_t* q;
+	void* item;
+	uint32_t delay_us;
+};
+
+static void*
+delayed_push(void* udata)
+{
+	struct delayed_push_s* args = (struct delayed_push_s*) udata;
+
+	usleep(args->delay_us);
+	queue_push(args->q, args->item);
+	return NULL;
+}
+
+static void*
+push_many(void* udata)
+{
+	queue_t* q = (queue_t*) udata;
+
+	for (uintptr_t i = 1; i <= 100000; i++) {
+		queue_push(q, (void*) i);
+		// give the popper a chance to run dry every so often
+		if (i % 1000 == 0) {
+			usleep(100);
+		}
+	}
+	return NULL;
+}
+
+
+START_TEST(push_pop)
+{
+	queue_t q;
+	int items[3];
+
+	ck_assert_int_eq(queue_init(&q, 3), 0);
+	ck_assert_ptr_eq(queue_pop(&q), NULL);
+
+	for (uint32_t i = 0; i < 3; i++) {
+		queue_push(&q, &items[i]);
+	}
+	for (uint32_t i = 0; i < 3; i++) {
+		ck_assert_ptr_eq(queue_pop(&q), &items[i]);
+	}
+	ck_assert_ptr_eq(queue_pop(&q), NULL);
+
+	queue_free(&q);
+}
+END_TEST
+
+START_TEST(pop_wait_ready)
+{
+	queue_t q;
+	queue_wait_t wait;
+	int item;
+
+	queue_init(&q, 1);
+	queue_push(&q, &item);
+	ck_assert_ptr_eq(queue_pop_wait(&q, &wait), &item);
+	ck_assert_int_eq(wait, QUEUE_WAIT_NONE);
+	ck_assert_uint_eq(q.spin_limit, QUEUE_SPIN_MIN);
+
+	queue_free(&q);
+}
+END_TEST
+
+START_TEST(pop_wait_parked)
+{
+	queue_t q;
+	queue_wait_t wait;
+	pthread_t thread;
+	int item;
+
+	queue_init(&q, 1);
+	q.spin_limit = QUEUE_SPIN_MIN * 4;
+
+	// far longer than the popper polls for
+	struct delayed_push_s args = { &q, &item, 100000 };
+	pthread_create(&thread, NULL, delayed_push, &args);
+	ck_assert_ptr_eq(queue_pop_wait(&q, &wait), &item);
+	pthread_join(thread, NULL);
+
+	ck_assert_int_eq(wait, QUEUE_WAIT_PARKED);
+	ck_assert_uint_eq(q.waiting, 0);
+	// it polls for less after a wasted poll
+	ck_assert_uint_eq(q.spin_limit, QUEUE_SPIN_MIN * 2);
+
+	queue_free(&q);
+}
+END_TEST
+
+START_TEST(spin_limit_bounds)
+{
+	queue_t q;
+	pthread_t thread;
+	int item;
+
+	queue_init(&q, 1);
+
+	// parking never takes the limit below the minimum
+	struct delayed_push_s args = { &q, &item, 10000 };
+	pthread_create(&thread, NULL, delayed_push, &args);
+	queue_pop_wait(&q, NULL);
+	pthread_join(thread, NULL);
+	ck_assert_uint_eq(q.spin_limit, QUEUE_SPIN_MIN);
+
+	queue_free(&q);
+}
+END_TEST
+
+/*
+ * every item pushed is popped exactly once, whether the popper is polling or
+ * parked when it arrives
+ */
+START_TEST(pop_wait_stress)
+{
+	queue_t q;
+	pthread_t thread;
+	uint32_t waits[3] = { 0 };
+
+	queue_init(&q, 100000);
+	pthread_create(&thread, NULL, push_many, &q);
+
+	for (uintptr_t i = 1; i <= 100000; i++) {
+		queue_wait_t wait;
+		ck_assert_uint_eq((uintptr_t) queue_pop_wait(&q, &wait), i);
+		waits[wait]++;
+		ck_assert_uint_ge(q.spin_limit, QUEUE_SPIN_MIN);
+		ck_assert_uint_le(q.spin_limit, QUEUE_SPIN_MAX);
+	}
+	pthread_join(thread, NULL);
+
+	ck_assert_ptr_eq(queue_pop(&q), NULL);
+	ck_assert_uint_gt(waits[QUEUE_WAIT_NONE], 0);
+
+	queue_free(&q);
+}
+END_TEST
+
+
+Suite*
+queue_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Queue");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, push_pop);
+	tcase_add_test(tc_core, pop_wait_ready);
+	tcase_add_test(tc_core, pop_wait_parked);
+	tcase_add_test(tc_core, spin_limit_bounds);
+	tcase_add_test(tc_core, pop_wait_stress);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,273 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <citrusleaf/cf_clock.h>
+
+#include <common.h>
+#include <self_stats.h>
+
+
+#define TEST_SUITE_NAME "self stats"
+
+// percentage points the measured breakdown may be off by
+#define TOLERANCE 2
+
+
+/*
+ * keeps the CPU busy for us microseconds
+ */
+static void
+spin_for(uint64_t us)
+{
+	uint64_t end = cf_getus() + us;
+	while (cf_getus() < end) {
+	}
+}
+
+/*
+ * enters phase and stays in it for about us microseconds, spinning or
+ * sleeping. Returns how long the thread actually spent in it
+ */
+static uint64_t
+timed_phase(self_stats_t* ss, self_phase_t phase, uint64_t us, bool spin)
+{
+	self_stats_enter(ss, phase);
+	uint64_t start = cf_getus();
+	if (spin) {
+		spin_for(us);
+	}
+	else {
+		usleep(us);
+	}
+	return cf_getus() - start;
+}
+
+static double
+pct(uint64_t part, uint64_t total)
+{
+	return 100. * part / total;
+}
+
+static void*
+gen_thread(void* udata)
+{
+	self_stats_t* ss = (self_stats_t*) udata;
+
+	timed_phase(ss, SELF_PHASE_GEN, 20000, true);
+	self_stats_enter(ss, SELF_PHASE_IDLE);
+	return NULL;
+}
+
+static void*
+client_thread(void* udata)
+{
+	self_stats_t* ss = (self_stats_t*) udata;
+
+	timed_phase(ss, SELF_PHASE_CLIENT, 20000, false);
+	self_stats_enter(ss, SELF_PHASE_IDLE);
+	return NULL;
+}
+
+
+START_TEST(phase_breakdown)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	uint64_t gen = timed_phase(ss, SELF_PHASE_GEN, 10000, true);
+	uint64_t client = timed_phase(ss, SELF_PHASE_CLIENT, 50000, false);
+	uint64_t record = timed_phase(ss, SELF_PHASE_RECORD, 10000, true);
+	uint64_t throttle = timed_phase(ss, SELF_PHASE_THROTTLE, 30000, false);
+	// time spent idle isn't part of the breakdown
+	timed_phase(ss, SELF_PHASE_IDLE, 100000, false);
+	uint64_t total = gen + client + record + throttle;
+
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_GEN],
+			pct(gen, total), TOLERANCE);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_CLIENT],
+			pct(client, total), TOLERANCE);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_RECORD],
+			pct(record, total), TOLERANCE);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_THROTTLE],
+			pct(throttle, total), TOLERANCE);
+	ck_assert_double_eq_tol(sample.max_gen_pct, pct(gen, total), TOLERANCE);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+/*
+ * a thread stuck in one phase shows up in the period it's stuck in, not only
+ * once it moves on
+ */
+START_TEST(current_phase)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	uint64_t gen = timed_phase(ss, SELF_PHASE_GEN, 10000, true);
+	uint64_t client = timed_phase(ss, SELF_PHASE_CLIENT, 30000, false);
+
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_GEN],
+			pct(gen, gen + client), TOLERANCE);
+
+	// the rest of the phase goes to the next period
+	usleep(10000);
+	self_stats_enter(ss, SELF_PHASE_IDLE);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_CLIENT], 100, 0.001);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+START_TEST(periods_reset)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	uint64_t gen = timed_phase(ss, SELF_PHASE_GEN, 10000, true);
+	self_stats_enter(ss, SELF_PHASE_IDLE);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_GEN], 100, 0.001);
+
+	// nothing happened since the last period
+	self_stats_sample(ss, false, &sample);
+	for (uint32_t p = 0; p < SELF_PHASE_IDLE; p++) {
+		ck_assert_double_eq(sample.phase_pct[p], 0);
+	}
+	ck_assert_double_eq(sample.max_gen_pct, 0);
+
+	uint64_t client = timed_phase(ss, SELF_PHASE_CLIENT, 10000, false);
+	self_stats_enter(ss, SELF_PHASE_IDLE);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_CLIENT], 100, 0.001);
+
+	// but the whole run is still there
+	self_stats_sample(ss, true, &sample);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_GEN],
+			pct(gen, gen + client), TOLERANCE);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+START_TEST(waits)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	self_stats_count_wait(ss, false);
+	self_stats_count_wait(ss, false);
+	self_stats_count_wait(ss, true);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_uint_eq(sample.spun_waits, 2);
+	ck_assert_uint_eq(sample.parked_waits, 1);
+
+	self_stats_count_wait(ss, true);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_uint_eq(sample.spun_waits, 0);
+	ck_assert_uint_eq(sample.parked_waits, 1);
+
+	self_stats_sample(ss, true, &sample);
+	ck_assert_uint_eq(sample.spun_waits, 2);
+	ck_assert_uint_eq(sample.parked_waits, 2);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+START_TEST(separate_threads)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	pthread_t threads[2];
+	pthread_create(&threads[0], NULL, gen_thread, ss);
+	pthread_create(&threads[1], NULL, client_thread, ss);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+	ck_assert_uint_eq(ss->n_threads, 2);
+
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_gt(sample.phase_pct[SELF_PHASE_GEN], 0);
+	ck_assert_double_gt(sample.phase_pct[SELF_PHASE_CLIENT], 0);
+	ck_assert_double_eq_tol(sample.phase_pct[SELF_PHASE_GEN] +
+			sample.phase_pct[SELF_PHASE_CLIENT], 100, 0.001);
+	// one of the threads did nothing but generate
+	ck_assert_double_eq_tol(sample.max_gen_pct, 100, 0.001);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+START_TEST(cpu_usage)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample;
+
+	spin_for(100000);
+	self_stats_sample(ss, false, &sample);
+	double busy_pct = sample.cpu_pct;
+
+	usleep(100000);
+	self_stats_sample(ss, false, &sample);
+	ck_assert_double_lt(sample.cpu_pct, busy_pct);
+	ck_assert_uint_ge(sample.voluntary_csw, 1);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+START_TEST(saturation)
+{
+	self_stats_t* ss = self_stats_create();
+	self_stats_sample_t sample = {
+		.phase_pct = { 10, 80, 5, 5 },
+		.cpu_pct = 10
+	};
+
+	ck_assert_int_eq(self_stats_saturation(ss, &sample),
+			SELF_SATURATION_NONE);
+
+	sample.phase_pct[SELF_PHASE_GEN] = 45;
+	sample.phase_pct[SELF_PHASE_CLIENT] = 45;
+	ck_assert_int_eq(self_stats_saturation(ss, &sample),
+			SELF_SATURATION_GEN);
+
+	sample.cpu_pct = 100. * ss->n_cpus;
+	ck_assert_int_eq(self_stats_saturation(ss, &sample),
+			SELF_SATURATION_CPU);
+
+	self_stats_free(ss);
+}
+END_TEST
+
+
+Suite*
+self_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Self Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, phase_breakdown);
+	tcase_add_test(tc_core, current_phase);
+	tcase_add_test(tc_core, periods_reset);
+	tcase_add_test(tc_core, waits);
+	tcase_add_test(tc_core, separate_threads);
+	tcase_add_test(tc_core, cpu_usage);
+	tcase_add_test(tc_core, saturation);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,227 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <slow_ops.h>
+
+
+#define TEST_SUITE_NAME "slow ops"
+
+#define N_THREADS 8
+#define N_PER_THREAD 10000
+#define MAX_ROWS 64
+
+struct row_s {
+	uint64_t interval;
+	char op[16];
+	uint64_t latency_us;
+	char key[32];
+	uint32_t batch_size;
+	int status;
+};
+
+struct thread_args_s {
+	slow_ops_t* so;
+	uint32_t t_idx;
+};
+
+
+static slow_ops_t*
+create_tmp(char* path, uint32_t k)
+{
+	strcpy(path, "/tmp/slow_ops_test_XXXXXX");
+	int fd = mkstemp(path);
+	ck_assert_int_ge(fd, 0);
+	close(fd);
+
+	slow_ops_t* so = slow_ops_create(path, k, NULL);
+	ck_assert_ptr_nonnull(so);
+	return so;
+}
+
+/*
+ * parses the rows written so far, skipping the header. Returns the number of
+ * rows
+ */
+static uint32_t
+read_rows(const char* path, struct row_s* rows)
+{
+	FILE* f = fopen(path, "r");
+	ck_assert_ptr_nonnull(f);
+
+	char line[256];
+	ck_assert_ptr_nonnull(fgets(line, sizeof(line), f));
+	ck_assert_str_eq(line, "interval,stage,start,op,latency_us,key,"
+			"batch_size,node,status\n");
+
+	uint32_t n = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char* fields[9];
+		char* p = line;
+		for (uint32_t i = 0; i < 9; i++) {
+			fields[i] = strsep(&p, ",");
+			ck_assert_ptr_nonnull(fields[i]);
+		}
+		ck_assert_uint_lt(n, MAX_ROWS);
+
+		struct row_s* row = &rows[n++];
+		row->interval = strtoull(fields[0], NULL, 10);
+		strcpy(row->op, fields[3]);
+		row->latency_us = strtoull(fields[4], NULL, 10);
+		strcpy(row->key, fields[5]);
+		row->batch_size = (uint32_t) strtoul(fields[6], NULL, 10);
+		row->status = atoi(fields[8]);
+	}
+	fclose(f);
+	return n;
+}
+
+static void*
+record_thread(void* udata)
+{
+	struct thread_args_s* args = (struct thread_args_s*) udata;
+
+	for (uint32_t i = 0; i < N_PER_THREAD; i++) {
+		// each latency is recorded by exactly one thread
+		slow_ops_record(args->so, SLOW_OP_READ, i * N_THREADS + args->t_idx,
+				AEROSPIKE_OK, 0, NULL);
+	}
+	return NULL;
+}
+
+
+START_TEST(keeps_slowest)
+{
+	char path[64];
+	slow_ops_t* so = create_tmp(path, 3);
+
+	static const uint64_t lats[] = { 50, 10, 400, 30, 70, 20, 300, 60 };
+	for (uint32_t i = 0; i < sizeof(lats) / sizeof(lats[0]); i++) {
+		slow_ops_record(so, SLOW_OP_WRITE, lats[i], AEROSPIKE_OK, 0, NULL);
+	}
+	slow_ops_dump(so, 0);
+
+	struct row_s rows[MAX_ROWS];
+	ck_assert_uint_eq(read_rows(path, rows), 3);
+	ck_assert_uint_eq(rows[0].latency_us, 400);
+	ck_assert_uint_eq(rows[1].latency_us, 300);
+	ck_assert_uint_eq(rows[2].latency_us, 70);
+	ck_assert_str_eq(rows[0].op, "write");
+
+	slow_ops_free(so);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(entry_fields)
+{
+	char path[64];
+	slow_ops_t* so = create_tmp(path, 4);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "testset", 1234);
+	slow_ops_record(so, SLOW_OP_UDF, 100, AEROSPIKE_ERR_TIMEOUT, 0, &key);
+	slow_ops_record(so, SLOW_OP_READ, 200, AEROSPIKE_OK, 16, NULL);
+	slow_ops_dump(so, 0);
+
+	struct row_s rows[MAX_ROWS];
+	ck_assert_uint_eq(read_rows(path, rows), 2);
+
+	ck_assert_str_eq(rows[0].op, "read");
+	ck_assert_str_eq(rows[0].key, "");
+	ck_assert_uint_eq(rows[0].batch_size, 16);
+	ck_assert_int_eq(rows[0].status, AEROSPIKE_OK);
+
+	ck_assert_str_eq(rows[1].op, "udf");
+	ck_assert_str_eq(rows[1].key, "1234");
+	ck_assert_uint_eq(rows[1].batch_size, 0);
+	ck_assert_int_eq(rows[1].status, AEROSPIKE_ERR_TIMEOUT);
+
+	slow_ops_free(so);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(intervals_separate)
+{
+	char path[64];
+	slow_ops_t* so = create_tmp(path, 2);
+
+	slow_ops_record(so, SLOW_OP_READ, 1000, AEROSPIKE_OK, 0, NULL);
+	slow_ops_dump(so, 0);
+
+	// the heap from the last interval is full of slower transactions, which
+	// mustn't shadow these ones
+	slow_ops_record(so, SLOW_OP_READ, 5, AEROSPIKE_OK, 0, NULL);
+	slow_ops_dump(so, 0);
+
+	// nothing recorded, and the heap of two intervals ago mustn't be dumped
+	// again
+	slow_ops_dump(so, 0);
+
+	struct row_s rows[MAX_ROWS];
+	ck_assert_uint_eq(read_rows(path, rows), 2);
+	ck_assert_uint_eq(rows[0].interval, 0);
+	ck_assert_uint_eq(rows[0].latency_us, 1000);
+	ck_assert_uint_eq(rows[1].interval, 1);
+	ck_assert_uint_eq(rows[1].latency_us, 5);
+
+	slow_ops_free(so);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(merges_threads)
+{
+	char path[64];
+	slow_ops_t* so = create_tmp(path, 5);
+
+	pthread_t threads[N_THREADS];
+	struct thread_args_s args[N_THREADS];
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		args[i].so = so;
+		args[i].t_idx = i;
+		pthread_create(&threads[i], NULL, record_thread, &args[i]);
+	}
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	ck_assert_uint_eq(so->n_reservoirs, N_THREADS);
+	slow_ops_dump(so, 0);
+
+	struct row_s rows[MAX_ROWS];
+	ck_assert_uint_eq(read_rows(path, rows), 5);
+	for (uint32_t i = 0; i < 5; i++) {
+		ck_assert_uint_eq(rows[i].latency_us,
+				N_PER_THREAD * N_THREADS - 1 - i);
+	}
+
+	slow_ops_free(so);
+	unlink(path);
+}
+END_TEST
+
+
+Suite*
+slow_ops_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Slow Ops");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, keeps_slowest);
+	tcase_add_test(tc_core, entry_fields);
+	tcase_add_test(tc_core, intervals_separate);
+	tcase_add_test(tc_core, merges_threads);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
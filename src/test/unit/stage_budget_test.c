@@ -0,0 +1,179 @@
+
+#include <check.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common.h>
+#include <stage_budget.h>
+
+
+#define TEST_SUITE_NAME "stage budget"
+
+#define N_THREADS 8
+
+
+struct take_ops_args_s {
+	stage_budget_t* budget;
+	uint64_t n_taken;
+};
+
+static void*
+take_ops(void* udata)
+{
+	struct take_ops_args_s* args = (struct take_ops_args_s*) udata;
+	budget_claim_t claim;
+
+	budget_claim_init(&claim);
+	args->n_taken = 0;
+	while (stage_budget_take_op(args->budget, &claim)) {
+		args->n_taken++;
+	}
+	return NULL;
+}
+
+
+START_TEST(unlimited)
+{
+	stage_budget_t budget;
+	budget_claim_t claim;
+
+	stage_budget_init(&budget, 0, 0);
+	budget_claim_init(&claim);
+	ck_assert(!stage_budget_limited(&budget));
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		ck_assert(stage_budget_take_op(&budget, &claim));
+		stage_budget_take_bytes(&budget, &claim, 1000000);
+	}
+	ck_assert(stage_budget_take_op(&budget, &claim));
+}
+END_TEST
+
+START_TEST(ops)
+{
+	stage_budget_t budget;
+	budget_claim_t claim;
+
+	// less than a chunk
+	stage_budget_init(&budget, 10, 0);
+	budget_claim_init(&claim);
+	ck_assert(stage_budget_limited(&budget));
+
+	for (uint32_t i = 0; i < 10; i++) {
+		ck_assert(stage_budget_take_op(&budget, &claim));
+	}
+	ck_assert(!stage_budget_take_op(&budget, &claim));
+	ck_assert(claim.spent);
+
+	// a fresh claim on a spent budget gets nothing
+	budget_claim_init(&claim);
+	ck_assert(!stage_budget_take_op(&budget, &claim));
+}
+END_TEST
+
+START_TEST(ops_threads)
+{
+	stage_budget_t budget;
+	pthread_t threads[N_THREADS];
+	struct take_ops_args_s args[N_THREADS];
+	uint64_t total = 0;
+
+	// not a multiple of the chunk size
+	stage_budget_init(&budget, 100003, 0);
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		args[i].budget = &budget;
+		pthread_create(&threads[i], NULL, take_ops, &args[i]);
+	}
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		total += args[i].n_taken;
+	}
+
+	// every thread used up what it claimed
+	ck_assert_uint_eq(total, 100003);
+}
+END_TEST
+
+START_TEST(bytes)
+{
+	stage_budget_t budget;
+	budget_claim_t writer;
+	budget_claim_t reader;
+
+	stage_budget_init(&budget, 0, 3 * STAGE_BUDGET_BYTES_CHUNK);
+	budget_claim_init(&writer);
+	budget_claim_init(&reader);
+
+	uint64_t written = 0;
+	while (stage_budget_take_op(&budget, &writer)) {
+		stage_budget_take_bytes(&budget, &writer, 1000);
+		written += 1000;
+	}
+
+	// the write that spends the budget still goes ahead
+	ck_assert_uint_ge(written, 3 * STAGE_BUDGET_BYTES_CHUNK);
+	ck_assert_uint_lt(written, 3 * STAGE_BUDGET_BYTES_CHUNK + 1000);
+
+	// and a thread that only reads stops with it
+	ck_assert(!stage_budget_take_op(&budget, &reader));
+}
+END_TEST
+
+START_TEST(large_write)
+{
+	stage_budget_t budget;
+	budget_claim_t claim;
+
+	// a single write bigger than a chunk
+	stage_budget_init(&budget, 0, 10 * STAGE_BUDGET_BYTES_CHUNK);
+	budget_claim_init(&claim);
+
+	ck_assert(stage_budget_take_op(&budget, &claim));
+	stage_budget_take_bytes(&budget, &claim, 4 * STAGE_BUDGET_BYTES_CHUNK);
+	ck_assert(stage_budget_take_op(&budget, &claim));
+	stage_budget_take_bytes(&budget, &claim, 4 * STAGE_BUDGET_BYTES_CHUNK);
+	ck_assert(stage_budget_take_op(&budget, &claim));
+	stage_budget_take_bytes(&budget, &claim, 4 * STAGE_BUDGET_BYTES_CHUNK);
+	ck_assert(!stage_budget_take_op(&budget, &claim));
+}
+END_TEST
+
+START_TEST(ops_and_bytes)
+{
+	stage_budget_t budget;
+	budget_claim_t claim;
+	uint64_t n_ops = 0;
+
+	// whichever runs out first ends it
+	stage_budget_init(&budget, 5, 1000000000);
+	budget_claim_init(&claim);
+	while (stage_budget_take_op(&budget, &claim)) {
+		stage_budget_take_bytes(&budget, &claim, 100);
+		n_ops++;
+	}
+	ck_assert_uint_eq(n_ops, 5);
+}
+END_TEST
+
+
+Suite*
+stage_budget_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Stage Budget");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, unlimited);
+	tcase_add_test(tc_core, ops);
+	tcase_add_test(tc_core, ops_threads);
+	tcase_add_test(tc_core, bytes);
+	tcase_add_test(tc_core, large_write);
+	tcase_add_test(tc_core, ops_and_bytes);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
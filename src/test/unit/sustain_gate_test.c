@@ -0,0 +1,223 @@
+#include <check.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <sustain_gate.h>
+
+
+#define TEST_SUITE_NAME "sustain gate"
+
+#define N_THREADS 4
+#define N_TAKES 100000
+#define PERIOD 100
+
+
+// what the gate is opened for, the gate never looks at it
+static int g_stage;
+#define STAGE ((const struct stage_s*) &g_stage)
+
+struct take_s {
+	sustain_gate_t* gate;
+	// a clock shared by the takers, which moves on by one with every take
+	_Atomic(uint64_t)* now;
+	uint32_t n_taken;
+};
+
+struct reissue_s {
+	sustain_gate_t* gate;
+	atomic_bool entered;
+	atomic_bool left;
+};
+
+static void*
+take_many(void* udata)
+{
+	struct take_s* args = (struct take_s*) udata;
+
+	for (uint32_t i = 0; i < N_TAKES; i++) {
+		uint64_t now = atomic_fetch_add(args->now, 1);
+		if (sustain_gate_take_permit(args->gate, now)) {
+			args->n_taken++;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * a callback which takes its time reissuing
+ */
+static void*
+slow_reissue(void* udata)
+{
+	struct reissue_s* args = (struct reissue_s*) udata;
+
+	ck_assert_ptr_eq(sustain_gate_enter(args->gate), STAGE);
+	atomic_store(&args->entered, true);
+	usleep(100000);
+	atomic_store(&args->left, true);
+	sustain_gate_leave(args->gate);
+	return NULL;
+}
+
+
+START_TEST(unthrottled)
+{
+	sustain_gate_t gate;
+
+	sustain_gate_init(&gate);
+	sustain_gate_open(&gate, STAGE, 0, 1000);
+	ck_assert(!sustain_gate_throttled(&gate));
+
+	// there's always a permit, whatever the time
+	for (uint32_t i = 0; i < 1000; i++) {
+		ck_assert(sustain_gate_take_permit(&gate, 0));
+		ck_assert(sustain_gate_take_permit(&gate, 1000));
+	}
+}
+END_TEST
+
+START_TEST(throttled)
+{
+	sustain_gate_t gate;
+
+	sustain_gate_init(&gate);
+	ck_assert(!sustain_gate_throttled(&gate));
+
+	sustain_gate_open(&gate, STAGE, PERIOD, 1000);
+	ck_assert(sustain_gate_throttled(&gate));
+
+	ck_assert(!sustain_gate_take_permit(&gate, 999));
+	ck_assert(sustain_gate_take_permit(&gate, 1000));
+	ck_assert(!sustain_gate_take_permit(&gate, 1000));
+	ck_assert_uint_eq(sustain_gate_next_permit(&gate), 1000 + PERIOD);
+
+	// a late permit doesn't push the ones after it back
+	ck_assert(sustain_gate_take_permit(&gate, 1000 + PERIOD + 50));
+	ck_assert(!sustain_gate_take_permit(&gate, 1000 + 2 * PERIOD - 1));
+	ck_assert(sustain_gate_take_permit(&gate, 1000 + 2 * PERIOD));
+
+	sustain_gate_close(&gate);
+	ck_assert(!sustain_gate_throttled(&gate));
+}
+END_TEST
+
+START_TEST(no_burst_after_stall)
+{
+	sustain_gate_t gate;
+	uint64_t now = 1000 + 50 * PERIOD;
+
+	sustain_gate_init(&gate);
+	sustain_gate_open(&gate, STAGE, PERIOD, 1000);
+
+	// the 50 permits missed while nothing was taking them are dropped
+	ck_assert(sustain_gate_take_permit(&gate, now));
+	for (uint32_t i = 0; i < 50; i++) {
+		ck_assert(!sustain_gate_take_permit(&gate, now));
+	}
+
+	// and the permits are a period apart again from then on
+	ck_assert(!sustain_gate_take_permit(&gate, now + PERIOD - 1));
+	ck_assert(sustain_gate_take_permit(&gate, now + PERIOD));
+	ck_assert(!sustain_gate_take_permit(&gate, now + PERIOD));
+}
+END_TEST
+
+START_TEST(concurrent_takers)
+{
+	sustain_gate_t gate;
+	_Atomic(uint64_t) now = 0;
+	pthread_t threads[N_THREADS];
+	struct take_s args[N_THREADS];
+
+	sustain_gate_init(&gate);
+	sustain_gate_open(&gate, STAGE, PERIOD, 0);
+
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		args[i] = (struct take_s) { &gate, &now, 0 };
+		pthread_create(&threads[i], NULL, take_many, &args[i]);
+	}
+
+	uint32_t n_taken = 0;
+	for (uint32_t i = 0; i < N_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		n_taken += args[i].n_taken;
+	}
+
+	// no permit is handed out twice, and no more than one per period
+	uint64_t n_periods = N_THREADS * N_TAKES / PERIOD;
+	ck_assert_uint_le(n_taken, n_periods);
+	ck_assert_uint_ge(sustain_gate_next_permit(&gate), n_taken * PERIOD);
+	// a taker that read the clock and was held up can lose a permit, but
+	// most periods have one taken
+	ck_assert_uint_ge(n_taken, n_periods / 2);
+}
+END_TEST
+
+START_TEST(enter_closed)
+{
+	sustain_gate_t gate;
+
+	sustain_gate_init(&gate);
+	ck_assert_ptr_null(sustain_gate_enter(&gate));
+	sustain_gate_leave(&gate);
+
+	sustain_gate_open(&gate, STAGE, 0, 0);
+	ck_assert_ptr_eq(sustain_gate_enter(&gate), STAGE);
+	sustain_gate_leave(&gate);
+
+	sustain_gate_close(&gate);
+	ck_assert_ptr_null(sustain_gate_enter(&gate));
+	sustain_gate_leave(&gate);
+	ck_assert_uint_eq(atomic_load(&gate.n_entered), 0);
+}
+END_TEST
+
+START_TEST(close_waits_for_reissue)
+{
+	sustain_gate_t gate;
+	pthread_t thread;
+	struct reissue_s args = { &gate, false, false };
+
+	sustain_gate_init(&gate);
+	sustain_gate_open(&gate, STAGE, 0, 0);
+
+	pthread_create(&thread, NULL, slow_reissue, &args);
+	while (!atomic_load(&args.entered)) {
+		usleep(1000);
+	}
+
+	// the stage can't go while the callback is still using it
+	sustain_gate_close(&gate);
+	ck_assert(atomic_load(&args.left));
+	pthread_join(thread, NULL);
+
+	ck_assert_ptr_null(sustain_gate_enter(&gate));
+	sustain_gate_leave(&gate);
+}
+END_TEST
+
+
+Suite*
+sustain_gate_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Sustain Gate");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, unthrottled);
+	tcase_add_test(tc_core, throttled);
+	tcase_add_test(tc_core, no_burst_after_stall);
+	tcase_add_test(tc_core, concurrent_takers);
+	tcase_add_test(tc_core, enter_closed);
+	tcase_add_test(tc_core, close_waits_for_reissue);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
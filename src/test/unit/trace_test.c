@@ -0,0 +1,209 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <trace.h>
+
+
+#define TEST_SUITE_NAME "trace"
+
+#define RECORDS_PER_SEGMENT (TRACE_SEGMENT_SIZE / sizeof(struct trace_record_s))
+
+
+/*
+ * makes a unique prefix for trace files, the calling thread's file is
+ * <prefix>.0
+ */
+static void
+make_prefix(char* prefix, char* path)
+{
+	strcpy(prefix, "/tmp/trace_test_XXXXXX");
+	int fd = mkstemp(prefix);
+	ck_assert_int_ge(fd, 0);
+	close(fd);
+	unlink(prefix);
+	sprintf(path, "%s.0", prefix);
+}
+
+/*
+ * decodes the trace at path, returning the CSV lines after the header in a
+ * buffer that must be freed
+ */
+static char*
+decode(const char* path)
+{
+	char* buf;
+	size_t len;
+	FILE* out = open_memstream(&buf, &len);
+	ck_assert_int_eq(trace_decode(path, out), 0);
+	fclose(out);
+
+	const char* header = "writer,start_us,end_us,latency_us,op,key,"
+		"batch_size,status\n";
+	ck_assert_int_eq(strncmp(buf, header, strlen(header)), 0);
+	memmove(buf, buf + strlen(header), len - strlen(header) + 1);
+	return buf;
+}
+
+static uint32_t
+count_lines(const char* buf)
+{
+	uint32_t n = 0;
+	for (const char* p = buf; *p != '\0'; p++) {
+		n += *p == '\n';
+	}
+	return n;
+}
+
+
+START_TEST(round_trip)
+{
+	char prefix[64];
+	char path[80];
+	make_prefix(prefix, path);
+
+	trace_t* trace = trace_create(prefix, 1);
+	int64_t offset = trace->realtime_offset_us;
+
+	as_key key;
+	as_key_init_int64(&key, "test", "testset", 42);
+	trace_record(trace, TRACE_OP_WRITE, 1000, 1250, AEROSPIKE_OK, 0, &key);
+	trace_record(trace, TRACE_OP_READ, 2000, 2900, AEROSPIKE_ERR_TIMEOUT, 8,
+			NULL);
+	trace_free(trace);
+
+	char* buf = decode(path);
+	char expected[256];
+	snprintf(expected, sizeof(expected),
+			"0,%" PRId64 ",%" PRId64 ",250,write,42,0,0\n"
+			"0,%" PRId64 ",%" PRId64 ",900,read,,8,%d\n",
+			offset + 1000, offset + 1250, offset + 2000, offset + 2900,
+			AEROSPIKE_ERR_TIMEOUT);
+	ck_assert_str_eq(buf, expected);
+
+	free(buf);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(sampling)
+{
+	char prefix[64];
+	char path[80];
+	make_prefix(prefix, path);
+
+	trace_t* trace = trace_create(prefix, 4);
+	for (uint32_t i = 0; i < 100; i++) {
+		trace_record(trace, TRACE_OP_READ, i + 1, i + 2, AEROSPIKE_OK, 0,
+				NULL);
+	}
+	trace_free(trace);
+
+	char* buf = decode(path);
+	ck_assert_uint_eq(count_lines(buf), 25);
+	free(buf);
+	unlink(path);
+}
+END_TEST
+
+/*
+ * a trace that wasn't closed is still full of zeroes past the last record
+ */
+START_TEST(unclosed_trace)
+{
+	char prefix[64];
+	char path[80];
+	make_prefix(prefix, path);
+
+	trace_t* trace = trace_create(prefix, 1);
+	for (uint32_t i = 0; i < 10; i++) {
+		trace_record(trace, TRACE_OP_UDF, i + 1, i + 2, AEROSPIKE_OK, 0, NULL);
+	}
+
+	struct stat st;
+	ck_assert_int_eq(stat(path, &st), 0);
+	ck_assert_int_eq(st.st_size, TRACE_SEGMENT_SIZE);
+
+	char* buf = decode(path);
+	ck_assert_uint_eq(count_lines(buf), 10);
+	free(buf);
+
+	trace_free(trace);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(segment_rollover)
+{
+	char prefix[64];
+	char path[80];
+	make_prefix(prefix, path);
+
+	// the header takes up the first two record slots of the first segment
+	uint64_t n_recs = RECORDS_PER_SEGMENT + 100;
+	trace_t* trace = trace_create(prefix, 1);
+	for (uint64_t i = 0; i < n_recs; i++) {
+		trace_record(trace, TRACE_OP_WRITE, i, i + 1, AEROSPIKE_OK, 0, NULL);
+	}
+	trace_free(trace);
+
+	struct stat st;
+	ck_assert_int_eq(stat(path, &st), 0);
+	ck_assert_int_eq(st.st_size, sizeof(struct trace_header_s) +
+			n_recs * sizeof(struct trace_record_s));
+
+	FILE* f = fopen(path, "r");
+	struct trace_record_s rec;
+	for (uint64_t i = RECORDS_PER_SEGMENT - 4; i < n_recs; i++) {
+		fseek(f, sizeof(struct trace_header_s) + i * sizeof(rec), SEEK_SET);
+		ck_assert_uint_eq(fread(&rec, sizeof(rec), 1, f), 1);
+		ck_assert_uint_eq(rec.start_us, i);
+		ck_assert_uint_eq(rec.end_us, i + 1);
+	}
+	fclose(f);
+	unlink(path);
+}
+END_TEST
+
+START_TEST(decode_invalid)
+{
+	char path[64];
+	strcpy(path, "/tmp/trace_test_XXXXXX");
+	int fd = mkstemp(path);
+	ck_assert_int_ge(fd, 0);
+	ck_assert_int_eq(write(fd, "not a trace", 11), 11);
+	close(fd);
+
+	FILE* out = fopen("/dev/null", "w");
+	ck_assert_int_ne(trace_decode(path, out), 0);
+	ck_assert_int_ne(trace_decode("/nonexistent/trace", out), 0);
+	fclose(out);
+	unlink(path);
+}
+END_TEST
+
+
+Suite*
+trace_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Trace");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, round_trip);
+	tcase_add_test(tc_core, sampling);
+	tcase_add_test(tc_core, unclosed_trace);
+	tcase_add_test(tc_core, segment_rollover);
+	tcase_add_test(tc_core, decode_invalid);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -0,0 +1,145 @@
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common.h>
+#include <warmup_stats.h>
+
+
+#define TEST_SUITE_NAME "warmup stats"
+
+
+static uint64_t
+op_count(warmup_stats_t* ws, group_op_t op)
+{
+	struct group_op_stats_s* stats = &ws->ops[op];
+	return stats->ok + stats->miss + stats->timeouts + stats->errors;
+}
+
+
+START_TEST(active)
+{
+	warmup_stats_t* ws = warmup_stats_create(false);
+
+	// no stage warms up
+	ck_assert(!warmup_stats_active(NULL));
+
+	ck_assert(!warmup_stats_active(ws));
+	warmup_stats_begin(ws);
+	ck_assert(warmup_stats_active(ws));
+	warmup_stats_end(ws);
+	ck_assert(!warmup_stats_active(ws));
+
+	warmup_stats_free(ws);
+}
+END_TEST
+
+START_TEST(record)
+{
+	warmup_stats_t* ws = warmup_stats_create(false);
+
+	warmup_stats_begin(ws);
+	warmup_stats_record(ws, GROUP_OP_READ, 10, AEROSPIKE_OK);
+	warmup_stats_record(ws, GROUP_OP_READ, 10, AEROSPIKE_ERR_RECORD_NOT_FOUND);
+	warmup_stats_record(ws, GROUP_OP_WRITE, 10, AEROSPIKE_ERR_TIMEOUT);
+	warmup_stats_record(ws, GROUP_OP_UDF, 10, AEROSPIKE_ERR_RECORD_NOT_FOUND);
+	warmup_stats_record(ws, GROUP_OP_UDF, 10, AEROSPIKE_ERR_CLIENT);
+	warmup_stats_end(ws);
+
+	ck_assert_uint_eq(ws->ops[GROUP_OP_READ].ok, 1);
+	ck_assert_uint_eq(ws->ops[GROUP_OP_READ].miss, 1);
+	ck_assert_uint_eq(ws->ops[GROUP_OP_WRITE].timeouts, 1);
+	ck_assert_uint_eq(ws->ops[GROUP_OP_UDF].ok, 1);
+	ck_assert_uint_eq(ws->ops[GROUP_OP_UDF].errors, 1);
+
+	// the counts last until the next warmup
+	warmup_stats_print(ws, NULL, stdout);
+	ck_assert_uint_eq(op_count(ws, GROUP_OP_READ), 2);
+
+	warmup_stats_begin(ws);
+	ck_assert_uint_eq(op_count(ws, GROUP_OP_READ), 0);
+	ck_assert_uint_eq(op_count(ws, GROUP_OP_WRITE), 0);
+	ck_assert_uint_eq(op_count(ws, GROUP_OP_UDF), 0);
+	warmup_stats_end(ws);
+
+	warmup_stats_free(ws);
+}
+END_TEST
+
+START_TEST(latency)
+{
+	warmup_stats_t* ws = warmup_stats_create(true);
+
+	warmup_stats_begin(ws);
+	warmup_stats_record(ws, GROUP_OP_WRITE, 100, AEROSPIKE_OK);
+	warmup_stats_record(ws, GROUP_OP_WRITE, 100, AEROSPIKE_ERR_TIMEOUT);
+	ck_assert_int_eq(hdr_total_count(ws->ops[GROUP_OP_WRITE].hdr), 1);
+	warmup_stats_end(ws);
+
+	// each warmup starts its histograms over
+	warmup_stats_begin(ws);
+	ck_assert_int_eq(hdr_total_count(ws->ops[GROUP_OP_WRITE].hdr), 0);
+	warmup_stats_end(ws);
+
+	warmup_stats_free(ws);
+}
+END_TEST
+
+START_TEST(take_period)
+{
+	warmup_stats_t* ws = warmup_stats_create(false);
+	struct interval_counts_s counts[GROUP_OP_COUNT];
+
+	// no stage warms up
+	warmup_stats_take_period(NULL, counts);
+	ck_assert_uint_eq(counts[GROUP_OP_READ].ok, 0);
+
+	warmup_stats_begin(ws);
+	warmup_stats_record(ws, GROUP_OP_READ, 10, AEROSPIKE_OK);
+	warmup_stats_record(ws, GROUP_OP_READ, 10, AEROSPIKE_ERR_RECORD_NOT_FOUND);
+	warmup_stats_record(ws, GROUP_OP_WRITE, 10, AEROSPIKE_OK);
+	warmup_stats_record(ws, GROUP_OP_UDF, 10, AEROSPIKE_ERR_TIMEOUT);
+	warmup_stats_add_bytes(ws, 100);
+
+	warmup_stats_take_period(ws, counts);
+	ck_assert_uint_eq(counts[GROUP_OP_READ].ok, 1);
+	ck_assert_uint_eq(counts[GROUP_OP_READ].miss, 1);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].ok, 1);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].bytes, 100);
+	ck_assert_uint_eq(counts[GROUP_OP_UDF].timeouts, 1);
+
+	// each period starts over, while the warmup keeps counting
+	warmup_stats_record(ws, GROUP_OP_WRITE, 10, AEROSPIKE_ERR_CLIENT);
+	warmup_stats_end(ws);
+
+	warmup_stats_take_period(ws, counts);
+	ck_assert_uint_eq(counts[GROUP_OP_READ].ok, 0);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].ok, 0);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].errors, 1);
+	ck_assert_uint_eq(counts[GROUP_OP_WRITE].bytes, 0);
+	ck_assert_uint_eq(op_count(ws, GROUP_OP_WRITE), 2);
+
+	warmup_stats_free(ws);
+}
+END_TEST
+
+
+Suite*
+warmup_stats_suite(void)
+{
+	Suite* s;
+	TCase* tc_core;
+
+	s = suite_create("Warmup Stats");
+
+	tc_core = tcase_create("Core");
+	tcase_add_test(tc_core, active);
+	tcase_add_test(tc_core, record);
+	tcase_add_test(tc_core, latency);
+	tcase_add_test(tc_core, take_period);
+	suite_add_tcase(s, tc_core);
+
+	return s;
+}
+
@@ -1,6 +1,7 @@
 
 #include <check.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <cyaml/cyaml.h>
 
@@ -43,6 +44,7 @@ static void assert_workloads_eq(const stages_t* parsed,
 		ck_assert(a->random == b->random);
 
 		ck_assert_uint_eq(a->workload.type, b->workload.type);
+		ck_assert(a->workload.shuffle == b->workload.shuffle);
 		if (a->workload.type == WORKLOAD_TYPE_RU) {
 			ck_assert_float_eq(a->workload.read_pct, b->workload.read_pct);
 		}
@@ -822,6 +824,41 @@ DEFINE_TEST(test_workload_db,
 		});
 
 
+DEFINE_TEST(test_workload_i_shuffle,
+		"- stage: 1\n"
+		"  desc: \"test stage\"\n"
+		"  duration: 20\n"
+		"  workload: I,shuffle\n",
+		((stages_t) {
+			(stage_t[]) {{
+				.duration = 20,
+				.desc = "test stage",
+				.tps = 0,
+				.ttl = 0,
+				.key_start = 1,
+				.key_end = 100001,
+				.pause = 0,
+				.batch_size = 1,
+				.batch_read_size = 1,
+				.batch_write_size = 1,
+				.batch_delete_size = 1,
+				.async = false,
+				.random = false,
+				.workload = (workload_t) {
+					.type = WORKLOAD_TYPE_I,
+					.shuffle = true
+				},
+				.read_bins = NULL,
+				.write_bins = NULL
+			},},
+			1,
+			true
+		}),
+		(char*[]) {
+			"I4"
+		});
+
+
 DEFINE_UDF_TEST(test_workload_rud_default,
 		"- stage: 1\n"
 		"  desc: \"test stage\"\n"
@@ -1021,11 +1058,224 @@ DEFINE_TEST(test_write_bins,
 		});
 
 
+/*
+ * loads file_contents as the workload stages file with 8 threads, returning
+ * the result of _load_defaults_post
+ */
+static int
+load_stages_file(args_t* args, const char* file_contents)
+{
+	FILE* tmp = fopen(TMP_FILE_LOC "/test.yml", "w+");
+	ck_assert_ptr_ne(tmp, NULL);
+
+	_load_defaults(args);
+	args->transaction_worker_threads = 8;
+	args->start_key = 1;
+	args->keys = 100000;
+
+	fwrite(file_contents, 1, strlen(file_contents), tmp);
+	fclose(tmp);
+	args->workload_stages_file = strdup(TMP_FILE_LOC "/test.yml");
+
+	int ret = _load_defaults_post(args);
+	remove(TMP_FILE_LOC "/test.yml");
+	return ret;
+}
+
+START_TEST(test_group)
+{
+	args_t args;
+
+	ck_assert_int_eq(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  duration: 5\n"
+				"  workload: I\n"
+				"- stage: 2\n"
+				"  desc: \"reads\"\n"
+				"  duration: 20\n"
+				"  workload: RU,100\n"
+				"- stage: 2\n"
+				"  duration: 30\n"
+				"  workload: RU,0\n"
+				"  threads: 2\n"
+				"- stage: 2\n"
+				"  workload: RU\n"
+				"  pause: 3\n"
+				"  warmup: 10\n"));
+
+	stage_t* stages = args.stages.stages;
+	ck_assert_uint_eq(args.stages.n_stages, 4);
+
+	// a stage on its own gets all of the threads
+	ck_assert_uint_eq(stages[0].group, 0);
+	ck_assert_uint_eq(stages[0].first_thread, 0);
+	ck_assert_uint_eq(stages[0].n_threads, 8);
+	ck_assert_uint_eq(stages[0].duration, 5);
+	ck_assert_uint_eq(stages[0].warmup, 0);
+
+	// the threads not explicitly given out are split evenly
+	ck_assert_uint_eq(stages[1].group, 1);
+	ck_assert_uint_eq(stages[1].group_pos, 0);
+	ck_assert_uint_eq(stages[1].first_thread, 0);
+	ck_assert_uint_eq(stages[1].n_threads, 3);
+	ck_assert_uint_eq(stages[2].group, 1);
+	ck_assert_uint_eq(stages[2].group_pos, 1);
+	ck_assert_uint_eq(stages[2].first_thread, 3);
+	ck_assert_uint_eq(stages[2].n_threads, 2);
+	ck_assert_uint_eq(stages[3].first_thread, 5);
+	ck_assert_uint_eq(stages[3].n_threads, 3);
+
+	// the stage runs as long as its longest workload
+	for (uint32_t i = 1; i < 4; i++) {
+		ck_assert_uint_eq(stages[i].duration, 30);
+		ck_assert_uint_eq(stages[i].pause, 3);
+		ck_assert_uint_eq(stages[i].warmup, 10);
+	}
+
+	ck_assert_str_eq(stages[1].desc, "reads");
+	ck_assert_str_eq(stages[2].desc, "workload 2");
+	ck_assert_str_eq(stages[3].desc, "workload 3");
+
+	_free_args(&args);
+}
+END_TEST
+
+START_TEST(test_stage_concurrency)
+{
+	args_t args;
+
+	ck_assert_int_eq(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: I\n"
+				"  threads: 2\n"
+				"  batch-size: 100\n"
+				"  batch-concurrent: true\n"
+				"- stage: 2\n"
+				"  workload: RU,100\n"
+				"  threads: 6\n"
+				"- stage: 2\n"
+				"  workload: RU,0\n"
+				"  threads: 4\n"
+				"  async: true\n"
+				"  async-max-commands: 200\n"
+				"- stage: 3\n"
+				"  workload: RU\n"
+				"  async: true\n"));
+
+	stage_t* stages = args.stages.stages;
+
+	// a stage can run on fewer threads than --threads
+	ck_assert_uint_eq(stages[0].n_threads, 2);
+	ck_assert(stage_runs_thread(&stages[0], 1));
+	ck_assert(!stage_runs_thread(&stages[0], 2));
+	ck_assert(stages[0].batch_concurrent);
+
+	// or more, which grows the threads to the most any stage needs
+	ck_assert_uint_eq(stages[1].first_thread, 0);
+	ck_assert_uint_eq(stages[2].first_thread, 6);
+	ck_assert_uint_eq(stages[2].n_threads, 4);
+	ck_assert_uint_eq(stages[3].n_threads, 8);
+	ck_assert_uint_eq(stages_n_threads(&args.stages), 10);
+	ck_assert_int_eq(args.transaction_worker_threads, 10);
+	ck_assert(!stages[1].batch_concurrent);
+
+	ck_assert_uint_eq(stages[2].async_max_commands, 200);
+	ck_assert_uint_eq(stages[3].async_max_commands,
+			(uint32_t) args.async_max_commands);
+	ck_assert_uint_eq(stages_async_max_commands(&args.stages), 200);
+
+	_free_args(&args);
+}
+END_TEST
+
+START_TEST(test_budget)
+{
+	args_t args;
+
+	ck_assert_int_eq(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: RU\n"
+				"  ops: 1000\n"
+				"  bytes: 5000\n"
+				"- stage: 2\n"
+				"  workload: RU\n"
+				"  ops: 1000\n"
+				"  duration: 20\n"
+				"- stage: 3\n"
+				"  workload: RU\n"));
+
+	stage_t* stages = args.stages.stages;
+
+	// a workload with a budget runs until it's spent
+	ck_assert_uint_eq(stages[0].ops, 1000);
+	ck_assert_uint_eq(stages[0].bytes, 5000);
+	ck_assert_uint_eq(stages[0].duration, 0);
+	ck_assert(stage_has_budget(&stages[0]));
+
+	// unless its duration runs out first
+	ck_assert_uint_eq(stages[1].duration, 20);
+
+	ck_assert(!stage_has_budget(&stages[2]));
+	ck_assert_uint_eq(stages[2].duration, DEFAULT_RANDOM_DURATION);
+	ck_assert(stages_contain_budgets(&args.stages));
+
+	_free_args(&args);
+
+	// a read-only workload never writes its bytes
+	ck_assert_int_ne(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: RU,100\n"
+				"  bytes: 5000\n"));
+}
+END_TEST
+
+START_TEST(test_group_invalid)
+{
+	args_t args;
+
+	// stage numbers can't skip ahead
+	ck_assert_int_ne(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: I\n"
+				"- stage: 3\n"
+				"  workload: RU\n"));
+	_free_args(&args);
+
+	// more threads than are allowed
+	ck_assert_int_ne(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: RU\n"
+				"  threads: 6000\n"
+				"- stage: 1\n"
+				"  workload: RU\n"
+				"  threads: 6000\n"));
+	_free_args(&args);
+
+	ck_assert_int_ne(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: RU\n"
+				"  async: true\n"
+				"  async-max-commands: 6000\n"));
+	_free_args(&args);
+
+	// no threads left for the second workload
+	ck_assert_int_ne(0, load_stages_file(&args,
+				"- stage: 1\n"
+				"  workload: RU\n"
+				"  threads: 8\n"
+				"- stage: 1\n"
+				"  workload: RU\n"));
+	_free_args(&args);
+}
+END_TEST
+
+
 Suite*
 yaml_parse_suite(void)
 {
 	Suite* s;
 	TCase* tc_simple;
+	TCase* tc_groups;
 
 	s = suite_create("Yaml");
 
@@ -1051,11 +1301,19 @@ yaml_parse_suite(void)
 	tcase_add_test(tc_simple, test_workload_rud_default);
 	tcase_add_test(tc_simple, test_workload_rud_pct);
 	tcase_add_test(tc_simple, test_workload_db);
+	tcase_add_test(tc_simple, test_workload_i_shuffle);
 	tcase_add_test(tc_simple, test_obj_spec);
 	tcase_add_test(tc_simple, test_read_bins);
 	tcase_add_test(tc_simple, test_write_bins);
 	suite_add_tcase(s, tc_simple);
 
+	tc_groups = tcase_create("Groups");
+	tcase_add_test(tc_groups, test_group);
+	tcase_add_test(tc_groups, test_stage_concurrency);
+	tcase_add_test(tc_groups, test_budget);
+	tcase_add_test(tc_groups, test_group_invalid);
+	suite_add_tcase(s, tc_groups);
+
 	return s;
 }
 